@@ -0,0 +1,165 @@
+//=============================================================================
+// AllocationCheck.cpp
+// ~~~~~~~~~~~~~~~~~~~
+//
+// Counts heap allocations of the steady-state decode path by interposing
+// malloc and friends ( glibc only ). Frames come from pools, are validated,
+// decoded, copied into a CompactFrame, visited and released, as a client
+// would do it. Exits with status 1 if any allocation happened after the
+// scene stopped changing.
+//
+// Usage: allocationCheck [frames]
+//=============================================================================
+
+#include "CompactFrame.h"
+#include "FramePool.h"
+#include "FrameVisitor.h"
+#include "NatNetDecoder.h"
+#include "SyntheticFrames.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined( __GLIBC__ )
+
+extern "C" void* __libc_malloc( size_t size );
+extern "C" void* __libc_calloc( size_t count, size_t size );
+extern "C" void* __libc_realloc( void* ptr, size_t size );
+extern "C" void* __libc_memalign( size_t alignment, size_t size );
+extern "C" void __libc_free( void* ptr );
+
+static std::atomic<long> gAllocations( 0 );
+
+extern "C" void* malloc( size_t size )
+{
+    gAllocations.fetch_add( 1, std::memory_order_relaxed );
+    return __libc_malloc( size );
+}
+
+extern "C" void* calloc( size_t count, size_t size )
+{
+    gAllocations.fetch_add( 1, std::memory_order_relaxed );
+    return __libc_calloc( count, size );
+}
+
+extern "C" void* realloc( void* ptr, size_t size )
+{
+    gAllocations.fetch_add( 1, std::memory_order_relaxed );
+    return __libc_realloc( ptr, size );
+}
+
+extern "C" void* aligned_alloc( size_t alignment, size_t size )
+{
+    gAllocations.fetch_add( 1, std::memory_order_relaxed );
+    return __libc_memalign( alignment, size );
+}
+
+extern "C" int posix_memalign( void** ptr, size_t alignment, size_t size )
+{
+    gAllocations.fetch_add( 1, std::memory_order_relaxed );
+    *ptr = __libc_memalign( alignment, size );
+    return *ptr ? 0 : 12;   // ENOMEM
+}
+
+extern "C" void free( void* ptr )
+{
+    __libc_free( ptr );
+}
+
+/**
+ * \brief Decode count frames from packets through the pools and return the # of heap allocations.
+ */
+static long RunFrames( const std::vector<std::vector<char>>& packets, int count, int major, int minor,
+    FramePool<sDecodedFrame>& decodedFrames, FramePool<CompactFrame>& compactFrames, FrameVisitor& visitor )
+{
+    FrameValidator validator = SelectFrameValidator( major, minor );
+    FrameDecoder decoder = SelectFrameDecoder( major, minor );
+
+    long before = gAllocations.load();
+    for( int i = 0; i < count; i++ )
+    {
+        const std::vector<char>& packet = packets[i % packets.size()];
+        if( ValidatePacket( packet.data(), packet.size(), validator, major, minor ) != PacketError_None )
+        {
+            fprintf( stderr, "synthetic packet failed validation\n" );
+            exit( 2 );
+        }
+
+        FramePool<sDecodedFrame>::Handle decoded = decodedFrames.Acquire();
+        int messageID = 0;
+        DecodePacket( packet.data(), decoder, major, minor, messageID, *decoded,
+            FrameSection_All | FrameSection_LabeledMarkerArrays );
+
+        FramePool<CompactFrame>::Handle compact = compactFrames.Acquire();
+        compact->Assign( decoded->data );
+        VisitFrame( decoded->data, visitor );
+    }
+    return gAllocations.load() - before;
+}
+
+int main( int argc, char* argv[] )
+{
+    int nFrames = ( argc > 1 ) ? atoi( argv[1] ) : 10000;
+    if( nFrames <= 0 )
+    {
+        fprintf( stderr, "Usage: allocationCheck [frames]\n" );
+        return 1;
+    }
+
+    sSyntheticScene scene;
+    scene.nAssets = 2;
+    scene.nOtherMarkers = 10;
+
+    sSyntheticScene largerScene = scene;
+    largerScene.nMarkersPerSet = 200;
+    largerScene.nSkeletons = 4;
+
+    std::vector<std::vector<char>> packets( 16 );
+    std::vector<std::vector<char>> largerPackets( 16 );
+    for( size_t i = 0; i < packets.size(); i++ )
+    {
+        BuildFramePacket( scene, 4, 1, (int) i, packets[i] );
+        BuildFramePacket( largerScene, 4, 1, (int) i, largerPackets[i] );
+    }
+
+    // Size compact frames for the larger scene, as if from its data descriptions
+    std::unique_ptr<sDecodedFrame> probe( new sDecodedFrame() );
+    int messageID = 0;
+    DecodePacket( largerPackets[0].data(), 4, 1, messageID, *probe );
+    sFrameCapacity capacity = FrameCapacityOf( probe->data );
+
+    FramePool<sDecodedFrame> decodedFrames( 2 );
+    FramePool<CompactFrame> compactFrames( 2, capacity );
+    FrameVisitor visitor;
+
+    long warmup = RunFrames( packets, 100, 4, 1, decodedFrames, compactFrames, visitor );
+    long steady = RunFrames( packets, nFrames, 4, 1, decodedFrames, compactFrames, visitor );
+    long grown = RunFrames( largerPackets, 100, 4, 1, decodedFrames, compactFrames, visitor );
+    long steadyLarger = RunFrames( largerPackets, nFrames, 4, 1, decodedFrames, compactFrames, visitor );
+
+    printf( "Heap allocations\n" );
+    printf( "  warm-up, %5d frames               %ld\n", 100, warmup );
+    printf( "  steady state, %5d frames          %ld\n", nFrames, steady );
+    printf( "  scene grows, %5d frames           %ld\n", 100, grown );
+    printf( "  steady state after growth, %5d    %ld\n", nFrames, steadyLarger );
+
+    if( ( steady != 0 ) || ( steadyLarger != 0 ) )
+    {
+        printf( "FAILED: steady-state decoding allocated\n" );
+        return 1;
+    }
+    printf( "OK: steady-state decoding does not allocate\n" );
+    return 0;
+}
+
+#else
+
+int main()
+{
+    printf( "allocationCheck needs glibc to interpose malloc\n" );
+    return 0;
+}
+
+#endif
@@ -0,0 +1,74 @@
+//=============================================================================
+// ClockSyncCheck.cpp
+// ~~~~~~~~~~~~~~~~~~
+//
+// Checks that ClockSync::AddResponse takes only well-formed NAT_ECHORESPONSE
+// datagrams: a response shorter than its header says, or too short to hold
+// the echoed time and the server ticks, is rejected without reading past
+// the datagram. Exits with status 1 if a check fails.
+//
+// Usage: clockSyncCheck
+//=============================================================================
+
+#include "ClockSync.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const uint64_t kFrequency = 1000000000ull;      // server ticks are ns
+static const int64_t kSent = 5000000000ll;
+static const int64_t kRoundTrip = 100000;
+
+/**
+ * \brief A response to the request sent at kSent, in a buffer with room to spare
+ * that is filled with bytes no response should be read from.
+ */
+static std::vector<char> BuildResponse( uint16_t message, uint16_t nBytes )
+{
+    std::vector<char> packet( 4 + 2 * ECHO_RESPONSE_BYTES, (char) 0x7F );
+    uint16_t header[2] = { message, nBytes };
+    uint64_t serverTicks = 1000000000ull;
+    memcpy( packet.data(), header, 4 );
+    memcpy( packet.data() + 4, &kSent, 8 );
+    memcpy( packet.data() + 12, &serverTicks, 8 );
+    return packet;
+}
+
+static int Check( const char* label, const std::vector<char>& packet, size_t length, bool expectUsed )
+{
+    ClockSync clock;
+    clock.SetServerClockFrequency( kFrequency );
+    bool used = clock.AddResponse( packet.data(), length, kSent + kRoundTrip );
+    sClockSyncStatus status = clock.Status();
+    bool ok = ( used == expectUsed ) && ( status.nSamples == 1 ) && ( status.nRejected == ( expectUsed ? 0u : 1u ) );
+    printf( "  %-44s %s\n", label, ok ? "OK" : "FAILED" );
+    return ok ? 0 : 1;
+}
+
+int main( int /*argc*/, char* /*argv*/[] )
+{
+    std::vector<char> response = BuildResponse( NAT_ECHORESPONSE, ECHO_RESPONSE_BYTES );
+    std::vector<char> longer = BuildResponse( NAT_ECHORESPONSE, ECHO_RESPONSE_BYTES + 8 );
+    std::vector<char> shorter = BuildResponse( NAT_ECHORESPONSE, ECHO_RESPONSE_BYTES - 8 );
+    std::vector<char> other = BuildResponse( NAT_ECHOREQUEST, ECHO_RESPONSE_BYTES );
+
+    printf( "NAT_ECHORESPONSE datagrams:\n" );
+    int nFailed = 0;
+    nFailed += Check( "complete response", response, 4 + ECHO_RESPONSE_BYTES, true );
+    nFailed += Check( "response with more payload", longer, 4 + ECHO_RESPONSE_BYTES + 8, true );
+    nFailed += Check( "truncated response", response, 4 + ECHO_RESPONSE_BYTES - 8, false );
+    nFailed += Check( "header only", response, 4, false );
+    nFailed += Check( "shorter than a packet header", response, 2, false );
+    nFailed += Check( "datagram shorter than its header says", longer, 4 + ECHO_RESPONSE_BYTES, false );
+    nFailed += Check( "payload too short for a response", shorter, 4 + ECHO_RESPONSE_BYTES - 8, false );
+    nFailed += Check( "other message", other, 4 + ECHO_RESPONSE_BYTES, false );
+
+    if( nFailed > 0 )
+    {
+        fprintf( stderr, "%d checks failed\n", nFailed );
+        return 1;
+    }
+    printf( "\nOK: malformed echo responses are rejected\n" );
+    return 0;
+}
@@ -0,0 +1,306 @@
+//=============================================================================
+// CompactStreamBenchmark.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Size, speed and precision of the compact stream format against NatNet:
+// a session of rigid bodies, skeletons and labeled markers moving smoothly
+// with sensor noise and occlusions is encoded at several precisions, decoded
+// again and compared with the original frames.
+//
+// Usage: compactStreamBenchmark [frames]
+//
+// Build with -DCMAKE_BUILD_TYPE=Release for meaningful numbers.
+//=============================================================================
+
+#include "CompactStream.h"
+#include "FrameEncoder.h"
+#include "NatNetDecoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+static const int kRigidBodies = 20;
+static const int kSkeletons = 2;
+static const int kBonesPerSkeleton = 21;
+static const int kMarkersPerRigidBody = 6;
+static const int kUnlabeledMarkers = 40;
+static const double kFrameRate = 120.0;
+static const float kNoise = 0.00002f;       // meters, +-
+
+static const float kPi = 3.14159265f;
+
+/**
+ * \brief Deterministic noise in [-1, 1].
+ */
+static float Noise( uint32_t& state )
+{
+    state = state * 1664525u + 1013904223u;
+    return ( state >> 8 ) / 8388608.0f - 1.0f;
+}
+
+/**
+ * \brief Pose of a body turning about a tilted axis while it circles its center.
+ */
+static void MovingPose( int index, double t, uint32_t& noise, sRigidBodyData& pose )
+{
+    float phase = 0.37f * index;
+    float angle = (float) ( t * ( 0.8 + 0.05 * index ) ) + phase;
+    pose.x = 0.3f * index + 0.5f * std::cos( angle ) + kNoise * Noise( noise );
+    pose.y = 1.0f + 0.2f * std::sin( 2.0f * angle ) + kNoise * Noise( noise );
+    pose.z = 0.5f * std::sin( angle ) + kNoise * Noise( noise );
+    float half = 0.5f * ( 1.3f * angle );
+    float axis[3] = { 0.3f, 0.9f, 0.3f };
+    float norm = std::sqrt( axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] );
+    pose.qx = std::sin( half ) * axis[0] / norm;
+    pose.qy = std::sin( half ) * axis[1] / norm;
+    pose.qz = std::sin( half ) * axis[2] / norm;
+    pose.qw = std::cos( half );
+    pose.MeanError = 0.0002f + 0.00005f * Noise( noise );
+    pose.params = 0x01;
+}
+
+/**
+ * \brief Frame f of the session. Frames are generated when needed: the session
+ * would not fit in memory as sFrameOfMocapData.
+ * \param bones - storage of the skeleton bones, kSkeletons * kBonesPerSkeleton
+ */
+static void BuildFrame( int f, sFrameOfMocapData& frame, sRigidBodyData* bones )
+{
+    uint32_t noise = 12345u + 2654435761u * (uint32_t) f;
+    double t = f / kFrameRate;
+    frame.nMarkerSets = 0;
+    frame.nOtherMarkers = 0;
+    frame.nRigidBodies = 0;
+    frame.nSkeletons = 0;
+    frame.nAssets = 0;
+    frame.nLabeledMarkers = 0;
+    frame.nForcePlates = 0;
+    frame.nDevices = 0;
+    frame.iFrame = 1000 + f;
+    frame.fTimestamp = t;
+    frame.Timecode = 0;
+    frame.TimecodeSubframe = 0;
+    frame.CameraMidExposureTimestamp = 1000000000ull + (uint64_t) ( t * 1e7 );
+    frame.CameraDataReceivedTimestamp = frame.CameraMidExposureTimestamp + 30000 + ( f % 7 );
+    frame.TransmitTimestamp = frame.CameraDataReceivedTimestamp + 20000 + ( f % 5 );
+    frame.PrecisionTimestampSecs = 0;
+    frame.PrecisionTimestampFractionalSecs = 0;
+    frame.params = 0x04;
+
+    for( int i = 0; i < kRigidBodies; i++ )
+    {
+        sRigidBodyData& rigidBody = frame.RigidBodies[frame.nRigidBodies++];
+        MovingPose( i, t, noise, rigidBody );
+        rigidBody.ID = i + 1;
+    }
+
+    for( int s = 0; s < kSkeletons; s++ )
+    {
+        sSkeletonData& skeleton = frame.Skeletons[frame.nSkeletons++];
+        skeleton.skeletonID = 100 + s;
+        skeleton.nRigidBodies = kBonesPerSkeleton;
+        skeleton.RigidBodyData = bones + s * kBonesPerSkeleton;
+        for( int b = 0; b < kBonesPerSkeleton; b++ )
+        {
+            sRigidBodyData& bone = skeleton.RigidBodyData[b];
+            MovingPose( 40 + s * kBonesPerSkeleton + b, t, noise, bone );
+            bone.ID = ( skeleton.skeletonID << 16 ) | ( b + 1 );
+        }
+    }
+
+    // Markers of the rigid bodies, each occluded now and then, then unlabeled ones
+    for( int i = 0; i < kRigidBodies * kMarkersPerRigidBody + kUnlabeledMarkers; i++ )
+    {
+        if( ( f + 7 * i ) % 97 < 3 )
+        {
+            continue;
+        }
+        int body = i / kMarkersPerRigidBody;
+        sMarker& marker = frame.LabeledMarkers[frame.nLabeledMarkers++];
+        sRigidBodyData pose;
+        MovingPose( body, t, noise, pose );
+        float offset = 0.05f * ( i % kMarkersPerRigidBody ) - 0.12f;
+        marker.x = pose.x + offset;
+        marker.y = pose.y + 0.5f * offset;
+        marker.z = pose.z - offset;
+        marker.size = 0.014f;
+        marker.residual = 0.3f + 0.1f * Noise( noise );
+        if( body < kRigidBodies )
+        {
+            marker.ID = ( ( body + 1 ) << 16 ) | ( i % kMarkersPerRigidBody + 1 );
+            marker.params = 0;
+        }
+        else
+        {
+            marker.ID = 50000 + i;
+            marker.params = 0x10;           // unlabeled
+        }
+    }
+}
+
+/**
+ * \brief Angle between two rotations in degrees, from the distance of the quaternions,
+ * which stays precise for small angles.
+ */
+static double RotationError( const sRigidBodyData& a, const sRigidBodyData& b )
+{
+    double minus = 0.0;
+    double plus = 0.0;
+    const float qa[4] = { a.qx, a.qy, a.qz, a.qw };
+    const float qb[4] = { b.qx, b.qy, b.qz, b.qw };
+    for( int i = 0; i < 4; i++ )
+    {
+        minus += ( (double) qa[i] - qb[i] ) * ( (double) qa[i] - qb[i] );
+        plus += ( (double) qa[i] + qb[i] ) * ( (double) qa[i] + qb[i] );
+    }
+    double distance = std::sqrt( std::min( minus, plus ) );
+    return 4.0 * std::asin( std::min( distance / 2.0, 1.0 ) ) * 180.0 / kPi;
+}
+
+static double PositionError( float ax, float ay, float az, float bx, float by, float bz )
+{
+    return std::max( { std::fabs( ax - bx ), std::fabs( ay - by ), std::fabs( az - bz ) } ) * 1000.0;
+}
+
+int main( int argc, char* argv[] )
+{
+    int nFrames = ( argc > 1 ) ? atoi( argv[1] ) : 12000;
+    if( nFrames <= 0 )
+    {
+        fprintf( stderr, "Usage: compactStreamBenchmark [frames]\n" );
+        return 1;
+    }
+
+    std::unique_ptr<sFrameOfMocapData> frame( new sFrameOfMocapData() );
+    std::vector<sRigidBodyData> bones( kSkeletons * kBonesPerSkeleton );
+    std::unique_ptr<sDecodedFrame> decoded( new sDecodedFrame() );
+    printf( "Session: %d frames at %.0f Hz, %d rigid bodies, %d skeletons x %d bones, up to %d labeled markers\n\n",
+        nFrames, kFrameRate, kRigidBodies, kSkeletons, kBonesPerSkeleton,
+        kRigidBodies * kMarkersPerRigidBody + kUnlabeledMarkers );
+
+    // NatNet 4.1 packets of the same contents
+    std::vector<char> buffer( MAX_PACKETSIZE );
+    uint64_t natnetBytes = 0;
+    for( int f = 0; f < nFrames; f++ )
+    {
+        BuildFrame( f, *frame, bones.data() );
+        natnetBytes += EncodeFramePacket( *frame, 4, 1, nullptr, buffer.data(), buffer.size() );
+    }
+    printf( "NatNet 4.1:  %7.0f bytes/frame\n\n", (double) natnetBytes / nFrames );
+
+    // Generating the frames, taken off the encoding time: timing each call instead
+    // would add more than the encoder takes
+    std::chrono::steady_clock::time_point buildStart = std::chrono::steady_clock::now();
+    for( int f = 0; f < nFrames; f++ )
+    {
+        BuildFrame( f, *frame, bones.data() );
+    }
+    double buildTime = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - buildStart ).count();
+
+    const sCompactStreamSettings settings[] = {
+        { 0.001f, 10, 60 },
+        { 0.0001f, 14, 60 },
+        { 0.0001f, 14, 600 },
+        { 0.00001f, 18, 60 },
+    };
+    printf( "Resolution  Rotation  Keyframe   Keyframe  Delta      Ratio   Encode     Decode     Max error\n" );
+    printf( "mm          bits      interval   bytes     bytes              ns/frame   ns/frame   mm / deg\n" );
+
+    // The packets of the session, one after the other
+    std::vector<char> packets;
+    std::vector<size_t> offsets( nFrames + 1 );
+    for( const sCompactStreamSettings& setting : settings )
+    {
+        CompactStreamEncoder encoder( setting );
+        packets.resize( (size_t) nFrames * 4096 );
+        std::chrono::steady_clock::time_point encodeStart = std::chrono::steady_clock::now();
+        uint64_t keyBytes = 0;
+        uint64_t deltaBytes = 0;
+        int nFailed = 0;
+        for( int f = 0; f < nFrames; f++ )
+        {
+            BuildFrame( f, *frame, bones.data() );
+            if( packets.size() - offsets[f] < MAX_PACKETSIZE )
+            {
+                packets.resize( packets.size() * 2 );
+            }
+            size_t length = encoder.Encode( *frame, nullptr, packets.data() + offsets[f], MAX_PACKETSIZE );
+            offsets[f + 1] = offsets[f] + length;
+            bool keyframe = ( length > 4 ) && ( packets[offsets[f] + 4] & 0x01 );
+            ( keyframe ? keyBytes : deltaBytes ) += length;
+            nFailed += ( length == 0 ) ? 1 : 0;
+        }
+        double encodeTime = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - encodeStart ).count() - buildTime;
+
+        CompactStreamDecoder decoder;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for( int f = 0; f < nFrames; f++ )
+        {
+            nFailed += ( decoder.Decode( packets.data() + offsets[f], offsets[f + 1] - offsets[f], *decoded ) != CompactStream_OK ) ? 1 : 0;
+        }
+        double decodeTime = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / nFrames;
+
+        // Precision, frame by frame
+        double maxPosition = 0.0;
+        double maxRotation = 0.0;
+        CompactStreamDecoder checker;
+        for( int f = 0; f < nFrames; f++ )
+        {
+            BuildFrame( f, *frame, bones.data() );
+            checker.Decode( packets.data() + offsets[f], offsets[f + 1] - offsets[f], *decoded );
+            const sFrameOfMocapData& in = *frame;
+            const sFrameOfMocapData& out = decoded->data;
+            if( ( out.iFrame != in.iFrame ) || ( out.nRigidBodies != in.nRigidBodies ) || ( out.nSkeletons != in.nSkeletons )
+                || ( out.nLabeledMarkers != in.nLabeledMarkers ) || ( out.CameraMidExposureTimestamp != in.CameraMidExposureTimestamp ) )
+            {
+                nFailed++;
+                continue;
+            }
+            for( int i = 0; i < in.nRigidBodies; i++ )
+            {
+                const sRigidBodyData& a = in.RigidBodies[i];
+                const sRigidBodyData& b = out.RigidBodies[i];
+                nFailed += ( a.ID != b.ID ) ? 1 : 0;
+                maxPosition = std::max( maxPosition, PositionError( a.x, a.y, a.z, b.x, b.y, b.z ) );
+                maxRotation = std::max( maxRotation, RotationError( a, b ) );
+            }
+            for( int s = 0; s < in.nSkeletons; s++ )
+            {
+                for( int b = 0; b < in.Skeletons[s].nRigidBodies; b++ )
+                {
+                    const sRigidBodyData& x = in.Skeletons[s].RigidBodyData[b];
+                    const sRigidBodyData& y = out.Skeletons[s].RigidBodyData[b];
+                    nFailed += ( x.ID != y.ID ) ? 1 : 0;
+                    maxPosition = std::max( maxPosition, PositionError( x.x, x.y, x.z, y.x, y.y, y.z ) );
+                    maxRotation = std::max( maxRotation, RotationError( x, y ) );
+                }
+            }
+            for( int i = 0; i < in.nLabeledMarkers; i++ )
+            {
+                const sMarker& a = in.LabeledMarkers[i];
+                const sMarker& b = out.LabeledMarkers[i];
+                nFailed += ( a.ID != b.ID ) ? 1 : 0;
+                maxPosition = std::max( maxPosition, PositionError( a.x, a.y, a.z, b.x, b.y, b.z ) );
+            }
+        }
+
+        int nKeyframes = ( nFrames + setting.keyframeInterval - 1 ) / setting.keyframeInterval;
+        int nDeltas = nFrames - nKeyframes;
+        printf( "%-10g  %-8d  %-9d  %-8.0f  %-9.0f  %5.1fx  %-9.0f  %-9.0f  %.4f / %.4f\n",
+            setting.positionResolution * 1000.0f, setting.rotationBits, setting.keyframeInterval,
+            (double) keyBytes / nKeyframes, nDeltas ? (double) deltaBytes / nDeltas : 0.0,
+            (double) natnetBytes / offsets[nFrames], encodeTime / nFrames, decodeTime, maxPosition, maxRotation );
+        if( nFailed > 0 )
+        {
+            fprintf( stderr, "%d frames or elements did not decode to the original\n", nFailed );
+            return 1;
+        }
+    }
+    return 0;
+}
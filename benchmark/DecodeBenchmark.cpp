@@ -0,0 +1,370 @@
+//=============================================================================
+// DecodeBenchmark.cpp
+// ~~~~~~~~~~~~~~~~~~~
+//
+// Measures per-frame decode time on synthetic NAT_FRAMEOFDATA packets.
+//
+// Usage: decodeBenchmark [iterations]
+//
+// Build with -DCMAKE_BUILD_TYPE=Release for meaningful numbers.
+//=============================================================================
+
+#include "CompactFrame.h"
+#include "DataDescriptionCache.h"
+#include "DecodePipeline.h"
+#include "NatNetDecoder.h"
+#include "SyntheticFrames.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const int kNumPackets = 64;         // distinct packets cycled through per run
+
+struct sVersion
+{
+    int major;
+    int minor;
+    const char* label;
+};
+
+/**
+ * \brief Time decoding of packets with decoder and return the mean time per frame in nanoseconds.
+ */
+static double TimeDecode( const std::vector<std::vector<char>>& packets, FrameDecoder decoder,
+    int major, int minor, int iterations, sDecodedFrame& frame, unsigned int sections = FrameSection_All )
+{
+    auto start = std::chrono::steady_clock::now();
+    for( int i = 0; i < iterations; i++ )
+    {
+        int messageID = 0;
+        DecodePacket( packets[i % packets.size()].data(), decoder, major, minor, messageID, frame, sections );
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>( stop - start ).count() / iterations;
+}
+
+/**
+ * \brief Time validation of packets and return the mean time per frame in nanoseconds.
+ */
+static double TimeValidate( const std::vector<std::vector<char>>& packets, FrameValidator validator,
+    int major, int minor, int iterations )
+{
+    int nRejected = 0;
+    auto start = std::chrono::steady_clock::now();
+    for( int i = 0; i < iterations; i++ )
+    {
+        const std::vector<char>& packet = packets[i % packets.size()];
+        if( ValidatePacket( packet.data(), packet.size(), validator, major, minor ) != PacketError_None )
+        {
+            ++nRejected;
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    if( nRejected > 0 )
+    {
+        fprintf( stderr, "%d valid packets rejected\n", nRejected );
+    }
+    return std::chrono::duration<double, std::nano>( stop - start ).count() / iterations;
+}
+
+/**
+ * \brief Time transposing nMarkers labeled marker records and return the mean time per frame in nanoseconds.
+ */
+static double TimeLabeledMarkerRecords( const std::vector<char>& records, int nMarkers, SimdLevel level,
+    int iterations, sLabeledMarkerArrays& arrays )
+{
+    auto start = std::chrono::steady_clock::now();
+    for( int i = 0; i < iterations; i++ )
+    {
+        DecodeLabeledMarkerRecords( records.data(), nMarkers, arrays, level );
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>( stop - start ).count() / iterations;
+}
+
+/**
+ * \brief Stand-in for per-frame client work.
+ */
+static void Spin( int microseconds )
+{
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds( microseconds );
+    while( std::chrono::steady_clock::now() < until ) {}
+}
+
+/**
+ * \brief Push frames through a DecodePipeline, spending workMicroseconds per frame in the
+ * parallel stage, and return the mean time per delivered frame in nanoseconds.
+ * With 0 workers, frames are copied, validated, decoded and worked on by the calling thread instead.
+ */
+static double TimePipeline( const std::vector<std::vector<char>>& packets, int nWorkers, int workMicroseconds, int iterations )
+{
+    DecoderContext context( 4, 1 );
+    long nDelivered = 0;
+    auto start = std::chrono::steady_clock::now();
+    if( nWorkers == 0 )
+    {
+        std::vector<char> datagram( MAX_PACKETSIZE );
+        std::unique_ptr<sDecodedFrame> frame( new sDecodedFrame() );
+        for( int i = 0; i < iterations; i++ )
+        {
+            const std::vector<char>& packet = packets[i % packets.size()];
+            memcpy( datagram.data(), packet.data(), packet.size() );
+            if( ValidatePacket( datagram.data(), packet.size(), context.Validator(), 4, 1 ) == PacketError_None )
+            {
+                int messageID = 0;
+                DecodePacket( datagram.data(), context.Decoder(), 4, 1, messageID, *frame );
+                Spin( workMicroseconds );
+                nDelivered++;
+            }
+        }
+    }
+    else
+    {
+        DecodePipeline pipeline( nWorkers, 16,
+            [&nDelivered]( const sDecodedFrame& ) { nDelivered++; },
+            [workMicroseconds]( sDecodedFrame& ) { Spin( workMicroseconds ); } );
+        for( int i = 0; i < iterations; i++ )
+        {
+            const std::vector<char>& packet = packets[i % packets.size()];
+            while( !pipeline.Push( packet.data(), packet.size(), context ) )
+            {
+                std::this_thread::yield();
+            }
+        }
+        pipeline.Stop();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>( stop - start ).count() / std::max( nDelivered, 1L );
+}
+
+int main( int argc, char* argv[] )
+{
+    int iterations = ( argc > 1 ) ? atoi( argv[1] ) : 20000;
+    if( iterations <= 0 )
+    {
+        fprintf( stderr, "Usage: decodeBenchmark [iterations]\n" );
+        return 1;
+    }
+
+    const sVersion versions[] = {
+        { 3, 1, "3.x " },
+        { 4, 0, "4.0 " },
+        { 4, 1, "4.1+" },
+    };
+
+    sSyntheticScene scene;
+    std::unique_ptr<sDecodedFrame> frame( new sDecodedFrame() );
+
+    printf( "Scene: %d rigid bodies, %d skeletons x %d bones, %d labeled markers, %d force plates, %d devices\n",
+        scene.nRigidBodies, scene.nSkeletons, scene.nBonesPerSkeleton, scene.nLabeledMarkers,
+        scene.nForcePlates, scene.nDevices );
+    printf( "%d iterations per measurement\n\n", iterations );
+    printf( "Version  Bytes  Generic (ns/frame)  Specialized (ns/frame)  Speedup  Rigid bodies only (ns/frame)  Validation (ns/frame)  Overhead\n" );
+
+    for( const sVersion& version : versions )
+    {
+        std::vector<std::vector<char>> packets( kNumPackets );
+        for( int i = 0; i < kNumPackets; i++ )
+        {
+            BuildFramePacket( scene, version.major, version.minor, i, packets[i] );
+        }
+
+        FrameDecoder specialized = SelectFrameDecoder( version.major, version.minor );
+        FrameValidator validator = SelectFrameValidator( version.major, version.minor );
+
+        // warm up
+        TimeDecode( packets, &DecodeFrameDataGeneric, version.major, version.minor, iterations / 10 + 1, *frame );
+        TimeDecode( packets, specialized, version.major, version.minor, iterations / 10 + 1, *frame );
+
+        double generic = TimeDecode( packets, &DecodeFrameDataGeneric, version.major, version.minor, iterations, *frame );
+        double fast = TimeDecode( packets, specialized, version.major, version.minor, iterations, *frame );
+        double rigidBodies = TimeDecode( packets, specialized, version.major, version.minor, iterations, *frame, FrameSection_RigidBodies );
+        double validation = TimeValidate( packets, validator, version.major, version.minor, iterations );
+
+        printf( "%s     %5zu  %18.1f  %22.1f  %6.2fx  %28.1f  %21.1f  %7.1f%%\n", version.label, packets[0].size(), generic, fast, generic / fast,
+            rigidBodies, validation, 100.0 * validation / fast );
+    }
+
+    // Labeled markers: sMarker array vs. structure of arrays ( NatNet 4.1+ frames, labeled markers only )
+    {
+        std::vector<std::vector<char>> packets( kNumPackets );
+        for( int i = 0; i < kNumPackets; i++ )
+        {
+            BuildFramePacket( scene, 4, 1, i, packets[i] );
+        }
+        FrameDecoder decoder = SelectFrameDecoder( 4, 1 );
+
+        std::vector<char> records( MAX_LABELED_MARKERS * LABELED_MARKER_RECORD_SIZE );
+        for( size_t i = 0; i < records.size(); i++ )
+        {
+            records[i] = (char) ( i * 7 );
+        }
+
+        const char* levelNames[] = { "scalar", "SSE4.1", "AVX2" };
+        SimdLevel supported = GetSupportedSimdLevel();
+
+        double aos = TimeDecode( packets, decoder, 4, 1, iterations, *frame, FrameSection_LabeledMarkers );
+        double soa = TimeDecode( packets, decoder, 4, 1, iterations, *frame, FrameSection_LabeledMarkerArrays );
+        printf( "\nLabeled markers only, %d per frame ( 4.1+ ), SIMD level %s\n", scene.nLabeledMarkers, levelNames[supported] );
+        printf( "  sMarker array        %8.1f ns/frame\n", aos );
+        printf( "  structure of arrays  %8.1f ns/frame\n", soa );
+
+        printf( "\nRecord transpose only, %d records\n", scene.nLabeledMarkers );
+        for( int level = SimdLevel_Scalar; level <= supported; level++ )
+        {
+            double t = TimeLabeledMarkerRecords( records, scene.nLabeledMarkers, (SimdLevel) level, iterations, frame->LabeledMarkerArrays );
+            printf( "  %-7s %8.1f ns/frame\n", levelNames[level], t );
+        }
+    }
+
+    // Frame storage: fixed capacity sFrameOfMocapData vs. CompactFrame sized for the scene
+    {
+        std::vector<char> packet;
+        BuildFramePacket( scene, 4, 1, 0, packet );
+        int messageID = 0;
+        DecodePacket( packet.data(), 4, 1, messageID, *frame );
+
+        CompactFrame compact( FrameCapacityOf( frame->data ) );
+        std::unique_ptr<sFrameOfMocapData> copy( new sFrameOfMocapData() );
+
+        auto start = std::chrono::steady_clock::now();
+        for( int i = 0; i < iterations; i++ )
+        {
+            compact.Assign( frame->data );
+        }
+        auto mid = std::chrono::steady_clock::now();
+        for( int i = 0; i < iterations; i++ )
+        {
+            compact.CopyTo( *copy );
+        }
+        auto stop = std::chrono::steady_clock::now();
+
+        printf( "\nFrame storage\n" );
+        printf( "  sFrameOfMocapData  %8zu bytes\n", sizeof( sFrameOfMocapData ) );
+        printf( "  CompactFrame       %8zu bytes ( + %zu bytes object )\n", compact.ReservedBytes(), sizeof( CompactFrame ) );
+        printf( "  Assign             %8.1f ns/frame\n", std::chrono::duration<double, std::nano>( mid - start ).count() / iterations );
+        printf( "  CopyTo             %8.1f ns/frame\n", std::chrono::duration<double, std::nano>( stop - mid ).count() / iterations );
+    }
+
+    // Data descriptions: updates of the cache, and per-frame ID resolution vs. std::map lookups
+    {
+        sSyntheticScene changedScene = scene;
+        changedScene.nRigidBodies++;
+        std::vector<char> description;
+        std::vector<char> changedDescription;
+        BuildDescriptionPacket( scene, 4, 1, description );
+        BuildDescriptionPacket( changedScene, 4, 1, changedDescription );
+        const char* payload = description.data() + 4;
+        const char* changedPayload = changedDescription.data() + 4;
+        int nBytes = (int) description.size() - 4;
+        int nChangedBytes = (int) changedDescription.size() - 4;
+        int nUpdates = iterations / 20 + 1;
+
+        DataDescriptionCache cache;
+        auto start = std::chrono::steady_clock::now();
+        for( int i = 0; i < nUpdates; i++ )
+        {
+            cache.Clear();
+            cache.Update( payload, nBytes, 4, 1 );
+        }
+        auto fullStop = std::chrono::steady_clock::now();
+        for( int i = 0; i < nUpdates; i++ )
+        {
+            cache.Update( payload, nBytes, 4, 1 );
+        }
+        auto sameStop = std::chrono::steady_clock::now();
+        for( int i = 0; i < nUpdates; i++ )
+        {
+            // alternately adds and removes one rigid body
+            if( i & 1 )
+            {
+                cache.Update( payload, nBytes, 4, 1 );
+            }
+            else
+            {
+                cache.Update( changedPayload, nChangedBytes, 4, 1 );
+            }
+        }
+        auto changedStop = std::chrono::steady_clock::now();
+        cache.Update( payload, nBytes, 4, 1 );
+
+        // what SampleClient's UpdateDataToDescriptionMaps builds
+        std::map<int, int> rigidBodyOrder;
+        std::map<int, std::string> rigidBodyNames;
+        for( size_t i = 0; i < cache.RigidBodies().size(); i++ )
+        {
+            rigidBodyOrder[cache.RigidBodies()[i].ID] = (int) i;
+            rigidBodyNames[cache.RigidBodies()[i].ID] = cache.RigidBodies()[i].name;
+        }
+
+        std::vector<char> packet;
+        BuildFramePacket( scene, 4, 1, 0, packet );
+        int messageID = 0;
+        DecodePacket( packet.data(), 4, 1, messageID, *frame );
+        const sFrameOfMocapData& data = frame->data;
+
+        size_t nResolved = 0;
+        auto mapStart = std::chrono::steady_clock::now();
+        for( int i = 0; i < iterations; i++ )
+        {
+            for( int j = 0; j < data.nRigidBodies; j++ )
+            {
+                auto order = rigidBodyOrder.find( data.RigidBodies[j].ID );
+                auto name = rigidBodyNames.find( data.RigidBodies[j].ID );
+                nResolved += ( order != rigidBodyOrder.end() ) + name->second.size();
+            }
+        }
+        auto cacheStart = std::chrono::steady_clock::now();
+        for( int i = 0; i < iterations; i++ )
+        {
+            for( int j = 0; j < data.nRigidBodies; j++ )
+            {
+                const sCachedRigidBody* pRigidBody = cache.FindRigidBody( data.RigidBodies[j].ID );
+                nResolved += 1 + pRigidBody->name.size();
+            }
+        }
+        auto cacheStop = std::chrono::steady_clock::now();
+
+        if( nResolved == 0 )
+        {
+            fprintf( stderr, "no rigid body resolved\n" );
+        }
+
+        printf( "\nData descriptions ( 4.1+, %zu byte NAT_MODELDEF )\n", description.size() );
+        printf( "  full decode             %10.1f ns/update\n", std::chrono::duration<double, std::nano>( fullStop - start ).count() / nUpdates );
+        printf( "  unchanged               %10.1f ns/update\n", std::chrono::duration<double, std::nano>( sameStop - fullStop ).count() / nUpdates );
+        printf( "  one rigid body changed  %10.1f ns/update\n", std::chrono::duration<double, std::nano>( changedStop - sameStop ).count() / nUpdates );
+        printf( "  resolve %d rigid body IDs with std::map  %8.1f ns/frame\n", data.nRigidBodies,
+            std::chrono::duration<double, std::nano>( cacheStart - mapStart ).count() / iterations );
+        printf( "  resolve %d rigid body IDs with cache     %8.1f ns/frame\n", data.nRigidBodies,
+            std::chrono::duration<double, std::nano>( cacheStop - cacheStart ).count() / iterations );
+    }
+
+    // Decode pipeline; frame numbers cycle with a step back larger than the stale frame window
+    {
+        std::vector<std::vector<char>> packets( 2 * PIPELINE_STALE_FRAME_WINDOW );
+        for( size_t i = 0; i < packets.size(); i++ )
+        {
+            BuildFramePacket( scene, 4, 1, (int) i, packets[i] );
+        }
+        int nFrames = std::min( iterations, 20000 );
+        printf( "\nDecode pipeline ( 4.1, %d frames, %u hardware threads )\n", nFrames, std::thread::hardware_concurrency() );
+        printf( "Workers  Decode only (ns/frame)  + 20 us work per frame (ns/frame)   ( 0 = decoded by the receiving thread )\n" );
+        for( int nWorkers : { 0, 1, 2, 4, 8 } )
+        {
+            double decodeOnly = TimePipeline( packets, nWorkers, 0, nFrames );
+            double withWork = TimePipeline( packets, nWorkers, 20, nFrames / 10 );
+            printf( "%7d  %22.1f  %33.1f\n", nWorkers, decodeOnly, withWork );
+        }
+    }
+
+    return 0;
+}
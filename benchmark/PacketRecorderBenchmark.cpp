@@ -0,0 +1,257 @@
+//=============================================================================
+// PacketRecorderBenchmark.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Cost of recording a stream with PacketRecorder to the receiving thread:
+// Record() times for full-size datagrams at 1 kHz, in segments small enough
+// to roll over, then datagrams without pause to find the throughput the
+// flusher sustains. The segments are read back with PacketLogReader,
+// checked and deleted.
+//
+// Usage: packetRecorderBenchmark [directory] [seconds at 1 kHz]
+//
+// Build with -DCMAKE_BUILD_TYPE=Release for meaningful numbers.
+//=============================================================================
+
+#include "PacketRecorder.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const double kPacedRate = 1000.0;
+static const uint64_t kSegmentBytes = 256ull * 1024 * 1024;
+static const double kUnpacedSeconds = 2.0;
+static const int kModelDefBytes = 4096;
+
+struct sRunResult
+{
+    std::vector<int64_t> recordNs;          // per Record() call
+    uint64_t nSent;
+    double seconds;                         // first Record() to Stop() returning
+    sPacketRecorderCounters counters;
+    uint32_t nSegments;
+};
+
+/**
+ * \brief Datagram i: its index, then bytes that depend on it.
+ */
+static void FillDatagram( std::vector<char>& datagram, uint64_t i )
+{
+    memcpy( datagram.data(), &i, sizeof( i ) );
+    memset( datagram.data() + sizeof( i ), (int) ( i & 0xFF ), datagram.size() - sizeof( i ) );
+}
+
+static bool CheckDatagram( const char* pData, size_t length, size_t expectedLength, uint64_t& i )
+{
+    if( length != expectedLength )
+    {
+        return false;
+    }
+    memcpy( &i, pData, sizeof( i ) );
+    return ( (unsigned char) pData[sizeof( i )] == ( i & 0xFF ) )
+        && ( (unsigned char) pData[length - 1] == ( i & 0xFF ) );
+}
+
+static int64_t Percentile( const std::vector<int64_t>& sorted, double p )
+{
+    if( sorted.empty() )
+    {
+        return 0;
+    }
+    size_t index = std::min( sorted.size() - 1, (size_t) ( p / 100.0 * sorted.size() ) );
+    return sorted[index];
+}
+
+/**
+ * \brief Record a model definition, then datagrams at rate for seconds ( without pause if rate is 0 ).
+ */
+static bool Run( const std::string& path, double rate, double seconds, sRunResult& result )
+{
+    PacketRecorder recorder;
+    if( !recorder.Start( path.c_str(), kSegmentBytes ) )
+    {
+        fprintf( stderr, "cannot record to %s: %s\n", recorder.SegmentPath( 0 ).c_str(), strerror( errno ) );
+        return false;
+    }
+
+    std::vector<char> modelDef( kModelDefBytes, 'M' );
+    std::vector<char> datagram( MAX_PACKETSIZE );
+    result.recordNs.clear();
+    result.recordNs.reserve( (size_t) ( ( rate > 0.0 ) ? rate * seconds : 0 ) );
+    result.nSent = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point end = start + std::chrono::microseconds( (int64_t) ( seconds * 1e6 ) );
+    recorder.RecordModelDef( modelDef.data(), modelDef.size(), 0, 4, 1 );
+    for( uint64_t i = 0;; i++ )
+    {
+        if( rate > 0.0 )
+        {
+            if( i >= (uint64_t) ( rate * seconds ) )
+            {
+                break;
+            }
+            std::this_thread::sleep_until( start + std::chrono::microseconds( (int64_t) ( i * 1e6 / rate ) ) );
+        }
+        else if( ( i % 64 == 0 ) && ( std::chrono::steady_clock::now() >= end ) )
+        {
+            break;
+        }
+        FillDatagram( datagram, i );
+        std::chrono::steady_clock::time_point recordStart = std::chrono::steady_clock::now();
+        recorder.Record( datagram.data(), datagram.size(), (int64_t) i, 4, 1 );
+        if( rate > 0.0 )
+        {
+            result.recordNs.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - recordStart ).count() );
+        }
+        result.nSent++;
+    }
+    recorder.Stop();
+    result.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    result.counters = recorder.Counters();
+    result.nSegments = (uint32_t) result.counters.nSegments;
+    if( recorder.Error() != 0 )
+    {
+        fprintf( stderr, "recording failed: %s\n", strerror( recorder.Error() ) );
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \brief Read the segments back: a model definition first in each, then the datagrams in order.
+ * Deletes the segments.
+ * \return - number of problems found
+ */
+static int Verify( const std::string& path, const sRunResult& result )
+{
+    int nProblems = 0;
+    uint64_t nDatagrams = 0;
+    uint64_t nMissing = 0;
+    uint64_t next = 0;
+    for( uint32_t segment = 0; segment < result.nSegments; segment++ )
+    {
+        char suffix[16];
+        snprintf( suffix, sizeof( suffix ), ".%04u", segment );
+        std::string segmentPath = path + suffix;
+        PacketLogReader reader;
+        if( !reader.Open( segmentPath.c_str() ) )
+        {
+            fprintf( stderr, "cannot read %s: %s\n", segmentPath.c_str(), strerror( errno ) );
+            nProblems++;
+            continue;
+        }
+        if( reader.Header().segment != segment )
+        {
+            fprintf( stderr, "%s: segment %u in the header\n", segmentPath.c_str(), reader.Header().segment );
+            nProblems++;
+        }
+
+        const sPacketRecordHeader* pRecord = nullptr;
+        const char* pData = nullptr;
+        bool first = true;
+        while( reader.Next( pRecord, pData ) )
+        {
+            if( first && ( ( pRecord->type != PacketRecord_ModelDef ) || ( pRecord->length != kModelDefBytes ) ) )
+            {
+                fprintf( stderr, "%s: does not start with the model definition\n", segmentPath.c_str() );
+                nProblems++;
+            }
+            first = false;
+            if( pRecord->type != PacketRecord_Datagram )
+            {
+                continue;
+            }
+            uint64_t i = 0;
+            if( !CheckDatagram( pData, pRecord->length, MAX_PACKETSIZE, i ) || ( i < next )
+                || ( pRecord->received != (int64_t) i ) || ( pRecord->major != 4 ) || ( pRecord->minor != 1 ) )
+            {
+                fprintf( stderr, "%s: datagram %llu corrupt or out of order\n", segmentPath.c_str(),
+                    (unsigned long long) nDatagrams );
+                nProblems++;
+                break;
+            }
+            nMissing += i - next;
+            next = i + 1;
+            nDatagrams++;
+        }
+        reader.Close();
+        unlink( segmentPath.c_str() );
+    }
+    nMissing += result.nSent - std::min( next, result.nSent );
+    if( nDatagrams + result.counters.nDropped != result.nSent )
+    {
+        fprintf( stderr, "%llu datagrams read back, %llu sent, %llu dropped\n", (unsigned long long) nDatagrams,
+            (unsigned long long) result.nSent, (unsigned long long) result.counters.nDropped );
+        nProblems++;
+    }
+    if( nMissing != result.counters.nDropped )
+    {
+        fprintf( stderr, "%llu datagrams missing, %llu dropped\n", (unsigned long long) nMissing,
+            (unsigned long long) result.counters.nDropped );
+        nProblems++;
+    }
+    return nProblems;
+}
+
+static void Print( const char* label, const sRunResult& result )
+{
+    printf( "%s: %llu datagrams in %.2f s, %llu dropped, %u segments, %.1f MB most queued, %.0f MB/s written\n",
+        label, (unsigned long long) result.nSent, result.seconds, (unsigned long long) result.counters.nDropped,
+        result.nSegments, result.counters.maxQueued / 1e6, result.counters.nBytes / 1e6 / result.seconds );
+    if( !result.recordNs.empty() )
+    {
+        std::vector<int64_t> sorted = result.recordNs;
+        std::sort( sorted.begin(), sorted.end() );
+        printf( "  Record(): p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n", Percentile( sorted, 50.0 ) / 1e3,
+            Percentile( sorted, 99.0 ) / 1e3, Percentile( sorted, 99.9 ) / 1e3, sorted.back() / 1e3 );
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    std::string directory = ( argc > 1 ) ? argv[1] : ".";
+    double seconds = ( argc > 2 ) ? atof( argv[2] ) : 5.0;
+    if( seconds <= 0.0 )
+    {
+        fprintf( stderr, "Usage: packetRecorderBenchmark [directory] [seconds at 1 kHz]\n" );
+        return 1;
+    }
+    std::string path = directory + "/natnet-benchmark-" + std::to_string( getpid() );
+
+    printf( "%d-byte datagrams, %llu MB segments, %u MB queue\n\n", MAX_PACKETSIZE,
+        (unsigned long long) ( kSegmentBytes >> 20 ), PACKET_LOG_QUEUE_BYTES >> 20 );
+
+    int nProblems = 0;
+    sRunResult result;
+    if( !Run( path, kPacedRate, seconds, result ) )
+    {
+        return 1;
+    }
+    Print( "At 1 kHz", result );
+    nProblems += Verify( path, result );
+
+    if( !Run( path, 0.0, kUnpacedSeconds, result ) )
+    {
+        return 1;
+    }
+    Print( "Without pause", result );
+    nProblems += Verify( path, result );
+
+    if( nProblems > 0 )
+    {
+        fprintf( stderr, "%d problems reading the segments back\n", nProblems );
+        return 1;
+    }
+    printf( "\nSegments read back: OK\n" );
+    return 0;
+}
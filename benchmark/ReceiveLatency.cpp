@@ -0,0 +1,229 @@
+//=============================================================================
+// ReceiveLatency.cpp
+// ~~~~~~~~~~~~~~~~~~
+//
+// Measures the wakeup latency of the receive modes of packetClient: the time
+// from sending a datagram on loopback to the receiving code running, for
+// datagrams sent at a fixed rate by another thread.
+//
+// Usage: receiveLatency [datagrams] [rate Hz] [cpu]
+//
+// With a cpu, the busy polling receiver is also measured pinned to it with
+// SCHED_FIFO ( where permitted ). Pick a CPU that nothing else runs on: the
+// sender needs another one.
+//=============================================================================
+
+#include "DatagramBatch.h"
+#include "ThreadTuning.h"
+
+#include <boost/asio.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+using boost::asio::ip::udp;
+
+static const int kWarmup = 100;             // first datagrams of each run, not measured
+static const int32_t kEndOfRun = -1;        // sequence number of the datagrams that end a run
+
+enum ReceiveMode
+{
+    ReceiveMode_AsyncReceive,               // async_receive_from ( packetClient --batch 1 )
+    ReceiveMode_AsyncWaitBatch,             // async_wait, then recvmmsg ( packetClient default )
+    ReceiveMode_BusyPoll,                   // non-blocking recvmmsg in a loop ( packetClient --busy-poll )
+    ReceiveMode_BusyPollPinned              // the same, pinned to a CPU with SCHED_FIFO
+};
+
+struct sProbe
+{
+    int64_t sent;                           // steady clock ns
+    int32_t sequence;
+};
+
+static int64_t SteadyNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+/**
+ * \brief Send count probes to target at rate Hz, then the end of the run.
+ */
+static void Send( udp::endpoint target, int count, double rate )
+{
+    boost::asio::io_context io_context;
+    udp::socket socket( io_context, udp::endpoint( udp::v4(), 0 ) );
+    std::chrono::nanoseconds period( (int64_t) ( 1e9 / rate ) );
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    sProbe probe;
+    for( int i = 0; i < count; i++ )
+    {
+        next += period;
+        std::this_thread::sleep_until( next );
+        probe.sent = SteadyNanoseconds();
+        probe.sequence = i;
+        socket.send_to( boost::asio::buffer( &probe, sizeof( probe ) ), target );
+    }
+    probe.sequence = kEndOfRun;
+    for( int i = 0; i < 3; i++ )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+        socket.send_to( boost::asio::buffer( &probe, sizeof( probe ) ), target );
+    }
+}
+
+/**
+ * \brief Record the latency of a received probe.
+ * \return - false at the end of the run
+ */
+static bool Record( const char* data, size_t length, int64_t now, std::vector<int64_t>& latencies )
+{
+    sProbe probe;
+    if( length < sizeof( probe ) )
+    {
+        return true;
+    }
+    memcpy( &probe, data, sizeof( probe ) );
+    if( probe.sequence == kEndOfRun )
+    {
+        return false;
+    }
+    if( probe.sequence >= kWarmup )
+    {
+        latencies.push_back( now - probe.sent );
+    }
+    return true;
+}
+
+/**
+ * \brief Receive one run in the given mode.
+ * \return - latencies in ns, in arrival order
+ */
+static std::vector<int64_t> Run( ReceiveMode mode, int count, double rate, int cpu )
+{
+    boost::asio::io_context io_context;
+    udp::socket socket( io_context, udp::endpoint( boost::asio::ip::address_v4::loopback(), 0 ) );
+    std::vector<int64_t> latencies;
+    latencies.reserve( count );
+
+    std::thread sender( Send, socket.local_endpoint(), count, rate );
+
+    if( mode == ReceiveMode_AsyncReceive )
+    {
+        std::vector<char> buffer( 1500 );
+        udp::endpoint from;
+        std::function<void( boost::system::error_code, size_t )> handler =
+            [&]( boost::system::error_code ec, size_t length )
+            {
+                if( !ec && Record( buffer.data(), length, SteadyNanoseconds(), latencies ) )
+                {
+                    socket.async_receive_from( boost::asio::buffer( buffer ), from, handler );
+                }
+            };
+        socket.async_receive_from( boost::asio::buffer( buffer ), from, handler );
+        io_context.run();
+    }
+    else if( mode == ReceiveMode_AsyncWaitBatch )
+    {
+        datagram_batch batch( 32, 1500 );
+        std::function<void( boost::system::error_code )> handler =
+            [&]( boost::system::error_code ec )
+            {
+                if( ec )
+                {
+                    return;
+                }
+                bool more = true;
+                size_t n = batch.receive( socket, ec );
+                int64_t now = SteadyNanoseconds();
+                for( size_t i = 0; i < n; i++ )
+                {
+                    more = Record( batch.data( i ), batch.length( i ), now, latencies ) && more;
+                }
+                if( more )
+                {
+                    socket.async_wait( udp::socket::wait_read, handler );
+                }
+            };
+        socket.async_wait( udp::socket::wait_read, handler );
+        io_context.run();
+    }
+    else
+    {
+        if( mode == ReceiveMode_BusyPollPinned )
+        {
+            PinCurrentThread( cpu );
+            SetCurrentThreadRealtimeScheduling( REALTIME_PRIORITY );
+        }
+        set_busy_poll( socket, 50 );
+        datagram_batch batch( 32, 1500 );
+        bool more = true;
+        while( more )
+        {
+            boost::system::error_code ec;
+            size_t n = batch.receive( socket, ec );
+            int64_t now = SteadyNanoseconds();
+            for( size_t i = 0; i < n; i++ )
+            {
+                more = Record( batch.data( i ), batch.length( i ), now, latencies ) && more;
+            }
+        }
+    }
+
+    sender.join();
+    return latencies;
+}
+
+static double PercentileMicroseconds( const std::vector<int64_t>& sorted, double p )
+{
+    if( sorted.empty() )
+    {
+        return 0.0;
+    }
+    size_t i = std::min( sorted.size() - 1, (size_t) ( p / 100.0 * sorted.size() ) );
+    return sorted[i] / 1e3;
+}
+
+int main( int argc, char* argv[] )
+{
+    int count = ( argc > 1 ) ? atoi( argv[1] ) : 5000;
+    double rate = ( argc > 2 ) ? atof( argv[2] ) : 1000.0;
+    int cpu = ( argc > 3 ) ? atoi( argv[3] ) : -1;
+    if( ( count <= kWarmup ) || ( rate <= 0.0 ) )
+    {
+        fprintf( stderr, "Usage: receiveLatency [datagrams > %d] [rate Hz] [cpu]\n", kWarmup );
+        return 1;
+    }
+
+    struct sModeRun
+    {
+        ReceiveMode mode;
+        const char* label;
+    };
+    std::vector<sModeRun> modes = {
+        { ReceiveMode_AsyncReceive, "asio async_receive_from" },
+        { ReceiveMode_AsyncWaitBatch, "asio async_wait + recvmmsg" },
+        { ReceiveMode_BusyPoll, "busy poll" },
+    };
+    if( cpu >= 0 )
+    {
+        modes.push_back( { ReceiveMode_BusyPollPinned, "busy poll, pinned, SCHED_FIFO" } );
+    }
+
+    printf( "Wakeup latency on loopback, %d datagrams at %.0f Hz (us)\n", count - kWarmup, rate );
+    printf( "%-32s %8s %8s %8s %8s %8s\n", "mode", "received", "p50", "p99", "p99.9", "max" );
+    for( const sModeRun& run : modes )
+    {
+        std::vector<int64_t> latencies = Run( run.mode, count, rate, cpu );
+        std::sort( latencies.begin(), latencies.end() );
+        printf( "%-32s %8zu %8.1f %8.1f %8.1f %8.1f\n", run.label, latencies.size(),
+            PercentileMicroseconds( latencies, 50.0 ), PercentileMicroseconds( latencies, 99.0 ),
+            PercentileMicroseconds( latencies, 99.9 ), latencies.empty() ? 0.0 : latencies.back() / 1e3 );
+    }
+    return 0;
+}
@@ -0,0 +1,315 @@
+//=============================================================================
+// ReceiveThroughput.cpp
+// ~~~~~~~~~~~~~~~~~~~~~
+//
+// Compares the cost of the receive backends of packetClient: datagrams sent
+// on loopback at a fixed rate by another thread are received, and every
+// byte of each is read in place, as a decoder would. Reports what arrived,
+// the CPU time of the receiving thread and its system calls and wakeups.
+//
+// Usage: receiveThroughput [seconds] [rate datagrams/s] [datagram bytes]
+//
+// A rate of 0 sends as fast as the sender thread can.
+//=============================================================================
+
+#include "DatagramBatch.h"
+#include "UringBatch.h"
+
+#include <boost/asio.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+using boost::asio::ip::udp;
+
+static const int32_t kEndOfRun = -1;        // sequence number of the datagrams that end a run
+static const size_t kBatch = 32;            // datagrams per receive call, as packetClient
+static const size_t kUringBuffers = 64;     // as packetClient --uring
+static const size_t kMaxDatagram = 65507;
+
+enum ReceiveMode
+{
+    ReceiveMode_AsyncReceive,               // async_receive_from ( packetClient --batch 1 )
+    ReceiveMode_AsyncWaitBatch,             // async_wait, then recvmmsg ( packetClient default )
+    ReceiveMode_Uring                       // multishot io_uring receive ( packetClient --uring )
+};
+
+struct sRunResult
+{
+    bool supported;
+    uint64_t nReceived;
+    uint64_t nSyscalls;                     // receive system calls
+    uint64_t nWakeups;                      // completion handlers run
+    double cpuMicroseconds;                 // receiving thread, user plus system
+    double seconds;                         // first to last datagram
+    uint64_t checksum;
+};
+
+static double ThreadCpuMicroseconds()
+{
+    rusage usage;
+    getrusage( RUSAGE_THREAD, &usage );
+    return ( usage.ru_utime.tv_sec + usage.ru_stime.tv_sec ) * 1e6 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/**
+ * \brief Send datagrams of the given size to target at rate Hz for the given time, then the end of the run.
+ */
+static void Send( udp::endpoint target, double seconds, double rate, size_t size, uint64_t* nSent )
+{
+    boost::asio::io_context io_context;
+    udp::socket socket( io_context, udp::endpoint( udp::v4(), 0 ) );
+    std::vector<char> datagram( size );
+    for( size_t i = sizeof( int32_t ); i < size; i++ )
+    {
+        datagram[i] = (char) i;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point end = start + std::chrono::microseconds( (int64_t) ( seconds * 1e6 ) );
+    std::chrono::nanoseconds period( rate > 0.0 ? (int64_t) ( 1e9 / rate ) : 0 );
+    std::chrono::steady_clock::time_point next = start;
+    int32_t sequence = 0;
+    boost::system::error_code ec;
+    while( std::chrono::steady_clock::now() < end )
+    {
+        // Behind schedule, send without sleeping to catch up
+        next += period;
+        if( next > std::chrono::steady_clock::now() )
+        {
+            std::this_thread::sleep_until( next );
+        }
+        memcpy( datagram.data(), &sequence, sizeof( sequence ) );
+        socket.send_to( boost::asio::buffer( datagram ), target, 0, ec );
+        sequence++;
+    }
+    *nSent = (uint64_t) sequence;
+
+    sequence = kEndOfRun;
+    memcpy( datagram.data(), &sequence, sizeof( sequence ) );
+    for( int i = 0; i < 3; i++ )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+        socket.send_to( boost::asio::buffer( datagram ), target, 0, ec );
+    }
+}
+
+/**
+ * \brief Read a received datagram the way a decoder would.
+ * \return - false at the end of the run
+ */
+static bool Consume( const char* data, size_t length, sRunResult& result )
+{
+    int32_t sequence = 0;
+    if( length >= sizeof( sequence ) )
+    {
+        memcpy( &sequence, data, sizeof( sequence ) );
+    }
+    if( sequence == kEndOfRun )
+    {
+        return false;
+    }
+    uint64_t sum = 0;
+    for( size_t i = 0; i < length; i++ )
+    {
+        sum += (unsigned char) data[i];
+    }
+    result.checksum += sum;
+    result.nReceived++;
+    return true;
+}
+
+/**
+ * \brief Receive one run in the given mode.
+ */
+static sRunResult Run( ReceiveMode mode, double seconds, double rate, size_t size, uint64_t& nSent )
+{
+    boost::asio::io_context io_context;
+    udp::socket socket( io_context, udp::endpoint( boost::asio::ip::address_v4::loopback(), 0 ) );
+    sRunResult result;
+    memset( &result, 0, sizeof( result ) );
+    result.supported = true;
+
+    uring_batch uring( kBatch, kUringBuffers, kMaxDatagram );
+    boost::asio::posix::stream_descriptor uringWait( io_context );
+    if( mode == ReceiveMode_Uring )
+    {
+        boost::system::error_code ec;
+        if( !uring.start( socket, false, false, ec ) )
+        {
+            fprintf( stderr, "io_uring receive not available: %s\n", ec.message().c_str() );
+            result.supported = false;
+            return result;
+        }
+        uringWait.assign( ::dup( uring.native_handle() ) );
+    }
+
+    std::thread sender( Send, socket.local_endpoint(), seconds, rate, size, &nSent );
+    std::chrono::steady_clock::time_point first;
+    std::chrono::steady_clock::time_point last;
+    double cpuStart = ThreadCpuMicroseconds();
+
+    if( mode == ReceiveMode_AsyncReceive )
+    {
+        std::vector<char> buffer( kMaxDatagram );
+        udp::endpoint from;
+        std::function<void( boost::system::error_code, size_t )> handler =
+            [&]( boost::system::error_code ec, size_t length )
+            {
+                result.nWakeups++;
+                result.nSyscalls++;
+                if( result.nReceived == 0 )
+                {
+                    first = std::chrono::steady_clock::now();
+                }
+                if( !ec && Consume( buffer.data(), length, result ) )
+                {
+                    last = std::chrono::steady_clock::now();
+                    socket.async_receive_from( boost::asio::buffer( buffer ), from, handler );
+                }
+            };
+        socket.async_receive_from( boost::asio::buffer( buffer ), from, handler );
+        io_context.run();
+    }
+    else if( mode == ReceiveMode_AsyncWaitBatch )
+    {
+        datagram_batch batch( kBatch, kMaxDatagram );
+        std::function<void( boost::system::error_code )> handler =
+            [&]( boost::system::error_code ec )
+            {
+                if( ec )
+                {
+                    return;
+                }
+                result.nWakeups++;
+                if( result.nReceived == 0 )
+                {
+                    first = std::chrono::steady_clock::now();
+                }
+                bool more = true;
+                size_t n = 0;
+                do
+                {
+                    uint64_t calls = batch.receive_calls();
+                    n = batch.receive( socket, ec );
+                    result.nSyscalls += batch.receive_calls() - calls;
+                    for( size_t i = 0; i < n; i++ )
+                    {
+                        more = Consume( batch.data( i ), batch.length( i ), result ) && more;
+                    }
+                } while( more && ( n == batch.capacity() ) );
+                last = std::chrono::steady_clock::now();
+                if( more )
+                {
+                    socket.async_wait( udp::socket::wait_read, handler );
+                }
+            };
+        socket.async_wait( udp::socket::wait_read, handler );
+        io_context.run();
+    }
+    else
+    {
+        std::function<void( boost::system::error_code )> handler =
+            [&]( boost::system::error_code ec )
+            {
+                if( ec )
+                {
+                    return;
+                }
+                result.nWakeups++;
+                if( result.nReceived == 0 )
+                {
+                    first = std::chrono::steady_clock::now();
+                }
+                bool more = true;
+                size_t n = 0;
+                do
+                {
+                    uint64_t calls = uring.enter_calls();
+                    n = uring.receive( ec );
+                    result.nSyscalls += uring.enter_calls() - calls;
+                    for( size_t i = 0; i < n; i++ )
+                    {
+                        more = Consume( uring.data( i ), uring.length( i ), result ) && more;
+                    }
+                } while( more && ( n == uring.capacity() ) );
+                last = std::chrono::steady_clock::now();
+                if( more && ( !ec || ( ec == boost::asio::error::would_block ) ) )
+                {
+                    uringWait.async_wait( boost::asio::posix::stream_descriptor::wait_read, handler );
+                }
+                else if( more )
+                {
+                    fprintf( stderr, "io_uring receive error: %s\n", ec.message().c_str() );
+                }
+            };
+        uringWait.async_wait( boost::asio::posix::stream_descriptor::wait_read, handler );
+        io_context.run();
+    }
+
+    result.cpuMicroseconds = ThreadCpuMicroseconds() - cpuStart;
+    result.seconds = std::chrono::duration<double>( last - first ).count();
+    sender.join();
+    return result;
+}
+
+int main( int argc, char* argv[] )
+{
+    double seconds = ( argc > 1 ) ? atof( argv[1] ) : 5.0;
+    double rate = ( argc > 2 ) ? atof( argv[2] ) : 10000.0;
+    long size = ( argc > 3 ) ? atol( argv[3] ) : 1400;
+    if( ( seconds <= 0.0 ) || ( rate < 0.0 ) || ( size < (long) sizeof( int32_t ) ) || ( size > (long) kMaxDatagram ) )
+    {
+        fprintf( stderr, "Usage: receiveThroughput [seconds] [rate datagrams/s, 0 unpaced] [datagram bytes]\n" );
+        return 1;
+    }
+
+    struct sModeRun
+    {
+        ReceiveMode mode;
+        const char* label;
+    };
+    const sModeRun modes[] = {
+        { ReceiveMode_AsyncReceive, "asio async_receive_from" },
+        { ReceiveMode_AsyncWaitBatch, "asio async_wait + recvmmsg" },
+        { ReceiveMode_Uring, "io_uring multishot" },
+    };
+
+    if( rate > 0.0 )
+    {
+        printf( "Receive cost on loopback, %ld byte datagrams at %.0f/s for %.1f s\n", size, rate, seconds );
+    }
+    else
+    {
+        printf( "Receive cost on loopback, %ld byte datagrams as fast as possible for %.1f s\n", size, seconds );
+    }
+    printf( "%-28s %9s %9s %10s %9s %10s %10s %8s\n", "mode", "sent", "received", "datagram/s",
+        "CPU %", "us CPU/dg", "syscall/dg", "wake/dg" );
+    for( const sModeRun& run : modes )
+    {
+        uint64_t nSent = 0;
+        sRunResult result = Run( run.mode, seconds, rate, (size_t) size, nSent );
+        if( !result.supported )
+        {
+            printf( "%-28s not supported\n", run.label );
+            continue;
+        }
+        double perDatagram = result.nReceived ? 1.0 / result.nReceived : 0.0;
+        printf( "%-28s %9llu %9llu %10.0f %9.1f %10.2f %10.3f %8.3f\n", run.label,
+            (unsigned long long) nSent, (unsigned long long) result.nReceived,
+            result.seconds > 0.0 ? result.nReceived / result.seconds : 0.0,
+            result.seconds > 0.0 ? result.cpuMicroseconds / ( result.seconds * 1e4 ) : 0.0,
+            result.cpuMicroseconds * perDatagram, result.nSyscalls * perDatagram, result.nWakeups * perDatagram );
+    }
+    return 0;
+}
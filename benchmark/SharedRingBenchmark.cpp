@@ -0,0 +1,241 @@
+//=============================================================================
+// SharedRingBenchmark.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Cost of sharing decoded frames through a SharedFrameWriter ring, against
+// every consumer decoding the packets itself: publish, read in place and
+// copy times per frame, then readers following a writer that publishes
+// without pause and at 1 kHz, counting the frames they lost to it.
+//
+// Usage: sharedRingBenchmark [iterations] [reader threads]
+//
+// Build with -DCMAKE_BUILD_TYPE=Release for meaningful numbers.
+//=============================================================================
+
+#include "CompactFrame.h"
+#include "NatNetDecoder.h"
+#include "SharedFrameRing.h"
+#include "SyntheticFrames.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const int kNumFrames = 4;            // distinct frames cycled through
+static const double kPacedRate = 1000.0;
+static const int kPacedFrames = 2000;
+
+static volatile float gSink;                // keeps the reads of the frames
+
+struct sFollowResult
+{
+    uint64_t nRead;
+    uint64_t nSkipped;
+    uint64_t nTorn;
+};
+
+static double NanosecondsPer( std::chrono::steady_clock::time_point start, int iterations )
+{
+    return std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / iterations;
+}
+
+/**
+ * \brief Read every frame of the ring in place until stop, as frameRingReader does.
+ */
+static void Follow( const char* name, std::atomic<bool>* stop, sFollowResult* result )
+{
+    memset( result, 0, sizeof( *result ) );
+    SharedFrameReader reader;
+    if( !reader.Open( name ) )
+    {
+        return;
+    }
+    uint64_t cursor = reader.Published();
+    while( !stop->load( std::memory_order_relaxed ) )
+    {
+        SharedFrameView view;
+        uint64_t nSkipped = 0;
+        SharedFrameResult read = reader.ReadNext( cursor, view, nSkipped );
+        result->nSkipped += nSkipped;
+        if( read != SharedFrame_OK )
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        const sMarker* markers = view.LabeledMarkers();
+        float sum = 0.0f;
+        for( int i = 0; i < view.Counts().nLabeledMarkers; i++ )
+        {
+            sum += markers[i].x;
+        }
+        gSink = sum;
+        if( reader.Validate( view ) )
+        {
+            result->nRead++;
+        }
+        else
+        {
+            result->nTorn++;
+        }
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    int iterations = ( argc > 1 ) ? atoi( argv[1] ) : 20000;
+    int nReaders = ( argc > 2 ) ? atoi( argv[2] ) : 4;
+    if( ( iterations <= 0 ) || ( nReaders < 1 ) )
+    {
+        fprintf( stderr, "Usage: sharedRingBenchmark [iterations] [reader threads]\n" );
+        return 1;
+    }
+
+    sSyntheticScene scene;
+    std::vector<std::vector<char>> packets( kNumFrames );
+    std::vector<std::unique_ptr<sDecodedFrame>> frames;
+    for( int i = 0; i < kNumFrames; i++ )
+    {
+        BuildFramePacket( scene, 4, 1, i, packets[i] );
+        frames.emplace_back( new sDecodedFrame() );
+        int messageID = 0;
+        DecodePacket( packets[i].data(), 4, 1, messageID, *frames[i] );
+    }
+    sFrameCapacity capacity = FrameCapacityOf( frames[0]->data );
+
+    std::string name = "/natnet-benchmark-" + std::to_string( getpid() );
+    SharedFrameWriter writer;
+    if( !writer.Create( name.c_str(), capacity ) )
+    {
+        fprintf( stderr, "cannot create shared memory ring: %s\n", strerror( errno ) );
+        return 1;
+    }
+    SharedFrameReader reader;
+    reader.Open( name.c_str() );
+
+    printf( "Scene: %d rigid bodies, %d skeletons x %d bones, %d labeled markers, %d force plates, %d devices\n",
+        scene.nRigidBodies, scene.nSkeletons, scene.nBonesPerSkeleton, scene.nLabeledMarkers,
+        scene.nForcePlates, scene.nDevices );
+    printf( "%d iterations per measurement, %u slots\n\n", iterations, reader.Slots() );
+
+    // Every consumer decoding its own copy of the stream
+    sDecodedFrame& decoded = *frames[0];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for( int i = 0; i < iterations; i++ )
+    {
+        int messageID = 0;
+        DecodePacket( packets[i % kNumFrames].data(), 4, 1, messageID, decoded );
+    }
+    double decode = NanosecondsPer( start, iterations );
+
+    start = std::chrono::steady_clock::now();
+    for( int i = 0; i < iterations; i++ )
+    {
+        writer.Publish( frames[i % kNumFrames]->data, frames[i % kNumFrames]->times );
+    }
+    double publish = NanosecondsPer( start, iterations );
+
+    // Latest frame in place: the rigid bodies and labeled markers a consumer would use
+    int nInvalid = 0;
+    start = std::chrono::steady_clock::now();
+    for( int i = 0; i < iterations; i++ )
+    {
+        SharedFrameView view;
+        reader.ReadLatest( view );
+        float sum = 0.0f;
+        const sRigidBodyData* rigidBodies = view.RigidBodies();
+        for( int j = 0; j < view.Counts().nRigidBodies; j++ )
+        {
+            sum += rigidBodies[j].x;
+        }
+        const sMarker* markers = view.LabeledMarkers();
+        for( int j = 0; j < view.Counts().nLabeledMarkers; j++ )
+        {
+            sum += markers[j].x;
+        }
+        gSink = sum;
+        nInvalid += reader.Validate( view ) ? 0 : 1;
+    }
+    double readInPlace = NanosecondsPer( start, iterations );
+
+    CompactFrame copy;
+    start = std::chrono::steady_clock::now();
+    for( int i = 0; i < iterations; i++ )
+    {
+        SharedFrameView view;
+        reader.ReadLatest( view );
+        nInvalid += reader.Copy( view, copy ) ? 0 : 1;
+    }
+    double readCopy = NanosecondsPer( start, iterations );
+    if( nInvalid > 0 )
+    {
+        fprintf( stderr, "%d frames failed validation without a concurrent writer\n", nInvalid );
+    }
+
+    printf( "Decode packet:            %8.1f ns/frame\n", decode );
+    printf( "Publish to ring:          %8.1f ns/frame\n", publish );
+    printf( "Read latest in place:     %8.1f ns/frame\n", readInPlace );
+    printf( "Read latest, copy:        %8.1f ns/frame\n\n", readCopy );
+
+    // Readers following a writer that never waits for them: without pause, then at a
+    // camera rate ( kPacedRate frames/s for kPacedFrames frames )
+    const double rates[] = { 0.0, kPacedRate };
+    for( double rate : rates )
+    {
+        int nFrames = ( rate > 0.0 ) ? kPacedFrames : iterations;
+        std::atomic<bool> stop( false );
+        std::vector<sFollowResult> results( nReaders );
+        std::vector<std::thread> readers;
+        for( int i = 0; i < nReaders; i++ )
+        {
+            readers.emplace_back( Follow, name.c_str(), &stop, &results[i] );
+        }
+        std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+        uint64_t first = writer.Published();
+        double busy = 0.0;
+        start = std::chrono::steady_clock::now();
+        for( int i = 0; i < nFrames; i++ )
+        {
+            if( rate > 0.0 )
+            {
+                std::this_thread::sleep_until( start + std::chrono::microseconds( (int64_t) ( i * 1e6 / rate ) ) );
+            }
+            std::chrono::steady_clock::time_point publishStart = std::chrono::steady_clock::now();
+            writer.Publish( frames[i % kNumFrames]->data, frames[i % kNumFrames]->times );
+            busy += std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - publishStart ).count();
+        }
+        std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+        stop = true;
+        for( std::thread& thread : readers )
+        {
+            thread.join();
+        }
+
+        if( rate > 0.0 )
+        {
+            printf( "Writer at %.0f frames/s, %d readers: %.1f ns/frame publishing, %llu frames\n", rate, nReaders,
+                busy / nFrames, (unsigned long long) ( writer.Published() - first ) );
+        }
+        else
+        {
+            printf( "Writer without pause, %d readers: %.1f ns/frame publishing, %llu frames\n", nReaders,
+                busy / nFrames, (unsigned long long) ( writer.Published() - first ) );
+        }
+        printf( "Reader  Read      Skipped   Torn\n" );
+        for( int i = 0; i < nReaders; i++ )
+        {
+            printf( "%6d  %8llu  %8llu  %5llu\n", i, (unsigned long long) results[i].nRead,
+                (unsigned long long) results[i].nSkipped, (unsigned long long) results[i].nTorn );
+        }
+        printf( "\n" );
+    }
+    return 0;
+}
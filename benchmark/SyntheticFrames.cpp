@@ -0,0 +1,422 @@
+//=============================================================================
+// SyntheticFrames.cpp
+// ~~~~~~~~~~~~~~~~~~~
+//
+// Builds NAT_FRAMEOFDATA and NAT_MODELDEF packets for a configurable scene,
+// in the bitstream layout of any NatNet version, for benchmarking the decoder
+// offline.
+//=============================================================================
+
+#include "SyntheticFrames.h"
+
+#include <NatNetTypes.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+static void Put( std::vector<char>& out, const void* value, size_t size )
+{
+    const char* bytes = static_cast<const char*>( value );
+    out.insert( out.end(), bytes, bytes + size );
+}
+
+static void PutInt( std::vector<char>& out, int32_t value ) { Put( out, &value, 4 ); }
+static void PutShort( std::vector<char>& out, int16_t value ) { Put( out, &value, 2 ); }
+static void PutFloat( std::vector<char>& out, float value ) { Put( out, &value, 4 ); }
+
+// Count followed, for NatNet 4.1 and later, by the byte size of the section
+static void PutSection( std::vector<char>& out, bool hasDataSize, int32_t count, const std::vector<char>& body )
+{
+    PutInt( out, count );
+    if( hasDataSize )
+    {
+        PutInt( out, (int32_t) body.size() );
+    }
+    out.insert( out.end(), body.begin(), body.end() );
+}
+
+static void PutPose( std::vector<char>& out, int32_t ID, float t )
+{
+    PutInt( out, ID );
+    PutFloat( out, t );
+    PutFloat( out, t + 0.5f );
+    PutFloat( out, t + 0.25f );
+    PutFloat( out, 0.0f );
+    PutFloat( out, 0.0f );
+    PutFloat( out, 0.0f );
+    PutFloat( out, 1.0f );
+}
+
+void BuildFramePacket( const sSyntheticScene& scene, int major, int minor, int frameNumber, std::vector<char>& packet )
+{
+    const bool hasDataSize = ( ( major == 4 ) && ( minor > 0 ) ) || ( major > 4 );
+    const bool hasTrackingParams = ( ( major == 2 ) && ( minor >= 6 ) ) || ( major > 2 ) || ( major == 0 );
+    const float t = 0.001f * frameNumber;
+
+    std::vector<char> payload;
+    std::vector<char> body;
+    PutInt( payload, frameNumber );
+
+    // MarkerSets
+    body.clear();
+    for( int i = 0; i < scene.nMarkerSets; i++ )
+    {
+        std::string name = "MarkerSet" + std::to_string( i );
+        Put( body, name.c_str(), name.size() + 1 );
+        PutInt( body, scene.nMarkersPerSet );
+        for( int j = 0; j < scene.nMarkersPerSet * 3; j++ )
+        {
+            PutFloat( body, t + j );
+        }
+    }
+    PutSection( payload, hasDataSize, scene.nMarkerSets, body );
+
+    // Legacy other markers
+    body.clear();
+    for( int j = 0; j < scene.nOtherMarkers * 3; j++ )
+    {
+        PutFloat( body, t + j );
+    }
+    PutSection( payload, hasDataSize, scene.nOtherMarkers, body );
+
+    // Rigid bodies
+    body.clear();
+    for( int i = 0; i < scene.nRigidBodies; i++ )
+    {
+        PutPose( body, i + 1, t + i );
+        if( major < 3 )
+        {
+            PutInt( body, 0 );      // no legacy rigid body markers
+        }
+        if( ( major >= 2 ) || ( major == 0 ) )
+        {
+            PutFloat( body, 0.0005f );
+        }
+        if( hasTrackingParams )
+        {
+            PutShort( body, 0x01 );
+        }
+    }
+    PutSection( payload, hasDataSize, scene.nRigidBodies, body );
+
+    // Skeletons
+    if( ( ( major == 2 ) && ( minor > 0 ) ) || ( major > 2 ) )
+    {
+        body.clear();
+        for( int i = 0; i < scene.nSkeletons; i++ )
+        {
+            PutInt( body, 100 + i );
+            PutInt( body, scene.nBonesPerSkeleton );
+            for( int k = 0; k < scene.nBonesPerSkeleton; k++ )
+            {
+                PutPose( body, ( ( 100 + i ) << 16 ) | ( k + 1 ), t + k );
+                if( major >= 2 )
+                {
+                    PutFloat( body, 0.0005f );
+                }
+                if( hasTrackingParams )
+                {
+                    PutShort( body, 0x01 );
+                }
+            }
+        }
+        PutSection( payload, hasDataSize, scene.nSkeletons, body );
+    }
+
+    // Assets
+    if( hasDataSize )
+    {
+        body.clear();
+        for( int i = 0; i < scene.nAssets; i++ )
+        {
+            PutInt( body, 200 + i );
+            PutInt( body, scene.nAssetRigidBodies );
+            for( int j = 0; j < scene.nAssetRigidBodies; j++ )
+            {
+                PutPose( body, j + 1, t + j );
+                PutFloat( body, 0.0005f );
+                PutShort( body, 0x01 );
+            }
+            PutInt( body, scene.nAssetMarkers );
+            for( int j = 0; j < scene.nAssetMarkers; j++ )
+            {
+                PutInt( body, j + 1 );
+                PutFloat( body, t + j );
+                PutFloat( body, t + j + 0.5f );
+                PutFloat( body, t + j + 0.25f );
+                PutFloat( body, 0.014f );
+                PutShort( body, 0x08 );
+                PutFloat( body, 0.0002f );
+            }
+        }
+        PutSection( payload, hasDataSize, scene.nAssets, body );
+    }
+
+    // Labeled markers
+    if( ( ( major == 2 ) && ( minor >= 3 ) ) || ( major > 2 ) )
+    {
+        body.clear();
+        for( int i = 0; i < scene.nLabeledMarkers; i++ )
+        {
+            PutInt( body, ( ( i / 50 ) << 16 ) | ( i % 50 ) );
+            PutFloat( body, t + i );
+            PutFloat( body, t + i + 0.5f );
+            PutFloat( body, t + i + 0.25f );
+            PutFloat( body, 0.014f );
+            if( hasTrackingParams )
+            {
+                PutShort( body, (int16_t) ( i & 0x3f ) );
+            }
+            if( ( major >= 3 ) || ( major == 0 ) )
+            {
+                PutFloat( body, 0.0002f );
+            }
+        }
+        PutSection( payload, hasDataSize, scene.nLabeledMarkers, body );
+    }
+
+    // Force plates and devices share the analog channel layout
+    const bool hasForcePlates = ( ( major == 2 ) && ( minor >= 9 ) ) || ( major > 2 );
+    const bool hasDevices = ( ( major == 2 ) && ( minor >= 11 ) ) || ( major > 2 );
+    for( int section = 0; section < 2; section++ )
+    {
+        int count = ( section == 0 ) ? scene.nForcePlates : scene.nDevices;
+        if( ( section == 0 ) ? !hasForcePlates : !hasDevices )
+        {
+            continue;
+        }
+        body.clear();
+        for( int i = 0; i < count; i++ )
+        {
+            PutInt( body, i + 1 );
+            PutInt( body, scene.nAnalogChannels );
+            for( int c = 0; c < scene.nAnalogChannels; c++ )
+            {
+                PutInt( body, scene.nAnalogFrames );
+                for( int f = 0; f < scene.nAnalogFrames; f++ )
+                {
+                    PutFloat( body, t + c + f );
+                }
+            }
+        }
+        PutSection( payload, hasDataSize, count, body );
+    }
+
+    // Suffix
+    if( major < 3 )
+    {
+        PutFloat( payload, 0.0f );  // software latency
+    }
+    PutInt( payload, 0 );           // timecode
+    PutInt( payload, 0 );           // timecode subframe
+    if( ( ( major == 2 ) && ( minor >= 7 ) ) || ( major > 2 ) )
+    {
+        double timestamp = t;
+        Put( payload, &timestamp, 8 );
+    }
+    else
+    {
+        PutFloat( payload, t );
+    }
+    if( ( major >= 3 ) || ( major == 0 ) )
+    {
+        uint64_t ticks = 1000000ull * frameNumber;
+        for( int i = 0; i < 3; i++ )
+        {
+            Put( payload, &ticks, 8 );
+            ticks += 1000;
+        }
+    }
+    if( hasDataSize || ( major == 0 ) )
+    {
+        PutInt( payload, 0 );       // precision timestamp seconds
+        PutInt( payload, 0 );       // precision timestamp fractional seconds
+    }
+    PutShort( payload, 0 );         // frame params
+    PutInt( payload, 0 );           // end of data tag
+
+    packet.clear();
+    uint16_t messageID = NAT_FRAMEOFDATA;
+    uint16_t nBytes = (uint16_t) payload.size();
+    Put( packet, &messageID, 2 );
+    Put( packet, &nBytes, 2 );
+    packet.insert( packet.end(), payload.begin(), payload.end() );
+}
+
+static void PutString( std::vector<char>& out, const std::string& value ) { Put( out, value.c_str(), value.size() + 1 ); }
+
+static void PutRigidBodyDescription( std::vector<char>& out, int major, int minor, const std::string& name, int32_t ID, int32_t parentID, int nMarkers )
+{
+    if( ( major >= 2 ) || ( major == 0 ) )
+    {
+        PutString( out, name );
+    }
+    PutInt( out, ID );
+    PutInt( out, parentID );
+    PutFloat( out, 0.0f );
+    PutFloat( out, 0.1f );
+    PutFloat( out, 0.0f );
+    if( ( ( major == 4 ) && ( minor >= 2 ) ) || ( major > 4 ) || ( major == 0 ) )
+    {
+        PutFloat( out, 0.0f );
+        PutFloat( out, 0.0f );
+        PutFloat( out, 0.0f );
+        PutFloat( out, 1.0f );
+    }
+    if( ( major >= 3 ) || ( major == 0 ) )
+    {
+        PutInt( out, nMarkers );
+        for( int j = 0; j < nMarkers * 3; j++ )
+        {
+            PutFloat( out, 0.01f * j );
+        }
+        for( int j = 0; j < nMarkers; j++ )
+        {
+            PutInt( out, 0 );       // no required active label
+        }
+        if( ( major >= 4 ) || ( major == 0 ) )
+        {
+            for( int j = 0; j < nMarkers; j++ )
+            {
+                PutString( out, name + "_" + std::to_string( j + 1 ) );
+            }
+        }
+    }
+}
+
+// Type followed, for NatNet 4.1 and later, by the byte size of the description
+static void PutDescription( std::vector<char>& out, bool hasDataSize, int32_t type, const std::vector<char>& body )
+{
+    PutInt( out, type );
+    if( hasDataSize )
+    {
+        PutInt( out, (int32_t) body.size() );
+    }
+    out.insert( out.end(), body.begin(), body.end() );
+}
+
+void BuildDescriptionPacket( const sSyntheticScene& scene, int major, int minor, std::vector<char>& packet )
+{
+    const bool hasDataSize = ( ( major == 4 ) && ( minor > 0 ) ) || ( major > 4 );
+    const bool hasAnalog = ( major >= 3 ) || ( major == 0 );
+
+    std::vector<char> descriptions;
+    std::vector<char> body;
+    int32_t nDescriptions = 0;
+
+    for( int i = 0; i < scene.nMarkerSets; i++ )
+    {
+        body.clear();
+        std::string name = "MarkerSet" + std::to_string( i );
+        PutString( body, name );
+        PutInt( body, scene.nMarkersPerSet );
+        for( int j = 0; j < scene.nMarkersPerSet; j++ )
+        {
+            PutString( body, name + "_" + std::to_string( j + 1 ) );
+        }
+        PutDescription( descriptions, hasDataSize, Descriptor_MarkerSet, body );
+        nDescriptions++;
+    }
+
+    for( int i = 0; i < scene.nRigidBodies; i++ )
+    {
+        body.clear();
+        PutRigidBodyDescription( body, major, minor, "RigidBody" + std::to_string( i + 1 ), i + 1, -1, 4 );
+        PutDescription( descriptions, hasDataSize, Descriptor_RigidBody, body );
+        nDescriptions++;
+    }
+
+    for( int i = 0; i < scene.nSkeletons; i++ )
+    {
+        body.clear();
+        std::string name = "Skeleton" + std::to_string( 100 + i );
+        PutString( body, name );
+        PutInt( body, 100 + i );
+        PutInt( body, scene.nBonesPerSkeleton );
+        for( int k = 0; k < scene.nBonesPerSkeleton; k++ )
+        {
+            // bones form a chain, the root bone has parent 0
+            PutRigidBodyDescription( body, major, minor, name + "_Bone" + std::to_string( k + 1 ), k + 1, k, 0 );
+        }
+        PutDescription( descriptions, hasDataSize, Descriptor_Skeleton, body );
+        nDescriptions++;
+    }
+
+    for( int section = 0; section < 2; section++ )
+    {
+        int count = ( section == 0 ) ? scene.nForcePlates : scene.nDevices;
+        for( int i = 0; i < count; i++ )
+        {
+            body.clear();
+            if( hasAnalog )
+            {
+                PutInt( body, i + 1 );
+                if( section == 0 )
+                {
+                    PutString( body, "FP" + std::to_string( i + 1 ) );
+                    PutFloat( body, 0.6f );
+                    PutFloat( body, 0.4f );
+                    for( int j = 0; j < 3 + 12 * 12 + 4 * 3; j++ )
+                    {
+                        PutFloat( body, 0.001f * j );
+                    }
+                    PutInt( body, 2 );      // plate type
+                    PutInt( body, 0 );      // calibrated force data
+                }
+                else
+                {
+                    PutString( body, "Device" + std::to_string( i + 1 ) );
+                    PutString( body, "DEV" + std::to_string( i + 1 ) );
+                    PutInt( body, 1 );      // device type
+                    PutInt( body, 0 );      // channel data type
+                }
+                PutInt( body, scene.nAnalogChannels );
+                for( int c = 0; c < scene.nAnalogChannels; c++ )
+                {
+                    PutString( body, "Channel" + std::to_string( c ) );
+                }
+            }
+            PutDescription( descriptions, hasDataSize, ( section == 0 ) ? Descriptor_ForcePlate : Descriptor_Device, body );
+            nDescriptions++;
+        }
+    }
+
+    if( hasDataSize )
+    {
+        for( int i = 0; i < scene.nAssets; i++ )
+        {
+            body.clear();
+            std::string name = "Asset" + std::to_string( 200 + i );
+            PutString( body, name );
+            PutInt( body, AssetType_TrainedMarkerset );
+            PutInt( body, 200 + i );
+            PutInt( body, scene.nAssetRigidBodies );
+            for( int j = 0; j < scene.nAssetRigidBodies; j++ )
+            {
+                PutRigidBodyDescription( body, major, minor, name + "_RigidBody" + std::to_string( j + 1 ), j + 1, -1, 0 );
+            }
+            PutInt( body, scene.nAssetMarkers );
+            for( int j = 0; j < scene.nAssetMarkers; j++ )
+            {
+                PutString( body, name + "_Marker" + std::to_string( j + 1 ) );
+                PutInt( body, j + 1 );
+                PutFloat( body, 0.01f * j );
+                PutFloat( body, 0.0f );
+                PutFloat( body, 0.0f );
+                PutFloat( body, 0.014f );
+                PutShort( body, 0 );
+            }
+            PutDescription( descriptions, hasDataSize, Descriptor_Asset, body );
+            nDescriptions++;
+        }
+    }
+
+    packet.clear();
+    uint16_t messageID = NAT_MODELDEF;
+    uint16_t nBytes = (uint16_t) ( 4 + descriptions.size() );
+    Put( packet, &messageID, 2 );
+    Put( packet, &nBytes, 2 );
+    PutInt( packet, nDescriptions );
+    packet.insert( packet.end(), descriptions.begin(), descriptions.end() );
+}
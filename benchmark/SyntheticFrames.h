@@ -0,0 +1,52 @@
+//=============================================================================
+// SyntheticFrames.h
+// ~~~~~~~~~~~~~~~~~
+//
+// Builds NAT_FRAMEOFDATA and NAT_MODELDEF packets for a configurable scene,
+// in the bitstream layout of any NatNet version, for benchmarking the decoder
+// offline.
+//=============================================================================
+
+#pragma once
+
+#include <vector>
+
+/**
+ * \brief Contents of a synthetic frame.
+ */
+struct sSyntheticScene
+{
+    int nMarkerSets = 2;
+    int nMarkersPerSet = 20;
+    int nOtherMarkers = 0;
+    int nRigidBodies = 20;
+    int nSkeletons = 2;
+    int nBonesPerSkeleton = 21;
+    int nAssets = 0;
+    int nAssetRigidBodies = 1;
+    int nAssetMarkers = 4;
+    int nLabeledMarkers = 500;
+    int nForcePlates = 2;
+    int nDevices = 1;
+    int nAnalogChannels = 6;
+    int nAnalogFrames = 10;
+};
+
+/**
+ * \brief Build a complete NAT_FRAMEOFDATA packet (header and payload).
+ * \param scene - frame contents
+ * \param major - NatNet major version of the bitstream
+ * \param minor - NatNet minor version of the bitstream
+ * \param frameNumber - frame number, also used to vary the values
+ * \param packet - output packet
+ */
+void BuildFramePacket( const sSyntheticScene& scene, int major, int minor, int frameNumber, std::vector<char>& packet );
+
+/**
+ * \brief Build a complete NAT_MODELDEF packet describing the frames of BuildFramePacket.
+ * \param scene - described contents
+ * \param major - NatNet major version of the bitstream
+ * \param minor - NatNet minor version of the bitstream
+ * \param packet - output packet
+ */
+void BuildDescriptionPacket( const sSyntheticScene& scene, int major, int minor, std::vector<char>& packet );
@@ -0,0 +1,28 @@
+//=============================================================================
+// BitstreamFeatures.h
+// ~~~~~~~~~~~~~~~~~~~
+//
+// NatNet bitstream features, by version: what the decoder reads and the
+// encoder writes for a given major.minor.
+//=============================================================================
+
+#pragma once
+
+// A major version of 0 means 'unknown' and is handled like the PacketClient sample does.
+static constexpr bool HasDataSize( int major, int minor ) { return ( ( major == 4 ) && ( minor > 0 ) ) || ( major > 4 ); }
+static constexpr bool HasRigidBodyMarkers( int major, int /*minor*/ ) { return major < 3; }
+static constexpr bool HasRigidBodyMarkerIDs( int major, int /*minor*/ ) { return major >= 2; }
+static constexpr bool HasRigidBodyError( int major, int /*minor*/ ) { return ( major >= 2 ) || ( major == 0 ); }
+static constexpr bool HasBoneError( int major, int /*minor*/ ) { return major >= 2; }
+static constexpr bool HasTrackingParams( int major, int minor ) { return ( ( major == 2 ) && ( minor >= 6 ) ) || ( major > 2 ) || ( major == 0 ); }
+static constexpr bool HasSkeletons( int major, int minor ) { return ( ( major == 2 ) && ( minor > 0 ) ) || ( major > 2 ); }
+static constexpr bool HasAssets( int major, int minor ) { return ( ( major == 4 ) && ( minor > 0 ) ) || ( major > 4 ); }
+static constexpr bool HasLabeledMarkers( int major, int minor ) { return ( ( major == 2 ) && ( minor >= 3 ) ) || ( major > 2 ); }
+static constexpr bool HasMarkerParams( int major, int minor ) { return ( ( major == 2 ) && ( minor >= 6 ) ) || ( major > 2 ) || ( major == 0 ); }
+static constexpr bool HasMarkerResidual( int major, int /*minor*/ ) { return ( major >= 3 ) || ( major == 0 ); }
+static constexpr bool HasForcePlates( int major, int minor ) { return ( ( major == 2 ) && ( minor >= 9 ) ) || ( major > 2 ); }
+static constexpr bool HasDevices( int major, int minor ) { return ( ( major == 2 ) && ( minor >= 11 ) ) || ( major > 2 ); }
+static constexpr bool HasSoftwareLatency( int major, int /*minor*/ ) { return major < 3; }
+static constexpr bool HasDoubleTimestamp( int major, int minor ) { return ( ( major == 2 ) && ( minor >= 7 ) ) || ( major > 2 ); }
+static constexpr bool HasHighResTimestamps( int major, int /*minor*/ ) { return ( major >= 3 ) || ( major == 0 ); }
+static constexpr bool HasPrecisionTimestamps( int major, int minor ) { return ( ( major == 4 ) && ( minor > 0 ) ) || ( major > 4 ) || ( major == 0 ); }
@@ -0,0 +1,213 @@
+//=============================================================================
+// ClockSync.cpp
+// ~~~~~~~~~~~~~
+//
+// Server clock to local clock mapping from echo round trips.
+//=============================================================================
+
+#include "ClockSync.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Round trips longer than this are never used
+#define CLOCK_SYNC_MAX_ROUND_TRIP_NS    1000000000LL
+
+// Drift is only fitted once the samples span this much server time; before, the clocks are assumed to run at the same rate
+#define CLOCK_SYNC_MIN_DRIFT_SPAN_NS    2000000000.0
+
+// Fitted drift beyond this is taken as noise ( crystal oscillators stay well within it )
+#define CLOCK_SYNC_MAX_DRIFT_PPM        500.0
+
+ClockSync::ClockSync()
+    : mFrequency( 0 )
+    , mRecentRoundTrips( CLOCK_SYNC_FILTER_SAMPLES )
+    , mnRecent( 0 )
+    , mPoints( CLOCK_SYNC_FIT_SAMPLES )
+    , mnPoints( 0 )
+    , mnSamples( 0 )
+    , mnRejected( 0 )
+    , mMinRoundTrip( 0 )
+    , mDriftPpm( 0.0 )
+    , mSeq( 0 )
+    , mBaseTicks( 0 )
+    , mBaseLocal( 0 )
+    , mNsPerTick( 0.0 )
+{
+}
+
+void ClockSync::SetServerClockFrequency( uint64_t frequency )
+{
+    mFrequency = frequency;
+}
+
+void ClockSync::BuildRequest( int64_t sent, std::vector<char>& packet )
+{
+    uint16_t header[2] = { NAT_ECHOREQUEST, ECHO_REQUEST_BYTES };
+    packet.resize( 4 + ECHO_REQUEST_BYTES );
+    memcpy( packet.data(), header, 4 );
+    memcpy( packet.data() + 4, &sent, 8 );
+}
+
+bool ClockSync::AddResponse( const char* pPacket, size_t length, int64_t received )
+{
+    // The payload size in the header is only trusted as far as the datagram goes
+    uint16_t header[2] = { 0, 0 };
+    if( length >= 4 )
+    {
+        memcpy( header, pPacket, 4 );
+    }
+    if( ( length < 4 ) || ( header[0] != NAT_ECHORESPONSE ) || ( 4 + (size_t) header[1] > length )
+        || ( header[1] < ECHO_RESPONSE_BYTES ) )
+    {
+        mnSamples++;
+        mnRejected++;
+        return false;
+    }
+    sEchoSample sample;
+    memcpy( &sample.sent, pPacket + 4, 8 );
+    memcpy( &sample.serverTicks, pPacket + 12, 8 );
+    sample.received = received;
+    return AddSample( sample );
+}
+
+bool ClockSync::AddSample( const sEchoSample& sample )
+{
+    mnSamples++;
+    int64_t roundTrip = sample.received - sample.sent;
+    if( ( mFrequency == 0 ) || ( roundTrip < 0 ) || ( roundTrip > CLOCK_SYNC_MAX_ROUND_TRIP_NS ) )
+    {
+        mnRejected++;
+        return false;
+    }
+
+    mRecentRoundTrips[mnRecent % CLOCK_SYNC_FILTER_SAMPLES] = roundTrip;
+    mnRecent++;
+    size_t nRecent = std::min( mnRecent, (size_t) CLOCK_SYNC_FILTER_SAMPLES );
+    mMinRoundTrip = *std::min_element( mRecentRoundTrips.begin(), mRecentRoundTrips.begin() + nRecent );
+
+    // Queueing in either direction shifts the midpoint; keep only the round trips that saw little of it
+    if( roundTrip > mMinRoundTrip * CLOCK_SYNC_RTT_FACTOR + CLOCK_SYNC_RTT_MARGIN_NS )
+    {
+        mnRejected++;
+        return false;
+    }
+
+    sPoint& point = mPoints[mnPoints % CLOCK_SYNC_FIT_SAMPLES];
+    point.serverTicks = sample.serverTicks;
+    point.local = sample.sent + roundTrip / 2;
+    point.roundTrip = roundTrip;
+    mnPoints++;
+
+    if( mnPoints >= CLOCK_SYNC_MIN_SAMPLES )
+    {
+        Fit();
+    }
+    return true;
+}
+
+int64_t ClockSync::ServerNanoseconds( uint64_t ticks ) const
+{
+    // Split to keep ticks * 1e9 from overflowing
+    return (int64_t) ( ( ticks / mFrequency ) * 1000000000ULL + ( ticks % mFrequency ) * 1000000000ULL / mFrequency );
+}
+
+void ClockSync::Fit()
+{
+    // Fit local = a + b * server relative to the newest point, in ns, so the sums stay small
+    size_t n = std::min( mnPoints, (size_t) CLOCK_SYNC_FIT_SAMPLES );
+    const sPoint& newest = mPoints[( mnPoints - 1 ) % CLOCK_SYNC_FIT_SAMPLES];
+    double nsPerTick = 1e9 / (double) mFrequency;
+
+    double sumX = 0.0, sumY = 0.0;
+    double minX = 0.0;
+    for( size_t i = 0; i < n; i++ )
+    {
+        double x = (double) (int64_t) ( mPoints[i].serverTicks - newest.serverTicks ) * nsPerTick;
+        double y = (double) ( mPoints[i].local - newest.local );
+        sumX += x;
+        sumY += y;
+        minX = std::min( minX, x );
+    }
+    double meanX = sumX / n;
+    double meanY = sumY / n;
+
+    double slope = 1.0;
+    if( -minX >= CLOCK_SYNC_MIN_DRIFT_SPAN_NS )
+    {
+        double sxx = 0.0, sxy = 0.0;
+        for( size_t i = 0; i < n; i++ )
+        {
+            double x = (double) (int64_t) ( mPoints[i].serverTicks - newest.serverTicks ) * nsPerTick - meanX;
+            double y = (double) ( mPoints[i].local - newest.local ) - meanY;
+            sxx += x * x;
+            sxy += x * y;
+        }
+        slope = sxy / sxx;
+        if( std::fabs( slope - 1.0 ) * 1e6 > CLOCK_SYNC_MAX_DRIFT_PPM )
+        {
+            slope = 1.0;
+        }
+    }
+    double intercept = meanY - slope * meanX;
+
+    mDriftPpm = ( slope - 1.0 ) * 1e6;
+    Publish( newest.serverTicks, newest.local + (int64_t) std::llround( intercept ), slope * nsPerTick );
+}
+
+void ClockSync::Publish( uint64_t baseTicks, int64_t baseLocal, double nsPerTick )
+{
+    uint32_t seq = mSeq.load( std::memory_order_relaxed );
+    mSeq.store( seq + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+    mBaseTicks.store( baseTicks, std::memory_order_relaxed );
+    mBaseLocal.store( baseLocal, std::memory_order_relaxed );
+    mNsPerTick.store( nsPerTick, std::memory_order_relaxed );
+    mSeq.store( seq + 2, std::memory_order_release );
+}
+
+int64_t ClockSync::HostTicksToLocalNs( uint64_t ticks ) const
+{
+    uint64_t baseTicks;
+    int64_t baseLocal;
+    double nsPerTick;
+    for( ;; )
+    {
+        uint32_t seq = mSeq.load( std::memory_order_acquire );
+        if( seq == 0 )
+        {
+            return 0;
+        }
+        if( seq & 1 )
+        {
+            continue;
+        }
+        baseTicks = mBaseTicks.load( std::memory_order_relaxed );
+        baseLocal = mBaseLocal.load( std::memory_order_relaxed );
+        nsPerTick = mNsPerTick.load( std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_acquire );
+        if( mSeq.load( std::memory_order_relaxed ) == seq )
+        {
+            break;
+        }
+    }
+    return baseLocal + (int64_t) std::llround( (double) (int64_t) ( ticks - baseTicks ) * nsPerTick );
+}
+
+sClockSyncStatus ClockSync::Status() const
+{
+    sClockSyncStatus status;
+    status.synchronized = Synchronized();
+    status.offset = 0;
+    if( status.synchronized )
+    {
+        uint64_t baseTicks = mBaseTicks.load( std::memory_order_relaxed );
+        status.offset = mBaseLocal.load( std::memory_order_relaxed ) - ServerNanoseconds( baseTicks );
+    }
+    status.driftPpm = mDriftPpm;
+    status.minRoundTrip = mMinRoundTrip;
+    status.nSamples = mnSamples;
+    status.nRejected = mnRejected;
+    return status;
+}
@@ -0,0 +1,143 @@
+//=============================================================================
+// ClockSync.h
+// ~~~~~~~~~~~
+//
+// Mapping from the server's high resolution ticks to local time, estimated
+// from NAT_ECHOREQUEST / NAT_ECHORESPONSE round trips.
+//=============================================================================
+
+#pragma once
+
+#include <NatNetTypes.h>
+
+#include <atomic>
+#include <vector>
+
+// Samples taken into account when looking for the smallest round trip
+#define CLOCK_SYNC_FILTER_SAMPLES       8
+
+// A sample whose round trip exceeds the smallest recent one by more than this factor and margin is an outlier
+#define CLOCK_SYNC_RTT_FACTOR           1.5
+#define CLOCK_SYNC_RTT_MARGIN_NS        20000
+
+// Accepted samples the offset and drift are fitted to
+#define CLOCK_SYNC_FIT_SAMPLES          64
+
+// Accepted samples needed before the mapping is used
+#define CLOCK_SYNC_MIN_SAMPLES          4
+
+// NAT_ECHOREQUEST payload: the client's send time, echoed back by the server
+#define ECHO_REQUEST_BYTES              8
+
+// NAT_ECHORESPONSE payload: the echoed request time, then the server's high resolution ticks when it answered
+#define ECHO_RESPONSE_BYTES             16
+
+/**
+ * \brief Round trip sample.
+ */
+typedef struct sEchoSample
+{
+    int64_t sent;                           // local ns when the request was sent
+    int64_t received;                       // local ns when the response arrived
+    uint64_t serverTicks;                   // server ticks in the response
+} sEchoSample;
+
+/**
+ * \brief Host clock estimate.
+ */
+typedef struct sClockSyncStatus
+{
+    bool synchronized;
+    int64_t offset;                         // local ns - server ns, now
+    double driftPpm;                        // rate of the local clock relative to the server clock - 1, in ppm
+    int64_t minRoundTrip;                   // smallest recent round trip, ns
+    uint64_t nSamples;                      // responses received
+    uint64_t nRejected;                     // responses rejected as malformed or outliers
+} sClockSyncStatus;
+
+/**
+ * \brief Server clock to local clock mapping.
+ * Each echo gives a server time and the local interval it lies in: the
+ * request and response times. Like NTP, only samples with a round trip close
+ * to the smallest recent one are trusted ( queueing delays the others
+ * asymmetrically ); local = server + offset + drift * server is fitted to
+ * the midpoints of the trusted samples by least squares.
+ * "Local" is whatever clock the caller timestamps echoes with, e.g.
+ * RealtimeNanoseconds to compare with SO_TIMESTAMPNS receive times.
+ * AddResponse must be called from one thread; HostTicksToLocalNs is lock free
+ * and may be called from any thread.
+ */
+class ClockSync
+{
+public:
+    ClockSync();
+
+    /**
+     * \brief Ticks per second of the server clock, sSender_Server::HighResClockFrequency.
+     */
+    void SetServerClockFrequency( uint64_t frequency );
+
+    /**
+     * \brief Build a NAT_ECHOREQUEST packet.
+     * \param sent - local time the request is sent at
+     */
+    static void BuildRequest( int64_t sent, std::vector<char>& packet );
+
+    /**
+     * \brief Add a NAT_ECHORESPONSE.
+     * A datagram shorter than its header says, or too short for the response, is rejected.
+     * \param pPacket - the datagram, packet header included
+     * \param length - datagram size in bytes
+     * \param received - local time the response arrived at
+     * \return - true if the sample was used for the estimate
+     */
+    bool AddResponse( const char* pPacket, size_t length, int64_t received );
+
+    /**
+     * \brief Add a round trip sample, see AddResponse.
+     */
+    bool AddSample( const sEchoSample& sample );
+
+    /**
+     * \brief Convert server ticks, e.g. a frame timestamp, to local ns.
+     * \return - local time, 0 before the clocks are synchronized
+     */
+    int64_t HostTicksToLocalNs( uint64_t ticks ) const;
+
+    bool Synchronized() const { return mSeq.load( std::memory_order_acquire ) != 0; }
+
+    /**
+     * \brief Current estimate. Call from the thread calling AddResponse.
+     */
+    sClockSyncStatus Status() const;
+
+private:
+    struct sPoint
+    {
+        uint64_t serverTicks;
+        int64_t local;                      // midpoint of the round trip
+        int64_t roundTrip;
+    };
+
+    int64_t ServerNanoseconds( uint64_t ticks ) const;
+    void Fit();
+    void Publish( uint64_t baseTicks, int64_t baseLocal, double nsPerTick );
+
+    uint64_t mFrequency;
+
+    std::vector<int64_t> mRecentRoundTrips; // ring of the last CLOCK_SYNC_FILTER_SAMPLES round trips
+    size_t mnRecent;
+    std::vector<sPoint> mPoints;            // ring of the last CLOCK_SYNC_FIT_SAMPLES accepted samples
+    size_t mnPoints;
+
+    uint64_t mnSamples;
+    uint64_t mnRejected;
+    int64_t mMinRoundTrip;
+    double mDriftPpm;
+
+    // Mapping, published with a sequence lock: odd while being written, 0 until first published
+    std::atomic<uint32_t> mSeq;
+    std::atomic<uint64_t> mBaseTicks;
+    std::atomic<int64_t> mBaseLocal;
+    std::atomic<double> mNsPerTick;
+};
@@ -0,0 +1,230 @@
+//
+// CommandClient.cpp
+// ~~~~~~~~~~~~~~~~~
+//
+
+#include "CommandClient.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+
+#include <NatNetTypes.h>
+
+command_client::command_client(boost::asio::io_context& io_context,
+    const boost::asio::ip::udp::endpoint& server)
+  : io_context_(io_context)
+  , socket_(io_context,
+      boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0))
+  , server_(server)
+  , sender_()
+  , data_(MAX_PACKETSIZE)
+  , receiving_(false)
+  , reading_(false)
+{
+}
+
+void command_client::build_request(std::uint16_t message,
+    std::vector<char>& packet)
+{
+  std::uint16_t header[2] = { message, 0 };
+  packet.resize(4);
+  memcpy(packet.data(), header, 4);
+}
+
+void command_client::build_string_request(const std::string& command,
+    std::vector<char>& packet)
+{
+  // The string goes with its terminating null.
+  std::uint16_t header[2] = { NAT_REQUEST,
+    static_cast<std::uint16_t>(command.size() + 1) };
+  packet.resize(4 + command.size() + 1);
+  memcpy(packet.data(), header, 4);
+  memcpy(packet.data() + 4, command.c_str(), command.size() + 1);
+}
+
+void command_client::start_receiving()
+{
+  receiving_ = true;
+  if (!reading_)
+  {
+    do_receive();
+  }
+}
+
+void command_client::stop_receiving()
+{
+  receiving_ = false;
+  if (reading_)
+  {
+    socket_.cancel();
+  }
+}
+
+void command_client::set_unsolicited_handler(message_handler handler)
+{
+  unsolicited_ = std::move(handler);
+}
+
+void command_client::do_receive()
+{
+  reading_ = true;
+  socket_.async_receive_from(
+      boost::asio::buffer(data_.data(), data_.size()), sender_,
+      [this](boost::system::error_code ec, std::size_t length)
+      {
+        reading_ = false;
+        if (ec)
+        {
+          if (ec != boost::asio::error::operation_aborted)
+          {
+            std::cerr << "command socket error: " << ec.message() << std::endl;
+          }
+          return;
+        }
+
+        if (!handle_reply(data_.data(), length) && unsolicited_)
+        {
+          unsolicited_(data_.data(), length);
+        }
+        if (receiving_ && !reading_)
+        {
+          do_receive();
+        }
+      });
+}
+
+void command_client::request(std::vector<char> packet,
+    std::uint16_t reply_message, const retry_policy& policy,
+    reply_handler handler)
+{
+  std::shared_ptr<pending_request> entry =
+    std::make_shared<pending_request>(io_context_);
+  entry->packet = std::move(packet);
+  entry->reply_message = reply_message;
+  entry->policy = policy;
+  entry->handler = std::move(handler);
+
+  boost::asio::post(io_context_,
+      [this, entry]()
+      {
+        pending_.push_back(entry);
+        transmit(entry);
+      });
+}
+
+std::future<std::vector<char>> command_client::request(
+    std::vector<char> packet, std::uint16_t reply_message,
+    const retry_policy& policy)
+{
+  std::shared_ptr<std::promise<std::vector<char>>> promise =
+    std::make_shared<std::promise<std::vector<char>>>();
+  std::future<std::vector<char>> future = promise->get_future();
+  request(std::move(packet), reply_message, policy,
+      [promise](const boost::system::error_code& ec, const char* reply,
+        std::size_t length)
+      {
+        if (ec)
+        {
+          promise->set_exception(
+              std::make_exception_ptr(boost::system::system_error(ec)));
+        }
+        else
+        {
+          promise->set_value(std::vector<char>(reply, reply + length));
+        }
+      });
+  return future;
+}
+
+void command_client::send(std::vector<char> packet)
+{
+  std::shared_ptr<std::vector<char>> buffer =
+    std::make_shared<std::vector<char>>(std::move(packet));
+  boost::asio::post(io_context_,
+      [this, buffer]()
+      {
+        socket_.async_send_to(boost::asio::buffer(*buffer), server_,
+            [buffer](boost::system::error_code ec, std::size_t /*length*/)
+            {
+              if (ec)
+              {
+                std::cerr << "command send failed: " << ec.message() << std::endl;
+              }
+            });
+      });
+}
+
+void command_client::transmit(const std::shared_ptr<pending_request>& entry)
+{
+  ++entry->sent;
+  socket_.async_send_to(boost::asio::buffer(entry->packet), server_,
+      [entry](boost::system::error_code ec, std::size_t /*length*/)
+      {
+        if (ec)
+        {
+          std::cerr << "command send failed: " << ec.message() << std::endl;
+        }
+      });
+
+  entry->timer.expires_after(entry->policy.timeout);
+  entry->timer.async_wait(
+      [this, entry](boost::system::error_code ec)
+      {
+        // A reply may complete the request after the timer expired but
+        // before this handler ran.
+        if (ec || entry->done)
+        {
+          return;
+        }
+        if (entry->policy.tries > 0 && entry->sent >= entry->policy.tries)
+        {
+          pending_list::iterator it =
+            std::find(pending_.begin(), pending_.end(), entry);
+          complete(it, boost::asio::error::timed_out, nullptr, 0);
+        }
+        else
+        {
+          transmit(entry);
+        }
+      });
+}
+
+bool command_client::handle_reply(const char* data, std::size_t length)
+{
+  if (length < 4 || pending_.empty())
+  {
+    return false;
+  }
+  std::uint16_t message = 0;
+  memcpy(&message, data, 2);
+
+  for (pending_list::iterator it = pending_.begin(); it != pending_.end(); ++it)
+  {
+    if ((*it)->reply_message == message)
+    {
+      complete(it, boost::system::error_code(), data, length);
+      return true;
+    }
+  }
+
+  // The server names no request in its refusal; it answers in order.
+  if (message == NAT_UNRECOGNIZED_REQUEST)
+  {
+    complete(pending_.begin(), boost::asio::error::operation_not_supported,
+        data, length);
+    return true;
+  }
+  return false;
+}
+
+void command_client::complete(pending_list::iterator it,
+    const boost::system::error_code& ec, const char* reply, std::size_t length)
+{
+  // The handler may issue new requests, so take the entry out first.
+  std::shared_ptr<pending_request> entry = *it;
+  pending_.erase(it);
+  entry->done = true;
+  entry->timer.cancel();
+  entry->handler(ec, reply, length);
+}
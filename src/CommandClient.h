@@ -0,0 +1,124 @@
+//
+// CommandClient.h
+// ~~~~~~~~~~~~~~~
+//
+// Asynchronous NatNet command channel. Requests are sent without waiting for
+// the earlier ones to be answered. The server answers commands in the order
+// it receives them, so a reply is matched to the oldest pending request that
+// expects its message type. Unanswered requests are resent after a timeout
+// and fail once their tries are used up.
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+
+struct retry_policy
+{
+  int tries;                          // sends before giving up, 0 to retry until answered
+  std::chrono::milliseconds timeout;  // wait for a reply before the next try
+};
+
+class command_client
+{
+public:
+  // reply is the whole reply packet, header included, valid during the call.
+  typedef std::function<void(const boost::system::error_code& ec,
+      const char* reply, std::size_t length)> reply_handler;
+
+  typedef std::function<void(const char* data, std::size_t length)>
+    message_handler;
+
+  command_client(boost::asio::io_context& io_context,
+      const boost::asio::ip::udp::endpoint& server);
+
+  command_client(const command_client&) = delete;
+  command_client& operator=(const command_client&) = delete;
+
+  // Packet with an empty payload, e.g. NAT_CONNECT or NAT_KEEPALIVE.
+  static void build_request(std::uint16_t message, std::vector<char>& packet);
+
+  // NAT_REQUEST with a command string from NatNetRequests.h, answered by
+  // NAT_RESPONSE.
+  static void build_string_request(const std::string& command,
+      std::vector<char>& packet);
+
+  boost::asio::ip::udp::socket& socket() { return socket_; }
+  const boost::asio::ip::udp::endpoint& server() const { return server_; }
+
+  // Read the replies from the socket. A socket shared with a unicast data
+  // stream is read by its owner instead, which passes everything that is
+  // not a frame to handle_reply(); hand it over with stop_receiving() from a
+  // reply handler.
+  void start_receiving();
+  void stop_receiving();
+
+  // Called with the messages read by start_receiving() that answer no
+  // pending request: late replies, messages the server sends on its own.
+  void set_unsolicited_handler(message_handler handler);
+
+  // Send a request and call handler on the io_context's thread with the
+  // first reply of type reply_message. Fails with timed_out once the tries
+  // are used up, or with operation_not_supported when the server answers
+  // NAT_UNRECOGNIZED_REQUEST. May be called from any thread.
+  void request(std::vector<char> packet, std::uint16_t reply_message,
+      const retry_policy& policy, reply_handler handler);
+
+  // As above, completing a future with the reply packet; the future throws
+  // boost::system::system_error on failure. Do not wait for it on the
+  // io_context's thread.
+  std::future<std::vector<char>> request(std::vector<char> packet,
+      std::uint16_t reply_message, const retry_policy& policy);
+
+  // Send a packet that expects no reply. May be called from any thread.
+  void send(std::vector<char> packet);
+
+  // Complete the pending request the datagram answers, if any. Call on the
+  // io_context's thread.
+  bool handle_reply(const char* data, std::size_t length);
+
+  std::size_t pending() const { return pending_.size(); }
+
+private:
+  struct pending_request
+  {
+    pending_request(boost::asio::io_context& io_context)
+      : timer(io_context), reply_message(0), sent(0), done(false)
+    {
+    }
+
+    boost::asio::steady_timer timer;
+    std::vector<char> packet;
+    std::uint16_t reply_message;
+    retry_policy policy;
+    int sent;
+    bool done;
+    reply_handler handler;
+  };
+
+  typedef std::list<std::shared_ptr<pending_request>> pending_list;
+
+  void do_receive();
+  void transmit(const std::shared_ptr<pending_request>& entry);
+  void complete(pending_list::iterator it, const boost::system::error_code& ec,
+      const char* reply, std::size_t length);
+
+  boost::asio::io_context& io_context_;
+  boost::asio::ip::udp::socket socket_;
+  boost::asio::ip::udp::endpoint server_;
+  boost::asio::ip::udp::endpoint sender_;
+  std::vector<char> data_;
+  bool receiving_;
+  bool reading_;
+  message_handler unsolicited_;
+  pending_list pending_;                // in send order
+};
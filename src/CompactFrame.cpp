@@ -0,0 +1,500 @@
+//=============================================================================
+// CompactFrame.cpp
+// ~~~~~~~~~~~~~~~~
+//
+// Frame of mocap data sized for the current scene.
+//=============================================================================
+
+#include "CompactFrame.h"
+
+#include "DataDescriptionCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+sFrameCapacity FrameCapacityFromDescriptions( const sDataDescriptions& descriptions )
+{
+    sFrameCapacity capacity;
+    memset( &capacity, 0, sizeof( capacity ) );
+
+    for( int i = 0; i < descriptions.nDataDescriptions; i++ )
+    {
+        const sDataDescription& description = descriptions.arrDataDescriptions[i];
+        switch( description.type )
+        {
+        case Descriptor_MarkerSet:
+        {
+            const sMarkerSetDescription* pMarkerSet = description.Data.MarkerSetDescription;
+            capacity.nMarkerSets++;
+            capacity.nMarkerSetMarkers += pMarkerSet->nMarkers;
+            capacity.nNameBytes += (int32_t) strnlen( pMarkerSet->szName, MAX_NAMELENGTH ) + 1;
+            break;
+        }
+        case Descriptor_RigidBody:
+            capacity.nRigidBodies++;
+            break;
+        case Descriptor_Skeleton:
+            capacity.nSkeletons++;
+            capacity.nSkeletonBones += description.Data.SkeletonDescription->nRigidBodies;
+            break;
+        case Descriptor_ForcePlate:
+            capacity.nForcePlates++;
+            capacity.nAnalogChannels += description.Data.ForcePlateDescription->nChannels;
+            break;
+        case Descriptor_Device:
+            capacity.nDevices++;
+            capacity.nAnalogChannels += description.Data.DeviceDescription->nChannels;
+            break;
+        case Descriptor_Asset:
+            capacity.nAssets++;
+            capacity.nAssetRigidBodies += description.Data.AssetDescription->nRigidBodies;
+            capacity.nAssetMarkers += description.Data.AssetDescription->nMarkers;
+            break;
+        default:
+            break;
+        }
+    }
+
+    capacity.nLabeledMarkers = std::min( capacity.nMarkerSetMarkers + capacity.nAssetMarkers, MAX_LABELED_MARKERS );
+    capacity.nAnalogValues = capacity.nAnalogChannels * MAX_ANALOG_SUBFRAMES;
+    return capacity;
+}
+
+sFrameCapacity FrameCapacityFromDescriptions( const DataDescriptionCache& descriptions )
+{
+    sFrameCapacity capacity;
+    memset( &capacity, 0, sizeof( capacity ) );
+
+    capacity.nMarkerSets = (int32_t) descriptions.MarkerSets().size();
+    for( const sCachedMarkerSet& markerSet : descriptions.MarkerSets() )
+    {
+        capacity.nMarkerSetMarkers += (int32_t) markerSet.markerNames.size();
+        capacity.nNameBytes += (int32_t) std::min( markerSet.name.size(), (size_t) MAX_NAMELENGTH - 1 ) + 1;
+    }
+    capacity.nRigidBodies = (int32_t) descriptions.RigidBodies().size();
+    capacity.nSkeletons = (int32_t) descriptions.Skeletons().size();
+    for( const sCachedSkeleton& skeleton : descriptions.Skeletons() )
+    {
+        capacity.nSkeletonBones += (int32_t) skeleton.bones.size();
+    }
+    capacity.nForcePlates = (int32_t) descriptions.ForcePlates().size();
+    for( const sCachedForcePlate& forcePlate : descriptions.ForcePlates() )
+    {
+        capacity.nAnalogChannels += (int32_t) forcePlate.channelNames.size();
+    }
+    capacity.nDevices = (int32_t) descriptions.Devices().size();
+    for( const sCachedDevice& device : descriptions.Devices() )
+    {
+        capacity.nAnalogChannels += (int32_t) device.channelNames.size();
+    }
+    capacity.nAssets = (int32_t) descriptions.Assets().size();
+    for( const sCachedAsset& asset : descriptions.Assets() )
+    {
+        capacity.nAssetRigidBodies += (int32_t) asset.rigidBodies.size();
+        capacity.nAssetMarkers += (int32_t) asset.markers.size();
+    }
+
+    capacity.nLabeledMarkers = std::min( capacity.nMarkerSetMarkers + capacity.nAssetMarkers, MAX_LABELED_MARKERS );
+    capacity.nAnalogValues = capacity.nAnalogChannels * MAX_ANALOG_SUBFRAMES;
+    return capacity;
+}
+
+sFrameCapacity FrameCapacityOf( const sFrameOfMocapData& frame )
+{
+    sFrameCapacity capacity;
+    memset( &capacity, 0, sizeof( capacity ) );
+
+    capacity.nMarkerSets = frame.nMarkerSets;
+    for( int i = 0; i < frame.nMarkerSets; i++ )
+    {
+        capacity.nMarkerSetMarkers += frame.MocapData[i].nMarkers;
+        capacity.nNameBytes += (int32_t) strnlen( frame.MocapData[i].szName, MAX_NAMELENGTH ) + 1;
+    }
+    capacity.nOtherMarkers = frame.nOtherMarkers;
+    capacity.nRigidBodies = frame.nRigidBodies;
+    capacity.nSkeletons = frame.nSkeletons;
+    for( int i = 0; i < frame.nSkeletons; i++ )
+    {
+        capacity.nSkeletonBones += frame.Skeletons[i].nRigidBodies;
+    }
+    capacity.nAssets = frame.nAssets;
+    for( int i = 0; i < frame.nAssets; i++ )
+    {
+        capacity.nAssetRigidBodies += frame.Assets[i].nRigidBodies;
+        capacity.nAssetMarkers += frame.Assets[i].nMarkers;
+    }
+    capacity.nLabeledMarkers = frame.nLabeledMarkers;
+    capacity.nForcePlates = frame.nForcePlates;
+    for( int i = 0; i < frame.nForcePlates; i++ )
+    {
+        capacity.nAnalogChannels += frame.ForcePlates[i].nChannels;
+        for( int j = 0; j < frame.ForcePlates[i].nChannels; j++ )
+        {
+            capacity.nAnalogValues += frame.ForcePlates[i].ChannelData[j].nFrames;
+        }
+    }
+    capacity.nDevices = frame.nDevices;
+    for( int i = 0; i < frame.nDevices; i++ )
+    {
+        capacity.nAnalogChannels += frame.Devices[i].nChannels;
+        for( int j = 0; j < frame.Devices[i].nChannels; j++ )
+        {
+            capacity.nAnalogValues += frame.Devices[i].ChannelData[j].nFrames;
+        }
+    }
+    return capacity;
+}
+
+sFrameCapacity MaxFrameCapacity( const sFrameCapacity& a, const sFrameCapacity& b )
+{
+    sFrameCapacity capacity;
+    capacity.nMarkerSets = std::max( a.nMarkerSets, b.nMarkerSets );
+    capacity.nMarkerSetMarkers = std::max( a.nMarkerSetMarkers, b.nMarkerSetMarkers );
+    capacity.nNameBytes = std::max( a.nNameBytes, b.nNameBytes );
+    capacity.nOtherMarkers = std::max( a.nOtherMarkers, b.nOtherMarkers );
+    capacity.nRigidBodies = std::max( a.nRigidBodies, b.nRigidBodies );
+    capacity.nSkeletons = std::max( a.nSkeletons, b.nSkeletons );
+    capacity.nSkeletonBones = std::max( a.nSkeletonBones, b.nSkeletonBones );
+    capacity.nAssets = std::max( a.nAssets, b.nAssets );
+    capacity.nAssetRigidBodies = std::max( a.nAssetRigidBodies, b.nAssetRigidBodies );
+    capacity.nAssetMarkers = std::max( a.nAssetMarkers, b.nAssetMarkers );
+    capacity.nLabeledMarkers = std::max( a.nLabeledMarkers, b.nLabeledMarkers );
+    capacity.nForcePlates = std::max( a.nForcePlates, b.nForcePlates );
+    capacity.nDevices = std::max( a.nDevices, b.nDevices );
+    capacity.nAnalogChannels = std::max( a.nAnalogChannels, b.nAnalogChannels );
+    capacity.nAnalogValues = std::max( a.nAnalogValues, b.nAnalogValues );
+    return capacity;
+}
+
+/**
+ * \brief Test whether n more elements fit into v without exceeding capacity.
+ */
+template <class T>
+static bool Fits( const std::vector<T>& v, int n, int capacity )
+{
+    return (int) v.size() + n <= capacity;
+}
+
+/**
+ * \brief Copy the channels of a force plate or device into the analog pools.
+ * \return - # of values dropped
+ */
+static int AssignAnalogChannels( CompactFrame& compact, sCompactAnalogDevice& device, const sAnalogChannelData* channelData, int nChannels )
+{
+    const sFrameCapacity& capacity = compact.Capacity();
+    int nDropped = 0;
+
+    device.firstChannel = (int32_t) compact.AnalogChannels.size();
+    device.nChannels = 0;
+    for( int i = 0; i < nChannels; i++ )
+    {
+        const sAnalogChannelData& channel = channelData[i];
+        if( !Fits( compact.AnalogChannels, 1, capacity.nAnalogChannels ) ||
+            !Fits( compact.AnalogValues, channel.nFrames, capacity.nAnalogValues ) )
+        {
+            // keep channel numbering: drop this and all following channels
+            for( int j = i; j < nChannels; j++ )
+            {
+                nDropped += channelData[j].nFrames;
+            }
+            break;
+        }
+        sCompactAnalogChannel compactChannel;
+        compactChannel.firstValue = (int32_t) compact.AnalogValues.size();
+        compactChannel.nFrames = channel.nFrames;
+        compact.AnalogChannels.push_back( compactChannel );
+        compact.AnalogValues.insert( compact.AnalogValues.end(), channel.Values, channel.Values + channel.nFrames );
+        device.nChannels++;
+    }
+    return nDropped;
+}
+
+CompactFrame::CompactFrame()
+    : iFrame( 0 )
+    , Timecode( 0 )
+    , TimecodeSubframe( 0 )
+    , fTimestamp( 0.0 )
+    , CameraMidExposureTimestamp( 0 )
+    , CameraDataReceivedTimestamp( 0 )
+    , TransmitTimestamp( 0 )
+    , PrecisionTimestampSecs( 0 )
+    , PrecisionTimestampFractionalSecs( 0 )
+    , params( 0 )
+{
+    memset( &mCapacity, 0, sizeof( mCapacity ) );
+}
+
+CompactFrame::CompactFrame( const sFrameCapacity& capacity )
+    : CompactFrame()
+{
+    Reserve( capacity );
+}
+
+void CompactFrame::Reserve( const sFrameCapacity& capacity )
+{
+    mCapacity = MaxFrameCapacity( mCapacity, capacity );
+
+    MarkerSets.reserve( mCapacity.nMarkerSets );
+    MarkerSetMarkers.reserve( mCapacity.nMarkerSetMarkers * 3 );
+    Names.reserve( mCapacity.nNameBytes );
+    OtherMarkers.reserve( mCapacity.nOtherMarkers * 3 );
+    RigidBodies.reserve( mCapacity.nRigidBodies );
+    Skeletons.reserve( mCapacity.nSkeletons );
+    SkeletonRigidBodies.reserve( mCapacity.nSkeletonBones );
+    Assets.reserve( mCapacity.nAssets );
+    AssetRigidBodies.reserve( mCapacity.nAssetRigidBodies );
+    AssetMarkers.reserve( mCapacity.nAssetMarkers );
+    LabeledMarkers.reserve( mCapacity.nLabeledMarkers );
+    ForcePlates.reserve( mCapacity.nForcePlates );
+    Devices.reserve( mCapacity.nDevices );
+    AnalogChannels.reserve( mCapacity.nAnalogChannels );
+    AnalogValues.reserve( mCapacity.nAnalogValues );
+}
+
+size_t CompactFrame::ReservedBytes() const
+{
+    return MarkerSets.capacity() * sizeof( sCompactMarkerSet ) +
+        MarkerSetMarkers.capacity() * sizeof( float ) +
+        Names.capacity() +
+        OtherMarkers.capacity() * sizeof( float ) +
+        RigidBodies.capacity() * sizeof( sRigidBodyData ) +
+        Skeletons.capacity() * sizeof( sCompactAsset ) +
+        SkeletonRigidBodies.capacity() * sizeof( sRigidBodyData ) +
+        Assets.capacity() * sizeof( sCompactAsset ) +
+        AssetRigidBodies.capacity() * sizeof( sRigidBodyData ) +
+        AssetMarkers.capacity() * sizeof( sMarker ) +
+        LabeledMarkers.capacity() * sizeof( sMarker ) +
+        ForcePlates.capacity() * sizeof( sCompactAnalogDevice ) +
+        Devices.capacity() * sizeof( sCompactAnalogDevice ) +
+        AnalogChannels.capacity() * sizeof( sCompactAnalogChannel ) +
+        AnalogValues.capacity() * sizeof( float );
+}
+
+int CompactFrame::Assign( const sFrameOfMocapData& frame )
+{
+    int nDropped = 0;
+
+    iFrame = frame.iFrame;
+    Timecode = frame.Timecode;
+    TimecodeSubframe = frame.TimecodeSubframe;
+    fTimestamp = frame.fTimestamp;
+    CameraMidExposureTimestamp = frame.CameraMidExposureTimestamp;
+    CameraDataReceivedTimestamp = frame.CameraDataReceivedTimestamp;
+    TransmitTimestamp = frame.TransmitTimestamp;
+    PrecisionTimestampSecs = frame.PrecisionTimestampSecs;
+    PrecisionTimestampFractionalSecs = frame.PrecisionTimestampFractionalSecs;
+    params = frame.params;
+
+    // MarkerSets
+    MarkerSets.clear();
+    MarkerSetMarkers.clear();
+    Names.clear();
+    for( int i = 0; i < frame.nMarkerSets; i++ )
+    {
+        const sMarkerSetData& markerSet = frame.MocapData[i];
+        int nNameBytes = (int) strnlen( markerSet.szName, MAX_NAMELENGTH - 1 ) + 1;
+        if( !Fits( MarkerSets, 1, mCapacity.nMarkerSets ) ||
+            !Fits( MarkerSetMarkers, markerSet.nMarkers * 3, mCapacity.nMarkerSetMarkers * 3 ) ||
+            !Fits( Names, nNameBytes, mCapacity.nNameBytes ) )
+        {
+            nDropped += markerSet.nMarkers;
+            continue;
+        }
+        sCompactMarkerSet compactSet;
+        compactSet.nameOffset = (int32_t) Names.size();
+        compactSet.firstMarker = (int32_t) MarkerSetMarkers.size() / 3;
+        compactSet.nMarkers = markerSet.nMarkers;
+        MarkerSets.push_back( compactSet );
+        Names.insert( Names.end(), markerSet.szName, markerSet.szName + nNameBytes - 1 );
+        Names.push_back( 0 );
+        const float* pMarkers = &markerSet.Markers[0][0];
+        MarkerSetMarkers.insert( MarkerSetMarkers.end(), pMarkers, pMarkers + markerSet.nMarkers * 3 );
+    }
+
+    // Other markers
+    int nOtherMarkers = std::min( frame.nOtherMarkers, mCapacity.nOtherMarkers );
+    nDropped += frame.nOtherMarkers - nOtherMarkers;
+    OtherMarkers.clear();
+    if( nOtherMarkers > 0 )
+    {
+        const float* pMarkers = &frame.OtherMarkers[0][0];
+        OtherMarkers.insert( OtherMarkers.end(), pMarkers, pMarkers + nOtherMarkers * 3 );
+    }
+
+    // Rigid bodies
+    int nRigidBodies = std::min( frame.nRigidBodies, mCapacity.nRigidBodies );
+    nDropped += frame.nRigidBodies - nRigidBodies;
+    RigidBodies.assign( frame.RigidBodies, frame.RigidBodies + nRigidBodies );
+
+    // Skeletons
+    Skeletons.clear();
+    SkeletonRigidBodies.clear();
+    for( int i = 0; i < frame.nSkeletons; i++ )
+    {
+        const sSkeletonData& skeleton = frame.Skeletons[i];
+        if( !Fits( Skeletons, 1, mCapacity.nSkeletons ) ||
+            !Fits( SkeletonRigidBodies, skeleton.nRigidBodies, mCapacity.nSkeletonBones ) )
+        {
+            nDropped += skeleton.nRigidBodies;
+            continue;
+        }
+        sCompactAsset compactSkeleton;
+        compactSkeleton.ID = skeleton.skeletonID;
+        compactSkeleton.firstRigidBody = (int32_t) SkeletonRigidBodies.size();
+        compactSkeleton.nRigidBodies = skeleton.nRigidBodies;
+        compactSkeleton.firstMarker = 0;
+        compactSkeleton.nMarkers = 0;
+        Skeletons.push_back( compactSkeleton );
+        SkeletonRigidBodies.insert( SkeletonRigidBodies.end(), skeleton.RigidBodyData, skeleton.RigidBodyData + skeleton.nRigidBodies );
+    }
+
+    // Assets
+    Assets.clear();
+    AssetRigidBodies.clear();
+    AssetMarkers.clear();
+    for( int i = 0; i < frame.nAssets; i++ )
+    {
+        const sAssetData& asset = frame.Assets[i];
+        if( !Fits( Assets, 1, mCapacity.nAssets ) ||
+            !Fits( AssetRigidBodies, asset.nRigidBodies, mCapacity.nAssetRigidBodies ) ||
+            !Fits( AssetMarkers, asset.nMarkers, mCapacity.nAssetMarkers ) )
+        {
+            nDropped += asset.nRigidBodies + asset.nMarkers;
+            continue;
+        }
+        sCompactAsset compactAsset;
+        compactAsset.ID = asset.assetID;
+        compactAsset.firstRigidBody = (int32_t) AssetRigidBodies.size();
+        compactAsset.nRigidBodies = asset.nRigidBodies;
+        compactAsset.firstMarker = (int32_t) AssetMarkers.size();
+        compactAsset.nMarkers = asset.nMarkers;
+        Assets.push_back( compactAsset );
+        AssetRigidBodies.insert( AssetRigidBodies.end(), asset.RigidBodyData, asset.RigidBodyData + asset.nRigidBodies );
+        AssetMarkers.insert( AssetMarkers.end(), asset.MarkerData, asset.MarkerData + asset.nMarkers );
+    }
+
+    // Labeled markers
+    int nLabeledMarkers = std::min( frame.nLabeledMarkers, mCapacity.nLabeledMarkers );
+    nDropped += frame.nLabeledMarkers - nLabeledMarkers;
+    LabeledMarkers.assign( frame.LabeledMarkers, frame.LabeledMarkers + nLabeledMarkers );
+
+    // Force plates and devices
+    ForcePlates.clear();
+    Devices.clear();
+    AnalogChannels.clear();
+    AnalogValues.clear();
+    for( int i = 0; i < frame.nForcePlates; i++ )
+    {
+        const sForcePlateData& forcePlate = frame.ForcePlates[i];
+        if( !Fits( ForcePlates, 1, mCapacity.nForcePlates ) )
+        {
+            ++nDropped;
+            continue;
+        }
+        sCompactAnalogDevice device;
+        device.ID = forcePlate.ID;
+        device.params = forcePlate.params;
+        nDropped += AssignAnalogChannels( *this, device, forcePlate.ChannelData, forcePlate.nChannels );
+        ForcePlates.push_back( device );
+    }
+    for( int i = 0; i < frame.nDevices; i++ )
+    {
+        const sDeviceData& deviceData = frame.Devices[i];
+        if( !Fits( Devices, 1, mCapacity.nDevices ) )
+        {
+            ++nDropped;
+            continue;
+        }
+        sCompactAnalogDevice device;
+        device.ID = deviceData.ID;
+        device.params = deviceData.params;
+        nDropped += AssignAnalogChannels( *this, device, deviceData.ChannelData, deviceData.nChannels );
+        Devices.push_back( device );
+    }
+
+    return nDropped;
+}
+
+/**
+ * \brief Copy the analog channels of a compact force plate or device.
+ */
+static void CopyAnalogChannels( const CompactFrame& compact, const sCompactAnalogDevice& device, sAnalogChannelData* channelData )
+{
+    for( int i = 0; i < device.nChannels; i++ )
+    {
+        const sCompactAnalogChannel& channel = compact.AnalogChannels[device.firstChannel + i];
+        channelData[i].nFrames = channel.nFrames;
+        memcpy( channelData[i].Values, &compact.AnalogValues[channel.firstValue], channel.nFrames * sizeof( float ) );
+    }
+}
+
+void CompactFrame::CopyTo( sFrameOfMocapData& frame ) const
+{
+    frame.iFrame = iFrame;
+
+    frame.nMarkerSets = (int32_t) MarkerSets.size();
+    for( int i = 0; i < frame.nMarkerSets; i++ )
+    {
+        const sCompactMarkerSet& compactSet = MarkerSets[i];
+        sMarkerSetData& markerSet = frame.MocapData[i];
+        strncpy( markerSet.szName, &Names[compactSet.nameOffset], MAX_NAMELENGTH - 1 );
+        markerSet.szName[MAX_NAMELENGTH - 1] = 0;
+        markerSet.nMarkers = compactSet.nMarkers;
+        markerSet.Markers = (MarkerData*) const_cast<float*>( MarkerSetMarkers.data() + compactSet.firstMarker * 3 );
+    }
+
+    frame.nOtherMarkers = (int32_t) OtherMarkers.size() / 3;
+    frame.OtherMarkers = (MarkerData*) const_cast<float*>( OtherMarkers.data() );
+
+    frame.nRigidBodies = (int32_t) RigidBodies.size();
+    std::copy( RigidBodies.begin(), RigidBodies.end(), frame.RigidBodies );
+
+    frame.nSkeletons = (int32_t) Skeletons.size();
+    for( int i = 0; i < frame.nSkeletons; i++ )
+    {
+        frame.Skeletons[i].skeletonID = Skeletons[i].ID;
+        frame.Skeletons[i].nRigidBodies = Skeletons[i].nRigidBodies;
+        frame.Skeletons[i].RigidBodyData = const_cast<sRigidBodyData*>( SkeletonRigidBodies.data() + Skeletons[i].firstRigidBody );
+    }
+
+    frame.nAssets = (int32_t) Assets.size();
+    for( int i = 0; i < frame.nAssets; i++ )
+    {
+        frame.Assets[i].assetID = Assets[i].ID;
+        frame.Assets[i].nRigidBodies = Assets[i].nRigidBodies;
+        frame.Assets[i].RigidBodyData = const_cast<sRigidBodyData*>( AssetRigidBodies.data() + Assets[i].firstRigidBody );
+        frame.Assets[i].nMarkers = Assets[i].nMarkers;
+        frame.Assets[i].MarkerData = const_cast<sMarker*>( AssetMarkers.data() + Assets[i].firstMarker );
+    }
+
+    frame.nLabeledMarkers = (int32_t) LabeledMarkers.size();
+    std::copy( LabeledMarkers.begin(), LabeledMarkers.end(), frame.LabeledMarkers );
+
+    frame.nForcePlates = (int32_t) ForcePlates.size();
+    for( int i = 0; i < frame.nForcePlates; i++ )
+    {
+        frame.ForcePlates[i].ID = ForcePlates[i].ID;
+        frame.ForcePlates[i].params = ForcePlates[i].params;
+        frame.ForcePlates[i].nChannels = ForcePlates[i].nChannels;
+        CopyAnalogChannels( *this, ForcePlates[i], frame.ForcePlates[i].ChannelData );
+    }
+
+    frame.nDevices = (int32_t) Devices.size();
+    for( int i = 0; i < frame.nDevices; i++ )
+    {
+        frame.Devices[i].ID = Devices[i].ID;
+        frame.Devices[i].params = Devices[i].params;
+        frame.Devices[i].nChannels = Devices[i].nChannels;
+        CopyAnalogChannels( *this, Devices[i], frame.Devices[i].ChannelData );
+    }
+
+    frame.Timecode = Timecode;
+    frame.TimecodeSubframe = TimecodeSubframe;
+    frame.fTimestamp = fTimestamp;
+    frame.CameraMidExposureTimestamp = CameraMidExposureTimestamp;
+    frame.CameraDataReceivedTimestamp = CameraDataReceivedTimestamp;
+    frame.TransmitTimestamp = TransmitTimestamp;
+    frame.PrecisionTimestampSecs = PrecisionTimestampSecs;
+    frame.PrecisionTimestampFractionalSecs = PrecisionTimestampFractionalSecs;
+    frame.params = params;
+}
@@ -0,0 +1,179 @@
+//=============================================================================
+// CompactFrame.h
+// ~~~~~~~~~~~~~~
+//
+// Frame of mocap data sized for the current scene. sFrameOfMocapData has
+// fixed arrays for the worst case ( MAX_MARKERSETS, MAX_FORCEPLATES, ... )
+// and takes megabytes; a CompactFrame only holds what the scene can produce
+// and converts to and from sFrameOfMocapData for API compatibility.
+//=============================================================================
+
+#pragma once
+
+#include <NatNetTypes.h>
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * \brief Element capacities of a CompactFrame.
+ */
+typedef struct sFrameCapacity
+{
+    int32_t nMarkerSets;
+    int32_t nMarkerSetMarkers;              // summed over all MarkerSets
+    int32_t nNameBytes;                     // MarkerSet names, including terminators
+    int32_t nOtherMarkers;
+    int32_t nRigidBodies;
+    int32_t nSkeletons;
+    int32_t nSkeletonBones;                 // summed over all skeletons
+    int32_t nAssets;
+    int32_t nAssetRigidBodies;              // summed over all Assets
+    int32_t nAssetMarkers;                  // summed over all Assets
+    int32_t nLabeledMarkers;
+    int32_t nForcePlates;
+    int32_t nDevices;
+    int32_t nAnalogChannels;                // summed over all force plates and devices
+    int32_t nAnalogValues;                  // summed over all analog channels
+} sFrameCapacity;
+
+/**
+ * \brief Capacity for the frames of a scene, from its data descriptions.
+ * Labeled markers are not described individually; their capacity is the
+ * number of described MarkerSet and Asset markers. Analog channels get
+ * MAX_ANALOG_SUBFRAMES values each. Use MaxFrameCapacity with
+ * FrameCapacityOf to grow it when frames turn out larger.
+ * \param descriptions - data descriptions of the scene
+ * \return - capacity
+ */
+sFrameCapacity FrameCapacityFromDescriptions( const sDataDescriptions& descriptions );
+
+class DataDescriptionCache;
+
+/**
+ * \brief Capacity for the frames of a scene, from its cached data descriptions.
+ * Same rules as FrameCapacityFromDescriptions( const sDataDescriptions& ).
+ */
+sFrameCapacity FrameCapacityFromDescriptions( const DataDescriptionCache& descriptions );
+
+/**
+ * \brief Exact capacity needed to hold frame.
+ */
+sFrameCapacity FrameCapacityOf( const sFrameOfMocapData& frame );
+
+/**
+ * \brief Element-wise maximum of two capacities.
+ */
+sFrameCapacity MaxFrameCapacity( const sFrameCapacity& a, const sFrameCapacity& b );
+
+/**
+ * \brief MarkerSet of a CompactFrame.
+ */
+typedef struct sCompactMarkerSet
+{
+    int32_t nameOffset;                     // into CompactFrame::Names
+    int32_t firstMarker;                    // into CompactFrame::MarkerSetMarkers ( in markers )
+    int32_t nMarkers;
+} sCompactMarkerSet;
+
+/**
+ * \brief Skeleton or Asset of a CompactFrame.
+ */
+typedef struct sCompactAsset
+{
+    int32_t ID;                             // skeletonID or assetID
+    int32_t firstRigidBody;                 // into CompactFrame::SkeletonRigidBodies or AssetRigidBodies
+    int32_t nRigidBodies;
+    int32_t firstMarker;                    // into CompactFrame::AssetMarkers ( Assets only )
+    int32_t nMarkers;
+} sCompactAsset;
+
+/**
+ * \brief Force plate or device of a CompactFrame.
+ */
+typedef struct sCompactAnalogDevice
+{
+    int32_t ID;
+    int16_t params;
+    int32_t firstChannel;                   // into CompactFrame::AnalogChannels
+    int32_t nChannels;
+} sCompactAnalogDevice;
+
+/**
+ * \brief Analog channel of a CompactFrame.
+ */
+typedef struct sCompactAnalogChannel
+{
+    int32_t firstValue;                     // into CompactFrame::AnalogValues
+    int32_t nFrames;
+} sCompactAnalogChannel;
+
+/**
+ * \brief Frame of mocap data with storage sized by an sFrameCapacity.
+ * Storage is reserved once at construction; Assign never allocates, it
+ * drops ( and counts ) elements that do not fit. Variable length members
+ * are flattened into pools indexed by the per-object entries.
+ */
+class CompactFrame
+{
+public:
+    CompactFrame();
+    explicit CompactFrame( const sFrameCapacity& capacity );
+
+    /**
+     * \brief Reserve storage for capacity; existing contents are kept.
+     */
+    void Reserve( const sFrameCapacity& capacity );
+
+    const sFrameCapacity& Capacity() const { return mCapacity; }
+
+    /**
+     * \brief Bytes of heap storage reserved by this frame.
+     */
+    size_t ReservedBytes() const;
+
+    /**
+     * \brief Copy frame into this CompactFrame.
+     * \param frame - source frame
+     * \return - # of elements dropped because the capacity was exceeded
+     */
+    int Assign( const sFrameOfMocapData& frame );
+
+    /**
+     * \brief Copy this CompactFrame into frame.
+     * Only the used entries of frame are written. Its pointer members refer into
+     * this CompactFrame and stay valid until it is modified or destroyed.
+     * \param frame - output frame
+     */
+    void CopyTo( sFrameOfMocapData& frame ) const;
+
+    int32_t iFrame;
+    uint32_t Timecode;
+    uint32_t TimecodeSubframe;
+    double fTimestamp;
+    uint64_t CameraMidExposureTimestamp;
+    uint64_t CameraDataReceivedTimestamp;
+    uint64_t TransmitTimestamp;
+    uint32_t PrecisionTimestampSecs;
+    uint32_t PrecisionTimestampFractionalSecs;
+    int16_t params;
+
+    std::vector<sCompactMarkerSet> MarkerSets;
+    std::vector<float> MarkerSetMarkers;            // x, y, z per marker
+    std::vector<char> Names;
+    std::vector<float> OtherMarkers;                // x, y, z per marker
+    std::vector<sRigidBodyData> RigidBodies;
+    std::vector<sCompactAsset> Skeletons;
+    std::vector<sRigidBodyData> SkeletonRigidBodies;
+    std::vector<sCompactAsset> Assets;
+    std::vector<sRigidBodyData> AssetRigidBodies;
+    std::vector<sMarker> AssetMarkers;
+    std::vector<sMarker> LabeledMarkers;
+    std::vector<sCompactAnalogDevice> ForcePlates;
+    std::vector<sCompactAnalogDevice> Devices;
+    std::vector<sCompactAnalogChannel> AnalogChannels;
+    std::vector<float> AnalogValues;
+
+private:
+    sFrameCapacity mCapacity;
+};
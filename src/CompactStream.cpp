@@ -0,0 +1,787 @@
+//=============================================================================
+// CompactStream.cpp
+// ~~~~~~~~~~~~~~~~~
+//
+// NAT_COMPACTFRAME encoding and decoding. After the NatNet packet header
+// ( message ID, byte count ) a compact frame holds:
+//
+//   flags                  byte, bit 0: keyframe
+//   sequence               varint, +1 per packet of the stream
+//   resolution, bits       keyframes only: float meters per step, byte rotation bits
+//   frame number           zigzag varint delta
+//   timestamp              zigzag varint delta, microseconds
+//   high res timestamps    3 zigzag varint deltas
+//   precision timestamp    2 zigzag varint deltas
+//   timecode, subframe     varints
+//   params                 varint
+//   rigid bodies           varint count, then a pose per rigid body
+//   skeletons              varint count, then per skeleton a zigzag varint ID
+//                          delta, a varint bone count and a pose per bone
+//   labeled markers        varint count, then a marker per labeled marker
+//
+// A pose is an ID, varint ( params << 2 | largest component ), zigzag varint
+// mean error, 3 zigzag varint positions and 3 zigzag varint smallest-three
+// rotation components. A marker is an ID, varint params, zigzag varint size
+// and residual and 3 zigzag varint positions.
+//
+// In a delta frame each pose and marker starts with a varint of the fields
+// it gives ( kField* ); the others are as in the previous frame, and an
+// omitted ID is that of the element after the previous one in the previous
+// frame. Keyframes give every field. IDs are zigzag varint deltas from the
+// previous ID of their list. Sizes, errors, residuals, positions and rotations
+// are deltas from those of the same ID in the previous frame, when it had
+// that ID ( and, for a rotation, the same largest component ), absolute
+// otherwise.
+// Header fields are deltas from the previous frame, or from 0.
+//=============================================================================
+
+#include "CompactStream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const int kFlagKeyframe = 0x01;
+
+// Fields of an element in a delta frame, given when they differ from the previous frame
+static const uint32_t kFieldID = 0x01;          // else the element after the previous one in the previous frame
+static const uint32_t kFieldParams = 0x02;
+static const uint32_t kFieldError = 0x04;       // mean error, marker residual
+static const uint32_t kFieldSize = 0x08;        // marker size
+static const uint32_t kPoseFields = kFieldID | kFieldParams | kFieldError;
+static const uint32_t kMarkerFields = kFieldID | kFieldParams | kFieldError | kFieldSize;
+
+// Smallest-three components lie within +-1/sqrt(2)
+static const float kSqrt2 = 1.41421356f;
+
+/**
+ * \brief Append-only varint writer. Writing past the end sets overflow and writes nothing further.
+ */
+struct sByteWriter
+{
+    sByteWriter( char* begin, char* end )
+        : ptr( reinterpret_cast<uint8_t*>( begin ) )
+        , end( reinterpret_cast<uint8_t*>( end ) )
+        , overflow( false )
+    {
+    }
+
+    void Put( const void* value, size_t size )
+    {
+        if( overflow || ( size > (size_t) ( end - ptr ) ) )
+        {
+            overflow = true;
+            return;
+        }
+        memcpy( ptr, value, size );
+        ptr += size;
+    }
+
+    void PutVarint( uint64_t value )
+    {
+        if( !overflow && ( end - ptr >= 10 ) )
+        {
+            while( value >= 0x80 )
+            {
+                *ptr++ = (uint8_t) ( value | 0x80 );
+                value >>= 7;
+            }
+            *ptr++ = (uint8_t) value;
+            return;
+        }
+        uint8_t bytes[10];
+        size_t n = 0;
+        while( value >= 0x80 )
+        {
+            bytes[n++] = (uint8_t) ( value | 0x80 );
+            value >>= 7;
+        }
+        bytes[n++] = (uint8_t) value;
+        Put( bytes, n );
+    }
+
+    void PutZigzag( int64_t value )
+    {
+        PutVarint( ( (uint64_t) value << 1 ) ^ (uint64_t) ( value >> 63 ) );
+    }
+
+    uint8_t* ptr;
+    uint8_t* end;
+    bool overflow;
+};
+
+/**
+ * \brief Bounds-checked varint reader. Reading past the end clears ok and yields 0.
+ */
+struct sByteReader
+{
+    sByteReader( const char* begin, const char* end )
+        : ptr( reinterpret_cast<const uint8_t*>( begin ) )
+        , end( reinterpret_cast<const uint8_t*>( end ) )
+        , ok( true )
+    {
+    }
+
+    void Get( void* value, size_t size )
+    {
+        if( !ok || ( size > (size_t) ( end - ptr ) ) )
+        {
+            ok = false;
+            memset( value, 0, size );
+            return;
+        }
+        memcpy( value, ptr, size );
+        ptr += size;
+    }
+
+    uint64_t Varint()
+    {
+        uint64_t value = 0;
+        for( int shift = 0; ok && ( ptr < end ) && ( shift < 64 ); shift += 7 )
+        {
+            uint8_t byte = *ptr++;
+            value |= (uint64_t) ( byte & 0x7F ) << shift;
+            if( !( byte & 0x80 ) )
+            {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t Zigzag()
+    {
+        uint64_t value = Varint();
+        return (int64_t) ( value >> 1 ) ^ -(int64_t) ( value & 1 );
+    }
+
+    /**
+     * \brief Read a zigzag varint delta and add it to base, wrapping around as the encoder's subtraction did.
+     */
+    int64_t Delta( int64_t base )
+    {
+        return (int64_t) ( (uint64_t) base + (uint64_t) Zigzag() );
+    }
+
+    /**
+     * \brief Read an element count; every element takes at least one byte.
+     */
+    int Count()
+    {
+        uint64_t count = Varint();
+        if( count > (uint64_t) ( end - ptr ) )
+        {
+            ok = false;
+            return 0;
+        }
+        return (int) count;
+    }
+
+    const uint8_t* ptr;
+    const uint8_t* end;
+    bool ok;
+};
+
+/**
+ * \brief Round to the nearest step, halves away from zero. Truncates instead of calling
+ * floor, which is a library call without SSE4.1 and the bulk of encoding otherwise.
+ */
+static int32_t Quantize( float value, float stepsPerUnit )
+{
+    double q = (double) value * stepsPerUnit;
+    if( !( q > INT32_MIN ) || !( q < INT32_MAX ) )
+    {
+        return ( q > 0 ) ? INT32_MAX : INT32_MIN;    // NaN ends up here too
+    }
+    return (int32_t) ( ( q < 0.0 ) ? q - 0.5 : q + 0.5 );
+}
+
+static int64_t Microseconds( double seconds )
+{
+    double microseconds = std::floor( seconds * 1e6 + 0.5 );
+    return ( std::fabs( microseconds ) < 9e18 ) ? (int64_t) microseconds : 0;     // NaN too
+}
+
+static float RotationScale( int bits )
+{
+    return (float) ( ( 1 << ( bits - 1 ) ) - 1 ) * kSqrt2;
+}
+
+/**
+ * \brief Quantize a rotation as its three smallest components, the largest made positive.
+ */
+static void QuantizeRotation( const sRigidBodyData& rigidBody, float scale, sQuantizedPose& pose )
+{
+    float q[4] = { rigidBody.qx, rigidBody.qy, rigidBody.qz, rigidBody.qw };
+    float norm = std::sqrt( q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3] );
+    if( !( norm > 1e-6f ) )
+    {
+        q[0] = q[1] = q[2] = 0.0f;
+        q[3] = norm = 1.0f;
+    }
+    int largest = 0;
+    for( int i = 1; i < 4; i++ )
+    {
+        if( std::fabs( q[i] ) > std::fabs( q[largest] ) )
+        {
+            largest = i;
+        }
+    }
+    float factor = ( ( q[largest] < 0.0f ) ? -scale : scale ) / norm;
+    for( int i = 0, j = 0; i < 4; i++ )
+    {
+        if( i != largest )
+        {
+            pose.rotation[j++] = Quantize( q[i], factor );
+        }
+    }
+    pose.largest = largest;
+}
+
+static void ExpandRotation( const sQuantizedPose& pose, float scale, sRigidBodyData& rigidBody )
+{
+    float q[4];
+    float sum = 0.0f;
+    for( int i = 0, j = 0; i < 4; i++ )
+    {
+        if( i != pose.largest )
+        {
+            q[i] = pose.rotation[j++] / scale;
+            sum += q[i] * q[i];
+        }
+    }
+    q[pose.largest] = std::sqrt( std::max( 0.0f, 1.0f - sum ) );
+    rigidBody.qx = q[0];
+    rigidBody.qy = q[1];
+    rigidBody.qz = q[2];
+    rigidBody.qw = q[3];
+}
+
+/**
+ * \brief Find key in the previous frame. Elements mostly keep their order from frame to
+ * frame, so the element after the last one found is tried first.
+ * \param cursor - in: where to look first, out: after the element found
+ * \return - nullptr if the previous frame did not have key, or there is none
+ */
+static const sQuantizedPose* FindReference( const std::vector<sQuantizedPose>* pReference, size_t& cursor, int64_t key )
+{
+    if( !pReference )
+    {
+        return nullptr;
+    }
+    const std::vector<sQuantizedPose>& reference = *pReference;
+    if( ( cursor < reference.size() ) && ( reference[cursor].key == key ) )
+    {
+        return &reference[cursor++];
+    }
+    for( size_t i = 0; i < reference.size(); i++ )
+    {
+        if( reference[i].key == key )
+        {
+            cursor = i + 1;
+            return &reference[i];
+        }
+    }
+    return nullptr;
+}
+
+static int64_t BoneKey( int32_t skeletonID, int32_t boneID )
+{
+    return (int64_t) ( ( (uint64_t) (uint32_t) skeletonID << 32 ) | (uint32_t) boneID );
+}
+
+/**
+ * \brief Quantize the pose of a rigid body or bone.
+ */
+static void QuantizePose( const sRigidBodyData& rigidBody, int64_t key, float stepsPerMeter, float rotationScale,
+    sQuantizedPose& pose )
+{
+    pose.key = key;
+    pose.position[0] = Quantize( rigidBody.x, stepsPerMeter );
+    pose.position[1] = Quantize( rigidBody.y, stepsPerMeter );
+    pose.position[2] = Quantize( rigidBody.z, stepsPerMeter );
+    QuantizeRotation( rigidBody, rotationScale, pose );
+    pose.params = ( (int32_t) (uint16_t) rigidBody.params << 2 ) | pose.largest;
+    pose.error = Quantize( rigidBody.MeanError, stepsPerMeter );
+    pose.size = 0;
+}
+
+static void ExpandPose( const sQuantizedPose& pose, int32_t ID, float resolution, float rotationScale,
+    sRigidBodyData& rigidBody )
+{
+    rigidBody.ID = ID;
+    rigidBody.x = pose.position[0] * resolution;
+    rigidBody.y = pose.position[1] * resolution;
+    rigidBody.z = pose.position[2] * resolution;
+    ExpandRotation( pose, rotationScale, rigidBody );
+    rigidBody.MeanError = pose.error * resolution;
+    rigidBody.params = (short) ( pose.params >> 2 );
+}
+
+/**
+ * \brief Encode a rigid body, bone or marker and append it to the current reference.
+ * \param pReferences - elements of the previous frame, nullptr in a keyframe
+ * \param fields - fields of the kind of element, kPoseFields or kMarkerFields
+ * \param rotation - whether the element has one
+ */
+static void EncodeElement( sByteWriter& writer, const std::vector<sQuantizedPose>* pReferences, size_t& cursor,
+    int32_t ID, int32_t& previousID, uint32_t fields, bool rotation, const sQuantizedPose& value, std::vector<sQuantizedPose>& current )
+{
+    const size_t next = cursor;
+    const sQuantizedPose* pReference = FindReference( pReferences, cursor, value.key );
+    if( pReferences )
+    {
+        if( pReference )
+        {
+            uint32_t changed = ( pReference != pReferences->data() + next ) ? kFieldID : 0;
+            changed |= ( value.params != pReference->params ) ? kFieldParams : 0;
+            changed |= ( value.error != pReference->error ) ? kFieldError : 0;
+            changed |= ( value.size != pReference->size ) ? kFieldSize : 0;
+            fields &= changed;
+        }
+        writer.PutVarint( fields );
+    }
+
+    if( fields & kFieldID )
+    {
+        writer.PutZigzag( (int64_t) ID - previousID );
+    }
+    previousID = ID;
+    if( fields & kFieldParams )
+    {
+        writer.PutVarint( (uint32_t) value.params );
+    }
+    if( fields & kFieldError )
+    {
+        writer.PutZigzag( (int64_t) value.error - ( pReference ? pReference->error : 0 ) );
+    }
+    if( fields & kFieldSize )
+    {
+        writer.PutZigzag( (int64_t) value.size - ( pReference ? pReference->size : 0 ) );
+    }
+    for( int i = 0; i < 3; i++ )
+    {
+        writer.PutZigzag( (int64_t) value.position[i] - ( pReference ? pReference->position[i] : 0 ) );
+    }
+    if( rotation )
+    {
+        bool rotationDelta = pReference && ( pReference->largest == value.largest );
+        for( int i = 0; i < 3; i++ )
+        {
+            writer.PutZigzag( (int64_t) value.rotation[i] - ( rotationDelta ? pReference->rotation[i] : 0 ) );
+        }
+    }
+    current.push_back( value );
+}
+
+/**
+ * \brief Decode a rigid body, bone or marker and append it to the current reference.
+ * \param pReferences - elements of the previous frame, nullptr in a keyframe
+ * \param makeKey - key of a decoded ID
+ * \param fields - fields of the kind of element, kPoseFields or kMarkerFields
+ * \param rotation - whether the element has one
+ * \param ID - out: ID of the element
+ */
+template <class MakeKey>
+static void DecodeElement( sByteReader& reader, const std::vector<sQuantizedPose>* pReferences, size_t& cursor,
+    MakeKey makeKey, int32_t& previousID, uint32_t fields, bool rotation, sQuantizedPose& value, int32_t& ID,
+    std::vector<sQuantizedPose>& current )
+{
+    const uint32_t allFields = fields;
+    const sQuantizedPose* pReference = nullptr;
+    if( pReferences )
+    {
+        fields &= (uint32_t) reader.Varint();
+    }
+    if( fields & kFieldID )
+    {
+        ID = (int32_t) reader.Delta( previousID );
+        value.key = makeKey( ID );
+        pReference = FindReference( pReferences, cursor, value.key );
+    }
+    else if( cursor < pReferences->size() )
+    {
+        pReference = &( *pReferences )[cursor++];
+        value.key = pReference->key;
+        ID = (int32_t) pReference->key;
+    }
+    else
+    {
+        ID = 0;
+        value.key = 0;
+    }
+    previousID = ID;
+    if( !pReference && ( fields != allFields ) )
+    {
+        reader.ok = false;      // a field refers to an element the previous frame did not have
+    }
+
+    value.params = ( fields & kFieldParams ) ? (int32_t) reader.Varint() : ( pReference ? pReference->params : 0 );
+    value.error = pReference ? pReference->error : 0;
+    value.error = ( fields & kFieldError ) ? (int32_t) reader.Delta( value.error ) : value.error;
+    value.size = pReference ? pReference->size : 0;
+    value.size = ( fields & kFieldSize ) ? (int32_t) reader.Delta( value.size ) : value.size;
+    for( int i = 0; i < 3; i++ )
+    {
+        value.position[i] = (int32_t) reader.Delta( pReference ? pReference->position[i] : 0 );
+    }
+    value.largest = rotation ? ( value.params & 3 ) : 0;
+    bool rotationDelta = pReference && ( pReference->largest == value.largest );
+    for( int i = 0; i < 3; i++ )
+    {
+        value.rotation[i] = rotation ? (int32_t) reader.Delta( rotationDelta ? pReference->rotation[i] : 0 ) : 0;
+    }
+    current.push_back( value );
+}
+/**
+ * \brief Elements of a list the filter keeps.
+ */
+template <class Element, class Keep>
+static uint32_t CountKept( const Element* elements, int count, Keep keep )
+{
+    uint32_t nKept = 0;
+    for( int i = 0; i < count; i++ )
+    {
+        nKept += keep( elements[i] ) ? 1 : 0;
+    }
+    return nKept;
+}
+
+CompactStreamEncoder::CompactStreamEncoder( const sCompactStreamSettings& settings )
+    : mSettings( settings )
+    , mSequence( 0 )
+    , mSinceKeyframe( 0 )
+    , mReference()
+    , mCurrent()
+{
+    mSettings.rotationBits = std::min( std::max( mSettings.rotationBits, COMPACT_ROTATION_BITS_MIN ), COMPACT_ROTATION_BITS_MAX );
+    mSettings.keyframeInterval = std::max( mSettings.keyframeInterval, 1 );
+    mReference.valid = false;
+}
+
+size_t CompactStreamEncoder::Encode( const sFrameOfMocapData& frame, const FrameFilter* pFilter, char* pBuffer,
+    size_t bufferSize )
+{
+    const bool keyframe = !mReference.valid || ( mSinceKeyframe + 1 >= mSettings.keyframeInterval );
+    const sCompactReference* pReference = keyframe ? nullptr : &mReference;
+    const float stepsPerMeter = 1.0f / mSettings.positionResolution;
+    const float rotationScale = RotationScale( mSettings.rotationBits );
+
+    sByteWriter writer( pBuffer, pBuffer + std::min( bufferSize, (size_t) MAX_PACKETSIZE ) );
+    uint16_t header[2] = { NAT_COMPACTFRAME, 0 };
+    writer.Put( header, sizeof( header ) );
+    uint8_t flags = keyframe ? kFlagKeyframe : 0;
+    writer.Put( &flags, 1 );
+    writer.PutVarint( mSequence );
+    if( keyframe )
+    {
+        uint8_t rotationBits = (uint8_t) mSettings.rotationBits;
+        writer.Put( &mSettings.positionResolution, 4 );
+        writer.Put( &rotationBits, 1 );
+    }
+
+    // Header fields
+    mCurrent.sequence = mSequence;
+    mCurrent.iFrame = frame.iFrame;
+    mCurrent.timestamp = Microseconds( frame.fTimestamp );
+    mCurrent.highResTimestamps[0] = frame.CameraMidExposureTimestamp;
+    mCurrent.highResTimestamps[1] = frame.CameraDataReceivedTimestamp;
+    mCurrent.highResTimestamps[2] = frame.TransmitTimestamp;
+    mCurrent.precisionTimestamp[0] = frame.PrecisionTimestampSecs;
+    mCurrent.precisionTimestamp[1] = frame.PrecisionTimestampFractionalSecs;
+    writer.PutZigzag( (int64_t) mCurrent.iFrame - ( pReference ? pReference->iFrame : 0 ) );
+    writer.PutZigzag( mCurrent.timestamp - ( pReference ? pReference->timestamp : 0 ) );
+    for( int i = 0; i < 3; i++ )
+    {
+        writer.PutZigzag( (int64_t) ( mCurrent.highResTimestamps[i] - ( pReference ? pReference->highResTimestamps[i] : 0 ) ) );
+    }
+    for( int i = 0; i < 2; i++ )
+    {
+        writer.PutZigzag( (int64_t) mCurrent.precisionTimestamp[i] - ( pReference ? pReference->precisionTimestamp[i] : 0 ) );
+    }
+    writer.PutVarint( frame.Timecode );
+    writer.PutVarint( frame.TimecodeSubframe );
+    writer.PutVarint( (uint16_t) frame.params );
+
+    // Rigid bodies
+    auto keepRigidBody = [pFilter]( const sRigidBodyData& rigidBody ) { return !pFilter || pFilter->RigidBody( rigidBody.ID ); };
+    mCurrent.rigidBodies.clear();
+    writer.PutVarint( CountKept( frame.RigidBodies, frame.nRigidBodies, keepRigidBody ) );
+    int32_t previousID = 0;
+    size_t cursor = 0;
+    for( int i = 0; i < frame.nRigidBodies; i++ )
+    {
+        const sRigidBodyData& rigidBody = frame.RigidBodies[i];
+        if( !keepRigidBody( rigidBody ) )
+        {
+            continue;
+        }
+        sQuantizedPose pose;
+        QuantizePose( rigidBody, rigidBody.ID, stepsPerMeter, rotationScale, pose );
+        EncodeElement( writer, pReference ? &pReference->rigidBodies : nullptr, cursor, rigidBody.ID, previousID,
+            kPoseFields, true, pose, mCurrent.rigidBodies );
+    }
+
+    // Skeletons
+    auto keepSkeleton = [pFilter]( const sSkeletonData& skeleton ) { return !pFilter || pFilter->Skeleton( skeleton.skeletonID ); };
+    mCurrent.bones.clear();
+    writer.PutVarint( CountKept( frame.Skeletons, frame.nSkeletons, keepSkeleton ) );
+    int32_t previousSkeletonID = 0;
+    cursor = 0;
+    for( int i = 0; i < frame.nSkeletons; i++ )
+    {
+        const sSkeletonData& skeleton = frame.Skeletons[i];
+        if( !keepSkeleton( skeleton ) )
+        {
+            continue;
+        }
+        writer.PutZigzag( (int64_t) skeleton.skeletonID - previousSkeletonID );
+        previousSkeletonID = skeleton.skeletonID;
+        writer.PutVarint( (uint32_t) skeleton.nRigidBodies );
+        previousID = 0;
+        for( int j = 0; j < skeleton.nRigidBodies; j++ )
+        {
+            const sRigidBodyData& bone = skeleton.RigidBodyData[j];
+            sQuantizedPose pose;
+            QuantizePose( bone, BoneKey( skeleton.skeletonID, bone.ID ), stepsPerMeter, rotationScale, pose );
+            EncodeElement( writer, pReference ? &pReference->bones : nullptr, cursor, bone.ID, previousID,
+                kPoseFields, true, pose, mCurrent.bones );
+        }
+    }
+
+    // Labeled markers
+    auto keepMarker = [pFilter]( const sMarker& marker ) { return !pFilter || pFilter->LabeledMarker( marker.ID ); };
+    mCurrent.markers.clear();
+    writer.PutVarint( CountKept( frame.LabeledMarkers, frame.nLabeledMarkers, keepMarker ) );
+    previousID = 0;
+    cursor = 0;
+    for( int i = 0; i < frame.nLabeledMarkers; i++ )
+    {
+        const sMarker& marker = frame.LabeledMarkers[i];
+        if( !keepMarker( marker ) )
+        {
+            continue;
+        }
+        sQuantizedPose point;
+        point.key = marker.ID;
+        point.position[0] = Quantize( marker.x, stepsPerMeter );
+        point.position[1] = Quantize( marker.y, stepsPerMeter );
+        point.position[2] = Quantize( marker.z, stepsPerMeter );
+        point.rotation[0] = point.rotation[1] = point.rotation[2] = 0;
+        point.largest = 0;
+        point.params = (uint16_t) marker.params;
+        point.error = Quantize( marker.residual, stepsPerMeter / 1000.0f );     // residuals are in millimeters
+        point.size = Quantize( marker.size, stepsPerMeter );
+        EncodeElement( writer, pReference ? &pReference->markers : nullptr, cursor, marker.ID, previousID,
+            kMarkerFields, false, point, mCurrent.markers );
+    }
+
+    size_t length = (size_t) ( writer.ptr - reinterpret_cast<uint8_t*>( pBuffer ) );
+    if( writer.overflow || ( length - 4 > UINT16_MAX ) )
+    {
+        return 0;
+    }
+    header[1] = (uint16_t) ( length - 4 );
+    memcpy( pBuffer, header, sizeof( header ) );
+
+    mCurrent.valid = true;
+    std::swap( mReference, mCurrent );
+    mSequence++;
+    mSinceKeyframe = keyframe ? 0 : mSinceKeyframe + 1;
+    return length;
+}
+
+CompactStreamDecoder::CompactStreamDecoder()
+    : mPositionResolution( 0.0f )
+    , mRotationBits( 0 )
+    , mReference()
+    , mCurrent()
+    , mCounters()
+{
+    mReference.valid = false;
+}
+
+CompactStreamResult CompactStreamDecoder::Decode( const char* pData, size_t length, sDecodedFrame& frame )
+{
+    int messageID = 0;
+    int nBytes = 0;
+    if( length >= 4 )
+    {
+        DecodePacketHeader( pData, messageID, nBytes );
+    }
+    if( ( messageID != NAT_COMPACTFRAME ) || ( (size_t) nBytes + 4 > length ) )
+    {
+        mCounters.nMalformed++;
+        return CompactStream_Malformed;
+    }
+    sByteReader reader( pData + 4, pData + 4 + nBytes );
+    uint8_t flags = 0;
+    reader.Get( &flags, 1 );
+    const bool keyframe = ( flags & kFlagKeyframe ) != 0;
+    uint32_t sequence = (uint32_t) reader.Varint();
+    if( !keyframe )
+    {
+        int32_t distance = (int32_t) ( sequence - mReference.sequence );
+        if( mReference.valid && ( distance <= 0 ) )
+        {
+            mCounters.nStale++;
+            return CompactStream_Stale;
+        }
+        if( !mReference.valid || ( distance != 1 ) )
+        {
+            mReference.valid = false;
+            mCounters.nWaiting++;
+            return CompactStream_NeedKeyframe;
+        }
+    }
+    else
+    {
+        uint8_t rotationBits = 0;
+        reader.Get( &mPositionResolution, 4 );
+        reader.Get( &rotationBits, 1 );
+        mRotationBits = rotationBits;
+        if( !( mPositionResolution > 0.0f ) || ( mRotationBits < COMPACT_ROTATION_BITS_MIN )
+            || ( mRotationBits > COMPACT_ROTATION_BITS_MAX ) )
+        {
+            reader.ok = false;
+        }
+    }
+    const sCompactReference* pReference = keyframe ? nullptr : &mReference;
+    const float resolution = mPositionResolution;
+    const float rotationScale = RotationScale( std::min( std::max( mRotationBits, COMPACT_ROTATION_BITS_MIN ), COMPACT_ROTATION_BITS_MAX ) );
+
+    sFrameOfMocapData& data = frame.data;
+    data.nMarkerSets = 0;
+    data.nOtherMarkers = 0;
+    data.nRigidBodies = 0;
+    data.nSkeletons = 0;
+    data.nAssets = 0;
+    data.nLabeledMarkers = 0;
+    data.nForcePlates = 0;
+    data.nDevices = 0;
+    frame.LabeledMarkerArrays.nMarkers = 0;
+    frame.nTruncated = 0;
+    frame.arena.Reset();
+
+    // Header fields
+    mCurrent.sequence = sequence;
+    mCurrent.iFrame = (int32_t) reader.Delta( pReference ? pReference->iFrame : 0 );
+    mCurrent.timestamp = reader.Delta( pReference ? pReference->timestamp : 0 );
+    for( int i = 0; i < 3; i++ )
+    {
+        mCurrent.highResTimestamps[i] = (uint64_t) reader.Delta( pReference ? (int64_t) pReference->highResTimestamps[i] : 0 );
+    }
+    for( int i = 0; i < 2; i++ )
+    {
+        mCurrent.precisionTimestamp[i] = (uint32_t) reader.Delta( pReference ? pReference->precisionTimestamp[i] : 0 );
+    }
+    data.iFrame = mCurrent.iFrame;
+    data.fTimestamp = mCurrent.timestamp / 1e6;
+    data.CameraMidExposureTimestamp = mCurrent.highResTimestamps[0];
+    data.CameraDataReceivedTimestamp = mCurrent.highResTimestamps[1];
+    data.TransmitTimestamp = mCurrent.highResTimestamps[2];
+    data.PrecisionTimestampSecs = mCurrent.precisionTimestamp[0];
+    data.PrecisionTimestampFractionalSecs = mCurrent.precisionTimestamp[1];
+    data.Timecode = (unsigned int) reader.Varint();
+    data.TimecodeSubframe = (unsigned int) reader.Varint();
+    data.params = (short) reader.Varint();
+
+    // Rigid bodies
+    mCurrent.rigidBodies.clear();
+    int nRigidBodies = reader.Count();
+    int32_t previousID = 0;
+    size_t cursor = 0;
+    for( int i = 0; ( i < nRigidBodies ) && reader.ok; i++ )
+    {
+        sRigidBodyData scratch;
+        sRigidBodyData& rigidBody = ( data.nRigidBodies < MAX_RIGIDBODIES ) ? data.RigidBodies[data.nRigidBodies++] : scratch;
+        if( &rigidBody == &scratch )
+        {
+            ++frame.nTruncated;
+        }
+        sQuantizedPose pose;
+        int32_t ID = 0;
+        DecodeElement( reader, pReference ? &pReference->rigidBodies : nullptr, cursor, []( int32_t decodedID ) { return (int64_t) decodedID; },
+            previousID, kPoseFields, true, pose, ID, mCurrent.rigidBodies );
+        ExpandPose( pose, ID, resolution, rotationScale, rigidBody );
+    }
+
+    // Skeletons
+    mCurrent.bones.clear();
+    int nSkeletons = reader.Count();
+    int32_t skeletonID = 0;
+    cursor = 0;
+    for( int i = 0; ( i < nSkeletons ) && reader.ok; i++ )
+    {
+        skeletonID = (int32_t) reader.Delta( skeletonID );
+        int nBones = reader.Count();
+
+        sSkeletonData* pSkeleton = nullptr;
+        sRigidBodyData* bones = ( data.nSkeletons < MAX_SKELETONS ) ? frame.arena.Allocate<sRigidBodyData>( nBones ) : nullptr;
+        if( bones )
+        {
+            pSkeleton = &data.Skeletons[data.nSkeletons++];
+            pSkeleton->skeletonID = skeletonID;
+            pSkeleton->nRigidBodies = nBones;
+            pSkeleton->RigidBodyData = bones;
+        }
+        else
+        {
+            frame.nTruncated += nBones;
+        }
+
+        previousID = 0;
+        for( int j = 0; ( j < nBones ) && reader.ok; j++ )
+        {
+            sRigidBodyData scratch;
+            sRigidBodyData& bone = pSkeleton ? pSkeleton->RigidBodyData[j] : scratch;
+            sQuantizedPose pose;
+            int32_t ID = 0;
+            DecodeElement( reader, pReference ? &pReference->bones : nullptr, cursor,
+                [skeletonID]( int32_t boneID ) { return BoneKey( skeletonID, boneID ); }, previousID, kPoseFields, true, pose, ID,
+                mCurrent.bones );
+            ExpandPose( pose, ID, resolution, rotationScale, bone );
+        }
+    }
+
+    // Labeled markers
+    mCurrent.markers.clear();
+    int nLabeledMarkers = reader.Count();
+    previousID = 0;
+    cursor = 0;
+    for( int i = 0; ( i < nLabeledMarkers ) && reader.ok; i++ )
+    {
+        sMarker scratch;
+        sMarker& marker = ( data.nLabeledMarkers < MAX_LABELED_MARKERS ) ? data.LabeledMarkers[data.nLabeledMarkers++] : scratch;
+        if( &marker == &scratch )
+        {
+            ++frame.nTruncated;
+        }
+
+        sQuantizedPose point;
+        int32_t ID = 0;
+        DecodeElement( reader, pReference ? &pReference->markers : nullptr, cursor, []( int32_t decodedID ) { return (int64_t) decodedID; },
+            previousID, kMarkerFields, false, point, ID, mCurrent.markers );
+        marker.ID = ID;
+        marker.params = (short) point.params;
+        marker.x = point.position[0] * resolution;
+        marker.y = point.position[1] * resolution;
+        marker.z = point.position[2] * resolution;
+        marker.size = point.size * resolution;
+        marker.residual = point.error * resolution * 1000.0f;
+    }
+
+    if( !reader.ok || ( reader.ptr != reader.end ) )
+    {
+        mReference.valid = false;
+        mCounters.nMalformed++;
+        return CompactStream_Malformed;
+    }
+
+    mCurrent.valid = true;
+    std::swap( mReference, mCurrent );
+    ( keyframe ? mCounters.nKeyframes : mCounters.nDeltas )++;
+    mCounters.nBytes += length;
+    return CompactStream_OK;
+}
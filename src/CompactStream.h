@@ -0,0 +1,152 @@
+//=============================================================================
+// CompactStream.h
+// ~~~~~~~~~~~~~~~
+//
+// Compact wire format for bandwidth-limited links: rigid bodies, skeleton
+// bones and labeled markers as keyframes and deltas against the previous
+// frame, positions quantized to a configurable resolution, rotations in
+// smallest-three encoding and all integers as varints. The decoder expands
+// the packets back into sFrameOfMocapData; MarkerSets, legacy markers,
+// assets, force plates and devices are not carried.
+//=============================================================================
+
+#pragma once
+
+#include <NatNetTypes.h>
+
+#include "FrameEncoder.h"
+#include "NatNetDecoder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Message ID of a compact frame, outside the range NatNet uses ( "CF" )
+#define NAT_COMPACTFRAME                0x4346
+
+// Bits per smallest-three rotation component
+#define COMPACT_ROTATION_BITS_MIN       8
+#define COMPACT_ROTATION_BITS_MAX       24
+
+/**
+ * \brief Precision and keyframe rate of a compact stream, chosen by the encoder.
+ * The decoder reads the precision from every keyframe.
+ */
+typedef struct sCompactStreamSettings
+{
+    float positionResolution = 0.0001f;     // meters per step ( 0.1 mm ), also for marker sizes and errors
+    int rotationBits = 14;                  // per smallest-three component
+    int keyframeInterval = 60;              // frames; a lost delta costs the frames up to the next keyframe
+} sCompactStreamSettings;
+
+/**
+ * \brief Quantized values of a rigid body, bone or marker in the previous frame.
+ */
+typedef struct sQuantizedPose
+{
+    int64_t key;                            // ID; skeleton ID and bone ID for bones
+    int32_t position[3];
+    int32_t rotation[3];                    // smallest three components
+    int32_t largest;                        // index of the dropped component, 0 .. 3 ( x, y, z, w )
+    int32_t params;                         // with the largest component in the lower 2 bits for poses
+    int32_t error;                          // mean error; residual of a marker
+    int32_t size;                           // size of a marker
+} sQuantizedPose;
+
+/**
+ * \brief What deltas refer to: the quantized contents of the previous frame.
+ * Encoder and decoder keep the same reference, so quantization errors never accumulate.
+ */
+typedef struct sCompactReference
+{
+    bool valid;
+    uint32_t sequence;
+    int32_t iFrame;
+    int64_t timestamp;                      // fTimestamp in microseconds
+    uint64_t highResTimestamps[3];          // camera mid-exposure, data received, transmit
+    uint32_t precisionTimestamp[2];         // seconds, fractional seconds
+    std::vector<sQuantizedPose> rigidBodies;
+    std::vector<sQuantizedPose> bones;
+    std::vector<sQuantizedPose> markers;    // rotation unused
+} sCompactReference;
+
+/**
+ * \brief Encodes frames of one stream into NAT_COMPACTFRAME packets.
+ * Keeps the previous frame: use one encoder per destination, and call
+ * RequestKeyframe when a destination needs to start over.
+ */
+class CompactStreamEncoder
+{
+public:
+    explicit CompactStreamEncoder( const sCompactStreamSettings& settings = sCompactStreamSettings() );
+
+    /**
+     * \brief Encode a frame as a keyframe or as a delta against the previous one.
+     * \param pFilter - rigid bodies, skeletons and labeled markers to keep, nullptr for all
+     * \return - packet length, 0 if it does not fit in bufferSize or MAX_PACKETSIZE bytes
+     * ( the frame is then skipped, and the next one refers to the previous frame still )
+     */
+    size_t Encode( const sFrameOfMocapData& frame, const FrameFilter* pFilter, char* pBuffer, size_t bufferSize );
+
+    /**
+     * \brief Make the next frame a keyframe.
+     */
+    void RequestKeyframe() { mReference.valid = false; }
+
+    const sCompactStreamSettings& Settings() const { return mSettings; }
+
+private:
+    sCompactStreamSettings mSettings;
+    uint32_t mSequence;
+    int mSinceKeyframe;
+    sCompactReference mReference;
+    sCompactReference mCurrent;             // built while encoding, the reference once sent
+};
+
+/**
+ * \brief Result of decoding a compact frame.
+ */
+enum CompactStreamResult
+{
+    CompactStream_OK = 0,
+    CompactStream_NeedKeyframe,             // a delta whose reference was lost; dropped until the next keyframe
+    CompactStream_Stale,                    // older than the last frame decoded, or a duplicate
+    CompactStream_Malformed
+};
+
+/**
+ * \brief Counters of a CompactStreamDecoder.
+ */
+typedef struct sCompactStreamCounters
+{
+    uint64_t nKeyframes;
+    uint64_t nDeltas;
+    uint64_t nWaiting;                      // deltas dropped waiting for a keyframe
+    uint64_t nStale;
+    uint64_t nMalformed;
+    uint64_t nBytes;                        // of the packets decoded
+} sCompactStreamCounters;
+
+/**
+ * \brief Decodes the NAT_COMPACTFRAME packets of one stream, in the order they were sent.
+ */
+class CompactStreamDecoder
+{
+public:
+    CompactStreamDecoder();
+
+    /**
+     * \brief Decode a complete NAT_COMPACTFRAME packet into frame, replacing its contents.
+     * Elements past the capacity of sFrameOfMocapData are counted in nTruncated.
+     */
+    CompactStreamResult Decode( const char* pData, size_t length, sDecodedFrame& frame );
+
+    const sCompactStreamCounters& Counters() const { return mCounters; }
+
+private:
+    float mPositionResolution;
+    int mRotationBits;
+    sCompactReference mReference;
+    sCompactReference mCurrent;
+    sCompactStreamCounters mCounters;
+};
@@ -0,0 +1,616 @@
+//=============================================================================
+// DataDescriptionCache.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Decoded NAT_MODELDEF contents with O(1) streaming ID lookups.
+// The bitstream handling is derived from samples/PacketClient/PacketClient.cpp
+// (NatNet SDK 4.1.0), licensed under the Apache License, Version 2.0.
+//=============================================================================
+
+#include "DataDescriptionCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+// NatNet description features, by version
+// A major version of 0 means 'unknown' and is handled like the PacketClient sample does.
+static constexpr bool HasDescriptionSize( int major, int minor ) { return ( ( major == 4 ) && ( minor > 0 ) ) || ( major > 4 ); }
+static constexpr bool HasRigidBodyName( int major, int /*minor*/ ) { return ( major >= 2 ) || ( major == 0 ); }
+static constexpr bool HasRotationOffset( int major, int minor ) { return ( ( major == 4 ) && ( minor >= 2 ) ) || ( major > 4 ) || ( major == 0 ); }
+static constexpr bool HasRigidBodyMarkers( int major, int /*minor*/ ) { return ( major >= 3 ) || ( major == 0 ); }
+static constexpr bool HasRigidBodyMarkerNames( int major, int /*minor*/ ) { return ( major >= 4 ) || ( major == 0 ); }
+static constexpr bool HasAnalogDescriptions( int major, int /*minor*/ ) { return ( major >= 3 ) || ( major == 0 ); }
+
+//-----------------------------------------------------------------------------
+// StreamingIdIndex
+//-----------------------------------------------------------------------------
+
+StreamingIdIndex::StreamingIdIndex()
+    : mnSparse( 0 )
+{
+}
+
+void StreamingIdIndex::Clear()
+{
+    mDense.clear();
+    mSparse.clear();
+    mnSparse = 0;
+}
+
+void StreamingIdIndex::Insert( int32_t ID, int32_t index )
+{
+    if( ( ID >= 0 ) && ( ID < STREAMING_ID_DENSE_LIMIT ) )
+    {
+        if( ID >= (int32_t) mDense.size() )
+        {
+            mDense.resize( ID + 1, -1 );
+        }
+        if( mDense[ID] < 0 )
+        {
+            mDense[ID] = index;
+        }
+        return;
+    }
+
+    if( ( mnSparse + 1 ) * 2 > mSparse.size() )
+    {
+        std::vector<sSlot> slots;
+        slots.swap( mSparse );
+        sSlot empty = { 0, -1 };
+        mSparse.assign( std::max( (size_t) 16, slots.size() * 2 ), empty );
+        mnSparse = 0;
+        for( const sSlot& slot : slots )
+        {
+            if( slot.index >= 0 )
+            {
+                InsertSparse( slot.ID, slot.index );
+            }
+        }
+    }
+    InsertSparse( ID, index );
+}
+
+void StreamingIdIndex::InsertSparse( int32_t ID, int32_t index )
+{
+    size_t mask = mSparse.size() - 1;
+    for( size_t slot = Hash( ID ) & mask; ; slot = ( slot + 1 ) & mask )
+    {
+        if( mSparse[slot].index < 0 )
+        {
+            mSparse[slot].ID = ID;
+            mSparse[slot].index = index;
+            ++mnSparse;
+            return;
+        }
+        if( mSparse[slot].ID == ID )
+        {
+            return;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Description decoding
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief Cursor over a NAT_MODELDEF payload that never reads past its end.
+ * The first error is kept and stops all further reads.
+ */
+struct sDescriptionReader
+{
+    sDescriptionReader( const char* begin, const char* limit )
+        : ptr( begin )
+        , end( limit )
+        , error( PacketError_None )
+    {
+    }
+
+    void Fail( PacketError reason )
+    {
+        if( error == PacketError_None )
+        {
+            error = reason;
+        }
+        ptr = end;
+    }
+
+    bool Require( int64_t nBytes )
+    {
+        if( nBytes > end - ptr )
+        {
+            Fail( PacketError_Truncated );
+            return false;
+        }
+        return true;
+    }
+
+    void Read( void* dest, size_t nBytes )
+    {
+        if( nBytes == 0 )
+        {
+            return;
+        }
+        if( Require( (int64_t) nBytes ) )
+        {
+            memcpy( dest, ptr, nBytes ); ptr += nBytes;
+        }
+        else
+        {
+            memset( dest, 0, nBytes );
+        }
+    }
+
+    int32_t ReadInt() { int32_t value = 0; Read( &value, 4 ); return value; }
+    int16_t ReadShort() { int16_t value = 0; Read( &value, 2 ); return value; }
+    void ReadFloats( float* dest, int count ) { Read( dest, count * sizeof( float ) ); }
+
+    /**
+     * \brief Read an element count, checking that count elements of at least minSize bytes fit.
+     */
+    int ReadCount( int minSize )
+    {
+        int32_t count = ReadInt();
+        if( count < 0 )
+        {
+            Fail( PacketError_InvalidCount );
+            return 0;
+        }
+        return Require( (int64_t) count * minSize ) ? count : 0;
+    }
+
+    void ReadString( std::string& dest )
+    {
+        const char* terminator = static_cast<const char*>( memchr( ptr, 0, end - ptr ) );
+        if( terminator == nullptr )
+        {
+            Fail( PacketError_UnterminatedString );
+            dest.clear();
+            return;
+        }
+        dest.assign( ptr, terminator );
+        ptr = terminator + 1;
+    }
+
+    void ReadStrings( std::vector<std::string>& dest, int count )
+    {
+        dest.resize( count );
+        for( int i = 0; ( i < count ) && ( error == PacketError_None ); i++ )
+        {
+            ReadString( dest[i] );
+        }
+    }
+
+    const char* ptr;
+    const char* end;
+    PacketError error;
+};
+
+static void DecodeMarkerSetDescription( sDescriptionReader& reader, int /*major*/, int /*minor*/, sCachedMarkerSet& markerSet )
+{
+    reader.ReadString( markerSet.name );
+    int nMarkers = reader.ReadCount( 1 );
+    reader.ReadStrings( markerSet.markerNames, nMarkers );
+}
+
+static void DecodeRigidBodyDescription( sDescriptionReader& reader, int major, int minor, sCachedRigidBody& rigidBody )
+{
+    rigidBody.name.clear();
+    if( HasRigidBodyName( major, minor ) )
+    {
+        reader.ReadString( rigidBody.name );
+    }
+    rigidBody.ID = reader.ReadInt();
+    rigidBody.parentID = reader.ReadInt();
+    rigidBody.parentIndex = -1;
+    reader.ReadFloats( rigidBody.offset, 3 );
+
+    rigidBody.rotation[0] = rigidBody.rotation[1] = rigidBody.rotation[2] = 0.0f;
+    rigidBody.rotation[3] = 1.0f;
+    if( HasRotationOffset( major, minor ) )
+    {
+        reader.ReadFloats( rigidBody.rotation, 4 );
+    }
+
+    int nMarkers = 0;
+    if( HasRigidBodyMarkers( major, minor ) )
+    {
+        // positions and required labels, then names
+        nMarkers = reader.ReadCount( 16 );
+    }
+    rigidBody.markerPositions.resize( 3 * nMarkers );
+    rigidBody.markerRequiredLabels.resize( nMarkers );
+    reader.ReadFloats( rigidBody.markerPositions.data(), 3 * nMarkers );
+    reader.Read( rigidBody.markerRequiredLabels.data(), 4 * nMarkers );
+    if( HasRigidBodyMarkerNames( major, minor ) )
+    {
+        reader.ReadStrings( rigidBody.markerNames, nMarkers );
+    }
+    else
+    {
+        rigidBody.markerNames.assign( nMarkers, std::string() );
+    }
+}
+
+/**
+ * \brief Index rigid bodies by ID and link each to its parent.
+ */
+static void IndexRigidBodies( std::vector<sCachedRigidBody>& rigidBodies, StreamingIdIndex& index )
+{
+    index.Clear();
+    for( size_t i = 0; i < rigidBodies.size(); i++ )
+    {
+        index.Insert( rigidBodies[i].ID, (int32_t) i );
+    }
+    for( sCachedRigidBody& rigidBody : rigidBodies )
+    {
+        rigidBody.parentIndex = ( rigidBody.parentID < 0 ) ? -1 : index.Find( rigidBody.parentID );
+    }
+}
+
+static void DecodeRigidBodyDescriptions( sDescriptionReader& reader, int major, int minor, std::vector<sCachedRigidBody>& rigidBodies, StreamingIdIndex& index )
+{
+    // smallest rigid body: ID, parent ID and offset
+    int nRigidBodies = reader.ReadCount( 20 );
+    rigidBodies.resize( nRigidBodies );
+    for( int i = 0; ( i < nRigidBodies ) && ( reader.error == PacketError_None ); i++ )
+    {
+        DecodeRigidBodyDescription( reader, major, minor, rigidBodies[i] );
+    }
+    IndexRigidBodies( rigidBodies, index );
+}
+
+static void DecodeSkeletonDescription( sDescriptionReader& reader, int major, int minor, sCachedSkeleton& skeleton )
+{
+    reader.ReadString( skeleton.name );
+    skeleton.ID = reader.ReadInt();
+    DecodeRigidBodyDescriptions( reader, major, minor, skeleton.bones, skeleton.boneIndex );
+}
+
+static void DecodeForcePlateDescription( sDescriptionReader& reader, int major, int minor, sCachedForcePlate& forcePlate )
+{
+    memset( forcePlate.origin, 0, sizeof( forcePlate.origin ) );
+    memset( forcePlate.calMat, 0, sizeof( forcePlate.calMat ) );
+    memset( forcePlate.corners, 0, sizeof( forcePlate.corners ) );
+    forcePlate.ID = 0;
+    forcePlate.serialNo.clear();
+    forcePlate.width = forcePlate.length = 0.0f;
+    forcePlate.plateType = forcePlate.channelDataType = 0;
+    forcePlate.channelNames.clear();
+    if( !HasAnalogDescriptions( major, minor ) )
+    {
+        return;
+    }
+
+    forcePlate.ID = reader.ReadInt();
+    reader.ReadString( forcePlate.serialNo );
+    reader.ReadFloats( &forcePlate.width, 1 );
+    reader.ReadFloats( &forcePlate.length, 1 );
+    reader.ReadFloats( forcePlate.origin, 3 );
+    reader.ReadFloats( &forcePlate.calMat[0][0], 12 * 12 );
+    reader.ReadFloats( &forcePlate.corners[0][0], 4 * 3 );
+    forcePlate.plateType = reader.ReadInt();
+    forcePlate.channelDataType = reader.ReadInt();
+    int nChannels = reader.ReadCount( 1 );
+    reader.ReadStrings( forcePlate.channelNames, nChannels );
+}
+
+static void DecodeDeviceDescription( sDescriptionReader& reader, int major, int minor, sCachedDevice& device )
+{
+    device.ID = 0;
+    device.name.clear();
+    device.serialNo.clear();
+    device.deviceType = device.channelDataType = 0;
+    device.channelNames.clear();
+    if( !HasAnalogDescriptions( major, minor ) )
+    {
+        return;
+    }
+
+    device.ID = reader.ReadInt();
+    reader.ReadString( device.name );
+    reader.ReadString( device.serialNo );
+    device.deviceType = reader.ReadInt();
+    device.channelDataType = reader.ReadInt();
+    int nChannels = reader.ReadCount( 1 );
+    reader.ReadStrings( device.channelNames, nChannels );
+}
+
+static void DecodeCameraDescription( sDescriptionReader& reader, int /*major*/, int /*minor*/, sCachedCamera& camera )
+{
+    reader.ReadString( camera.name );
+    reader.ReadFloats( camera.position, 3 );
+    reader.ReadFloats( camera.orientation, 4 );
+}
+
+static void DecodeAssetDescription( sDescriptionReader& reader, int major, int minor, sCachedAsset& asset )
+{
+    reader.ReadString( asset.name );
+    asset.type = reader.ReadInt();
+    asset.ID = reader.ReadInt();
+    DecodeRigidBodyDescriptions( reader, major, minor, asset.rigidBodies, asset.rigidBodyIndex );
+
+    // smallest marker: name terminator, ID, position, size and params
+    int nMarkers = reader.ReadCount( 23 );
+    asset.markers.resize( nMarkers );
+    asset.markerIndex.Clear();
+    for( int i = 0; ( i < nMarkers ) && ( reader.error == PacketError_None ); i++ )
+    {
+        sCachedMarker& marker = asset.markers[i];
+        reader.ReadString( marker.name );
+        marker.ID = reader.ReadInt();
+        reader.ReadFloats( marker.position, 3 );
+        reader.ReadFloats( &marker.size, 1 );
+        marker.params = reader.ReadShort();
+        asset.markerIndex.Insert( marker.ID, i );
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Incremental update
+//-----------------------------------------------------------------------------
+
+/**
+ * \brief Entries of one description type being assembled by an Update.
+ * Nothing is moved out of the previous entries until the whole payload decoded.
+ */
+template <class T>
+struct sPendingEntries
+{
+    sPendingEntries( const sDescriptionEntries<T>& entries, bool reuse )
+        : previous( entries )
+        , taken( reuse ? entries.items.size() : 0, false )
+        , hint( 0 )
+    {
+    }
+
+    /**
+     * \brief Find a previous entry decoded from exactly [begin, end).
+     * The search starts after the last match, so an unchanged or shifted order matches at once.
+     * \return - index of the previous entry, -1 if the description is new or changed
+     */
+    int32_t FindUnchanged( const char* begin, const char* end )
+    {
+        size_t nBytes = (size_t) ( end - begin );
+        size_t n = taken.size();
+        for( size_t k = 0; k < n; k++ )
+        {
+            size_t j = ( hint + k ) % n;
+            const std::string& encoding = previous.encodings[j];
+            if( !taken[j] && ( encoding.size() == nBytes ) && ( memcmp( encoding.data(), begin, nBytes ) == 0 ) )
+            {
+                taken[j] = true;
+                hint = j + 1;
+                return (int32_t) j;
+            }
+        }
+        return -1;
+    }
+
+    const sDescriptionEntries<T>& previous;
+    std::vector<bool> taken;
+    size_t hint;
+    std::vector<int32_t> source;            // >= 0: previous entry to keep, < 0: -1 - index into decoded
+    std::vector<T> decoded;
+    std::vector<std::string> encodings;
+};
+
+/**
+ * \brief Decode one description, or match it with an unchanged previous one.
+ * \param reader - payload cursor, at the description
+ * \param end - end of the description ( NatNet 4.1+ ), nullptr if only known after decoding it
+ * \param pending - entries of the description type
+ * \param decode - decoder of the description type
+ */
+template <class T, class Decode>
+static void AddDescription( sDescriptionReader& reader, const char* end, int major, int minor, sPendingEntries<T>& pending, Decode decode )
+{
+    const char* begin = reader.ptr;
+    int32_t unchanged = -1;
+    if( end != nullptr )
+    {
+        unchanged = pending.FindUnchanged( begin, end );
+        if( unchanged < 0 )
+        {
+            // newer servers may append fields; ignore what the description size says is left
+            sDescriptionReader sizedReader( begin, end );
+            T entry;
+            decode( sizedReader, major, minor, entry );
+            if( sizedReader.error != PacketError_None )
+            {
+                reader.Fail( ( sizedReader.error == PacketError_Truncated ) ? PacketError_SectionSize : sizedReader.error );
+                return;
+            }
+            pending.decoded.push_back( std::move( entry ) );
+        }
+        reader.ptr = end;
+    }
+    else
+    {
+        T entry;
+        decode( reader, major, minor, entry );
+        if( reader.error != PacketError_None )
+        {
+            return;
+        }
+        end = reader.ptr;
+        unchanged = pending.FindUnchanged( begin, end );
+        if( unchanged < 0 )
+        {
+            pending.decoded.push_back( std::move( entry ) );
+        }
+    }
+
+    pending.source.push_back( ( unchanged >= 0 ) ? unchanged : -(int32_t) pending.decoded.size() );
+    pending.encodings.push_back( std::string( begin, end ) );
+}
+
+/**
+ * \brief Replace entries by the assembled ones.
+ * \return - true if any entry was added, removed, changed or moved
+ */
+template <class T>
+static bool CommitEntries( sDescriptionEntries<T>& entries, sPendingEntries<T>& pending, sDescriptionChanges& changes )
+{
+    std::vector<T> items;
+    items.reserve( pending.source.size() );
+    int32_t nUnchanged = 0;
+    bool moved = false;
+    for( int32_t source : pending.source )
+    {
+        if( source >= 0 )
+        {
+            moved |= ( source != (int32_t) items.size() );
+            items.push_back( std::move( entries.items[source] ) );
+            ++nUnchanged;
+        }
+        else
+        {
+            items.push_back( std::move( pending.decoded[-1 - source] ) );
+            ++changes.nDecoded;
+        }
+    }
+    int32_t nRemoved = (int32_t) entries.items.size() - nUnchanged;
+    changes.nUnchanged += nUnchanged;
+    changes.nRemoved += nRemoved;
+
+    entries.items.swap( items );
+    entries.encodings.swap( pending.encodings );
+    return moved || ( nRemoved > 0 ) || ( nUnchanged < (int32_t) entries.items.size() );
+}
+
+DataDescriptionCache::DataDescriptionCache()
+    : mMajor( -1 )
+    , mMinor( -1 )
+    , mGeneration( 0 )
+{
+    memset( &mLastChanges, 0, sizeof( mLastChanges ) );
+}
+
+PacketError DataDescriptionCache::Update( const char* inptr, int nBytes, int major, int minor )
+{
+    // The encoding of a description depends on the version, so nothing carries over a version change
+    const bool reuse = ( major == mMajor ) && ( minor == mMinor );
+    sPendingEntries<sCachedMarkerSet> markerSets( mMarkerSets, reuse );
+    sPendingEntries<sCachedRigidBody> rigidBodies( mRigidBodies, reuse );
+    sPendingEntries<sCachedSkeleton> skeletons( mSkeletons, reuse );
+    sPendingEntries<sCachedForcePlate> forcePlates( mForcePlates, reuse );
+    sPendingEntries<sCachedDevice> devices( mDevices, reuse );
+    sPendingEntries<sCachedCamera> cameras( mCameras, reuse );
+    sPendingEntries<sCachedAsset> assets( mAssets, reuse );
+
+    sDescriptionReader reader( inptr, inptr + nBytes );
+    // smallest description: its type
+    int nDescriptions = reader.ReadCount( 4 );
+    for( int i = 0; ( i < nDescriptions ) && ( reader.error == PacketError_None ); i++ )
+    {
+        int type = reader.ReadInt();
+
+        // Unlike frame data sections, the size here is per description
+        const char* end = nullptr;
+        if( HasDescriptionSize( major, minor ) )
+        {
+            int sizeInBytes = reader.ReadCount( 1 );
+            end = reader.ptr + sizeInBytes;
+        }
+        if( reader.error != PacketError_None )
+        {
+            break;
+        }
+
+        switch( type )
+        {
+        case Descriptor_MarkerSet:
+            AddDescription( reader, end, major, minor, markerSets, DecodeMarkerSetDescription );
+            break;
+        case Descriptor_RigidBody:
+            AddDescription( reader, end, major, minor, rigidBodies, DecodeRigidBodyDescription );
+            break;
+        case Descriptor_Skeleton:
+            AddDescription( reader, end, major, minor, skeletons, DecodeSkeletonDescription );
+            break;
+        case Descriptor_ForcePlate:
+            AddDescription( reader, end, major, minor, forcePlates, DecodeForcePlateDescription );
+            break;
+        case Descriptor_Device:
+            AddDescription( reader, end, major, minor, devices, DecodeDeviceDescription );
+            break;
+        case Descriptor_Camera:
+            AddDescription( reader, end, major, minor, cameras, DecodeCameraDescription );
+            break;
+        case Descriptor_Asset:
+            AddDescription( reader, end, major, minor, assets, DecodeAssetDescription );
+            break;
+        default:
+            // a description size lets us step over types added after this decoder
+            if( end != nullptr )
+            {
+                reader.ptr = end;
+            }
+            else
+            {
+                reader.Fail( PacketError_UnknownDescription );
+            }
+            break;
+        }
+    }
+    if( reader.error != PacketError_None )
+    {
+        return reader.error;
+    }
+
+    sDescriptionChanges changes;
+    memset( &changes, 0, sizeof( changes ) );
+    bool changed = false;
+    changed |= CommitEntries( mMarkerSets, markerSets, changes );
+    changed |= CommitEntries( mRigidBodies, rigidBodies, changes );
+    changed |= CommitEntries( mSkeletons, skeletons, changes );
+    changed |= CommitEntries( mForcePlates, forcePlates, changes );
+    changed |= CommitEntries( mDevices, devices, changes );
+    changed |= CommitEntries( mCameras, cameras, changes );
+    changed |= CommitEntries( mAssets, assets, changes );
+    mLastChanges = changes;
+    mMajor = major;
+    mMinor = minor;
+
+    // Entries kept in place keep their index entries, so a repeated NAT_MODELDEF costs no rebuild
+    if( changed )
+    {
+        RebuildIndices();
+        ++mGeneration;
+    }
+    return PacketError_None;
+}
+
+void DataDescriptionCache::Clear()
+{
+    uint64_t generation = mGeneration;
+    *this = DataDescriptionCache();
+    mGeneration = generation + 1;
+}
+
+void DataDescriptionCache::RebuildIndices()
+{
+    IndexRigidBodies( mRigidBodies.items, mRigidBodyIndex );
+
+    mSkeletonIndex.Clear();
+    for( size_t i = 0; i < mSkeletons.items.size(); i++ )
+    {
+        mSkeletonIndex.Insert( mSkeletons.items[i].ID, (int32_t) i );
+    }
+    mAssetIndex.Clear();
+    for( size_t i = 0; i < mAssets.items.size(); i++ )
+    {
+        mAssetIndex.Insert( mAssets.items[i].ID, (int32_t) i );
+    }
+    mForcePlateIndex.Clear();
+    for( size_t i = 0; i < mForcePlates.items.size(); i++ )
+    {
+        mForcePlateIndex.Insert( mForcePlates.items[i].ID, (int32_t) i );
+    }
+    mDeviceIndex.Clear();
+    for( size_t i = 0; i < mDevices.items.size(); i++ )
+    {
+        mDeviceIndex.Insert( mDevices.items[i].ID, (int32_t) i );
+    }
+}
@@ -0,0 +1,324 @@
+//=============================================================================
+// DataDescriptionCache.h
+// ~~~~~~~~~~~~~~~~~~~~~~
+//
+// Decoded NAT_MODELDEF contents, kept across description updates, with
+// constant time lookups from the streaming IDs found in frame data to names,
+// skeleton hierarchy, marker offsets and force plate calibration.
+// The bitstream handling is derived from samples/PacketClient/PacketClient.cpp
+// (NatNet SDK 4.1.0), licensed under the Apache License, Version 2.0.
+//=============================================================================
+
+#pragma once
+
+#include <NatNetTypes.h>
+
+#include "NatNetDecoder.h"
+
+#include <string>
+#include <vector>
+
+// IDs below this resolve through a direct table; Motive numbers streaming IDs from 1
+#define STREAMING_ID_DENSE_LIMIT        4096
+
+/**
+ * \brief Map from streaming ID to the position of an entry.
+ * Small non-negative IDs index a dense table, any other ID goes through an
+ * open addressing hash table, so a lookup never walks a tree.
+ */
+class StreamingIdIndex
+{
+public:
+    StreamingIdIndex();
+
+    void Clear();
+
+    /**
+     * \brief Map ID to index. The first insertion of an ID wins.
+     */
+    void Insert( int32_t ID, int32_t index );
+
+    /**
+     * \return - index inserted for ID, -1 if there is none
+     */
+    int32_t Find( int32_t ID ) const
+    {
+        if( ( ID >= 0 ) && ( ID < (int32_t) mDense.size() ) )
+        {
+            return mDense[ID];
+        }
+        if( mnSparse == 0 )
+        {
+            return -1;
+        }
+        size_t mask = mSparse.size() - 1;
+        for( size_t slot = Hash( ID ) & mask; ; slot = ( slot + 1 ) & mask )
+        {
+            if( mSparse[slot].index < 0 )
+            {
+                return -1;
+            }
+            if( mSparse[slot].ID == ID )
+            {
+                return mSparse[slot].index;
+            }
+        }
+    }
+
+private:
+    struct sSlot
+    {
+        int32_t ID;
+        int32_t index;                      // -1 if the slot is empty
+    };
+
+    // Murmur3 finalizer: every bit of the ID reaches the low bits the mask
+    // keeps, so strided IDs ( e.g. model << 16 ) spread over the table
+    static size_t Hash( int32_t ID )
+    {
+        uint32_t h = (uint32_t) ID;
+        h ^= h >> 16;
+        h *= 0x85EBCA6Bu;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35u;
+        h ^= h >> 16;
+        return (size_t) h;
+    }
+
+    void InsertSparse( int32_t ID, int32_t index );
+
+    std::vector<int32_t> mDense;
+    std::vector<sSlot> mSparse;             // power of 2 size, at most half full
+    size_t mnSparse;
+};
+
+/**
+ * \brief Marker of an Asset description.
+ */
+typedef struct sCachedMarker
+{
+    std::string name;
+    int32_t ID;
+    float position[3];                      // initial position
+    float size;
+    int16_t params;
+} sCachedMarker;
+
+/**
+ * \brief Rigid body, skeleton bone or Asset rigid body description.
+ */
+typedef struct sCachedRigidBody
+{
+    std::string name;
+    int32_t ID;                             // streaming ID, or bone ID within a skeleton or Asset
+    int32_t parentID;                       // -1 if there is no parent
+    int32_t parentIndex;                    // position of the parent among its siblings, -1 if not described
+    float offset[3];                        // position relative to the parent
+    float rotation[4];                      // qx, qy, qz, qw relative to the parent ( NatNet 4.2+, identity before )
+    std::vector<float> markerPositions;     // x, y, z per marker
+    std::vector<int32_t> markerRequiredLabels;
+    std::vector<std::string> markerNames;
+} sCachedRigidBody;
+
+/**
+ * \brief MarkerSet description.
+ */
+typedef struct sCachedMarkerSet
+{
+    std::string name;
+    std::vector<std::string> markerNames;
+} sCachedMarkerSet;
+
+/**
+ * \brief Skeleton description.
+ */
+typedef struct sCachedSkeleton
+{
+    std::string name;
+    int32_t ID;
+    std::vector<sCachedRigidBody> bones;
+    StreamingIdIndex boneIndex;             // bone ID to position in bones
+} sCachedSkeleton;
+
+/**
+ * \brief Asset description.
+ */
+typedef struct sCachedAsset
+{
+    std::string name;
+    int32_t type;                           // AssetTypes
+    int32_t ID;
+    std::vector<sCachedRigidBody> rigidBodies;
+    StreamingIdIndex rigidBodyIndex;        // rigid body ID to position in rigidBodies
+    std::vector<sCachedMarker> markers;
+    StreamingIdIndex markerIndex;           // marker ID to position in markers
+} sCachedAsset;
+
+/**
+ * \brief Force plate description.
+ */
+typedef struct sCachedForcePlate
+{
+    int32_t ID;
+    std::string serialNo;
+    float width;
+    float length;
+    float origin[3];                        // electrical center offset
+    float calMat[12][12];                   // calibration matrix ( raw analog voltage channels only )
+    float corners[4][3];                    // in world coordinates, clockwise from plate +x,+y
+    int32_t plateType;
+    int32_t channelDataType;                // 0 = calibrated force data, 1 = raw analog voltages
+    std::vector<std::string> channelNames;
+} sCachedForcePlate;
+
+/**
+ * \brief Peripheral device description.
+ */
+typedef struct sCachedDevice
+{
+    int32_t ID;
+    std::string name;
+    std::string serialNo;
+    int32_t deviceType;
+    int32_t channelDataType;
+    std::vector<std::string> channelNames;
+} sCachedDevice;
+
+/**
+ * \brief Camera description.
+ */
+typedef struct sCachedCamera
+{
+    std::string name;
+    float position[3];
+    float orientation[4];                   // qx, qy, qz, qw
+} sCachedCamera;
+
+/**
+ * \brief Decoded entries of one description type, with the bytes each was decoded from.
+ */
+template <class T>
+struct sDescriptionEntries
+{
+    std::vector<T> items;
+    std::vector<std::string> encodings;
+};
+
+/**
+ * \brief What the last DataDescriptionCache::Update did.
+ */
+typedef struct sDescriptionChanges
+{
+    int32_t nUnchanged;                     // descriptions kept from the previous update
+    int32_t nDecoded;                       // new or changed descriptions
+    int32_t nRemoved;                       // previous descriptions no longer present
+} sDescriptionChanges;
+
+/**
+ * \brief Data descriptions of the current scene.
+ * Each NAT_MODELDEF received is compared description by description with
+ * the previous one; unchanged descriptions keep their decoded entry and only
+ * new or changed ones are decoded. Entries are stored per type in stream order.
+ * Lookups by streaming ID are O(1) and meant to be called for every frame;
+ * returned pointers are valid until the next Update.
+ */
+class DataDescriptionCache
+{
+public:
+    DataDescriptionCache();
+
+    /**
+     * \brief Update the cache from a NAT_MODELDEF payload.
+     * The payload is fully checked against nBytes first; on error the cache is left unchanged.
+     * \param inptr - pointer to the payload (after the packet header)
+     * \param nBytes - payload size in bytes
+     * \param major - NatNet major version
+     * \param minor - NatNet minor version
+     * \return - PacketError_None on success
+     */
+    PacketError Update( const char* inptr, int nBytes, int major, int minor );
+
+    void Clear();
+
+    /**
+     * \brief Incremented by every Update that changed the contents.
+     */
+    uint64_t Generation() const { return mGeneration; }
+
+    const sDescriptionChanges& LastChanges() const { return mLastChanges; }
+
+    const std::vector<sCachedMarkerSet>& MarkerSets() const { return mMarkerSets.items; }
+    const std::vector<sCachedRigidBody>& RigidBodies() const { return mRigidBodies.items; }
+    const std::vector<sCachedSkeleton>& Skeletons() const { return mSkeletons.items; }
+    const std::vector<sCachedForcePlate>& ForcePlates() const { return mForcePlates.items; }
+    const std::vector<sCachedDevice>& Devices() const { return mDevices.items; }
+    const std::vector<sCachedCamera>& Cameras() const { return mCameras.items; }
+    const std::vector<sCachedAsset>& Assets() const { return mAssets.items; }
+
+    const sCachedRigidBody* FindRigidBody( int32_t ID ) const { return Find( mRigidBodies.items, mRigidBodyIndex, ID ); }
+    const sCachedSkeleton* FindSkeleton( int32_t ID ) const { return Find( mSkeletons.items, mSkeletonIndex, ID ); }
+    const sCachedAsset* FindAsset( int32_t ID ) const { return Find( mAssets.items, mAssetIndex, ID ); }
+    const sCachedForcePlate* FindForcePlate( int32_t ID ) const { return Find( mForcePlates.items, mForcePlateIndex, ID ); }
+    const sCachedDevice* FindDevice( int32_t ID ) const { return Find( mDevices.items, mDeviceIndex, ID ); }
+
+    /**
+     * \brief Bone of a skeleton.
+     * \param skeletonID - skeleton ID
+     * \param boneID - bone ID, or the ID of a skeleton rigid body in frame data ( bone ID in the low 16 bits )
+     * \return - bone description, nullptr if not described
+     */
+    const sCachedRigidBody* FindSkeletonBone( int32_t skeletonID, int32_t boneID ) const
+    {
+        const sCachedSkeleton* pSkeleton = FindSkeleton( skeletonID );
+        return pSkeleton ? Find( pSkeleton->bones, pSkeleton->boneIndex, boneID & 0xFFFF ) : nullptr;
+    }
+
+    /**
+     * \brief Rigid body of an Asset, see FindSkeletonBone.
+     */
+    const sCachedRigidBody* FindAssetRigidBody( int32_t assetID, int32_t rigidBodyID ) const
+    {
+        const sCachedAsset* pAsset = FindAsset( assetID );
+        return pAsset ? Find( pAsset->rigidBodies, pAsset->rigidBodyIndex, rigidBodyID & 0xFFFF ) : nullptr;
+    }
+
+    /**
+     * \brief Marker of an Asset.
+     * \param assetID - Asset ID
+     * \param markerID - marker ID, or the ID of an Asset marker in frame data ( marker ID in the low 16 bits )
+     */
+    const sCachedMarker* FindAssetMarker( int32_t assetID, int32_t markerID ) const
+    {
+        const sCachedAsset* pAsset = FindAsset( assetID );
+        return pAsset ? Find( pAsset->markers, pAsset->markerIndex, markerID & 0xFFFF ) : nullptr;
+    }
+
+private:
+    template <class T>
+    static const T* Find( const std::vector<T>& items, const StreamingIdIndex& index, int32_t ID )
+    {
+        int32_t i = index.Find( ID );
+        return ( i < 0 ) ? nullptr : &items[i];
+    }
+
+    void RebuildIndices();
+
+    sDescriptionEntries<sCachedMarkerSet> mMarkerSets;
+    sDescriptionEntries<sCachedRigidBody> mRigidBodies;
+    sDescriptionEntries<sCachedSkeleton> mSkeletons;
+    sDescriptionEntries<sCachedForcePlate> mForcePlates;
+    sDescriptionEntries<sCachedDevice> mDevices;
+    sDescriptionEntries<sCachedCamera> mCameras;
+    sDescriptionEntries<sCachedAsset> mAssets;
+
+    StreamingIdIndex mRigidBodyIndex;
+    StreamingIdIndex mSkeletonIndex;
+    StreamingIdIndex mAssetIndex;
+    StreamingIdIndex mForcePlateIndex;
+    StreamingIdIndex mDeviceIndex;
+
+    int mMajor;
+    int mMinor;
+    uint64_t mGeneration;
+    sDescriptionChanges mLastChanges;
+};
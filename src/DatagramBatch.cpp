@@ -0,0 +1,408 @@
+//
+// DatagramBatch.cpp
+// ~~~~~~~~~~~~~~~~~
+//
+
+#include "DatagramBatch.h"
+
+#include <array>
+#include <chrono>
+#include <errno.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <time.h>
+#endif
+
+static std::int64_t realtime_now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+datagram_batch::datagram_batch(std::size_t capacity, std::size_t buffer_size)
+  : capacity_(capacity)
+  , buffer_size_(buffer_size)
+  , size_(0)
+  , buffers_(capacity * buffer_size)
+  , lengths_(capacity)
+  , senders_(capacity)
+  , timestamps_(capacity)
+  , truncated_(capacity)
+  , timestamps_enabled_(false)
+  , drop_count_enabled_(false)
+#if defined(__linux__)
+  , iovecs_(capacity)
+  , headers_(capacity)
+  , control_size_(0)
+#endif
+  , socket_drops_(0)
+  , receive_calls_(0)
+{
+#if defined(__linux__)
+  for (std::size_t i = 0; i < capacity_; ++i)
+  {
+    iovecs_[i].iov_base = buffers_.data() + i * buffer_size_;
+    iovecs_[i].iov_len = buffer_size_;
+  }
+#endif
+}
+
+send_batch::send_batch(std::size_t capacity)
+  : capacity_(capacity)
+  , size_(0)
+  , destinations_(capacity)
+  , headers_(capacity * max_header_size)
+  , header_sizes_(capacity)
+  , bodies_(capacity)
+  , body_sizes_(capacity)
+  , segmentation_(false)
+#if defined(__linux__)
+  , iovecs_(2 * capacity)
+  , messages_(capacity)
+  , message_datagrams_(capacity)
+  , controls_(capacity * CMSG_SPACE(sizeof(std::uint16_t)))
+#endif
+  , send_calls_(0)
+{
+}
+
+bool send_batch::add(const boost::asio::ip::udp::endpoint& destination,
+    const void* header, std::size_t header_size,
+    const void* body, std::size_t body_size)
+{
+  if (size_ == capacity_ || header_size > max_header_size)
+  {
+    return false;
+  }
+  destinations_[size_] = destination;
+  if (header_size > 0)
+  {
+    memcpy(&headers_[size_ * max_header_size], header, header_size);
+  }
+  header_sizes_[size_] = header_size;
+  bodies_[size_] = body;
+  body_sizes_[size_] = body_size;
+  ++size_;
+  return true;
+}
+
+#if defined(__linux__)
+
+bool datagram_batch::enable_timestamps(boost::asio::ip::udp::socket& socket)
+{
+  int on = 1;
+  if (::setsockopt(socket.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS,
+      &on, sizeof(on)) != 0)
+  {
+    timestamps_enabled_ = true;
+    return false;
+  }
+  timestamps_enabled_ = true;
+  allocate_controls();
+  return true;
+}
+
+bool datagram_batch::enable_drop_count(boost::asio::ip::udp::socket& socket)
+{
+  int on = 1;
+  if (::setsockopt(socket.native_handle(), SOL_SOCKET, SO_RXQ_OVFL,
+      &on, sizeof(on)) != 0)
+  {
+    return false;
+  }
+  drop_count_enabled_ = true;
+  allocate_controls();
+  return true;
+}
+
+// Room for every control message enabled.
+void datagram_batch::allocate_controls()
+{
+  control_size_ = 0;
+  if (timestamps_enabled_)
+  {
+    control_size_ += CMSG_SPACE(sizeof(timespec));
+  }
+  if (drop_count_enabled_)
+  {
+    control_size_ += CMSG_SPACE(sizeof(std::uint32_t));
+  }
+  controls_.assign(capacity_ * control_size_, 0);
+}
+
+std::size_t datagram_batch::receive(boost::asio::ip::udp::socket& socket,
+    boost::system::error_code& ec)
+{
+  size_ = 0;
+  // recvmmsg overwrites the name lengths and flags, so reset the headers.
+  for (std::size_t i = 0; i < capacity_; ++i)
+  {
+    msghdr& header = headers_[i].msg_hdr;
+    header.msg_name = senders_[i].data();
+    header.msg_namelen = static_cast<socklen_t>(senders_[i].capacity());
+    header.msg_iov = &iovecs_[i];
+    header.msg_iovlen = 1;
+    header.msg_control = control_size_ ? &controls_[i * control_size_] : nullptr;
+    header.msg_controllen = control_size_;
+    header.msg_flags = 0;
+    headers_[i].msg_len = 0;
+  }
+
+  ++receive_calls_;
+  int count = ::recvmmsg(socket.native_handle(), headers_.data(),
+      static_cast<unsigned int>(capacity_), MSG_DONTWAIT, nullptr);
+  if (count < 0)
+  {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+    {
+      ec = boost::asio::error::would_block;
+    }
+    else
+    {
+      ec = boost::system::error_code(errno, boost::system::system_category());
+    }
+    return 0;
+  }
+
+  ec = boost::system::error_code();
+  size_ = static_cast<std::size_t>(count);
+  std::int64_t now = timestamps_enabled_ ? realtime_now() : 0;
+  for (std::size_t i = 0; i < size_; ++i)
+  {
+    msghdr& header = headers_[i].msg_hdr;
+    lengths_[i] = headers_[i].msg_len;
+    truncated_[i] = (header.msg_flags & MSG_TRUNC) != 0;
+    senders_[i].resize(header.msg_namelen);
+
+    timestamps_[i] = now;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&header); cmsg != nullptr;
+        cmsg = CMSG_NXTHDR(&header, cmsg))
+    {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+      {
+        timespec ts;
+        memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+        timestamps_[i] = static_cast<std::int64_t>(ts.tv_sec) * 1000000000
+          + ts.tv_nsec;
+      }
+      else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+      {
+        std::uint32_t drops;
+        memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+        socket_drops_ = drops;
+      }
+    }
+  }
+  return size_;
+}
+
+std::size_t set_receive_buffer_size(boost::asio::ip::udp::socket& socket,
+    std::size_t bytes)
+{
+  int size = static_cast<int>(bytes);
+  if (::setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVBUFFORCE,
+      &size, sizeof(size)) != 0)
+  {
+    ::setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVBUF,
+        &size, sizeof(size));
+  }
+  return receive_buffer_size(socket);
+}
+
+bool send_batch::enable_segmentation(boost::asio::ip::udp::socket& socket)
+{
+  int size = 0;
+  socklen_t length = sizeof(size);
+  segmentation_ = ::getsockopt(socket.native_handle(), SOL_UDP, UDP_SEGMENT,
+      &size, &length) == 0;
+  return segmentation_;
+}
+
+// Messages for the datagrams from first on: with segmentation, a run of
+// datagrams to the same destination, all of the size of the first but the
+// last, which may be shorter, becomes one message cut by the kernel.
+std::size_t send_batch::prepare_messages(std::size_t first)
+{
+  std::size_t count = 0;
+  std::size_t i = first;
+  while (i < size_)
+  {
+    std::size_t segment = header_sizes_[i] + body_sizes_[i];
+    std::size_t bytes = segment;
+    std::size_t end = i + 1;
+    while (segmentation_ && end < size_ && end - i < max_segments
+        && destinations_[end] == destinations_[i]
+        && header_sizes_[end - 1] + body_sizes_[end - 1] == segment
+        && header_sizes_[end] + body_sizes_[end] <= segment
+        && bytes + header_sizes_[end] + body_sizes_[end] <= max_segmented_size)
+    {
+      bytes += header_sizes_[end] + body_sizes_[end];
+      ++end;
+    }
+
+    msghdr& header = messages_[count].msg_hdr;
+    memset(&header, 0, sizeof(header));
+    header.msg_name = destinations_[i].data();
+    header.msg_namelen = static_cast<socklen_t>(destinations_[i].size());
+    header.msg_iov = &iovecs_[2 * i];
+    header.msg_iovlen = 2 * (end - i);
+    if (end - i > 1)
+    {
+      header.msg_control = &controls_[count * CMSG_SPACE(sizeof(std::uint16_t))];
+      header.msg_controllen = CMSG_SPACE(sizeof(std::uint16_t));
+      cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
+      cmsg->cmsg_level = SOL_UDP;
+      cmsg->cmsg_type = UDP_SEGMENT;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+      std::uint16_t gso_size = static_cast<std::uint16_t>(segment);
+      memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+    }
+    message_datagrams_[count++] = end - i;
+    i = end;
+  }
+  return count;
+}
+
+std::size_t send_batch::send(boost::asio::ip::udp::socket& socket,
+    boost::system::error_code& ec)
+{
+  ec = boost::system::error_code();
+  for (std::size_t i = 0; i < size_; ++i)
+  {
+    iovecs_[2 * i].iov_base = &headers_[i * max_header_size];
+    iovecs_[2 * i].iov_len = header_sizes_[i];
+    iovecs_[2 * i + 1].iov_base = const_cast<void*>(bodies_[i]);
+    iovecs_[2 * i + 1].iov_len = body_sizes_[i];
+  }
+
+  // sendmmsg stops early when the socket buffer fills up (non-blocking) or
+  // on an error; carry on after the messages it sent.
+  std::size_t sent = 0;
+  std::size_t messages = prepare_messages(0);
+  std::size_t message = 0;
+  while (message < messages)
+  {
+    ++send_calls_;
+    int count = ::sendmmsg(socket.native_handle(), &messages_[message],
+        static_cast<unsigned int>(messages - message), 0);
+    if (count < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (count < 0 && segmentation_ && message_datagrams_[message] > 1
+        && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT))
+    {
+      // The route cannot segment (no checksum offload): one datagram each.
+      segmentation_ = false;
+      messages = prepare_messages(sent);
+      message = 0;
+      continue;
+    }
+    if (count < 0)
+    {
+      ec = boost::system::error_code(errno, boost::system::system_category());
+      break;
+    }
+    for (int m = 0; m < count; ++m)
+    {
+      sent += message_datagrams_[message++];
+    }
+  }
+  size_ = 0;
+  return sent;
+}
+
+bool set_busy_poll(boost::asio::ip::udp::socket& socket, int microseconds)
+{
+  return ::setsockopt(socket.native_handle(), SOL_SOCKET, SO_BUSY_POLL,
+      &microseconds, sizeof(microseconds)) == 0;
+}
+
+#else
+
+bool datagram_batch::enable_timestamps(boost::asio::ip::udp::socket& /*socket*/)
+{
+  timestamps_enabled_ = true;
+  return false;
+}
+
+bool datagram_batch::enable_drop_count(boost::asio::ip::udp::socket& /*socket*/)
+{
+  return false;
+}
+
+std::size_t datagram_batch::receive(boost::asio::ip::udp::socket& socket,
+    boost::system::error_code& ec)
+{
+  size_ = 0;
+  socket.non_blocking(true, ec);
+  while (!ec && size_ < capacity_)
+  {
+    ++receive_calls_;
+    std::size_t length = socket.receive_from(
+        boost::asio::buffer(buffers_.data() + size_ * buffer_size_, buffer_size_),
+        senders_[size_], 0, ec);
+    if (!ec)
+    {
+      timestamps_[size_] = timestamps_enabled_ ? realtime_now() : 0;
+      truncated_[size_] = 0;
+      lengths_[size_++] = length;
+    }
+  }
+  if (size_ > 0)
+  {
+    ec = boost::system::error_code();
+  }
+  return size_;
+}
+
+std::size_t set_receive_buffer_size(boost::asio::ip::udp::socket& socket,
+    std::size_t bytes)
+{
+  boost::system::error_code ec;
+  socket.set_option(boost::asio::socket_base::receive_buffer_size(
+      static_cast<int>(bytes)), ec);
+  return receive_buffer_size(socket);
+}
+
+bool send_batch::enable_segmentation(boost::asio::ip::udp::socket& /*socket*/)
+{
+  return false;
+}
+
+std::size_t send_batch::send(boost::asio::ip::udp::socket& socket,
+    boost::system::error_code& ec)
+{
+  ec = boost::system::error_code();
+  std::size_t sent = 0;
+  for (std::size_t i = 0; i < size_ && !ec; ++i)
+  {
+    std::array<boost::asio::const_buffer, 2> buffers = {{
+      boost::asio::buffer(&headers_[i * max_header_size], header_sizes_[i]),
+      boost::asio::buffer(bodies_[i], body_sizes_[i]) }};
+    ++send_calls_;
+    socket.send_to(buffers, destinations_[i], 0, ec);
+    sent += ec ? 0 : 1;
+  }
+  size_ = 0;
+  return sent;
+}
+
+bool set_busy_poll(boost::asio::ip::udp::socket& /*socket*/,
+    int /*microseconds*/)
+{
+  return false;
+}
+
+#endif
+
+std::size_t receive_buffer_size(boost::asio::ip::udp::socket& socket)
+{
+  boost::asio::socket_base::receive_buffer_size option;
+  boost::system::error_code ec;
+  socket.get_option(option, ec);
+  return ec ? 0 : static_cast<std::size_t>(option.value());
+}
@@ -0,0 +1,176 @@
+//
+// DatagramBatch.h
+// ~~~~~~~~~~~~~~~
+//
+// Batched datagram receive: one recvmmsg call drains up to capacity queued
+// datagrams into preallocated buffers (Linux), optionally with kernel
+// receive timestamps. Elsewhere the batch is filled with one non-blocking
+// receive per datagram. And the sending side, with sendmmsg.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <boost/asio.hpp>
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#endif
+
+class datagram_batch
+{
+public:
+  datagram_batch(std::size_t capacity, std::size_t buffer_size);
+
+  datagram_batch(const datagram_batch&) = delete;
+  datagram_batch& operator=(const datagram_batch&) = delete;
+
+  // Receive the datagrams already queued on the socket, up to capacity(),
+  // without blocking. Returns the number received; 0 with ec set to
+  // would_block when nothing is queued.
+  std::size_t receive(boost::asio::ip::udp::socket& socket,
+      boost::system::error_code& ec);
+
+  // Ask the kernel to timestamp datagrams as they arrive (SO_TIMESTAMPNS).
+  // Returns false where that is not supported; timestamp() then reports
+  // when the datagram was read.
+  bool enable_timestamps(boost::asio::ip::udp::socket& socket);
+
+  // Ask the kernel for the count of datagrams the socket dropped because its
+  // receive buffer was full (SO_RXQ_OVFL). Returns false where that is not
+  // supported; socket_drops() then stays 0.
+  bool enable_drop_count(boost::asio::ip::udp::socket& socket);
+
+  std::size_t capacity() const { return capacity_; }
+  std::size_t size() const { return size_; }
+
+  const char* data(std::size_t i) const
+  {
+    return buffers_.data() + i * buffer_size_;
+  }
+
+  std::size_t length(std::size_t i) const { return lengths_[i]; }
+
+  // The datagram was longer than the buffer and was cut (Linux only).
+  bool truncated(std::size_t i) const { return truncated_[i] != 0; }
+
+  boost::asio::ip::udp::endpoint sender(std::size_t i) const
+  {
+    return senders_[i];
+  }
+
+  // Receive time in nanoseconds of the realtime clock, 0 unless
+  // enable_timestamps() was called.
+  std::int64_t timestamp(std::size_t i) const { return timestamps_[i]; }
+
+  // Datagrams dropped by the socket since it was created, as of the last
+  // datagram received, 0 unless enable_drop_count() was called.
+  std::uint64_t socket_drops() const { return socket_drops_; }
+
+  // Receive system calls issued so far, including those that found nothing.
+  std::uint64_t receive_calls() const { return receive_calls_; }
+
+private:
+  std::size_t capacity_;
+  std::size_t buffer_size_;
+  std::size_t size_;
+  std::vector<char> buffers_;
+  std::vector<std::size_t> lengths_;
+  std::vector<boost::asio::ip::udp::endpoint> senders_;
+  std::vector<std::int64_t> timestamps_;
+  std::vector<char> truncated_;
+  bool timestamps_enabled_;
+  bool drop_count_enabled_;
+#if defined(__linux__)
+  void allocate_controls();
+
+  std::vector<iovec> iovecs_;
+  std::vector<mmsghdr> headers_;
+  std::vector<char> controls_;
+  std::size_t control_size_;
+#endif
+  std::uint64_t socket_drops_;
+  std::uint64_t receive_calls_;
+};
+
+// Batched datagram send: datagrams of a small header and a body are queued
+// and go out with one sendmmsg call (Linux). The header is copied, the body
+// is not: it is sent from where it lies, e.g. a receive buffer, and must
+// stay there until send(). Elsewhere each datagram is sent on its own,
+// still gathered from both parts.
+class send_batch
+{
+public:
+  static const std::size_t max_header_size = 32;
+
+  // Limits of one segmented send (UDP_MAX_SEGMENTS, largest UDP payload).
+  static const std::size_t max_segments = 64;
+  static const std::size_t max_segmented_size = 65507;
+
+  explicit send_batch(std::size_t capacity);
+
+  send_batch(const send_batch&) = delete;
+  send_batch& operator=(const send_batch&) = delete;
+
+  // Send each run of datagrams queued for the same destination, all of one
+  // size but the last, as one UDP GSO message (UDP_SEGMENT, Linux 4.18+)
+  // that the kernel or the NIC cuts back into those datagrams: one trip
+  // through the stack instead of one per datagram. Returns false where
+  // not supported; send() also turns it off when a route cannot segment.
+  bool enable_segmentation(boost::asio::ip::udp::socket& socket);
+
+  // Queue a datagram. Returns false when the batch is full or the header
+  // too large.
+  bool add(const boost::asio::ip::udp::endpoint& destination,
+      const void* header, std::size_t header_size,
+      const void* body, std::size_t body_size);
+
+  // Send the queued datagrams and clear the batch. Returns the number sent;
+  // the rest are dropped, with the error in ec.
+  std::size_t send(boost::asio::ip::udp::socket& socket,
+      boost::system::error_code& ec);
+
+  std::size_t capacity() const { return capacity_; }
+  std::size_t size() const { return size_; }
+  bool full() const { return size_ == capacity_; }
+
+  // Send system calls issued so far.
+  std::uint64_t send_calls() const { return send_calls_; }
+
+private:
+  std::size_t capacity_;
+  std::size_t size_;
+  std::vector<boost::asio::ip::udp::endpoint> destinations_;
+  std::vector<char> headers_;
+  std::vector<std::size_t> header_sizes_;
+  std::vector<const void*> bodies_;
+  std::vector<std::size_t> body_sizes_;
+  bool segmentation_;
+#if defined(__linux__)
+  std::size_t prepare_messages(std::size_t first);
+
+  std::vector<iovec> iovecs_;
+  std::vector<mmsghdr> messages_;
+  std::vector<std::size_t> message_datagrams_;
+  std::vector<char> controls_;
+#endif
+  std::uint64_t send_calls_;
+};
+
+// Set the receive buffer size of a socket; as root (CAP_NET_ADMIN) on Linux
+// past the net.core.rmem_max limit. Returns the size the socket reports
+// afterwards (Linux usually doubles the size set to account for its
+// bookkeeping), 0 if it cannot be read.
+std::size_t set_receive_buffer_size(boost::asio::ip::udp::socket& socket,
+    std::size_t bytes);
+
+// Let a non-blocking receive on the socket poll the device queue for up to
+// microseconds before returning empty-handed (SO_BUSY_POLL; raising it above
+// net.core.busy_read needs CAP_NET_ADMIN). Returns false where not permitted
+// or supported.
+bool set_busy_poll(boost::asio::ip::udp::socket& socket, int microseconds);
+
+// Current receive buffer size, as reported by the socket.
+std::size_t receive_buffer_size(boost::asio::ip::udp::socket& socket);
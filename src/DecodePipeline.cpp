@@ -0,0 +1,349 @@
+//=============================================================================
+// DecodePipeline.cpp
+// ~~~~~~~~~~~~~~~~~~
+//
+// Multi-core frame decoding with in-order delivery.
+//=============================================================================
+
+#include "DecodePipeline.h"
+#include "FrameLatency.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Checks for a new frame before an idle worker goes to sleep
+#define PIPELINE_SPIN_COUNT     1000
+
+DecodePipeline::DecodePipeline( int nWorkers, int nSlots, DeliverCallback deliver, DecodedCallback decoded, unsigned int sections )
+    : mDeliver( deliver )
+    , mDecoded( decoded )
+    , mSections( sections )
+    , mHead( 0 )
+    , mClaim( 0 )
+    , mTail( 0 )
+    , mDelivering( false )
+    , mLastFrame( 0 )
+    , mHaveLastFrame( false )
+    , mnWaiting( 0 )
+    , mSleepers( 0 )
+    , mStop( false )
+    , mnPushed( 0 )
+    , mnRingFull( 0 )
+    , mnInvalid( 0 )
+    , mnStale( 0 )
+    , mnReordered( 0 )
+    , mnSkipped( 0 )
+    , mnDelivered( 0 )
+{
+    nSlots = std::max( nSlots, 1 );
+    mSlots.reserve( nSlots );
+    for( int i = 0; i < nSlots; i++ )
+    {
+        mSlots.emplace_back( new sSlot() );
+    }
+    // The spare frames themselves are allocated the first time frames wait
+    mWaiting.reserve( PIPELINE_REORDER_FRAMES + 1 );
+    mSpare.reserve( PIPELINE_REORDER_FRAMES + 1 );
+
+    nWorkers = std::max( nWorkers, 1 );
+    mThreads.reserve( nWorkers );
+    for( int i = 0; i < nWorkers; i++ )
+    {
+        mThreads.emplace_back( &DecodePipeline::Work, this );
+    }
+}
+
+DecodePipeline::~DecodePipeline()
+{
+    Stop();
+}
+
+bool DecodePipeline::Push( const char* pData, size_t length, const DecoderContext& context, int64_t received )
+{
+    if( mStop.load( std::memory_order_relaxed ) )
+    {
+        return false;
+    }
+
+    uint64_t head = mHead.load( std::memory_order_relaxed );
+    sSlot& slot = *mSlots[head % mSlots.size()];
+    if( slot.state.load( std::memory_order_acquire ) != SlotState_Free )
+    {
+        mnRingFull.fetch_add( 1, std::memory_order_relaxed );
+        return false;
+    }
+
+    slot.length = std::min( length, slot.datagram.size() );
+    memcpy( slot.datagram.data(), pData, slot.length );
+    slot.received = received;
+    slot.decoder = context.Decoder();
+    slot.validator = context.Validator();
+    slot.major = context.Major();
+    slot.minor = context.Minor();
+    slot.state.store( SlotState_Received, std::memory_order_relaxed );
+    mHead.store( head + 1 );    // publishes the slot
+    mnPushed.fetch_add( 1, std::memory_order_relaxed );
+
+    // A worker going to sleep registers before checking mHead again, so either it sees the
+    // new head or this sees it registered
+    if( mSleepers.load() > 0 )
+    {
+        {
+            std::lock_guard<std::mutex> lock( mMutex );
+        }
+        mWake.notify_one();
+    }
+    return true;
+}
+
+void DecodePipeline::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        if( mStop.exchange( true ) && mThreads.empty() )
+        {
+            return;
+        }
+    }
+    mWake.notify_all();
+    for( std::thread& thread : mThreads )
+    {
+        thread.join();
+    }
+    mThreads.clear();
+    Deliver();
+    DeliverWaiting( mWaiting.size() );
+}
+
+sPipelineStats DecodePipeline::Stats() const
+{
+    sPipelineStats stats;
+    stats.nPushed = mnPushed.load( std::memory_order_relaxed );
+    stats.nRingFull = mnRingFull.load( std::memory_order_relaxed );
+    stats.nInvalid = mnInvalid.load( std::memory_order_relaxed );
+    stats.nStale = mnStale.load( std::memory_order_relaxed );
+    stats.nReordered = mnReordered.load( std::memory_order_relaxed );
+    stats.nSkipped = mnSkipped.load( std::memory_order_relaxed );
+    stats.nDelivered = mnDelivered.load( std::memory_order_relaxed );
+    return stats;
+}
+
+void DecodePipeline::Work()
+{
+    int spins = 0;
+    for( ;; )
+    {
+        uint64_t claim = mClaim.load( std::memory_order_acquire );
+        if( claim == mHead.load( std::memory_order_acquire ) )
+        {
+            if( ++spins < PIPELINE_SPIN_COUNT )
+            {
+                continue;
+            }
+            // While frames wait for earlier ones, wake up in time to give up on those
+            bool expired = false;
+            {
+                std::unique_lock<std::mutex> lock( mMutex );
+                mSleepers.fetch_add( 1 );
+                while( ( mClaim.load() == mHead.load() ) && !mStop.load() && !expired )
+                {
+                    if( mnWaiting.load( std::memory_order_relaxed ) > 0 )
+                    {
+                        expired = ( mWake.wait_for( lock, std::chrono::milliseconds( PIPELINE_REORDER_TIMEOUT_MS ) )
+                            == std::cv_status::timeout );
+                    }
+                    else
+                    {
+                        mWake.wait( lock );
+                    }
+                }
+                mSleepers.fetch_sub( 1 );
+                if( ( mClaim.load() == mHead.load() ) && mStop.load() )
+                {
+                    return;
+                }
+            }
+            if( expired )
+            {
+                Deliver();
+            }
+            spins = 0;
+            continue;
+        }
+        if( !mClaim.compare_exchange_weak( claim, claim + 1 ) )
+        {
+            continue;
+        }
+        spins = 0;
+
+        sSlot& slot = *mSlots[claim % mSlots.size()];
+        Decode( slot );
+        slot.state.store( SlotState_Decoded );
+        Deliver();
+    }
+}
+
+void DecodePipeline::Decode( sSlot& slot )
+{
+    slot.error = ValidatePacket( slot.datagram.data(), slot.length, slot.validator, slot.major, slot.minor );
+    if( slot.error != PacketError_None )
+    {
+        return;
+    }
+    int messageID = 0;
+    DecodePacket( slot.datagram.data(), slot.decoder, slot.major, slot.minor, messageID, *slot.frame, mSections );
+    slot.frame->times.received = slot.received;
+    slot.frame->times.decoded = slot.received ? RealtimeNanoseconds() : 0;
+    if( mDecoded )
+    {
+        mDecoded( *slot.frame );
+    }
+}
+
+void DecodePipeline::Deliver()
+{
+    // Whichever worker gets here first delivers every frame that is ready in order, including
+    // those decoded by other workers meanwhile
+    for( ;; )
+    {
+        if( mDelivering.exchange( true, std::memory_order_acquire ) )
+        {
+            return;
+        }
+
+        for( ;; )
+        {
+            uint64_t tail = mTail.load( std::memory_order_relaxed );
+            sSlot& slot = *mSlots[tail % mSlots.size()];
+            if( slot.state.load( std::memory_order_acquire ) != SlotState_Decoded )
+            {
+                break;
+            }
+
+            Reorder( slot );
+            mTail.store( tail + 1, std::memory_order_relaxed );
+            slot.state.store( SlotState_Free, std::memory_order_release );
+        }
+
+        DeliverExpired();
+
+        // A frame decoded after the check above but before this store would otherwise wait for the next one
+        mDelivering.store( false );
+        if( mSlots[mTail.load( std::memory_order_relaxed ) % mSlots.size()]->state.load() != SlotState_Decoded )
+        {
+            return;
+        }
+    }
+}
+
+void DecodePipeline::Reorder( sSlot& slot )
+{
+    if( slot.error != PacketError_None )
+    {
+        mnInvalid.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+    const sDecodedFrame& frame = *slot.frame;
+    int64_t step = mHaveLastFrame ? (int64_t) frame.data.iFrame - mLastFrame : 1;
+    if( step == 1 )
+    {
+        DeliverFrame( frame );
+        DeliverWaiting( 0 );
+    }
+    else if( ( step <= 0 ) && ( -step < PIPELINE_STALE_FRAME_WINDOW ) )
+    {
+        mnStale.fetch_add( 1, std::memory_order_relaxed );
+    }
+    else if( ( step > 0 ) && ( step < PIPELINE_STALE_FRAME_WINDOW ) )
+    {
+        Wait( slot );
+    }
+    else
+    {
+        // The frame numbers restarted: the waiting frames belong to the previous run
+        DeliverWaiting( mWaiting.size() );
+        DeliverFrame( frame );
+    }
+}
+
+void DecodePipeline::Wait( sSlot& slot )
+{
+    int32_t iFrame = slot.frame->data.iFrame;
+    std::vector<sWaiting>::iterator position = std::lower_bound( mWaiting.begin(), mWaiting.end(), iFrame,
+        []( const sWaiting& waiting, int32_t i ) { return waiting.frame->data.iFrame < i; } );
+    if( ( position != mWaiting.end() ) && ( position->frame->data.iFrame == iFrame ) )
+    {
+        mnStale.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+
+    // The slot takes a spare frame in exchange, at most PIPELINE_REORDER_FRAMES + 1 are ever allocated
+    if( mSpare.empty() )
+    {
+        mSpare.emplace_back( new sDecodedFrame() );
+    }
+    sWaiting waiting;
+    waiting.frame = std::move( slot.frame );
+    waiting.since = std::chrono::steady_clock::now();
+    slot.frame = std::move( mSpare.back() );
+    mSpare.pop_back();
+    mWaiting.insert( position, std::move( waiting ) );
+
+    if( mWaiting.size() > PIPELINE_REORDER_FRAMES )
+    {
+        DeliverWaiting( 1 );
+    }
+    mnWaiting.store( (int) mWaiting.size(), std::memory_order_relaxed );
+}
+
+void DecodePipeline::DeliverFrame( const sDecodedFrame& frame )
+{
+    mLastFrame = frame.data.iFrame;
+    mHaveLastFrame = true;
+    mDeliver( frame );
+    mnDelivered.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void DecodePipeline::DeliverWaiting( size_t count )
+{
+    // The first count frames go whatever is missing before them, then those that follow on
+    size_t i = 0;
+    for( ; i < mWaiting.size(); i++ )
+    {
+        const sDecodedFrame& frame = *mWaiting[i].frame;
+        int64_t missing = (int64_t) frame.data.iFrame - mLastFrame - 1;
+        if( ( i >= count ) && ( missing != 0 ) )
+        {
+            break;
+        }
+        mnSkipped.fetch_add( (uint64_t) std::max( missing, (int64_t) 0 ), std::memory_order_relaxed );
+        mnReordered.fetch_add( 1, std::memory_order_relaxed );
+        DeliverFrame( frame );
+        mSpare.push_back( std::move( mWaiting[i].frame ) );
+    }
+    mWaiting.erase( mWaiting.begin(), mWaiting.begin() + i );
+    mnWaiting.store( (int) mWaiting.size(), std::memory_order_relaxed );
+}
+
+void DecodePipeline::DeliverExpired()
+{
+    if( mWaiting.empty() )
+    {
+        return;
+    }
+    // Frames are numbered in the order they were sent, so one that waited too long takes the
+    // frames numbered before it along
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    size_t count = 0;
+    for( size_t i = 0; i < mWaiting.size(); i++ )
+    {
+        if( now - mWaiting[i].since >= std::chrono::milliseconds( PIPELINE_REORDER_TIMEOUT_MS ) )
+        {
+            count = i + 1;
+        }
+    }
+    if( count > 0 )
+    {
+        DeliverWaiting( count );
+    }
+}
@@ -0,0 +1,193 @@
+//=============================================================================
+// DecodePipeline.h
+// ~~~~~~~~~~~~~~~~
+//
+// Multi-core frame decoding. The receiving thread only admits
+// NAT_FRAMEOFDATA datagrams ( DecoderContext::AdmitFrame ) and copies them
+// into a ring of slots; worker threads validate and decode them in
+// parallel, and a reorder stage drops duplicates and delivers the decoded
+// frames to the consumer one at a time, in frame number order.
+//=============================================================================
+
+#pragma once
+
+#include "DecoderContext.h"
+#include "NatNetDecoder.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A frame numbered at most this far below the last delivered one arrived late and is dropped;
+// a larger step back is taken as a restart of the frame numbers ( e.g. looped playback )
+#define PIPELINE_STALE_FRAME_WINDOW     1000
+
+// A frame numbered past the next one expected waits for the frames before it while fewer than
+// PIPELINE_REORDER_FRAMES frames wait and for at most PIPELINE_REORDER_TIMEOUT_MS; the frames still
+// missing then are skipped
+#define PIPELINE_REORDER_FRAMES         8
+#define PIPELINE_REORDER_TIMEOUT_MS     5
+
+/**
+ * \brief Counters of a DecodePipeline.
+ */
+typedef struct sPipelineStats
+{
+    uint64_t nPushed;                       // frames accepted by Push
+    uint64_t nRingFull;                     // frames dropped by Push because every slot was in use
+    uint64_t nInvalid;                      // frames that failed validation
+    uint64_t nStale;                        // every duplicate pushed, and frames older than the last delivered one
+    uint64_t nReordered;                    // frames that waited for an earlier frame
+    uint64_t nSkipped;                      // frame numbers given up on, see PIPELINE_REORDER_FRAMES
+    uint64_t nDelivered;                    // frames passed to the deliver callback
+} sPipelineStats;
+
+/**
+ * \brief Receive thread -> decode workers -> reorder stage -> in-order delivery.
+ * Each slot of the ring owns a datagram buffer and an sDecodedFrame, so a
+ * frame is decoded and delivered in place without copies or allocations.
+ * Slots are claimed by the workers in receive order and released in
+ * receive order once delivered; a slow frame holds back the delivery ( not
+ * the decoding ) of the frames behind it. A frame that arrives ahead of an
+ * earlier one the network delayed is moved out of its slot ( swapped with a
+ * spare frame ) and waits, keyed by frame number, until the earlier frame
+ * is delivered or given up on. When every slot is in use, Push drops the
+ * frame rather than stall the receiving thread.
+ */
+class DecodePipeline
+{
+public:
+    /**
+     * \brief Called on a worker thread right after a frame is decoded, concurrently for different frames.
+     * For per-frame work that does not depend on order ( filtering, conversion, ... ).
+     */
+    typedef std::function<void( sDecodedFrame& frame )> DecodedCallback;
+
+    /**
+     * \brief Called once per frame in frame number order, never concurrently, on one of the worker threads.
+     * The frame is only valid during the call.
+     */
+    typedef std::function<void( const sDecodedFrame& frame )> DeliverCallback;
+
+    /**
+     * \brief Start the workers.
+     * \param nWorkers - # of decode threads
+     * \param nSlots - # of frames received but not yet delivered that the ring can hold
+     * \param deliver - in-order consumer
+     * \param decoded - optional parallel stage
+     * \param sections - FrameSection mask of the sections to decode
+     */
+    DecodePipeline( int nWorkers, int nSlots, DeliverCallback deliver,
+        DecodedCallback decoded = DecodedCallback(), unsigned int sections = FrameSection_All );
+
+    /**
+     * \brief Stop, see Stop.
+     */
+    ~DecodePipeline();
+
+    DecodePipeline( const DecodePipeline& ) = delete;
+    DecodePipeline& operator=( const DecodePipeline& ) = delete;
+
+    /**
+     * \brief Queue a NAT_FRAMEOFDATA datagram for decoding.
+     * Call from the receiving thread only, after context.AdmitFrame; the frame
+     * is decoded in the bitstream version of context at the time of the call.
+     * The caller neither validates nor deduplicates: invalid frames are counted
+     * in nInvalid, duplicates and late frames in nStale, and only the others
+     * reach the deliver callback, where continuity can be accounted.
+     * \param received - receive time for sFrameTimes, see RealtimeNanoseconds; 0 if not measured
+     * \return - false if the frame was dropped because the ring is full or the pipeline stopped
+     */
+    bool Push( const char* pData, size_t length, const DecoderContext& context, int64_t received = 0 );
+
+    /**
+     * \brief Decode and deliver the frames pushed so far, waiting ones included, then join the workers.
+     */
+    void Stop();
+
+    sPipelineStats Stats() const;
+
+    int Workers() const { return (int) mThreads.size(); }
+
+    /**
+     * \brief Worker thread i, to set its CPU affinity or priority ( see ThreadTuning.h ).
+     */
+    std::thread& Worker( int i ) { return mThreads[i]; }
+
+private:
+    enum SlotState
+    {
+        SlotState_Free,
+        SlotState_Received,
+        SlotState_Decoded
+    };
+
+    struct sSlot
+    {
+        sSlot() : state( SlotState_Free ), datagram( MAX_PACKETSIZE ), length( 0 ), received( 0 ), decoder( nullptr ),
+            validator( nullptr ), major( 0 ), minor( 0 ), error( PacketError_None ), frame( new sDecodedFrame() ) {}
+
+        std::atomic<int> state;             // SlotState
+        std::vector<char> datagram;
+        size_t length;
+        int64_t received;
+        FrameDecoder decoder;
+        FrameValidator validator;
+        int major;
+        int minor;
+        PacketError error;
+        std::unique_ptr<sDecodedFrame> frame;
+    };
+
+    // A frame waiting for the frames numbered before it
+    struct sWaiting
+    {
+        std::unique_ptr<sDecodedFrame> frame;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    void Work();
+    void Decode( sSlot& slot );
+    void Deliver();
+
+    // Reorder stage, called while delivering
+    void Reorder( sSlot& slot );
+    void Wait( sSlot& slot );
+    void DeliverFrame( const sDecodedFrame& frame );
+    void DeliverWaiting( size_t count );
+    void DeliverExpired();
+
+    std::vector<std::unique_ptr<sSlot>> mSlots;
+    DeliverCallback mDeliver;
+    DecodedCallback mDecoded;
+    unsigned int mSections;
+
+    std::atomic<uint64_t> mHead;            // next slot to push, written by the receiving thread only
+    std::atomic<uint64_t> mClaim;           // next slot to decode
+    std::atomic<uint64_t> mTail;            // next slot to deliver
+    std::atomic<bool> mDelivering;          // a worker is delivering
+    int32_t mLastFrame;                     // last delivered frame number, accessed while delivering
+    bool mHaveLastFrame;
+    std::vector<sWaiting> mWaiting;         // by frame number, accessed while delivering
+    std::vector<std::unique_ptr<sDecodedFrame>> mSpare;     // swapped into the slots of waiting frames
+    std::atomic<int> mnWaiting;             // idle workers wake up to deliver expired frames
+
+    std::mutex mMutex;                      // idle workers sleep on mWake
+    std::condition_variable mWake;
+    std::atomic<int> mSleepers;
+    std::atomic<bool> mStop;
+    std::vector<std::thread> mThreads;
+
+    std::atomic<uint64_t> mnPushed;
+    std::atomic<uint64_t> mnRingFull;
+    std::atomic<uint64_t> mnInvalid;
+    std::atomic<uint64_t> mnStale;
+    std::atomic<uint64_t> mnReordered;
+    std::atomic<uint64_t> mnSkipped;
+    std::atomic<uint64_t> mnDelivered;
+};
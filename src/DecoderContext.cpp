@@ -0,0 +1,149 @@
+//=============================================================================
+// DecoderContext.cpp
+// ~~~~~~~~~~~~~~~~~~
+//
+// Decoding state of one connection to one NatNet server.
+//=============================================================================
+
+#include "DecoderContext.h"
+
+#include <algorithm>
+#include <cstring>
+
+DecoderContext::DecoderContext()
+    : DecoderContext( 0, 0 )
+{
+    mVersionFixed = false;
+}
+
+DecoderContext::DecoderContext( int major, int minor )
+    : mMajor( major )
+    , mMinor( minor )
+    , mVersionFixed( true )
+    , mDecoder( SelectFrameDecoder( major, minor ) )
+    , mValidator( SelectFrameValidator( major, minor ) )
+    , mChangePending( false )
+    , mPendingMajor( 0 )
+    , mPendingMinor( 0 )
+    , mHasServerInfo( false )
+    , mDescriptions( std::make_shared<DataDescriptionCache>() )
+{
+    memset( &mServer, 0, sizeof( mServer ) );
+}
+
+void DecoderContext::SetVersion( int major, int minor )
+{
+    mMajor = major;
+    mMinor = minor;
+    mVersionFixed = true;
+    mDecoder = SelectFrameDecoder( major, minor );
+    mValidator = SelectFrameValidator( major, minor );
+}
+
+void DecoderContext::BeginBitstreamChange( int major, int minor )
+{
+    mChangePending = true;
+    mPendingMajor = major;
+    mPendingMinor = minor;
+}
+
+PacketError DecoderContext::HandlePacket( const char* pData, size_t length, int& messageID, sDecodedFrame* pFrame, unsigned int sections )
+{
+    messageID = -1;
+    if( length < 4 )
+    {
+        return PacketError_TooShort;
+    }
+    int nBytes = 0;
+    const char* ptr = DecodePacketHeader( pData, messageID, nBytes );
+
+    if( messageID == NAT_FRAMEOFDATA )
+    {
+        PacketError error = AdmitFrame( pData, length );
+        if( error != PacketError_None )
+        {
+            return error;
+        }
+    }
+
+    PacketError error = ValidatePacket( pData, length, mValidator, mMajor, mMinor );
+    if( error != PacketError_None )
+    {
+        return error;
+    }
+
+    switch( messageID )
+    {
+    case NAT_FRAMEOFDATA:
+        if( pFrame != nullptr )
+        {
+            mDecoder( ptr, nBytes, mMajor, mMinor, *pFrame, sections );
+        }
+        break;
+    case NAT_MODELDEF:
+        error = UpdateDescriptions( ptr, nBytes );
+        break;
+    case NAT_SERVERINFO:
+        HandleServerInfo( ptr, nBytes );
+        break;
+    default:
+        break;
+    }
+    return error;
+}
+
+PacketError DecoderContext::AdmitFrame( const char* pData, size_t length )
+{
+    if( !mChangePending )
+    {
+        return PacketError_None;
+    }
+    uint16_t params = 0;
+    PeekFrameParams( pData, length, params );
+    if( !( params & FRAME_PARAMS_BITSTREAM_CHANGED ) )
+    {
+        return PacketError_BitstreamChange;
+    }
+    SetVersion( mPendingMajor, mPendingMinor );
+    mChangePending = false;
+    return PacketError_None;
+}
+
+void DecoderContext::HandleServerInfo( const char* inptr, int nBytes )
+{
+    // Servers before NatNet 3 send only the common sSender part
+    memset( &mServer, 0, sizeof( mServer ) );
+    memcpy( &mServer, inptr, std::min( (size_t) nBytes, sizeof( mServer ) ) );
+    mServer.Common.szName[MAX_NAMELENGTH - 1] = 0;
+    mHasServerInfo = true;
+
+    if( !mVersionFixed )
+    {
+        SetVersion( mServer.Common.NatNetVersion[0], mServer.Common.NatNetVersion[1] );
+        mVersionFixed = false;
+    }
+}
+
+std::shared_ptr<const DataDescriptionCache> DecoderContext::Descriptions() const
+{
+    return std::atomic_load( &mDescriptions );
+}
+
+PacketError DecoderContext::UpdateDescriptions( const char* inptr, int nBytes )
+{
+    // Only this thread replaces mDescriptions, so the set read here is the latest
+    std::shared_ptr<const DataDescriptionCache> current = Descriptions();
+    std::shared_ptr<DataDescriptionCache> next = std::make_shared<DataDescriptionCache>( *current );
+    PacketError error = next->Update( inptr, nBytes, mMajor, mMinor );
+    if( error != PacketError_None )
+    {
+        return error;
+    }
+
+    // A repeated NAT_MODELDEF changes nothing; keep the current set and its readers undisturbed
+    if( next->Generation() != current->Generation() )
+    {
+        std::atomic_store( &mDescriptions, std::shared_ptr<const DataDescriptionCache>( std::move( next ) ) );
+    }
+    return PacketError_None;
+}
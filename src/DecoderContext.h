@@ -0,0 +1,122 @@
+//=============================================================================
+// DecoderContext.h
+// ~~~~~~~~~~~~~~~~
+//
+// Decoding state of one connection to one NatNet server: bitstream version,
+// pending bitstream version change, server description and data
+// descriptions. Contexts share nothing, so one process can decode several
+// servers or bitstream versions at once, each on its own thread.
+//=============================================================================
+
+#pragma once
+
+#include <NatNetTypes.h>
+
+#include "DataDescriptionCache.h"
+#include "NatNetDecoder.h"
+
+#include <memory>
+
+/**
+ * \brief Decoder state of one server connection.
+ * HandlePacket and the other non-const members must be called from one
+ * thread at a time ( typically the thread receiving the connection's
+ * datagrams ); Descriptions may be called from any thread.
+ */
+class DecoderContext
+{
+public:
+    /**
+     * \brief Context for an unknown bitstream version; the first NAT_SERVERINFO sets it.
+     */
+    DecoderContext();
+
+    /**
+     * \brief Context for a known bitstream version, e.g. for recorded data or a requested bitstream.
+     * NAT_SERVERINFO does not override it.
+     */
+    DecoderContext( int major, int minor );
+
+    DecoderContext( const DecoderContext& ) = delete;
+    DecoderContext& operator=( const DecoderContext& ) = delete;
+
+    /**
+     * \brief Validate and handle a received datagram.
+     * NAT_FRAMEOFDATA is decoded into frame, NAT_MODELDEF updates the data
+     * descriptions and NAT_SERVERINFO the server description; other messages
+     * are only validated and left to the caller. While a bitstream change is
+     * pending, frames are dropped until one flags FRAME_PARAMS_BITSTREAM_CHANGED;
+     * that frame and all later ones are decoded in the new version.
+     * \param pData - received datagram
+     * \param length - # of bytes received
+     * \param messageID - output message ID from the packet header
+     * \param pFrame - output frame, nullptr to ignore frames ( e.g. on a command socket )
+     * \param sections - FrameSection mask of the sections to decode
+     * \return - PacketError_None if the packet was handled
+     */
+    PacketError HandlePacket( const char* pData, size_t length, int& messageID, sDecodedFrame* pFrame, unsigned int sections = FrameSection_All );
+
+    /**
+     * \brief Apply a pending bitstream change to a received NAT_FRAMEOFDATA
+     * without validating or decoding it; HandlePacket does this for every frame.
+     * For clients decoding frames elsewhere, e.g. in a DecodePipeline.
+     * \return - PacketError_BitstreamChange if the frame is still in the previous version
+     */
+    PacketError AdmitFrame( const char* pData, size_t length );
+
+    /**
+     * \brief Set the bitstream version and select its decoder and validator.
+     */
+    void SetVersion( int major, int minor );
+
+    /**
+     * \brief Expect the server to switch to another bitstream version.
+     * Call after sending the "Bitstream,major.minor" command.
+     */
+    void BeginBitstreamChange( int major, int minor );
+
+    bool BitstreamChangePending() const { return mChangePending; }
+
+    int Major() const { return mMajor; }
+    int Minor() const { return mMinor; }
+    FrameDecoder Decoder() const { return mDecoder; }
+    FrameValidator Validator() const { return mValidator; }
+
+    /**
+     * \brief Server description from NAT_SERVERINFO.
+     * Fields a server does not send ( HighResClockFrequency and later, before NatNet 3 ) are 0.
+     */
+    const sSender_Server& Server() const { return mServer; }
+    bool HasServerInfo() const { return mHasServerInfo; }
+
+    /**
+     * \brief Current data descriptions.
+     * Safe to call from any thread; the returned set stays valid while newer ones are swapped in.
+     */
+    std::shared_ptr<const DataDescriptionCache> Descriptions() const;
+
+    /**
+     * \brief Update the data descriptions from a NAT_MODELDEF payload.
+     * The new set is built next to the current one and swapped in when complete.
+     * \return - PacketError_None on success; the current set is kept on error
+     */
+    PacketError UpdateDescriptions( const char* inptr, int nBytes );
+
+private:
+    void HandleServerInfo( const char* inptr, int nBytes );
+
+    int mMajor;
+    int mMinor;
+    bool mVersionFixed;                     // set explicitly, NAT_SERVERINFO does not override it
+    FrameDecoder mDecoder;
+    FrameValidator mValidator;
+
+    bool mChangePending;
+    int mPendingMajor;
+    int mPendingMinor;
+
+    sSender_Server mServer;
+    bool mHasServerInfo;
+
+    std::shared_ptr<const DataDescriptionCache> mDescriptions;
+};
@@ -0,0 +1,49 @@
+//=============================================================================
+// FrameArena.cpp
+// ~~~~~~~~~~~~~~
+//
+// Bump allocator for per-frame storage.
+//=============================================================================
+
+#include "FrameArena.h"
+
+#include <cstdint>
+
+FrameArena::FrameArena( size_t capacity )
+    : mBuffer( capacity ? new char[capacity] : nullptr )
+    , mCapacity( capacity )
+    , mUsed( 0 )
+    , mRequested( 0 )
+    , mReallocations( capacity ? 1 : 0 )
+{
+}
+
+void FrameArena::Reset()
+{
+    if( mRequested > mCapacity )
+    {
+        // grow with some headroom so a slowly growing scene does not reallocate every frame
+        size_t capacity = mRequested + mRequested / 2;
+        mBuffer.reset( new char[capacity] );
+        mCapacity = capacity;
+        ++mReallocations;
+    }
+    mUsed = 0;
+    mRequested = 0;
+}
+
+void* FrameArena::Allocate( size_t nBytes, size_t alignment )
+{
+    uintptr_t base = reinterpret_cast<uintptr_t>( mBuffer.get() );
+    size_t offset = ( ( base + mUsed + alignment - 1 ) & ~( uintptr_t ) ( alignment - 1 ) ) - base;
+
+    // account for worst case padding, as the next buffer may be aligned differently
+    mRequested += nBytes + alignment - 1;
+
+    if( ( mBuffer == nullptr ) || ( offset + nBytes > mCapacity ) )
+    {
+        return nullptr;
+    }
+    mUsed = offset + nBytes;
+    return mBuffer.get() + offset;
+}
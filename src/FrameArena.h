@@ -0,0 +1,63 @@
+//=============================================================================
+// FrameArena.h
+// ~~~~~~~~~~~~
+//
+// Bump allocator for per-frame storage. Everything allocated for a frame is
+// released at once by Reset(); the backing buffer is only reallocated when a
+// frame needed more than it holds, so steady-state decoding never touches
+// the heap.
+//=============================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+class FrameArena
+{
+public:
+    /**
+     * \param capacity - initial size of the backing buffer in bytes
+     */
+    explicit FrameArena( size_t capacity = 0 );
+
+    FrameArena( const FrameArena& ) = delete;
+    FrameArena& operator=( const FrameArena& ) = delete;
+
+    /**
+     * \brief Release all allocations.
+     * If allocations failed since the last Reset, the backing buffer first
+     * grows to the size that would have satisfied them.
+     */
+    void Reset();
+
+    /**
+     * \brief Allocate nBytes aligned to alignment ( a power of 2 ).
+     * \return - storage valid until the next Reset, nullptr if the buffer is exhausted
+     */
+    void* Allocate( size_t nBytes, size_t alignment );
+
+    /**
+     * \brief Allocate uninitialized storage for count objects of type T.
+     */
+    template <class T>
+    T* Allocate( size_t count )
+    {
+        return static_cast<T*>( Allocate( count * sizeof( T ), alignof( T ) ) );
+    }
+
+    size_t Capacity() const { return mCapacity; }
+    size_t Used() const { return mUsed; }
+
+    /**
+     * \brief # of times the backing buffer has been ( re )allocated.
+     */
+    size_t Reallocations() const { return mReallocations; }
+
+private:
+    std::unique_ptr<char[]> mBuffer;
+    size_t mCapacity;
+    size_t mUsed;
+    size_t mRequested;                      // bytes requested since Reset, including failed requests
+    size_t mReallocations;
+};
@@ -0,0 +1,458 @@
+//=============================================================================
+// FrameEncoder.cpp
+// ~~~~~~~~~~~~~~~~
+//
+// NAT_FRAMEOFDATA encoding, the mirror image of the frame decoding in
+// NatNetDecoder.cpp: every field is written under the same version test the
+// decoder reads it under.
+//=============================================================================
+
+#include "FrameEncoder.h"
+
+#include "BitstreamFeatures.h"
+#include "NatNetDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+/**
+ * \brief Append-only cursor over the output buffer.
+ * Writing past the end sets overflow and writes nothing further.
+ */
+struct sPacketWriter
+{
+    sPacketWriter( char* begin, char* end ) : ptr( begin ), end( end ), overflow( false ) {}
+
+    /**
+     * \brief Reserve size bytes to fill in later.
+     * \return - pointer to the reserved bytes, nullptr on overflow
+     */
+    char* Reserve( size_t size )
+    {
+        if( overflow || ( size > (size_t) ( end - ptr ) ) )
+        {
+            overflow = true;
+            return nullptr;
+        }
+        char* reserved = ptr;
+        ptr += size;
+        return reserved;
+    }
+
+    void Put( const void* value, size_t size )
+    {
+        char* dest = Reserve( size );
+        if( dest )
+        {
+            memcpy( dest, value, size );
+        }
+    }
+
+    void PutInt( int32_t value ) { Put( &value, 4 ); }
+    void PutShort( int16_t value ) { Put( &value, 2 ); }
+    void PutFloat( float value ) { Put( &value, 4 ); }
+
+    char* ptr;
+    char* end;
+    bool overflow;
+};
+
+/**
+ * \brief Element count of a section and, in NatNet 4.1 and later, its byte count.
+ * Both are reserved when the section starts and filled in when it ends.
+ */
+struct sSection
+{
+    sSection( sPacketWriter& writer, bool hasDataSize )
+        : writer( writer )
+        , pCount( writer.Reserve( 4 ) )
+        , pDataSize( hasDataSize ? writer.Reserve( 4 ) : nullptr )
+        , count( 0 )
+    {
+    }
+
+    void End()
+    {
+        if( writer.overflow )
+        {
+            return;
+        }
+        memcpy( pCount, &count, 4 );
+        if( pDataSize )
+        {
+            int32_t nBytes = (int32_t) ( writer.ptr - ( pDataSize + 4 ) );
+            memcpy( pDataSize, &nBytes, 4 );
+        }
+    }
+
+    sPacketWriter& writer;
+    char* pCount;
+    char* pDataSize;
+    int32_t count;
+};
+
+FrameFilter::FrameFilter()
+    : mSections( 0 )
+    , mModelMarkers( false )
+{
+}
+
+static void InsertSorted( std::vector<int32_t>& IDs, int32_t ID )
+{
+    std::vector<int32_t>::iterator it = std::lower_bound( IDs.begin(), IDs.end(), ID );
+    if( ( it == IDs.end() ) || ( *it != ID ) )
+    {
+        IDs.insert( it, ID );
+    }
+}
+
+void FrameFilter::SelectRigidBody( int32_t ID ) { InsertSorted( mRigidBodyIDs, ID ); }
+void FrameFilter::SelectSkeleton( int32_t ID ) { InsertSorted( mSkeletonIDs, ID ); }
+void FrameFilter::SelectAsset( int32_t ID ) { InsertSorted( mAssetIDs, ID ); }
+
+void FrameFilter::SelectMarkerSet( const char* name )
+{
+    if( !MarkerSet( name ) )
+    {
+        mMarkerSetNames.push_back( name );
+    }
+}
+
+bool FrameFilter::RigidBody( int32_t ID ) const
+{
+    return ( mSections & FrameSection_RigidBodies ) || std::binary_search( mRigidBodyIDs.begin(), mRigidBodyIDs.end(), ID );
+}
+
+bool FrameFilter::Skeleton( int32_t ID ) const
+{
+    return ( mSections & FrameSection_Skeletons ) || std::binary_search( mSkeletonIDs.begin(), mSkeletonIDs.end(), ID );
+}
+
+bool FrameFilter::Asset( int32_t ID ) const
+{
+    return ( mSections & FrameSection_Assets ) || std::binary_search( mAssetIDs.begin(), mAssetIDs.end(), ID );
+}
+
+bool FrameFilter::MarkerSet( const char* name ) const
+{
+    if( mSections & FrameSection_MarkerSets )
+    {
+        return true;
+    }
+    for( const std::string& selected : mMarkerSetNames )
+    {
+        if( selected == name )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FrameFilter::LabeledMarker( int32_t ID ) const
+{
+    if( mSections & FrameSection_LabeledMarkers )
+    {
+        return true;
+    }
+    if( !mModelMarkers )
+    {
+        return false;
+    }
+    // Upper 16 bits: the rigid body, skeleton or asset the marker belongs to, 0 if unlabeled
+    int32_t modelID = ID >> 16;
+    return ( modelID != 0 ) && ( std::binary_search( mRigidBodyIDs.begin(), mRigidBodyIDs.end(), modelID )
+        || std::binary_search( mSkeletonIDs.begin(), mSkeletonIDs.end(), modelID )
+        || std::binary_search( mAssetIDs.begin(), mAssetIDs.end(), modelID ) );
+}
+
+/**
+ * \brief Encode rigid body ID, position and orientation.
+ */
+static void EncodeRigidBodyPose( sPacketWriter& writer, const sRigidBodyData& rigidBody )
+{
+    writer.PutInt( rigidBody.ID );
+    writer.PutFloat( rigidBody.x );
+    writer.PutFloat( rigidBody.y );
+    writer.PutFloat( rigidBody.z );
+    writer.PutFloat( rigidBody.qx );
+    writer.PutFloat( rigidBody.qy );
+    writer.PutFloat( rigidBody.qz );
+    writer.PutFloat( rigidBody.qw );
+}
+
+/**
+ * \brief Encode analog channel data shared by force plates and devices.
+ */
+static void EncodeAnalogChannels( sPacketWriter& writer, int nChannels, const sAnalogChannelData* channelData )
+{
+    for( int i = 0; i < nChannels; i++ )
+    {
+        writer.PutInt( channelData[i].nFrames );
+        writer.Put( channelData[i].Values, channelData[i].nFrames * sizeof( float ) );
+    }
+}
+
+static void EncodeMarkersetData( sPacketWriter& writer, int major, int minor, const sFrameOfMocapData& frame,
+    const FrameFilter* pFilter )
+{
+    sSection section( writer, HasDataSize( major, minor ) );
+    for( int i = 0; i < frame.nMarkerSets; i++ )
+    {
+        const sMarkerSetData& markerSet = frame.MocapData[i];
+        if( pFilter && !pFilter->MarkerSet( markerSet.szName ) )
+        {
+            continue;
+        }
+        writer.Put( markerSet.szName, strnlen( markerSet.szName, MAX_NAMELENGTH - 1 ) );
+        writer.Put( "", 1 );
+        writer.PutInt( markerSet.nMarkers );
+        writer.Put( markerSet.Markers, markerSet.nMarkers * sizeof( MarkerData ) );
+        section.count++;
+    }
+    section.End();
+}
+
+static void EncodeLegacyOtherMarkers( sPacketWriter& writer, int major, int minor, const sFrameOfMocapData& frame,
+    const FrameFilter* pFilter )
+{
+    sSection section( writer, HasDataSize( major, minor ) );
+    if( !pFilter || ( pFilter->Sections() & FrameSection_OtherMarkers ) )
+    {
+        writer.Put( frame.OtherMarkers, frame.nOtherMarkers * sizeof( MarkerData ) );
+        section.count = frame.nOtherMarkers;
+    }
+    section.End();
+}
+
+static void EncodeRigidBodyData( sPacketWriter& writer, int major, int minor, const sFrameOfMocapData& frame,
+    const FrameFilter* pFilter )
+{
+    sSection section( writer, HasDataSize( major, minor ) );
+    for( int i = 0; i < frame.nRigidBodies; i++ )
+    {
+        const sRigidBodyData& rigidBody = frame.RigidBodies[i];
+        if( pFilter && !pFilter->RigidBody( rigidBody.ID ) )
+        {
+            continue;
+        }
+        EncodeRigidBodyPose( writer, rigidBody );
+
+        // Legacy rigid body markers are not decoded: none are sent
+        if( HasRigidBodyMarkers( major, minor ) )
+        {
+            writer.PutInt( 0 );
+        }
+        if( HasRigidBodyError( major, minor ) )
+        {
+            writer.PutFloat( rigidBody.MeanError );
+        }
+        if( HasTrackingParams( major, minor ) )
+        {
+            writer.PutShort( rigidBody.params );
+        }
+        section.count++;
+    }
+    section.End();
+}
+
+static void EncodeSkeletonData( sPacketWriter& writer, int major, int minor, const sFrameOfMocapData& frame,
+    const FrameFilter* pFilter )
+{
+    if( !HasSkeletons( major, minor ) )
+    {
+        return;
+    }
+    sSection section( writer, HasDataSize( major, minor ) );
+    for( int i = 0; i < frame.nSkeletons; i++ )
+    {
+        const sSkeletonData& skeleton = frame.Skeletons[i];
+        if( pFilter && !pFilter->Skeleton( skeleton.skeletonID ) )
+        {
+            continue;
+        }
+        writer.PutInt( skeleton.skeletonID );
+        writer.PutInt( skeleton.nRigidBodies );
+        for( int j = 0; j < skeleton.nRigidBodies; j++ )
+        {
+            const sRigidBodyData& bone = skeleton.RigidBodyData[j];
+            EncodeRigidBodyPose( writer, bone );
+            if( HasBoneError( major, minor ) )
+            {
+                writer.PutFloat( bone.MeanError );
+            }
+            if( HasTrackingParams( major, minor ) )
+            {
+                writer.PutShort( bone.params );
+            }
+        }
+        section.count++;
+    }
+    section.End();
+}
+
+static void EncodeAssetData( sPacketWriter& writer, int major, int minor, const sFrameOfMocapData& frame,
+    const FrameFilter* pFilter )
+{
+    if( !HasAssets( major, minor ) )
+    {
+        return;
+    }
+    sSection section( writer, HasDataSize( major, minor ) );
+    for( int i = 0; i < frame.nAssets; i++ )
+    {
+        const sAssetData& asset = frame.Assets[i];
+        if( pFilter && !pFilter->Asset( asset.assetID ) )
+        {
+            continue;
+        }
+        writer.PutInt( asset.assetID );
+        writer.PutInt( asset.nRigidBodies );
+        for( int j = 0; j < asset.nRigidBodies; j++ )
+        {
+            const sRigidBodyData& rigidBody = asset.RigidBodyData[j];
+            EncodeRigidBodyPose( writer, rigidBody );
+            writer.PutFloat( rigidBody.MeanError );
+            writer.PutShort( rigidBody.params );
+        }
+        writer.PutInt( asset.nMarkers );
+        for( int j = 0; j < asset.nMarkers; j++ )
+        {
+            const sMarker& marker = asset.MarkerData[j];
+            writer.PutInt( marker.ID );
+            writer.PutFloat( marker.x );
+            writer.PutFloat( marker.y );
+            writer.PutFloat( marker.z );
+            writer.PutFloat( marker.size );
+            writer.PutShort( marker.params );
+            writer.PutFloat( marker.residual );
+        }
+        section.count++;
+    }
+    section.End();
+}
+
+static void EncodeLabeledMarkerData( sPacketWriter& writer, int major, int minor, const sFrameOfMocapData& frame,
+    const FrameFilter* pFilter )
+{
+    if( !HasLabeledMarkers( major, minor ) )
+    {
+        return;
+    }
+    sSection section( writer, HasDataSize( major, minor ) );
+    for( int i = 0; i < frame.nLabeledMarkers; i++ )
+    {
+        const sMarker& marker = frame.LabeledMarkers[i];
+        if( pFilter && !pFilter->LabeledMarker( marker.ID ) )
+        {
+            continue;
+        }
+        writer.PutInt( marker.ID );
+        writer.PutFloat( marker.x );
+        writer.PutFloat( marker.y );
+        writer.PutFloat( marker.z );
+        writer.PutFloat( marker.size );
+        if( HasMarkerParams( major, minor ) )
+        {
+            writer.PutShort( marker.params );
+        }
+        // Sent in meters, decoded in millimeters
+        if( HasMarkerResidual( major, minor ) )
+        {
+            writer.PutFloat( marker.residual / 1000.0f );
+        }
+        section.count++;
+    }
+    section.End();
+}
+
+template <class Device>
+static void EncodeAnalogDeviceData( sPacketWriter& writer, int major, int minor, bool keep, int nDevices,
+    const Device* devices )
+{
+    sSection section( writer, HasDataSize( major, minor ) );
+    if( keep )
+    {
+        for( int i = 0; i < nDevices; i++ )
+        {
+            writer.PutInt( devices[i].ID );
+            writer.PutInt( devices[i].nChannels );
+            EncodeAnalogChannels( writer, devices[i].nChannels, devices[i].ChannelData );
+        }
+        section.count = nDevices;
+    }
+    section.End();
+}
+
+static void EncodeFrameSuffixData( sPacketWriter& writer, int major, int minor, const sFrameOfMocapData& frame )
+{
+    // software latency (removed in version 3.0)
+    if( HasSoftwareLatency( major, minor ) )
+    {
+        writer.PutFloat( 0.0f );
+    }
+
+    writer.Put( &frame.Timecode, 4 );
+    writer.Put( &frame.TimecodeSubframe, 4 );
+
+    if( HasDoubleTimestamp( major, minor ) )
+    {
+        writer.Put( &frame.fTimestamp, 8 );
+    }
+    else
+    {
+        writer.PutFloat( (float) frame.fTimestamp );
+    }
+
+    if( HasHighResTimestamps( major, minor ) )
+    {
+        writer.Put( &frame.CameraMidExposureTimestamp, 8 );
+        writer.Put( &frame.CameraDataReceivedTimestamp, 8 );
+        writer.Put( &frame.TransmitTimestamp, 8 );
+    }
+
+    if( HasPrecisionTimestamps( major, minor ) )
+    {
+        writer.Put( &frame.PrecisionTimestampSecs, 4 );
+        writer.Put( &frame.PrecisionTimestampFractionalSecs, 4 );
+    }
+
+    writer.PutShort( frame.params );
+
+    // end of data tag
+    writer.PutInt( 0 );
+}
+
+size_t EncodeFramePacket( const sFrameOfMocapData& frame, int major, int minor, const FrameFilter* pFilter,
+    char* pBuffer, size_t bufferSize )
+{
+    sPacketWriter writer( pBuffer, pBuffer + std::min( bufferSize, (size_t) MAX_PACKETSIZE ) );
+    char* pHeader = writer.Reserve( 4 );
+
+    writer.PutInt( frame.iFrame );
+    EncodeMarkersetData( writer, major, minor, frame, pFilter );
+    EncodeLegacyOtherMarkers( writer, major, minor, frame, pFilter );
+    EncodeRigidBodyData( writer, major, minor, frame, pFilter );
+    EncodeSkeletonData( writer, major, minor, frame, pFilter );
+    EncodeAssetData( writer, major, minor, frame, pFilter );
+    EncodeLabeledMarkerData( writer, major, minor, frame, pFilter );
+    if( HasForcePlates( major, minor ) )
+    {
+        bool keep = !pFilter || ( pFilter->Sections() & FrameSection_ForcePlates );
+        EncodeAnalogDeviceData( writer, major, minor, keep, frame.nForcePlates, frame.ForcePlates );
+    }
+    if( HasDevices( major, minor ) )
+    {
+        bool keep = !pFilter || ( pFilter->Sections() & FrameSection_Devices );
+        EncodeAnalogDeviceData( writer, major, minor, keep, frame.nDevices, frame.Devices );
+    }
+    EncodeFrameSuffixData( writer, major, minor, frame );
+
+    if( writer.overflow )
+    {
+        return 0;
+    }
+    uint16_t header[2] = { NAT_FRAMEOFDATA, (uint16_t) ( writer.ptr - pBuffer - 4 ) };
+    memcpy( pHeader, header, 4 );
+    return (size_t) ( writer.ptr - pBuffer );
+}
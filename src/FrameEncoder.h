@@ -0,0 +1,79 @@
+//=============================================================================
+// FrameEncoder.h
+// ~~~~~~~~~~~~~~
+//
+// Encoding of decoded frames back into NAT_FRAMEOFDATA packets, in the
+// bitstream of any NatNet version the decoder reads, optionally keeping only
+// the rigid bodies, skeletons, assets and markers a FrameFilter selects. The
+// packets are what a server of that version would send with fewer models in
+// the scene, so any NatNet client decodes them unchanged.
+//=============================================================================
+
+#pragma once
+
+#include <NatNetTypes.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Selection of the parts of a frame to encode.
+ * A section is kept whole when it is in the section mask ( FrameSection_* ); otherwise
+ * only the elements selected by ID or name are. A new filter selects nothing: the
+ * frame number, timecode, timestamps and params always go out.
+ */
+class FrameFilter
+{
+public:
+    FrameFilter();
+
+    /**
+     * \brief Keep whole sections, e.g. FrameSection_ForcePlates or FrameSection_All.
+     */
+    void SelectSections( unsigned int sections ) { mSections |= sections; }
+
+    void SelectRigidBody( int32_t ID );
+    void SelectSkeleton( int32_t ID );
+    void SelectAsset( int32_t ID );
+    void SelectMarkerSet( const char* name );
+
+    /**
+     * \brief Keep the labeled markers of the selected rigid bodies, skeletons and assets
+     * ( the model ID in the upper 16 bits of a marker ID ).
+     */
+    void SelectModelMarkers( bool select ) { mModelMarkers = select; }
+
+    unsigned int Sections() const { return mSections; }
+
+    bool RigidBody( int32_t ID ) const;
+    bool Skeleton( int32_t ID ) const;
+    bool Asset( int32_t ID ) const;
+    bool MarkerSet( const char* name ) const;
+    bool LabeledMarker( int32_t ID ) const;
+
+private:
+    unsigned int mSections;
+    bool mModelMarkers;
+    std::vector<int32_t> mRigidBodyIDs;     // sorted
+    std::vector<int32_t> mSkeletonIDs;      // sorted
+    std::vector<int32_t> mAssetIDs;         // sorted
+    std::vector<std::string> mMarkerSetNames;
+};
+
+/**
+ * \brief Encode a frame as a NAT_FRAMEOFDATA packet ( header and payload ).
+ * Elements are written as decoded: MarkerSets, rigid bodies, skeletons and assets in
+ * the order of the frame, so a subscriber's data descriptions still name them.
+ * Fields the version does not carry are left out, fields the frame does not hold
+ * ( legacy rigid body markers, software latency ) are written empty.
+ * \param frame - decoded frame
+ * \param major, minor - NatNet version of the bitstream to write
+ * \param pFilter - parts of the frame to keep, nullptr for all of it
+ * \param pBuffer - output packet
+ * \param bufferSize - size of pBuffer in bytes
+ * \return - packet length, 0 if it does not fit in bufferSize or MAX_PACKETSIZE bytes
+ */
+size_t EncodeFramePacket( const sFrameOfMocapData& frame, int major, int minor, const FrameFilter* pFilter,
+    char* pBuffer, size_t bufferSize );
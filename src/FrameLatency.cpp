@@ -0,0 +1,316 @@
+//=============================================================================
+// FrameLatency.cpp
+// ~~~~~~~~~~~~~~~~
+//
+// Per-frame latency breakdown kept as rolling histograms.
+//=============================================================================
+
+#include "FrameLatency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+void LatencyHistogram::Clear()
+{
+    memset( mBuckets, 0, sizeof( mBuckets ) );
+    mCount = 0;
+    mSum = 0;
+    mMin = 0;
+    mMax = 0;
+}
+
+int LatencyHistogram::BucketIndex( int64_t microseconds )
+{
+    if( microseconds < 32 )
+    {
+        return (int) std::max( microseconds, (int64_t) 0 );
+    }
+    int shift = 1;
+    while( ( microseconds >> shift ) >= 32 )
+    {
+        shift++;
+    }
+    return std::min( shift * 16 + (int) ( microseconds >> shift ), LATENCY_HISTOGRAM_BUCKETS - 1 );
+}
+
+int64_t LatencyHistogram::BucketLowerBound( int i )
+{
+    if( i < 32 )
+    {
+        return i;
+    }
+    int shift = i / 16 - 1;
+    return (int64_t) ( i % 16 + 16 ) << shift;
+}
+
+void LatencyHistogram::Add( int64_t microseconds )
+{
+    // Negative durations come from clock adjustments; count them as 0
+    microseconds = std::max( microseconds, (int64_t) 0 );
+    mBuckets[BucketIndex( microseconds )]++;
+    if( ( mCount == 0 ) || ( microseconds < mMin ) )
+    {
+        mMin = microseconds;
+    }
+    mMax = std::max( mMax, microseconds );
+    mSum += microseconds;
+    mCount++;
+}
+
+void LatencyHistogram::Merge( const LatencyHistogram& other )
+{
+    if( other.mCount == 0 )
+    {
+        return;
+    }
+    for( int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++ )
+    {
+        mBuckets[i] += other.mBuckets[i];
+    }
+    mMin = mCount ? std::min( mMin, other.mMin ) : other.mMin;
+    mMax = std::max( mMax, other.mMax );
+    mSum += other.mSum;
+    mCount += other.mCount;
+}
+
+int64_t LatencyHistogram::Percentile( double p ) const
+{
+    if( mCount == 0 )
+    {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) std::ceil( p / 100.0 * mCount );
+    rank = std::min( std::max( rank, (uint64_t) 1 ), mCount );
+    uint64_t seen = 0;
+    for( int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++ )
+    {
+        seen += mBuckets[i];
+        if( seen >= rank )
+        {
+            return std::max( std::min( BucketLowerBound( i + 1 ) - 1, mMax ), mMin );
+        }
+    }
+    return mMax;
+}
+
+FrameLatency::FrameLatency()
+    : mCurrent( 0 )
+    , mFrequency( 0 )
+    , mOffset( 0 )
+    , mOffsetKnown( false )
+{
+    for( sWindow& window : mWindows )
+    {
+        window.start = 0;
+        window.minOffset = 0;
+        window.hasOffset = false;
+    }
+}
+
+void FrameLatency::SetServerClockFrequency( uint64_t frequency )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+    mFrequency = frequency;
+}
+
+void FrameLatency::SetServerClockOffset( int64_t offsetNanoseconds )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+    mOffset = offsetNanoseconds;
+    mOffsetKnown = true;
+}
+
+bool FrameLatency::ServerClockSynchronized() const
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+    return mOffsetKnown;
+}
+
+int64_t FrameLatency::ServerNanoseconds( uint64_t ticks ) const
+{
+    // Split to keep ticks * 1e9 from overflowing
+    return (int64_t) ( ( ticks / mFrequency ) * 1000000000ULL + ( ticks % mFrequency ) * 1000000000ULL / mFrequency );
+}
+
+bool FrameLatency::InRange( const sWindow& window, int64_t now ) const
+{
+    return ( window.start != 0 ) && ( window.start > now - LATENCY_ROLLING_WINDOWS * LATENCY_WINDOW_NS );
+}
+
+void FrameLatency::Advance( int64_t now )
+{
+    sWindow& current = mWindows[mCurrent];
+    if( ( current.start != 0 ) && ( now < current.start + LATENCY_WINDOW_NS ) )
+    {
+        return;
+    }
+    if( current.start != 0 )
+    {
+        mCurrent = ( mCurrent + 1 ) % LATENCY_ROLLING_WINDOWS;
+    }
+    sWindow& next = mWindows[mCurrent];
+    for( LatencyHistogram& stage : next.stages )
+    {
+        stage.Clear();
+    }
+    next.start = now;
+    next.hasOffset = false;
+}
+
+bool FrameLatency::EstimatedOffset( int64_t& offset, int64_t now ) const
+{
+    bool found = false;
+    for( const sWindow& window : mWindows )
+    {
+        if( InRange( window, now ) && window.hasOffset && ( !found || ( window.minOffset < offset ) ) )
+        {
+            offset = window.minOffset;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void FrameLatency::Record( const sFrameOfMocapData& frame, const sFrameTimes& times, int64_t returned )
+{
+    if( times.received == 0 )
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock( mMutex );
+    Advance( returned );
+    sWindow& window = mWindows[mCurrent];
+
+    if( times.decoded != 0 )
+    {
+        window.stages[LatencyStage_Decode].Add( ( times.decoded - times.received ) / 1000 );
+        window.stages[LatencyStage_Callback].Add( ( returned - times.decoded ) / 1000 );
+    }
+
+    // Servers before NatNet 3 send no timestamps
+    if( ( mFrequency == 0 ) || ( frame.CameraMidExposureTimestamp == 0 ) || ( frame.TransmitTimestamp == 0 ) )
+    {
+        return;
+    }
+
+    int64_t exposure = ServerNanoseconds( frame.CameraMidExposureTimestamp );
+    int64_t cameraReceived = ServerNanoseconds( frame.CameraDataReceivedTimestamp );
+    int64_t transmit = ServerNanoseconds( frame.TransmitTimestamp );
+    window.stages[LatencyStage_Exposure].Add( ( cameraReceived - exposure ) / 1000 );
+    window.stages[LatencyStage_ServerProcessing].Add( ( transmit - cameraReceived ) / 1000 );
+
+    // receive - transmit is the clock offset plus the network delay
+    int64_t receiveOffset = times.received - transmit;
+    if( !window.hasOffset || ( receiveOffset < window.minOffset ) )
+    {
+        window.minOffset = receiveOffset;
+        window.hasOffset = true;
+    }
+
+    int64_t offset = mOffset;
+    if( mOffsetKnown || EstimatedOffset( offset, returned ) )
+    {
+        window.stages[LatencyStage_Network].Add( ( receiveOffset - offset ) / 1000 );
+        window.stages[LatencyStage_Total].Add( ( returned - ( exposure + offset ) ) / 1000 );
+    }
+}
+
+void FrameLatency::Merge( LatencyHistogram* stages, int64_t now ) const
+{
+    for( const sWindow& window : mWindows )
+    {
+        if( InRange( window, now ) )
+        {
+            for( int i = 0; i < LatencyStage_Count; i++ )
+            {
+                stages[i].Merge( window.stages[i] );
+            }
+        }
+    }
+}
+
+sLatencySummary FrameLatency::Summary( LatencyStage stage ) const
+{
+    LatencyHistogram stages[LatencyStage_Count];
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        Merge( stages, RealtimeNanoseconds() );
+    }
+    const LatencyHistogram& histogram = stages[stage];
+
+    sLatencySummary summary;
+    summary.count = histogram.Count();
+    summary.min = histogram.Min();
+    summary.p50 = histogram.Percentile( 50 );
+    summary.p90 = histogram.Percentile( 90 );
+    summary.p99 = histogram.Percentile( 99 );
+    summary.max = histogram.Max();
+    summary.mean = histogram.Mean();
+    return summary;
+}
+
+const char* FrameLatency::StageName( LatencyStage stage )
+{
+    switch( stage )
+    {
+    case LatencyStage_Exposure:         return "exposure -> camera data received";
+    case LatencyStage_ServerProcessing: return "camera data received -> transmit";
+    case LatencyStage_Network:          return "transmit -> kernel receive";
+    case LatencyStage_Decode:           return "kernel receive -> decoded";
+    case LatencyStage_Callback:         return "decoded -> callback returned";
+    case LatencyStage_Total:            return "exposure -> callback returned";
+    default:                            break;
+    }
+    return "unknown stage";
+}
+
+void FrameLatency::Print( FILE* fp ) const
+{
+    LatencyHistogram stages[LatencyStage_Count];
+    bool synchronized;
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        Merge( stages, RealtimeNanoseconds() );
+        synchronized = mOffsetKnown;
+    }
+
+    fprintf( fp, "Latency over the last %d s (us)           frames      p50      p90      p99      max\n",
+        (int) ( LATENCY_ROLLING_WINDOWS * LATENCY_WINDOW_NS / 1000000000LL ) );
+    for( int i = 0; i < LatencyStage_Count; i++ )
+    {
+        const LatencyHistogram& histogram = stages[i];
+        fprintf( fp, "  %-36s %8llu %8lld %8lld %8lld %8lld\n", StageName( (LatencyStage) i ),
+            (unsigned long long) histogram.Count(), (long long) histogram.Percentile( 50 ),
+            (long long) histogram.Percentile( 90 ), (long long) histogram.Percentile( 99 ), (long long) histogram.Max() );
+    }
+    if( !synchronized )
+    {
+        fprintf( fp, "  ( clocks not synchronized: transmit -> kernel receive and the total are above the smallest delay seen )\n" );
+    }
+}
+
+void FrameLatency::WriteCsv( FILE* fp ) const
+{
+    LatencyHistogram stages[LatencyStage_Count];
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        Merge( stages, RealtimeNanoseconds() );
+    }
+
+    fprintf( fp, "stage,lower_us,upper_us,count\n" );
+    for( int i = 0; i < LatencyStage_Count; i++ )
+    {
+        for( int bucket = 0; bucket < LATENCY_HISTOGRAM_BUCKETS; bucket++ )
+        {
+            if( stages[i].Bucket( bucket ) != 0 )
+            {
+                fprintf( fp, "\"%s\",%lld,%lld,%llu\n", StageName( (LatencyStage) i ),
+                    (long long) LatencyHistogram::BucketLowerBound( bucket ),
+                    (long long) LatencyHistogram::BucketLowerBound( bucket + 1 ),
+                    (unsigned long long) stages[i].Bucket( bucket ) );
+            }
+        }
+    }
+}
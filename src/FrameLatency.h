@@ -0,0 +1,172 @@
+//=============================================================================
+// FrameLatency.h
+// ~~~~~~~~~~~~~~
+//
+// Per-frame latency breakdown from mid-exposure to the client's frame
+// callback, kept as rolling histograms. The server stages come from the
+// frame timestamps ( NatNet 3+ ); the client stages from sFrameTimes and
+// the time the callback returned.
+//=============================================================================
+
+#pragma once
+
+#include <NatNetTypes.h>
+
+#include "NatNetDecoder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+
+// Histogram buckets: 1 us wide below 32 us, then 16 per power of 2 ( about 6% wide ) up to 2^30 us
+#define LATENCY_HISTOGRAM_BUCKETS       432
+
+// The rolling histograms cover the last LATENCY_ROLLING_WINDOWS windows of LATENCY_WINDOW_NS
+#define LATENCY_ROLLING_WINDOWS         10
+#define LATENCY_WINDOW_NS               1000000000LL
+
+/**
+ * \brief Current time in nanoseconds of the realtime clock, the clock of SO_TIMESTAMPNS.
+ */
+inline int64_t RealtimeNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+/**
+ * \brief Log-linear histogram of durations in microseconds.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() { Clear(); }
+
+    void Clear();
+
+    void Add( int64_t microseconds );
+
+    void Merge( const LatencyHistogram& other );
+
+    uint64_t Count() const { return mCount; }
+    int64_t Min() const { return mCount ? mMin : 0; }
+    int64_t Max() const { return mCount ? mMax : 0; }
+    double Mean() const { return mCount ? (double) mSum / mCount : 0.0; }
+
+    /**
+     * \return - upper bound of the bucket holding the p-th percentile ( 0 <= p <= 100 ), capped by Max
+     */
+    int64_t Percentile( double p ) const;
+
+    uint64_t Bucket( int i ) const { return mBuckets[i]; }
+
+    static int BucketIndex( int64_t microseconds );
+    static int64_t BucketLowerBound( int i );
+
+private:
+    uint64_t mBuckets[LATENCY_HISTOGRAM_BUCKETS];
+    uint64_t mCount;
+    int64_t mSum;
+    int64_t mMin;
+    int64_t mMax;
+};
+
+/**
+ * \brief Stages of the latency breakdown.
+ */
+typedef enum LatencyStage
+{
+    LatencyStage_Exposure = 0,              // mid-exposure -> camera data received by the server
+    LatencyStage_ServerProcessing,          // camera data received -> transmit
+    LatencyStage_Network,                   // transmit -> kernel receive timestamp
+    LatencyStage_Decode,                    // kernel receive -> decoded
+    LatencyStage_Callback,                  // decoded -> frame callback returned
+    LatencyStage_Total,                     // mid-exposure -> frame callback returned
+    LatencyStage_Count
+} LatencyStage;
+
+/**
+ * \brief Summary of one stage over the rolling windows.
+ */
+typedef struct sLatencySummary
+{
+    uint64_t count;
+    int64_t min;                            // microseconds
+    int64_t p50;
+    int64_t p90;
+    int64_t p99;
+    int64_t max;
+    double mean;
+} sLatencySummary;
+
+/**
+ * \brief Rolling latency histograms of every stage.
+ * Server timestamps are converted with the server's HighResClockFrequency.
+ * Stages crossing from the server clock to the client clock ( Network,
+ * Total ) need the offset between the two clocks; until SetServerClockOffset
+ * provides it, they are measured relative to the smallest transmit -> receive
+ * delay seen in the rolling windows, i.e. they show the delay above the
+ * network minimum. Thread safe.
+ */
+class FrameLatency
+{
+public:
+    FrameLatency();
+
+    /**
+     * \brief Ticks per second of the server timestamps, from NAT_SERVERINFO ( 0 disables the server stages ).
+     */
+    void SetServerClockFrequency( uint64_t frequency );
+
+    /**
+     * \brief Offset to add to a server time, converted to nanoseconds, to get client realtime nanoseconds.
+     */
+    void SetServerClockOffset( int64_t offsetNanoseconds );
+
+    bool ServerClockSynchronized() const;
+
+    /**
+     * \brief Record a delivered frame.
+     * \param frame - decoded frame
+     * \param times - client receive and decode times ( frames with times.received == 0 are ignored )
+     * \param returned - when the frame callback returned, see RealtimeNanoseconds
+     */
+    void Record( const sFrameOfMocapData& frame, const sFrameTimes& times, int64_t returned );
+
+    sLatencySummary Summary( LatencyStage stage ) const;
+
+    /**
+     * \brief Print the percentiles of every stage.
+     */
+    void Print( FILE* fp ) const;
+
+    /**
+     * \brief Write the rolling histograms as CSV: stage, bucket lower bound (us), upper bound (us), count.
+     */
+    void WriteCsv( FILE* fp ) const;
+
+    static const char* StageName( LatencyStage stage );
+
+private:
+    struct sWindow
+    {
+        LatencyHistogram stages[LatencyStage_Count];
+        int64_t start;                      // realtime ns, 0 if the window is unused
+        int64_t minOffset;                  // smallest receive - transmit in the window, ns
+        bool hasOffset;
+    };
+
+    void Advance( int64_t now );
+    bool InRange( const sWindow& window, int64_t now ) const;
+    int64_t ServerNanoseconds( uint64_t ticks ) const;
+    void Merge( LatencyHistogram* stages, int64_t now ) const;
+    bool EstimatedOffset( int64_t& offset, int64_t now ) const;
+
+    sWindow mWindows[LATENCY_ROLLING_WINDOWS];
+    int mCurrent;
+
+    uint64_t mFrequency;
+    int64_t mOffset;
+    bool mOffsetKnown;
+
+    mutable std::mutex mMutex;
+};
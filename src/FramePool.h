@@ -0,0 +1,102 @@
+//=============================================================================
+// FramePool.h
+// ~~~~~~~~~~~
+//
+// Fixed set of recycled frame objects. Frames are handed to consumers as
+// handles that return them to the pool when released, so passing frames
+// between threads costs no allocation.
+//=============================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+template <class T>
+class FramePool
+{
+public:
+    /**
+     * \brief Returns a frame to its pool; deleter of Handle.
+     */
+    class Releaser
+    {
+    public:
+        Releaser() : mPool( nullptr ) {}
+        explicit Releaser( FramePool* pool ) : mPool( pool ) {}
+        void operator()( T* frame ) const { mPool->Release( frame ); }
+    private:
+        FramePool* mPool;
+    };
+
+    /**
+     * \brief Exclusive ownership of a pooled frame. The pool must outlive its handles.
+     */
+    typedef std::unique_ptr<T, Releaser> Handle;
+
+    /**
+     * \brief Create count frames, each constructed as T( args... ).
+     */
+    template <class... Args>
+    explicit FramePool( size_t count, const Args&... args )
+    {
+        mFrames.reserve( count );
+        mFree.reserve( count );
+        for( size_t i = 0; i < count; i++ )
+        {
+            mFrames.emplace_back( new T( args... ) );
+            mFree.push_back( mFrames.back().get() );
+        }
+    }
+
+    FramePool( const FramePool& ) = delete;
+    FramePool& operator=( const FramePool& ) = delete;
+
+    /**
+     * \brief Take a frame out of the pool. Its contents are those of its previous use.
+     * \return - frame, empty if all frames are in use
+     */
+    Handle Acquire()
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        if( mFree.empty() )
+        {
+            ++mExhausted;
+            return Handle();
+        }
+        T* frame = mFree.back();
+        mFree.pop_back();
+        return Handle( frame, Releaser( this ) );
+    }
+
+    size_t Size() const { return mFrames.size(); }
+
+    size_t Available() const
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        return mFree.size();
+    }
+
+    /**
+     * \brief # of Acquire calls that found the pool empty.
+     */
+    size_t Exhausted() const
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        return mExhausted;
+    }
+
+private:
+    void Release( T* frame )
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        mFree.push_back( frame );   // never reallocates: capacity is the number of frames
+    }
+
+    std::vector<std::unique_ptr<T>> mFrames;
+    std::vector<T*> mFree;
+    size_t mExhausted = 0;
+    mutable std::mutex mMutex;
+};
@@ -0,0 +1,216 @@
+//=============================================================================
+// FrameVisitor.cpp
+// ~~~~~~~~~~~~~~~~
+//
+// Optional traversal of a decoded frame. The printed format follows
+// samples/PacketClient/PacketClient.cpp (NatNet SDK 4.1.0), licensed under
+// the Apache License, Version 2.0.
+//=============================================================================
+
+#include "FrameVisitor.h"
+
+#include <algorithm>
+#include <cinttypes>
+
+void VisitFrame( const sFrameOfMocapData& frame, FrameVisitor& visitor )
+{
+    visitor.FramePrefix( frame );
+    visitor.MarkerSets( frame.MocapData, frame.nMarkerSets );
+    visitor.OtherMarkers( frame.OtherMarkers, frame.nOtherMarkers );
+    visitor.RigidBodies( frame.RigidBodies, frame.nRigidBodies );
+    visitor.Skeletons( frame.Skeletons, frame.nSkeletons );
+    visitor.Assets( frame.Assets, frame.nAssets );
+    visitor.LabeledMarkers( frame.LabeledMarkers, frame.nLabeledMarkers );
+    visitor.ForcePlates( frame.ForcePlates, frame.nForcePlates );
+    visitor.Devices( frame.Devices, frame.nDevices );
+    visitor.FrameSuffix( frame );
+}
+
+FramePrinter::FramePrinter( FILE* out, unsigned int level )
+    : mOut( out )
+    , mIndent( 2 * level )
+{
+}
+
+void FramePrinter::FramePrefix( const sFrameOfMocapData& frame )
+{
+    fprintf( mOut, "%*sMoCap Frame Begin\n", mIndent, "" );
+    fprintf( mOut, "-----------------\n" );
+    fprintf( mOut, "%*sFrame #: %3.1d\n", mIndent, "", frame.iFrame );
+}
+
+void FramePrinter::MarkerSets( const sMarkerSetData* markerSets, int count )
+{
+    fprintf( mOut, "%*sMarkerset Count : %3.1d\n", mIndent, "", count );
+    for( int i = 0; i < count; i++ )
+    {
+        const sMarkerSetData& markerSet = markerSets[i];
+        fprintf( mOut, "%*sMarkerData:\n", mIndent, "" );
+        fprintf( mOut, "%*sModel Name       : %s\n", mIndent, "", markerSet.szName );
+        fprintf( mOut, "%*sMarker Count     : %3.1d\n", mIndent, "", markerSet.nMarkers );
+        for( int j = 0; j < markerSet.nMarkers; j++ )
+        {
+            const MarkerData& marker = markerSet.Markers[j];
+            fprintf( mOut, "%*s  Marker %3.1d pos : [x=%3.2f,y=%3.2f,z=%3.2f]\n", mIndent, "",
+                j, marker[0], marker[1], marker[2] );
+        }
+    }
+}
+
+void FramePrinter::OtherMarkers( const MarkerData* markers, int count )
+{
+    fprintf( mOut, "%*sUnlabeled Marker Count : %3.1d\n", mIndent, "", count );
+    for( int j = 0; j < count; j++ )
+    {
+        fprintf( mOut, "%*s  Marker %3.1d pos : [x=%3.2f,y=%3.2f,z=%3.2f]\n", mIndent, "",
+            j, markers[j][0], markers[j][1], markers[j][2] );
+    }
+}
+
+void FramePrinter::RigidBodies( const sRigidBodyData* rigidBodies, int count )
+{
+    fprintf( mOut, "%*sRigid Body Count : %3.1d\n", mIndent, "", count );
+    for( int j = 0; j < count; j++ )
+    {
+        const sRigidBodyData& rb = rigidBodies[j];
+        fprintf( mOut, "%*s  Rigid Body      : %3.1d\n", mIndent, "", j );
+        fprintf( mOut, "%*s    ID            : %3.1d\n", mIndent, "", rb.ID );
+        fprintf( mOut, "%*s    Position      : [%3.2f, %3.2f, %3.2f]\n", mIndent, "", rb.x, rb.y, rb.z );
+        fprintf( mOut, "%*s    Orientation   : [%3.2f, %3.2f, %3.2f, %3.2f]\n", mIndent, "", rb.qx, rb.qy, rb.qz, rb.qw );
+        fprintf( mOut, "%*s  Marker Error: %3.2f\n", mIndent, "", rb.MeanError );
+        fprintf( mOut, "%*s  Tracking Valid: %s\n", mIndent, "", ( rb.params & 0x01 ) ? "True" : "False" );
+    }
+}
+
+void FramePrinter::Skeletons( const sSkeletonData* skeletons, int count )
+{
+    fprintf( mOut, "%*sSkeleton Count : %d\n", mIndent, "", count );
+    for( int j = 0; j < count; j++ )
+    {
+        const sSkeletonData& skeleton = skeletons[j];
+        fprintf( mOut, "%*s  Skeleton %3.1d\n", mIndent, "", j );
+        fprintf( mOut, "%*s    ID: %3.1d\n", mIndent, "", skeleton.skeletonID );
+        fprintf( mOut, "%*s  Rigid Body Count : %d\n", mIndent, "", skeleton.nRigidBodies );
+        for( int k = 0; k < skeleton.nRigidBodies; k++ )
+        {
+            const sRigidBodyData& rb = skeleton.RigidBodyData[k];
+            fprintf( mOut, "%*s    Rigid Body      : %3.1d\n", mIndent, "", k );
+            fprintf( mOut, "%*s      ID            : %3.1d\n", mIndent, "", rb.ID );
+            fprintf( mOut, "%*s      Position      : [%3.2f, %3.2f, %3.2f]\n", mIndent, "", rb.x, rb.y, rb.z );
+            fprintf( mOut, "%*s      Orientation   : [%3.2f, %3.2f, %3.2f, %3.2f]\n", mIndent, "", rb.qx, rb.qy, rb.qz, rb.qw );
+            fprintf( mOut, "%*s      Marker Error  : %3.2f\n", mIndent, "", rb.MeanError );
+            fprintf( mOut, "%*s      Tracking Valid: %s\n", mIndent, "", ( rb.params & 0x01 ) ? "True" : "False" );
+        }
+    }
+}
+
+void FramePrinter::Assets( const sAssetData* assets, int count )
+{
+    fprintf( mOut, "%*sAsset Count : %d\n", mIndent, "", count );
+    for( int i = 0; i < count; i++ )
+    {
+        const sAssetData& asset = assets[i];
+        fprintf( mOut, "%*sAsset ID: %d\n", mIndent, "", asset.assetID );
+        fprintf( mOut, "%*sRigid Body Count: %3.1d\n", mIndent, "", asset.nRigidBodies );
+        for( int j = 0; j < asset.nRigidBodies; j++ )
+        {
+            const sRigidBodyData& rb = asset.RigidBodyData[j];
+            fprintf( mOut, "%*s  Rigid Body : %d\n", mIndent, "", j );
+            fprintf( mOut, "%*s    ID : %d\n", mIndent, "", rb.ID );
+            fprintf( mOut, "%*s    Position    : [%3.2f, %3.2f, %3.2f]\n", mIndent, "", rb.x, rb.y, rb.z );
+            fprintf( mOut, "%*s    Orientation : [%3.2f, %3.2f, %3.2f, %3.2f]\n", mIndent, "", rb.qx, rb.qy, rb.qz, rb.qw );
+            fprintf( mOut, "%*s    Mean Error: %3.2f\n", mIndent, "", rb.MeanError );
+            fprintf( mOut, "%*s    Params : %d\n", mIndent, "", rb.params );
+        }
+        fprintf( mOut, "%*sMarker Count: %3.1d\n", mIndent, "", asset.nMarkers );
+        for( int j = 0; j < asset.nMarkers; j++ )
+        {
+            const sMarker& marker = asset.MarkerData[j];
+            fprintf( mOut, "%*s%3.1d   Marker %d\tpos : [%3.2f, %3.2f, %3.2f]\tsize=%3.2f\terr=%3.2f\tparams=%d\n", mIndent, "",
+                j, marker.ID, marker.x, marker.y, marker.z, marker.size, marker.residual, marker.params );
+        }
+    }
+}
+
+void FramePrinter::LabeledMarkers( const sMarker* markers, int count )
+{
+    fprintf( mOut, "%*sLabeled Marker Count : %d\n", mIndent, "", count );
+    for( int j = 0; j < count; j++ )
+    {
+        const sMarker& marker = markers[j];
+        int modelID = marker.ID >> 16;
+        int markerID = marker.ID & 0x0000ffff;
+        fprintf( mOut, "%*sLabeled Marker %3.1d:\n", mIndent, "", j );
+        fprintf( mOut, "%*s    ID                 : [MarkerID: %d] [ModelID: %d]\n", mIndent, "", markerID, modelID );
+        fprintf( mOut, "%*s    pos                : [%3.2f, %3.2f, %3.2f]\n", mIndent, "", marker.x, marker.y, marker.z );
+        fprintf( mOut, "%*s    size               : [%3.2f]\n", mIndent, "", marker.size );
+        fprintf( mOut, "%*s    err                : [%3.2f]\n", mIndent, "", marker.residual );
+        fprintf( mOut, "%*s    occluded           : [%3.1d]\n", mIndent, "", ( marker.params & 0x01 ) != 0 );
+        fprintf( mOut, "%*s    point_cloud_solved : [%3.1d]\n", mIndent, "", ( marker.params & 0x02 ) != 0 );
+        fprintf( mOut, "%*s    model_solved       : [%3.1d]\n", mIndent, "", ( marker.params & 0x04 ) != 0 );
+    }
+}
+
+/**
+ * \brief Print analog channels of a force plate or device, showing at most a few frames per channel.
+ */
+static void PrintAnalogChannels( FILE* out, int indent, const sAnalogChannelData* channels, int nChannels )
+{
+    const int kNFramesShowMax = 4;
+    for( int i = 0; i < nChannels; i++ )
+    {
+        const sAnalogChannelData& channel = channels[i];
+        fprintf( out, "%*s  Channel %d :   %3.1d Frames - Frame Data: ", indent, "", i, channel.nFrames );
+        int nFramesShow = std::min( channel.nFrames, kNFramesShowMax );
+        for( int j = 0; j < nFramesShow; j++ )
+        {
+            fprintf( out, "%3.2f   ", channel.Values[j] );
+        }
+        if( nFramesShow < channel.nFrames )
+        {
+            fprintf( out, " - Showing %3.1d of %3.1d frames", nFramesShow, channel.nFrames );
+        }
+        fprintf( out, "\n" );
+    }
+}
+
+void FramePrinter::ForcePlates( const sForcePlateData* forcePlates, int count )
+{
+    fprintf( mOut, "%*sForce Plate Count: %d\n", mIndent, "", count );
+    for( int i = 0; i < count; i++ )
+    {
+        const sForcePlateData& forcePlate = forcePlates[i];
+        fprintf( mOut, "%*sForce Plate %3.1d\n", mIndent, "", i );
+        fprintf( mOut, "%*s  ID           : %3.1d  Channel Count: %3.1d\n", mIndent, "", forcePlate.ID, forcePlate.nChannels );
+        PrintAnalogChannels( mOut, mIndent, forcePlate.ChannelData, forcePlate.nChannels );
+    }
+}
+
+void FramePrinter::Devices( const sDeviceData* devices, int count )
+{
+    fprintf( mOut, "%*sDevice Count: %d\n", mIndent, "", count );
+    for( int i = 0; i < count; i++ )
+    {
+        const sDeviceData& device = devices[i];
+        fprintf( mOut, "%*sDevice %3.1d      ID: %3.1d Num Channels: %3.1d\n", mIndent, "", i, device.ID, device.nChannels );
+        PrintAnalogChannels( mOut, mIndent, device.ChannelData, device.nChannels );
+    }
+}
+
+void FramePrinter::FrameSuffix( const sFrameOfMocapData& frame )
+{
+    int hour = ( frame.Timecode >> 24 ) & 255;
+    int minute = ( frame.Timecode >> 16 ) & 255;
+    int second = ( frame.Timecode >> 8 ) & 255;
+    int subframeFrame = frame.Timecode & 255;
+    fprintf( mOut, "%*sTimecode : %02d:%02d:%02d:%02d.%d\n", mIndent, "",
+        hour, minute, second, subframeFrame, (int) frame.TimecodeSubframe );
+    fprintf( mOut, "%*sTimestamp : %3.3f\n", mIndent, "", frame.fTimestamp );
+    fprintf( mOut, "%*sMid-exposure timestamp         : %" PRIu64 "\n", mIndent, "", frame.CameraMidExposureTimestamp );
+    fprintf( mOut, "%*sCamera data received timestamp : %" PRIu64 "\n", mIndent, "", frame.CameraDataReceivedTimestamp );
+    fprintf( mOut, "%*sTransmit timestamp             : %" PRIu64 "\n", mIndent, "", frame.TransmitTimestamp );
+    fprintf( mOut, "%*sPrecision timestamp (seconds) : %u\n", mIndent, "", frame.PrecisionTimestampSecs );
+    fprintf( mOut, "%*sPrecision timestamp (fractional seconds) : %u\n", mIndent, "", frame.PrecisionTimestampFractionalSecs );
+    fprintf( mOut, "%*sMoCap Frame End\n", mIndent, "" );
+    fprintf( mOut, "-----------------\n" );
+}
@@ -0,0 +1,66 @@
+//=============================================================================
+// FrameVisitor.h
+// ~~~~~~~~~~~~~~
+//
+// Optional traversal of a decoded frame. Decoding itself never prints;
+// FramePrinter reproduces the console output of the PacketClient sample
+// for clients that want it.
+//=============================================================================
+
+#pragma once
+
+#include <NatNetTypes.h>
+
+#include <cstdio>
+
+/**
+ * \brief Callbacks invoked by VisitFrame for every section of a decoded frame.
+ * All callbacks default to doing nothing; override only what you need.
+ */
+class FrameVisitor
+{
+public:
+    virtual ~FrameVisitor() {}
+
+    virtual void FramePrefix( const sFrameOfMocapData& /*frame*/ ) {}
+    virtual void MarkerSets( const sMarkerSetData* /*markerSets*/, int /*count*/ ) {}
+    virtual void OtherMarkers( const MarkerData* /*markers*/, int /*count*/ ) {}
+    virtual void RigidBodies( const sRigidBodyData* /*rigidBodies*/, int /*count*/ ) {}
+    virtual void Skeletons( const sSkeletonData* /*skeletons*/, int /*count*/ ) {}
+    virtual void Assets( const sAssetData* /*assets*/, int /*count*/ ) {}
+    virtual void LabeledMarkers( const sMarker* /*markers*/, int /*count*/ ) {}
+    virtual void ForcePlates( const sForcePlateData* /*forcePlates*/, int /*count*/ ) {}
+    virtual void Devices( const sDeviceData* /*devices*/, int /*count*/ ) {}
+    virtual void FrameSuffix( const sFrameOfMocapData& /*frame*/ ) {}
+};
+
+/**
+ * \brief Walk a decoded frame in bitstream order and invoke visitor for each section.
+ * \param frame - decoded frame
+ * \param visitor - callbacks
+ */
+void VisitFrame( const sFrameOfMocapData& frame, FrameVisitor& visitor );
+
+/**
+ * \brief Visitor that prints a frame in the format of the PacketClient sample.
+ */
+class FramePrinter : public FrameVisitor
+{
+public:
+    explicit FramePrinter( FILE* out = stdout, unsigned int level = 0 );
+
+    void FramePrefix( const sFrameOfMocapData& frame ) override;
+    void MarkerSets( const sMarkerSetData* markerSets, int count ) override;
+    void OtherMarkers( const MarkerData* markers, int count ) override;
+    void RigidBodies( const sRigidBodyData* rigidBodies, int count ) override;
+    void Skeletons( const sSkeletonData* skeletons, int count ) override;
+    void Assets( const sAssetData* assets, int count ) override;
+    void LabeledMarkers( const sMarker* markers, int count ) override;
+    void ForcePlates( const sForcePlateData* forcePlates, int count ) override;
+    void Devices( const sDeviceData* devices, int count ) override;
+    void FrameSuffix( const sFrameOfMocapData& frame ) override;
+
+private:
+    FILE* mOut;
+    int mIndent;                            // # of leading spaces ( 2 per level )
+};
@@ -0,0 +1,62 @@
+//=============================================================================
+// LabeledMarkerArrays.h
+// ~~~~~~~~~~~~~~~~~~~~~
+//
+// Structure-of-arrays storage for labeled markers and vectorized transposing
+// of the packed labeled marker records of the NatNet bitstream.
+//=============================================================================
+
+#pragma once
+
+#include <NatNetTypes.h>
+
+// Size of a labeled marker record in NatNet 3.0 and later bitstreams:
+// ID, x, y, z, size ( 4 bytes each ), params ( 2 bytes ), residual ( 4 bytes )
+#define LABELED_MARKER_RECORD_SIZE      26
+
+/**
+ * \brief Labeled markers of one frame, one contiguous array per field.
+ * Same contents as sFrameOfMocapData::LabeledMarkers, laid out for bulk
+ * processing ( e.g. x[0..nMarkers) can be loaded straight into SIMD registers ).
+ */
+typedef struct sLabeledMarkerArrays
+{
+    int32_t nMarkers;                       // # of valid entries in every array
+    int32_t ID[MAX_LABELED_MARKERS];        // see sMarker::ID
+    float x[MAX_LABELED_MARKERS];
+    float y[MAX_LABELED_MARKERS];
+    float z[MAX_LABELED_MARKERS];
+    float size[MAX_LABELED_MARKERS];
+    int16_t params[MAX_LABELED_MARKERS];    // see sMarker::params
+    float residual[MAX_LABELED_MARKERS];    // mm, already scaled like sMarker::residual
+} sLabeledMarkerArrays;
+
+/**
+ * \brief Instruction set used to transpose labeled marker records.
+ */
+typedef enum SimdLevel
+{
+    SimdLevel_Scalar = 0,
+    SimdLevel_SSE41,
+    SimdLevel_AVX2
+} SimdLevel;
+
+/**
+ * \brief Best instruction set supported by the CPU ( and by the compiler ).
+ */
+SimdLevel GetSupportedSimdLevel();
+
+/**
+ * \brief Transpose packed labeled marker records into arrays[0..nMarkers).
+ * Residuals are scaled from m to mm. Does not set arrays.nMarkers.
+ * \param ptr - first record ( LABELED_MARKER_RECORD_SIZE bytes each )
+ * \param nMarkers - # of records, at most MAX_LABELED_MARKERS
+ * \param arrays - output arrays
+ * \param level - instruction set, must not exceed GetSupportedSimdLevel()
+ */
+void DecodeLabeledMarkerRecords( const char* ptr, int nMarkers, sLabeledMarkerArrays& arrays, SimdLevel level );
+
+/**
+ * \brief Transpose packed labeled marker records with the best supported instruction set.
+ */
+void DecodeLabeledMarkerRecords( const char* ptr, int nMarkers, sLabeledMarkerArrays& arrays );
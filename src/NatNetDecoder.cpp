@@ -0,0 +1,1439 @@
+//=============================================================================
+// NatNetDecoder.cpp
+// ~~~~~~~~~~~~~~~~~
+//
+// Print-free decoding of NatNet packets into caller-owned frame structures.
+// The bitstream handling is derived from samples/PacketClient/PacketClient.cpp
+// (NatNet SDK 4.1.0), licensed under the Apache License, Version 2.0.
+//=============================================================================
+
+#include "NatNetDecoder.h"
+
+#include "BitstreamFeatures.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * \brief Bitstream layout known only at runtime.
+ * Every feature test is a branch in the decode loops.
+ */
+struct sRuntimeLayout
+{
+    sRuntimeLayout( int major, int minor )
+        : dataSize( HasDataSize( major, minor ) )
+        , rigidBodyMarkers( HasRigidBodyMarkers( major, minor ) )
+        , rigidBodyMarkerIDs( HasRigidBodyMarkerIDs( major, minor ) )
+        , rigidBodyError( HasRigidBodyError( major, minor ) )
+        , boneError( HasBoneError( major, minor ) )
+        , trackingParams( HasTrackingParams( major, minor ) )
+        , skeletons( HasSkeletons( major, minor ) )
+        , assets( HasAssets( major, minor ) )
+        , labeledMarkers( HasLabeledMarkers( major, minor ) )
+        , markerParams( HasMarkerParams( major, minor ) )
+        , markerResidual( HasMarkerResidual( major, minor ) )
+        , forcePlates( HasForcePlates( major, minor ) )
+        , devices( HasDevices( major, minor ) )
+        , softwareLatency( HasSoftwareLatency( major, minor ) )
+        , doubleTimestamp( HasDoubleTimestamp( major, minor ) )
+        , highResTimestamps( HasHighResTimestamps( major, minor ) )
+        , precisionTimestamps( HasPrecisionTimestamps( major, minor ) )
+    {
+    }
+
+    bool dataSize;
+    bool rigidBodyMarkers;
+    bool rigidBodyMarkerIDs;
+    bool rigidBodyError;
+    bool boneError;
+    bool trackingParams;
+    bool skeletons;
+    bool assets;
+    bool labeledMarkers;
+    bool markerParams;
+    bool markerResidual;
+    bool forcePlates;
+    bool devices;
+    bool softwareLatency;
+    bool doubleTimestamp;
+    bool highResTimestamps;
+    bool precisionTimestamps;
+};
+
+/**
+ * \brief Bitstream layout fixed at compile time.
+ * Every feature test is a constant, so the decode loops of an instantiation are branch free.
+ */
+template <int Major, int Minor>
+struct sStaticLayout
+{
+    static constexpr bool dataSize = HasDataSize( Major, Minor );
+    static constexpr bool rigidBodyMarkers = HasRigidBodyMarkers( Major, Minor );
+    static constexpr bool rigidBodyMarkerIDs = HasRigidBodyMarkerIDs( Major, Minor );
+    static constexpr bool rigidBodyError = HasRigidBodyError( Major, Minor );
+    static constexpr bool boneError = HasBoneError( Major, Minor );
+    static constexpr bool trackingParams = HasTrackingParams( Major, Minor );
+    static constexpr bool skeletons = HasSkeletons( Major, Minor );
+    static constexpr bool assets = HasAssets( Major, Minor );
+    static constexpr bool labeledMarkers = HasLabeledMarkers( Major, Minor );
+    static constexpr bool markerParams = HasMarkerParams( Major, Minor );
+    static constexpr bool markerResidual = HasMarkerResidual( Major, Minor );
+    static constexpr bool forcePlates = HasForcePlates( Major, Minor );
+    static constexpr bool devices = HasDevices( Major, Minor );
+    static constexpr bool softwareLatency = HasSoftwareLatency( Major, Minor );
+    static constexpr bool doubleTimestamp = HasDoubleTimestamp( Major, Minor );
+    static constexpr bool highResTimestamps = HasHighResTimestamps( Major, Minor );
+    static constexpr bool precisionTimestamps = HasPrecisionTimestamps( Major, Minor );
+};
+
+/**
+ * \brief Copy a NUL terminated string from the data stream into a fixed size field.
+ * \param ptr - input data stream pointer
+ * \param dest - output buffer
+ * \param destSize - size of dest in bytes
+ * \return - pointer after decoded string
+ */
+static const char* DecodeString( const char* ptr, char* dest, size_t destSize )
+{
+    size_t len = strlen( ptr );
+    size_t nCopy = std::min( len, destSize - 1 );
+    memcpy( dest, ptr, nCopy );
+    dest[nCopy] = 0;
+    return ptr + len + 1;
+}
+
+/**
+ * \brief Decode number of bytes of data for a given data type (NatNet 4.1 and later).
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \param nBytes - output byte count, 0 if not present in this version
+ * \return - pointer after decoded object
+ */
+template <class Layout>
+static const char* DecodeDataSize( const char* ptr, const Layout& layout, int& nBytes )
+{
+    nBytes = 0;
+    if( layout.dataSize )
+    {
+        memcpy( &nBytes, ptr, 4 ); ptr += 4;
+    }
+    return ptr;
+}
+
+/**
+ * \brief Decode rigid body ID, position and orientation.
+ * \param ptr - input data stream pointer
+ * \param rigidBody - output rigid body
+ * \return - pointer after decoded object
+ */
+static const char* DecodeRigidBodyPose( const char* ptr, sRigidBodyData& rigidBody )
+{
+    memcpy( &rigidBody.ID, ptr, 4 ); ptr += 4;
+    memcpy( &rigidBody.x, ptr, 4 ); ptr += 4;
+    memcpy( &rigidBody.y, ptr, 4 ); ptr += 4;
+    memcpy( &rigidBody.z, ptr, 4 ); ptr += 4;
+    memcpy( &rigidBody.qx, ptr, 4 ); ptr += 4;
+    memcpy( &rigidBody.qy, ptr, 4 ); ptr += 4;
+    memcpy( &rigidBody.qz, ptr, 4 ); ptr += 4;
+    memcpy( &rigidBody.qw, ptr, 4 ); ptr += 4;
+    return ptr;
+}
+
+/**
+ * \brief Decode analog channel data shared by force plates and devices.
+ * \param ptr - input data stream pointer
+ * \param nChannels - # of channels in the data stream
+ * \param channelData - output channels, at most MAX_ANALOG_CHANNELS are stored
+ * \param frame - output frame (truncation count)
+ * \return - pointer after decoded object
+ */
+static const char* DecodeAnalogChannels( const char* ptr, int nChannels, sAnalogChannelData* channelData, sDecodedFrame& frame )
+{
+    for( int i = 0; i < nChannels; i++ )
+    {
+        int nFrames = 0; memcpy( &nFrames, ptr, 4 ); ptr += 4;
+        if( i < MAX_ANALOG_CHANNELS )
+        {
+            int nStore = std::min( nFrames, MAX_ANALOG_SUBFRAMES );
+            channelData[i].nFrames = nStore;
+            memcpy( channelData[i].Values, ptr, nStore * sizeof( float ) );
+            frame.nTruncated += nFrames - nStore;
+        }
+        else
+        {
+            frame.nTruncated += nFrames;
+        }
+        ptr += nFrames * sizeof( float );
+    }
+    return ptr;
+}
+
+/**
+ * \brief Skip analog channel data without storing it.
+ * \param ptr - input data stream pointer
+ * \param nChannels - # of channels in the data stream
+ * \return - pointer after skipped object
+ */
+static const char* SkipAnalogChannels( const char* ptr, int nChannels )
+{
+    for( int i = 0; i < nChannels; i++ )
+    {
+        int nFrames = 0; memcpy( &nFrames, ptr, 4 ); ptr += 4;
+        ptr += nFrames * sizeof( float );
+    }
+    return ptr;
+}
+
+/**
+ * \brief Decode frame prefix data
+ * \param ptr - input data stream pointer
+ * \param frame - output frame
+ * \return - pointer after decoded object
+ */
+static const char* DecodeFramePrefixData( const char* ptr, sDecodedFrame& frame )
+{
+    // Next 4 Bytes is the frame number
+    memcpy( &frame.data.iFrame, ptr, 4 ); ptr += 4;
+    return ptr;
+}
+
+/**
+ * \brief Decode markerset data
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \param frame - output frame
+ * \return - pointer after decoded object
+ */
+template <class Layout>
+static const char* DecodeMarkersetData( const char* ptr, const Layout& layout, sDecodedFrame& frame )
+{
+    sFrameOfMocapData& data = frame.data;
+
+    // First 4 Bytes is the number of data sets (markersets, rigidbodies, etc)
+    int nMarkerSets = 0; memcpy( &nMarkerSets, ptr, 4 ); ptr += 4;
+
+    int nBytes = 0;
+    ptr = DecodeDataSize( ptr, layout, nBytes );
+
+    for( int i = 0; i < nMarkerSets; i++ )
+    {
+        char szName[MAX_NAMELENGTH];
+        ptr = DecodeString( ptr, szName, MAX_NAMELENGTH );
+
+        int nMarkers = 0; memcpy( &nMarkers, ptr, 4 ); ptr += 4;
+        int nMarkerBytes = nMarkers * 3 * sizeof( float );
+
+        MarkerData* markers = ( data.nMarkerSets < MAX_MARKERSETS ) ? frame.arena.Allocate<MarkerData>( nMarkers ) : nullptr;
+        if( markers )
+        {
+            sMarkerSetData& markerSet = data.MocapData[data.nMarkerSets++];
+            memcpy( markerSet.szName, szName, MAX_NAMELENGTH );
+            markerSet.nMarkers = nMarkers;
+            markerSet.Markers = markers;
+            memcpy( markerSet.Markers, ptr, nMarkerBytes );
+        }
+        else
+        {
+            frame.nTruncated += nMarkers;
+        }
+        ptr += nMarkerBytes;
+    }
+
+    return ptr;
+}
+
+/**
+ * \brief Decode legacy 'other' unlabeled markers (will be deprecated)
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \param frame - output frame
+ * \return - pointer after decoded object
+ */
+template <class Layout>
+static const char* DecodeLegacyOtherMarkers( const char* ptr, const Layout& layout, sDecodedFrame& frame )
+{
+    sFrameOfMocapData& data = frame.data;
+
+    // First 4 Bytes is the number of Other markers
+    int nOtherMarkers = 0; memcpy( &nOtherMarkers, ptr, 4 ); ptr += 4;
+
+    int nBytes = 0;
+    ptr = DecodeDataSize( ptr, layout, nBytes );
+
+    data.OtherMarkers = frame.arena.Allocate<MarkerData>( nOtherMarkers );
+    if( data.OtherMarkers )
+    {
+        data.nOtherMarkers = nOtherMarkers;
+        memcpy( data.OtherMarkers, ptr, nOtherMarkers * 3 * sizeof( float ) );
+    }
+    else
+    {
+        frame.nTruncated += nOtherMarkers;
+    }
+    ptr += nOtherMarkers * 3 * sizeof( float );
+
+    return ptr;
+}
+
+/**
+ * \brief Decode rigid body data
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \param frame - output frame
+ * \return - pointer after decoded object
+ */
+template <class Layout>
+static const char* DecodeRigidBodyData( const char* ptr, const Layout& layout, sDecodedFrame& frame )
+{
+    sFrameOfMocapData& data = frame.data;
+
+    int nRigidBodies = 0; memcpy( &nRigidBodies, ptr, 4 ); ptr += 4;
+
+    int nBytes = 0;
+    ptr = DecodeDataSize( ptr, layout, nBytes );
+
+    for( int j = 0; j < nRigidBodies; j++ )
+    {
+        sRigidBodyData scratch;
+        sRigidBodyData& rigidBody = ( data.nRigidBodies < MAX_RIGIDBODIES ) ? data.RigidBodies[data.nRigidBodies++] : scratch;
+        if( &rigidBody == &scratch )
+        {
+            ++frame.nTruncated;
+        }
+
+        ptr = DecodeRigidBodyPose( ptr, rigidBody );
+
+        // Marker positions removed as redundant (since they can be derived from RB Pos/Ori plus initial offset) in NatNet 3.0 and later
+        if( layout.rigidBodyMarkers )
+        {
+            int nRigidMarkers = 0; memcpy( &nRigidMarkers, ptr, 4 ); ptr += 4;
+            ptr += nRigidMarkers * 3 * sizeof( float );
+
+            // NatNet Version 2.0 and later: associated marker IDs and sizes
+            if( layout.rigidBodyMarkerIDs )
+            {
+                ptr += nRigidMarkers * sizeof( int );
+                ptr += nRigidMarkers * sizeof( float );
+            }
+        }
+
+        // Mean marker error (NatNet version 2.0 and later)
+        rigidBody.MeanError = 0.0f;
+        if( layout.rigidBodyError )
+        {
+            memcpy( &rigidBody.MeanError, ptr, 4 ); ptr += 4;
+        }
+
+        // Tracking flags (NatNet version 2.6 and later)
+        rigidBody.params = 0;
+        if( layout.trackingParams )
+        {
+            memcpy( &rigidBody.params, ptr, 2 ); ptr += 2;
+        }
+    }
+
+    return ptr;
+}
+
+/**
+ * \brief Decode skeleton data
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \param frame - output frame
+ * \return - pointer after decoded object
+ */
+template <class Layout>
+static const char* DecodeSkeletonData( const char* ptr, const Layout& layout, sDecodedFrame& frame )
+{
+    sFrameOfMocapData& data = frame.data;
+
+    // Skeletons (NatNet version 2.1 and later)
+    if( layout.skeletons )
+    {
+        int nSkeletons = 0; memcpy( &nSkeletons, ptr, 4 ); ptr += 4;
+
+        int nBytes = 0;
+        ptr = DecodeDataSize( ptr, layout, nBytes );
+
+        for( int j = 0; j < nSkeletons; j++ )
+        {
+            int skeletonID = 0; memcpy( &skeletonID, ptr, 4 ); ptr += 4;
+            int nRigidBodies = 0; memcpy( &nRigidBodies, ptr, 4 ); ptr += 4;
+
+            sSkeletonData* pSkeleton = nullptr;
+            sRigidBodyData* bones = ( data.nSkeletons < MAX_SKELETONS ) ? frame.arena.Allocate<sRigidBodyData>( nRigidBodies ) : nullptr;
+            if( bones )
+            {
+                pSkeleton = &data.Skeletons[data.nSkeletons++];
+                pSkeleton->skeletonID = skeletonID;
+                pSkeleton->nRigidBodies = nRigidBodies;
+                pSkeleton->RigidBodyData = bones;
+            }
+            else
+            {
+                frame.nTruncated += nRigidBodies;
+            }
+
+            // Loop through rigid bodies (bones) in skeleton
+            for( int k = 0; k < nRigidBodies; k++ )
+            {
+                sRigidBodyData scratch;
+                sRigidBodyData& bone = pSkeleton ? pSkeleton->RigidBodyData[k] : scratch;
+
+                ptr = DecodeRigidBodyPose( ptr, bone );
+
+                // Mean marker error (NatNet version 2.0 and later)
+                bone.MeanError = 0.0f;
+                if( layout.boneError )
+                {
+                    memcpy( &bone.MeanError, ptr, 4 ); ptr += 4;
+                }
+
+                // Tracking flags (NatNet version 2.6 and later)
+                bone.params = 0;
+                if( layout.trackingParams )
+                {
+                    memcpy( &bone.params, ptr, 2 ); ptr += 2;
+                }
+            }
+        }
+    }
+
+    return ptr;
+}
+
+/**
+ * \brief Decode asset data (Motive 3.1 / NatNet 4.1 and greater)
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \param frame - output frame
+ * \return - pointer after decoded object
+ */
+template <class Layout>
+static const char* DecodeAssetData( const char* ptr, const Layout& layout, sDecodedFrame& frame )
+{
+    sFrameOfMocapData& data = frame.data;
+
+    int nAssets = 0; memcpy( &nAssets, ptr, 4 ); ptr += 4;
+
+    int nBytes = 0;
+    ptr = DecodeDataSize( ptr, layout, nBytes );
+
+    for( int i = 0; i < nAssets; i++ )
+    {
+        int assetID = 0; memcpy( &assetID, ptr, 4 ); ptr += 4;
+
+        sAssetData* pAsset = nullptr;
+        if( data.nAssets < MAX_ASSETS )
+        {
+            pAsset = &data.Assets[data.nAssets++];
+            pAsset->assetID = assetID;
+            pAsset->nRigidBodies = 0;
+            pAsset->RigidBodyData = nullptr;
+            pAsset->nMarkers = 0;
+            pAsset->MarkerData = nullptr;
+        }
+
+        // Rigid Body data
+        int nRigidBodies = 0; memcpy( &nRigidBodies, ptr, 4 ); ptr += 4;
+        if( pAsset )
+        {
+            pAsset->RigidBodyData = frame.arena.Allocate<sRigidBodyData>( nRigidBodies );
+        }
+        for( int j = 0; j < nRigidBodies; j++ )
+        {
+            sRigidBodyData scratch;
+            sRigidBodyData* pRigidBody = &scratch;
+            if( pAsset && pAsset->RigidBodyData )
+            {
+                pRigidBody = &pAsset->RigidBodyData[pAsset->nRigidBodies++];
+            }
+            else
+            {
+                ++frame.nTruncated;
+            }
+
+            ptr = DecodeRigidBodyPose( ptr, *pRigidBody );
+            memcpy( &pRigidBody->MeanError, ptr, 4 ); ptr += 4;
+            memcpy( &pRigidBody->params, ptr, 2 ); ptr += 2;
+        }
+
+        // Marker data
+        int nMarkers = 0; memcpy( &nMarkers, ptr, 4 ); ptr += 4;
+        if( pAsset )
+        {
+            pAsset->MarkerData = frame.arena.Allocate<sMarker>( nMarkers );
+        }
+        for( int j = 0; j < nMarkers; j++ )
+        {
+            sMarker scratch;
+            sMarker* pMarker = &scratch;
+            if( pAsset && pAsset->MarkerData )
+            {
+                pMarker = &pAsset->MarkerData[pAsset->nMarkers++];
+            }
+            else
+            {
+                ++frame.nTruncated;
+            }
+
+            memcpy( &pMarker->ID, ptr, 4 ); ptr += 4;
+            memcpy( &pMarker->x, ptr, 4 ); ptr += 4;
+            memcpy( &pMarker->y, ptr, 4 ); ptr += 4;
+            memcpy( &pMarker->z, ptr, 4 ); ptr += 4;
+            memcpy( &pMarker->size, ptr, 4 ); ptr += 4;
+            memcpy( &pMarker->params, ptr, 2 ); ptr += 2;
+            memcpy( &pMarker->residual, ptr, 4 ); ptr += 4;
+        }
+    }
+
+    return ptr;
+}
+
+/**
+ * \brief Decode labeled marker data
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \param frame - output frame
+ * \return - pointer after decoded object
+ */
+template <class Layout>
+static const char* DecodeLabeledMarkerData( const char* ptr, const Layout& layout, sDecodedFrame& frame )
+{
+    sFrameOfMocapData& data = frame.data;
+
+    // labeled markers (NatNet version 2.3 and later)
+    // labeled markers - this includes all markers: Active, Passive, and 'unlabeled' (markers with no asset but a PointCloud ID)
+    if( layout.labeledMarkers )
+    {
+        int nLabeledMarkers = 0; memcpy( &nLabeledMarkers, ptr, 4 ); ptr += 4;
+
+        int nBytes = 0;
+        ptr = DecodeDataSize( ptr, layout, nBytes );
+
+        for( int j = 0; j < nLabeledMarkers; j++ )
+        {
+            sMarker scratch;
+            sMarker& marker = ( data.nLabeledMarkers < MAX_LABELED_MARKERS ) ? data.LabeledMarkers[data.nLabeledMarkers++] : scratch;
+            if( &marker == &scratch )
+            {
+                ++frame.nTruncated;
+            }
+
+            memcpy( &marker.ID, ptr, 4 ); ptr += 4;
+            memcpy( &marker.x, ptr, 4 ); ptr += 4;
+            memcpy( &marker.y, ptr, 4 ); ptr += 4;
+            memcpy( &marker.z, ptr, 4 ); ptr += 4;
+            memcpy( &marker.size, ptr, 4 ); ptr += 4;
+
+            // NatNet version 2.6 and later
+            marker.params = 0;
+            if( layout.markerParams )
+            {
+                memcpy( &marker.params, ptr, 2 ); ptr += 2;
+            }
+
+            // NatNet version 3.0 and later
+            marker.residual = 0.0f;
+            if( layout.markerResidual )
+            {
+                memcpy( &marker.residual, ptr, 4 ); ptr += 4;
+                marker.residual *= 1000.0f;
+            }
+        }
+    }
+
+    return ptr;
+}
+
+/**
+ * \brief Decode labeled marker data into structure of arrays
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \param frame - output frame
+ * \return - pointer after decoded object
+ */
+template <class Layout>
+static const char* DecodeLabeledMarkerArrays( const char* ptr, const Layout& layout, sDecodedFrame& frame )
+{
+    sLabeledMarkerArrays& arrays = frame.LabeledMarkerArrays;
+
+    if( layout.labeledMarkers )
+    {
+        int nLabeledMarkers = 0; memcpy( &nLabeledMarkers, ptr, 4 ); ptr += 4;
+
+        int nBytes = 0;
+        ptr = DecodeDataSize( ptr, layout, nBytes );
+
+        const int nMarkerBytes = 5 * 4 + ( layout.markerParams ? 2 : 0 ) + ( layout.markerResidual ? 4 : 0 );
+        int nStore = std::min( nLabeledMarkers, MAX_LABELED_MARKERS );
+        arrays.nMarkers = nStore;
+        frame.nTruncated += nLabeledMarkers - nStore;
+
+        if( nMarkerBytes == LABELED_MARKER_RECORD_SIZE )
+        {
+            // NatNet 3.0 and later
+            DecodeLabeledMarkerRecords( ptr, nStore, arrays );
+        }
+        else
+        {
+            for( int j = 0; j < nStore; j++ )
+            {
+                const char* record = ptr + j * nMarkerBytes;
+                memcpy( &arrays.ID[j], record, 4 );
+                memcpy( &arrays.x[j], record + 4, 4 );
+                memcpy( &arrays.y[j], record + 8, 4 );
+                memcpy( &arrays.z[j], record + 12, 4 );
+                memcpy( &arrays.size[j], record + 16, 4 );
+                arrays.params[j] = 0;
+                if( layout.markerParams )
+                {
+                    memcpy( &arrays.params[j], record + 20, 2 );
+                }
+                arrays.residual[j] = 0.0f;
+            }
+        }
+        ptr += nLabeledMarkers * nMarkerBytes;
+    }
+
+    return ptr;
+}
+
+/**
+ * \brief Decode force plate data
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \param frame - output frame
+ * \return - pointer after decoded object
+ */
+template <class Layout>
+static const char* DecodeForcePlateData( const char* ptr, const Layout& layout, sDecodedFrame& frame )
+{
+    sFrameOfMocapData& data = frame.data;
+
+    // Force Plate data (NatNet version 2.9 and later)
+    if( layout.forcePlates )
+    {
+        int nForcePlates = 0; memcpy( &nForcePlates, ptr, 4 ); ptr += 4;
+
+        int nBytes = 0;
+        ptr = DecodeDataSize( ptr, layout, nBytes );
+
+        for( int iForcePlate = 0; iForcePlate < nForcePlates; iForcePlate++ )
+        {
+            int ID = 0; memcpy( &ID, ptr, 4 ); ptr += 4;
+            int nChannels = 0; memcpy( &nChannels, ptr, 4 ); ptr += 4;
+
+            if( data.nForcePlates < MAX_FORCEPLATES )
+            {
+                sForcePlateData& forcePlate = data.ForcePlates[data.nForcePlates++];
+                forcePlate.ID = ID;
+                forcePlate.nChannels = std::min( nChannels, MAX_ANALOG_CHANNELS );
+                forcePlate.params = 0;
+                ptr = DecodeAnalogChannels( ptr, nChannels, forcePlate.ChannelData, frame );
+            }
+            else
+            {
+                ++frame.nTruncated;
+                ptr = SkipAnalogChannels( ptr, nChannels );
+            }
+        }
+    }
+
+    return ptr;
+}
+
+/**
+ * \brief Decode device data
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \param frame - output frame
+ * \return - pointer after decoded object
+ */
+template <class Layout>
+static const char* DecodeDeviceData( const char* ptr, const Layout& layout, sDecodedFrame& frame )
+{
+    sFrameOfMocapData& data = frame.data;
+
+    // Device data (NatNet version 3.0 and later)
+    if( layout.devices )
+    {
+        int nDevices = 0; memcpy( &nDevices, ptr, 4 ); ptr += 4;
+
+        int nBytes = 0;
+        ptr = DecodeDataSize( ptr, layout, nBytes );
+
+        for( int iDevice = 0; iDevice < nDevices; iDevice++ )
+        {
+            int ID = 0; memcpy( &ID, ptr, 4 ); ptr += 4;
+            int nChannels = 0; memcpy( &nChannels, ptr, 4 ); ptr += 4;
+
+            if( data.nDevices < MAX_DEVICES )
+            {
+                sDeviceData& device = data.Devices[data.nDevices++];
+                device.ID = ID;
+                device.nChannels = std::min( nChannels, MAX_ANALOG_CHANNELS );
+                device.params = 0;
+                ptr = DecodeAnalogChannels( ptr, nChannels, device.ChannelData, frame );
+            }
+            else
+            {
+                ++frame.nTruncated;
+                ptr = SkipAnalogChannels( ptr, nChannels );
+            }
+        }
+    }
+
+    return ptr;
+}
+
+/**
+ * \brief Decode frame suffix data
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \param frame - output frame
+ * \return - pointer after decoded object
+ */
+template <class Layout>
+static const char* DecodeFrameSuffixData( const char* ptr, const Layout& layout, sDecodedFrame& frame )
+{
+    sFrameOfMocapData& data = frame.data;
+
+    // software latency (removed in version 3.0)
+    if( layout.softwareLatency )
+    {
+        ptr += 4;
+    }
+
+    // timecode
+    memcpy( &data.Timecode, ptr, 4 ); ptr += 4;
+    memcpy( &data.TimecodeSubframe, ptr, 4 ); ptr += 4;
+
+    // timestamp
+    // NatNet version 2.7 and later - increased from single to double precision
+    if( layout.doubleTimestamp )
+    {
+        memcpy( &data.fTimestamp, ptr, 8 ); ptr += 8;
+    }
+    else
+    {
+        float fTemp = 0.0f;
+        memcpy( &fTemp, ptr, 4 ); ptr += 4;
+        data.fTimestamp = (double) fTemp;
+    }
+
+    // high res timestamps (version 3.0 and later)
+    data.CameraMidExposureTimestamp = 0;
+    data.CameraDataReceivedTimestamp = 0;
+    data.TransmitTimestamp = 0;
+    if( layout.highResTimestamps )
+    {
+        memcpy( &data.CameraMidExposureTimestamp, ptr, 8 ); ptr += 8;
+        memcpy( &data.CameraDataReceivedTimestamp, ptr, 8 ); ptr += 8;
+        memcpy( &data.TransmitTimestamp, ptr, 8 ); ptr += 8;
+    }
+
+    // precision timestamps (optionally present) (NatNet 4.1 and later)
+    data.PrecisionTimestampSecs = 0;
+    data.PrecisionTimestampFractionalSecs = 0;
+    if( layout.precisionTimestamps )
+    {
+        memcpy( &data.PrecisionTimestampSecs, ptr, 4 ); ptr += 4;
+        memcpy( &data.PrecisionTimestampFractionalSecs, ptr, 4 ); ptr += 4;
+    }
+
+    // frame params
+    memcpy( &data.params, ptr, 2 ); ptr += 2;
+
+    // end of data tag
+    ptr += 4;
+
+    return ptr;
+}
+
+// Section skipping
+// With a section byte count ( NatNet 4.1 and later ) a section is skipped in one step.
+// Otherwise only the variable length parts are walked; fixed size elements are skipped by stride.
+
+/**
+ * \brief Skip markerset data
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \return - pointer after skipped object
+ */
+template <class Layout>
+static const char* SkipMarkersetData( const char* ptr, const Layout& layout )
+{
+    int nMarkerSets = 0; memcpy( &nMarkerSets, ptr, 4 ); ptr += 4;
+
+    int nBytes = 0;
+    ptr = DecodeDataSize( ptr, layout, nBytes );
+    if( layout.dataSize )
+    {
+        return ptr + nBytes;
+    }
+
+    for( int i = 0; i < nMarkerSets; i++ )
+    {
+        ptr += strlen( ptr ) + 1;
+        int nMarkers = 0; memcpy( &nMarkers, ptr, 4 ); ptr += 4;
+        ptr += nMarkers * 3 * sizeof( float );
+    }
+    return ptr;
+}
+
+/**
+ * \brief Skip legacy 'other' unlabeled markers
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \return - pointer after skipped object
+ */
+template <class Layout>
+static const char* SkipLegacyOtherMarkers( const char* ptr, const Layout& layout )
+{
+    int nOtherMarkers = 0; memcpy( &nOtherMarkers, ptr, 4 ); ptr += 4;
+
+    int nBytes = 0;
+    ptr = DecodeDataSize( ptr, layout, nBytes );
+    return ptr + nOtherMarkers * 3 * sizeof( float );
+}
+
+/**
+ * \brief Skip rigid body data
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \return - pointer after skipped object
+ */
+template <class Layout>
+static const char* SkipRigidBodyData( const char* ptr, const Layout& layout )
+{
+    int nRigidBodies = 0; memcpy( &nRigidBodies, ptr, 4 ); ptr += 4;
+
+    int nBytes = 0;
+    ptr = DecodeDataSize( ptr, layout, nBytes );
+    if( layout.dataSize )
+    {
+        return ptr + nBytes;
+    }
+
+    // ID, position, orientation, mean error, tracking flags
+    const int nPoseBytes = 8 * 4;
+    const int nTailBytes = ( layout.rigidBodyError ? 4 : 0 ) + ( layout.trackingParams ? 2 : 0 );
+    if( !layout.rigidBodyMarkers )
+    {
+        return ptr + nRigidBodies * ( nPoseBytes + nTailBytes );
+    }
+
+    for( int j = 0; j < nRigidBodies; j++ )
+    {
+        ptr += nPoseBytes;
+        int nRigidMarkers = 0; memcpy( &nRigidMarkers, ptr, 4 ); ptr += 4;
+        ptr += nRigidMarkers * 3 * sizeof( float );
+        if( layout.rigidBodyMarkerIDs )
+        {
+            ptr += nRigidMarkers * ( sizeof( int ) + sizeof( float ) );
+        }
+        ptr += nTailBytes;
+    }
+    return ptr;
+}
+
+/**
+ * \brief Skip skeleton data
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \return - pointer after skipped object
+ */
+template <class Layout>
+static const char* SkipSkeletonData( const char* ptr, const Layout& layout )
+{
+    if( !layout.skeletons )
+    {
+        return ptr;
+    }
+
+    int nSkeletons = 0; memcpy( &nSkeletons, ptr, 4 ); ptr += 4;
+
+    int nBytes = 0;
+    ptr = DecodeDataSize( ptr, layout, nBytes );
+    if( layout.dataSize )
+    {
+        return ptr + nBytes;
+    }
+
+    // ID, position, orientation, mean error, tracking flags
+    const int nBoneBytes = 8 * 4 + ( layout.boneError ? 4 : 0 ) + ( layout.trackingParams ? 2 : 0 );
+    for( int j = 0; j < nSkeletons; j++ )
+    {
+        ptr += 4;   // skeleton ID
+        int nRigidBodies = 0; memcpy( &nRigidBodies, ptr, 4 ); ptr += 4;
+        ptr += nRigidBodies * nBoneBytes;
+    }
+    return ptr;
+}
+
+/**
+ * \brief Skip asset data (assets only exist in streams with section byte counts)
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \return - pointer after skipped object
+ */
+template <class Layout>
+static const char* SkipAssetData( const char* ptr, const Layout& layout )
+{
+    ptr += 4;   // # of assets
+
+    int nBytes = 0;
+    ptr = DecodeDataSize( ptr, layout, nBytes );
+    return ptr + nBytes;
+}
+
+/**
+ * \brief Skip labeled marker data
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \return - pointer after skipped object
+ */
+template <class Layout>
+static const char* SkipLabeledMarkerData( const char* ptr, const Layout& layout )
+{
+    if( !layout.labeledMarkers )
+    {
+        return ptr;
+    }
+
+    int nLabeledMarkers = 0; memcpy( &nLabeledMarkers, ptr, 4 ); ptr += 4;
+
+    int nBytes = 0;
+    ptr = DecodeDataSize( ptr, layout, nBytes );
+    if( layout.dataSize )
+    {
+        return ptr + nBytes;
+    }
+
+    // ID, position, size, params, residual
+    const int nMarkerBytes = 5 * 4 + ( layout.markerParams ? 2 : 0 ) + ( layout.markerResidual ? 4 : 0 );
+    return ptr + nLabeledMarkers * nMarkerBytes;
+}
+
+/**
+ * \brief Skip force plate or device data, which share one layout
+ * \param ptr - input data stream pointer
+ * \param layout - bitstream layout
+ * \param present - section present in this bitstream version
+ * \return - pointer after skipped object
+ */
+template <class Layout>
+static const char* SkipAnalogDeviceData( const char* ptr, const Layout& layout, bool present )
+{
+    if( !present )
+    {
+        return ptr;
+    }
+
+    int nDevices = 0; memcpy( &nDevices, ptr, 4 ); ptr += 4;
+
+    int nBytes = 0;
+    ptr = DecodeDataSize( ptr, layout, nBytes );
+    if( layout.dataSize )
+    {
+        return ptr + nBytes;
+    }
+
+    for( int i = 0; i < nDevices; i++ )
+    {
+        ptr += 4;   // ID
+        int nChannels = 0; memcpy( &nChannels, ptr, 4 ); ptr += 4;
+        ptr = SkipAnalogChannels( ptr, nChannels );
+    }
+    return ptr;
+}
+
+// Validation
+
+/**
+ * \brief Bounds-checked cursor over a payload.
+ * The first failure is sticky: it moves the cursor to the end and makes all
+ * further reads return 0 and all further skips fail.
+ */
+struct sBoundedReader
+{
+    sBoundedReader( const char* begin, const char* limit )
+        : ptr( begin )
+        , end( limit )
+        , error( PacketError_None )
+    {
+    }
+
+    void Fail( PacketError reason )
+    {
+        if( error == PacketError_None )
+        {
+            error = reason;
+        }
+        ptr = end;
+    }
+
+    void Skip( int64_t nBytes )
+    {
+        if( ( nBytes < 0 ) || ( nBytes > end - ptr ) )
+        {
+            Fail( PacketError_Truncated );
+        }
+        else
+        {
+            ptr += nBytes;
+        }
+    }
+
+    int ReadInt()
+    {
+        int32_t value = 0;
+        if( end - ptr < 4 )
+        {
+            Fail( PacketError_Truncated );
+            return 0;
+        }
+        memcpy( &value, ptr, 4 ); ptr += 4;
+        return value;
+    }
+
+    int ReadCount()
+    {
+        int count = ReadInt();
+        if( count < 0 )
+        {
+            Fail( PacketError_InvalidCount );
+            return 0;
+        }
+        return count;
+    }
+
+    void SkipString()
+    {
+        const char* terminator = static_cast<const char*>( memchr( ptr, 0, end - ptr ) );
+        if( terminator == nullptr )
+        {
+            Fail( PacketError_UnterminatedString );
+        }
+        else
+        {
+            ptr = terminator + 1;
+        }
+    }
+
+    const char* ptr;
+    const char* end;
+    PacketError error;
+};
+
+/**
+ * \brief Read the section byte count ( NatNet 4.1 and later ) and check it fits in the payload.
+ * \param reader - payload cursor
+ * \param layout - bitstream layout
+ * \return - expected end of the section, nullptr if the version has no byte counts
+ */
+template <class Layout>
+static const char* ValidateDataSize( sBoundedReader& reader, const Layout& layout )
+{
+    if( !layout.dataSize )
+    {
+        return nullptr;
+    }
+    int nBytes = reader.ReadCount();
+    if( nBytes > reader.end - reader.ptr )
+    {
+        reader.Fail( PacketError_Truncated );
+        return nullptr;
+    }
+    return reader.ptr + nBytes;
+}
+
+/**
+ * \brief Check that a section ended where its byte count says it does.
+ * Skipping relies on the byte count, decoding on the element counts; both must agree.
+ */
+static void ValidateSectionEnd( sBoundedReader& reader, const char* sectionEnd )
+{
+    if( ( sectionEnd != nullptr ) && ( reader.ptr != sectionEnd ) )
+    {
+        reader.Fail( PacketError_SectionSize );
+    }
+}
+
+/**
+ * \brief Validate analog channel data shared by force plates and devices.
+ * Like all validation loops, this stops at the first error, so a corrupt count costs nothing.
+ */
+static void ValidateAnalogChannels( sBoundedReader& reader, int nChannels )
+{
+    for( int i = 0; ( i < nChannels ) && ( reader.error == PacketError_None ); i++ )
+    {
+        int nFrames = reader.ReadCount();
+        reader.Skip( (int64_t) nFrames * sizeof( float ) );
+    }
+}
+
+/**
+ * \brief Validate a frame payload with the given bitstream layout.
+ * Mirrors DecodeFrameDataWithLayout; fixed size elements are checked by stride.
+ * \param inptr - pointer to the payload (after the packet header)
+ * \param nBytes - payload size in bytes
+ * \param layout - bitstream layout
+ * \return - PacketError_None if the payload can be decoded safely
+ */
+template <class Layout>
+static PacketError ValidateFrameDataWithLayout( const char* inptr, int nBytes, const Layout& layout )
+{
+    sBoundedReader reader( inptr, inptr + nBytes );
+    const char* sectionEnd = nullptr;
+
+    // frame number
+    reader.Skip( 4 );
+
+    // markersets
+    int nMarkerSets = reader.ReadCount();
+    sectionEnd = ValidateDataSize( reader, layout );
+    for( int i = 0; ( i < nMarkerSets ) && ( reader.error == PacketError_None ); i++ )
+    {
+        reader.SkipString();
+        int nMarkers = reader.ReadCount();
+        reader.Skip( (int64_t) nMarkers * 3 * sizeof( float ) );
+    }
+    ValidateSectionEnd( reader, sectionEnd );
+
+    // legacy other markers
+    int nOtherMarkers = reader.ReadCount();
+    sectionEnd = ValidateDataSize( reader, layout );
+    reader.Skip( (int64_t) nOtherMarkers * 3 * sizeof( float ) );
+    ValidateSectionEnd( reader, sectionEnd );
+
+    // rigid bodies: ID, position, orientation, [markers], mean error, tracking flags
+    const int64_t nPoseBytes = 8 * 4;
+    const int64_t nRigidBodyTailBytes = ( layout.rigidBodyError ? 4 : 0 ) + ( layout.trackingParams ? 2 : 0 );
+    int nRigidBodies = reader.ReadCount();
+    sectionEnd = ValidateDataSize( reader, layout );
+    if( layout.rigidBodyMarkers )
+    {
+        for( int j = 0; ( j < nRigidBodies ) && ( reader.error == PacketError_None ); j++ )
+        {
+            reader.Skip( nPoseBytes );
+            int nRigidMarkers = reader.ReadCount();
+            int64_t nMarkerBytes = layout.rigidBodyMarkerIDs ? ( 3 * sizeof( float ) + sizeof( int ) + sizeof( float ) ) : 3 * sizeof( float );
+            reader.Skip( nRigidMarkers * nMarkerBytes );
+            reader.Skip( nRigidBodyTailBytes );
+        }
+    }
+    else
+    {
+        reader.Skip( nRigidBodies * ( nPoseBytes + nRigidBodyTailBytes ) );
+    }
+    ValidateSectionEnd( reader, sectionEnd );
+
+    // skeletons
+    if( layout.skeletons )
+    {
+        const int64_t nBoneBytes = nPoseBytes + ( layout.boneError ? 4 : 0 ) + ( layout.trackingParams ? 2 : 0 );
+        int nSkeletons = reader.ReadCount();
+        sectionEnd = ValidateDataSize( reader, layout );
+        for( int j = 0; ( j < nSkeletons ) && ( reader.error == PacketError_None ); j++ )
+        {
+            reader.Skip( 4 );
+            int nBones = reader.ReadCount();
+            reader.Skip( nBones * nBoneBytes );
+        }
+        ValidateSectionEnd( reader, sectionEnd );
+    }
+
+    // assets: ID, rigid bodies ( pose, error, params ), markers ( ID, position, size, params, residual )
+    if( layout.assets )
+    {
+        int nAssets = reader.ReadCount();
+        sectionEnd = ValidateDataSize( reader, layout );
+        for( int i = 0; ( i < nAssets ) && ( reader.error == PacketError_None ); i++ )
+        {
+            reader.Skip( 4 );
+            int nAssetRigidBodies = reader.ReadCount();
+            reader.Skip( nAssetRigidBodies * ( nPoseBytes + 4 + 2 ) );
+            int nAssetMarkers = reader.ReadCount();
+            reader.Skip( (int64_t) nAssetMarkers * ( 5 * 4 + 2 + 4 ) );
+        }
+        ValidateSectionEnd( reader, sectionEnd );
+    }
+
+    // labeled markers
+    if( layout.labeledMarkers )
+    {
+        const int64_t nMarkerBytes = 5 * 4 + ( layout.markerParams ? 2 : 0 ) + ( layout.markerResidual ? 4 : 0 );
+        int nLabeledMarkers = reader.ReadCount();
+        sectionEnd = ValidateDataSize( reader, layout );
+        reader.Skip( nLabeledMarkers * nMarkerBytes );
+        ValidateSectionEnd( reader, sectionEnd );
+    }
+
+    // force plates and devices
+    const bool analogSections[] = { layout.forcePlates, layout.devices };
+    for( bool present : analogSections )
+    {
+        if( present )
+        {
+            int nDevices = reader.ReadCount();
+            sectionEnd = ValidateDataSize( reader, layout );
+            for( int i = 0; ( i < nDevices ) && ( reader.error == PacketError_None ); i++ )
+            {
+                reader.Skip( 4 );
+                int nChannels = reader.ReadCount();
+                ValidateAnalogChannels( reader, nChannels );
+            }
+            ValidateSectionEnd( reader, sectionEnd );
+        }
+    }
+
+    // suffix: [software latency], timecode, timestamp, [high res timestamps], [precision timestamps], params, end of data tag
+    reader.Skip( ( layout.softwareLatency ? 4 : 0 ) + 8 + ( layout.doubleTimestamp ? 8 : 4 ) +
+        ( layout.highResTimestamps ? 24 : 0 ) + ( layout.precisionTimestamps ? 8 : 0 ) + 2 + 4 );
+
+    return reader.error;
+}
+
+/**
+ * \brief Frame validator specialized for one bitstream version.
+ */
+template <int Major, int Minor>
+static PacketError ValidateFrameDataStatic( const char* inptr, int nBytes, int /*major*/, int /*minor*/ )
+{
+    return ValidateFrameDataWithLayout( inptr, nBytes, sStaticLayout<Major, Minor>() );
+}
+
+/**
+ * \brief Frame validator testing the version for every element.
+ */
+static PacketError ValidateFrameDataGeneric( const char* inptr, int nBytes, int major, int minor )
+{
+    return ValidateFrameDataWithLayout( inptr, nBytes, sRuntimeLayout( major, minor ) );
+}
+
+const char* DecodePacketHeader( const char* ptr, int& messageID, int& nBytes )
+{
+    // First 2 Bytes is message ID
+    uint16_t value = 0;
+    memcpy( &value, ptr, 2 ); ptr += 2;
+    messageID = value;
+
+    // Second 2 Bytes is the size of the packet
+    memcpy( &value, ptr, 2 ); ptr += 2;
+    nBytes = value;
+    return ptr;
+}
+
+bool PeekFrameParams( const char* pData, size_t length, uint16_t& params )
+{
+    params = 0;
+    if( length < 4 )
+    {
+        return false;
+    }
+    int messageID = 0;
+    int nBytes = 0;
+    const char* ptr = DecodePacketHeader( pData, messageID, nBytes );
+    if( ( nBytes < 6 ) || ( (size_t) nBytes > length - 4 ) )
+    {
+        return false;
+    }
+    memcpy( &params, ptr + nBytes - 6, 2 );
+    return true;
+}
+
+bool PeekFrameNumber( const char* pData, size_t length, int32_t& frame )
+{
+    frame = 0;
+    if( length < 8 )
+    {
+        return false;
+    }
+    memcpy( &frame, pData + 4, 4 );
+    return true;
+}
+
+/**
+ * \brief Decode a frame with the given bitstream layout.
+ * \param inptr - pointer to the payload (after the packet header)
+ * \param layout - bitstream layout
+ * \param sections - FrameSection mask of the sections to decode
+ * \param frame - output frame
+ * \return - pointer after decoded object
+ */
+template <class Layout>
+static const char* DecodeFrameDataWithLayout( const char* inptr, const Layout& layout, unsigned int sections, sDecodedFrame& frame )
+{
+    sFrameOfMocapData& data = frame.data;
+    data.nMarkerSets = 0;
+    data.nOtherMarkers = 0;
+    data.nRigidBodies = 0;
+    data.nSkeletons = 0;
+    data.nAssets = 0;
+    data.nLabeledMarkers = 0;
+    data.nForcePlates = 0;
+    data.nDevices = 0;
+    frame.LabeledMarkerArrays.nMarkers = 0;
+    frame.nTruncated = 0;
+    frame.arena.Reset();
+
+    const char* ptr = inptr;
+    ptr = DecodeFramePrefixData( ptr, frame );
+
+    ptr = ( sections & FrameSection_MarkerSets ) ? DecodeMarkersetData( ptr, layout, frame ) : SkipMarkersetData( ptr, layout );
+
+    ptr = ( sections & FrameSection_OtherMarkers ) ? DecodeLegacyOtherMarkers( ptr, layout, frame ) : SkipLegacyOtherMarkers( ptr, layout );
+
+    ptr = ( sections & FrameSection_RigidBodies ) ? DecodeRigidBodyData( ptr, layout, frame ) : SkipRigidBodyData( ptr, layout );
+
+    ptr = ( sections & FrameSection_Skeletons ) ? DecodeSkeletonData( ptr, layout, frame ) : SkipSkeletonData( ptr, layout );
+
+    // Assets ( Motive 3.1 / NatNet 4.1 and greater)
+    if( layout.assets )
+    {
+        ptr = ( sections & FrameSection_Assets ) ? DecodeAssetData( ptr, layout, frame ) : SkipAssetData( ptr, layout );
+    }
+
+    if( sections & FrameSection_LabeledMarkerArrays )
+    {
+        ptr = DecodeLabeledMarkerArrays( ptr, layout, frame );
+    }
+    else
+    {
+        ptr = ( sections & FrameSection_LabeledMarkers ) ? DecodeLabeledMarkerData( ptr, layout, frame ) : SkipLabeledMarkerData( ptr, layout );
+    }
+
+    ptr = ( sections & FrameSection_ForcePlates ) ? DecodeForcePlateData( ptr, layout, frame ) : SkipAnalogDeviceData( ptr, layout, layout.forcePlates );
+
+    ptr = ( sections & FrameSection_Devices ) ? DecodeDeviceData( ptr, layout, frame ) : SkipAnalogDeviceData( ptr, layout, layout.devices );
+
+    ptr = DecodeFrameSuffixData( ptr, layout, frame );
+
+    return ptr;
+}
+
+/**
+ * \brief Frame decoder specialized for one bitstream version.
+ * major and minor are ignored; they are part of the signature so that
+ * specialized and generic decoders are interchangeable.
+ */
+template <int Major, int Minor>
+static const char* DecodeFrameDataStatic( const char* inptr, int /*nBytes*/, int /*major*/, int /*minor*/, sDecodedFrame& frame, unsigned int sections )
+{
+    return DecodeFrameDataWithLayout( inptr, sStaticLayout<Major, Minor>(), sections, frame );
+}
+
+const char* DecodeFrameDataGeneric( const char* inptr, int /*nBytes*/, int major, int minor, sDecodedFrame& frame, unsigned int sections )
+{
+    return DecodeFrameDataWithLayout( inptr, sRuntimeLayout( major, minor ), sections, frame );
+}
+
+FrameDecoder SelectFrameDecoder( int major, int minor )
+{
+    // NatNet 4.1 and later share one frame layout (4.2 only changed descriptions)
+    if( HasDataSize( major, minor ) )
+    {
+        return &DecodeFrameDataStatic<4, 1>;
+    }
+    if( major == 4 )
+    {
+        return &DecodeFrameDataStatic<4, 0>;
+    }
+    // 3.0 and 3.1 frames are identical
+    if( major == 3 )
+    {
+        return &DecodeFrameDataStatic<3, 0>;
+    }
+    // NatNet 2.x and unknown ( 0 ) versions are rare enough to not warrant their own instantiations
+    return &DecodeFrameDataGeneric;
+}
+
+FrameValidator SelectFrameValidator( int major, int minor )
+{
+    // Same specializations as SelectFrameDecoder
+    if( HasDataSize( major, minor ) )
+    {
+        return &ValidateFrameDataStatic<4, 1>;
+    }
+    if( major == 4 )
+    {
+        return &ValidateFrameDataStatic<4, 0>;
+    }
+    if( major == 3 )
+    {
+        return &ValidateFrameDataStatic<3, 0>;
+    }
+    return &ValidateFrameDataGeneric;
+}
+
+const char* PacketErrorString( PacketError error )
+{
+    switch( error )
+    {
+    case PacketError_None:                  return "no error";
+    case PacketError_TooShort:              return "shorter than the packet header";
+    case PacketError_Truncated:             return "truncated";
+    case PacketError_InvalidCount:          return "negative count";
+    case PacketError_SectionSize:           return "section byte count does not match contents";
+    case PacketError_UnterminatedString:    return "unterminated string";
+    case PacketError_UnknownDescription:    return "unknown data description type";
+    case PacketError_BitstreamChange:       return "bitstream version change pending";
+    }
+    return "unknown error";
+}
+
+PacketError ValidatePacket( const char* pData, size_t length, FrameValidator validateFrame, int major, int minor )
+{
+    if( length < 4 )
+    {
+        return PacketError_TooShort;
+    }
+
+    int messageID = 0;
+    int nBytes = 0;
+    const char* ptr = DecodePacketHeader( pData, messageID, nBytes );
+    if( (size_t) nBytes > length - 4 )
+    {
+        return PacketError_Truncated;
+    }
+
+    // Other messages are decoded by the caller, which only needs the header to be consistent
+    if( messageID == NAT_FRAMEOFDATA )
+    {
+        return validateFrame( ptr, nBytes, major, minor );
+    }
+    return PacketError_None;
+}
+
+PacketError ValidatePacket( const char* pData, size_t length, int major, int minor )
+{
+    return ValidatePacket( pData, length, SelectFrameValidator( major, minor ), major, minor );
+}
+
+const char* DecodeFrameData( const char* inptr, int nBytes, int major, int minor, sDecodedFrame& frame, unsigned int sections )
+{
+    return SelectFrameDecoder( major, minor )( inptr, nBytes, major, minor, frame, sections );
+}
+
+const char* DecodePacket( const char* pData, FrameDecoder decodeFrame, int major, int minor, int& messageID, sDecodedFrame& frame, unsigned int sections )
+{
+    int nBytes = 0;
+    const char* ptr = DecodePacketHeader( pData, messageID, nBytes );
+
+    if( messageID == NAT_FRAMEOFDATA )
+    {
+        decodeFrame( ptr, nBytes, major, minor, frame, sections );
+    }
+
+    // return the beginning of the possible next packet
+    // assuming no additional termination
+    return pData + 4 + nBytes;
+}
+
+const char* DecodePacket( const char* pData, int major, int minor, int& messageID, sDecodedFrame& frame, unsigned int sections )
+{
+    return DecodePacket( pData, SelectFrameDecoder( major, minor ), major, minor, messageID, frame, sections );
+}
@@ -0,0 +1,224 @@
+//=============================================================================
+// NatNetDecoder.h
+// ~~~~~~~~~~~~~~~
+//
+// Print-free decoding of NatNet packets into caller-owned frame structures.
+// The bitstream handling is derived from samples/PacketClient/PacketClient.cpp
+// (NatNet SDK 4.1.0), licensed under the Apache License, Version 2.0.
+//=============================================================================
+
+#pragma once
+
+#include <NatNetTypes.h>
+
+#include "FrameArena.h"
+#include "LabeledMarkerArrays.h"
+
+#include <cstddef>
+
+// Initial arena size of an sDecodedFrame. Decoded elements are at most a few bytes
+// larger than their encoding, so this holds the pointer members of any frame that fits in one packet.
+#define DECODED_FRAME_ARENA_SIZE        ( 2 * MAX_PACKETSIZE )
+
+// sFrameOfMocapData::params bits
+#define FRAME_PARAMS_RECORDING                  0x01    // Motive is recording
+#define FRAME_PARAMS_TRACKED_MODELS_CHANGED     0x02    // actively tracked model list has changed, data descriptions are stale
+#define FRAME_PARAMS_LIVE_MODE                  0x04    // live ( not edit ) mode
+#define FRAME_PARAMS_BITSTREAM_CHANGED          0x08    // first frame in a newly requested bitstream version
+
+/**
+ * \brief Client-side times of a frame, in nanoseconds of the realtime clock ( CLOCK_REALTIME ).
+ * Filled by the receiving code, not by the decoder; 0 if not measured.
+ */
+typedef struct sFrameTimes
+{
+    int64_t received;                       // kernel receive timestamp ( SO_TIMESTAMPNS ), or when the datagram was read
+    int64_t decoded;                        // when decoding finished
+} sFrameTimes;
+
+/**
+ * \brief Destination for one decoded frame of mocap data.
+ * Holds an sFrameOfMocapData together with the arena its pointer members
+ * (MarkerSet markers, other markers, skeleton and asset members) are
+ * allocated from. Every decode resets the arena, so steady-state decoding
+ * never touches the heap. It is large: allocate it once ( or take it from
+ * a FramePool ) and reuse it for every frame.
+ */
+typedef struct sDecodedFrame
+{
+    sDecodedFrame() : data(), arena( DECODED_FRAME_ARENA_SIZE ), LabeledMarkerArrays(), nTruncated( 0 ), times() {}
+
+    sFrameOfMocapData data;
+
+    FrameArena arena;
+
+    sLabeledMarkerArrays LabeledMarkerArrays;  // labeled markers, if decoded with FrameSection_LabeledMarkerArrays
+
+    int32_t nTruncated;                     // # of elements skipped because a capacity was exceeded
+
+    sFrameTimes times;                      // left untouched by the decoder
+} sDecodedFrame;
+
+/**
+ * \brief Sections of a frame of mocap data, for selective decoding.
+ * Sections not in the mask passed to the decoder are skipped and left empty
+ * (count 0). NatNet 4.1 and later streams carry the byte count of every
+ * section, so a skipped section costs a single pointer increment; older
+ * streams are walked without storing anything.
+ */
+typedef enum FrameSection
+{
+    FrameSection_MarkerSets     = 0x01,
+    FrameSection_OtherMarkers   = 0x02,     // legacy unlabeled markers
+    FrameSection_RigidBodies    = 0x04,
+    FrameSection_Skeletons      = 0x08,
+    FrameSection_Assets         = 0x10,
+    FrameSection_LabeledMarkers = 0x20,
+    FrameSection_ForcePlates    = 0x40,
+    FrameSection_Devices        = 0x80,
+    FrameSection_All            = 0xFF,
+
+    // Decode labeled markers into sDecodedFrame::LabeledMarkerArrays ( structure of
+    // arrays, SIMD transposed ) instead of sFrameOfMocapData::LabeledMarkers.
+    // Takes precedence over FrameSection_LabeledMarkers.
+    FrameSection_LabeledMarkerArrays = 0x100
+} FrameSection;
+
+/**
+ * \brief Result of validating a received datagram.
+ */
+typedef enum PacketError
+{
+    PacketError_None = 0,
+    PacketError_TooShort,               // shorter than the packet header
+    PacketError_Truncated,              // header or an element count points past the end of the datagram
+    PacketError_InvalidCount,           // negative element count or byte count
+    PacketError_SectionSize,            // NatNet 4.1+ section byte count disagrees with the section contents
+    PacketError_UnterminatedString,     // name runs past the end of the datagram
+    PacketError_UnknownDescription,     // data description of unknown type, in a stream without description sizes
+    PacketError_BitstreamChange,        // frame in the previous bitstream version, dropped while a version change is pending
+} PacketError;
+
+/**
+ * \brief Human readable description of a PacketError.
+ */
+const char* PacketErrorString( PacketError error );
+
+/**
+ * \brief Decode the 4 byte packet header.
+ * \param ptr - input data stream pointer
+ * \param messageID - output message ID (e.g. NAT_FRAMEOFDATA)
+ * \param nBytes - output payload size in bytes
+ * \return - pointer to the payload
+ */
+const char* DecodePacketHeader( const char* ptr, int& messageID, int& nBytes );
+
+/**
+ * \brief Read the params ( FRAME_PARAMS_* ) of a NAT_FRAMEOFDATA datagram without decoding it.
+ * They sit at the same place in every version: before the 4 byte end of data tag.
+ * \param pData - received datagram
+ * \param length - # of bytes received
+ * \param params - output params, 0 if the datagram is too short to hold them
+ * \return - false if the datagram is too short
+ */
+bool PeekFrameParams( const char* pData, size_t length, uint16_t& params );
+
+/**
+ * \brief Read the frame number of a NAT_FRAMEOFDATA datagram without decoding it ( the first payload field in every version ).
+ * \param pData - received datagram
+ * \param length - # of bytes received
+ * \param frame - output frame number, 0 if the datagram is too short to hold it
+ * \return - false if the datagram is too short
+ */
+bool PeekFrameNumber( const char* pData, size_t length, int32_t& frame );
+
+/**
+ * \brief Decoder for a NAT_FRAMEOFDATA payload.
+ * \param inptr - pointer to the payload (after the packet header)
+ * \param nBytes - payload size in bytes
+ * \param major - NatNet major version
+ * \param minor - NatNet minor version
+ * \param frame - output frame
+ * \param sections - FrameSection mask of the sections to decode
+ * \return - pointer after decoded object
+ */
+typedef const char* ( *FrameDecoder )( const char* inptr, int nBytes, int major, int minor, sDecodedFrame& frame, unsigned int sections );
+
+/**
+ * \brief Select the frame decoder for a bitstream version.
+ * NatNet 3.x, 4.0 and 4.1+ get decoders specialized at compile time, with no
+ * per-element version tests; other versions use DecodeFrameDataGeneric.
+ * Call once per connection, after the server's NatNet version is known.
+ * \param major - NatNet major version
+ * \param minor - NatNet minor version
+ * \return - decoder for this version
+ */
+FrameDecoder SelectFrameDecoder( int major, int minor );
+
+/**
+ * \brief Decode a NAT_FRAMEOFDATA payload, testing the version for every element.
+ * Handles any version; prefer the decoder returned by SelectFrameDecoder.
+ */
+const char* DecodeFrameDataGeneric( const char* inptr, int nBytes, int major, int minor, sDecodedFrame& frame, unsigned int sections = FrameSection_All );
+
+/**
+ * \brief Decode a NAT_FRAMEOFDATA payload into frame.
+ * Selects the decoder for every call; see SelectFrameDecoder.
+ */
+const char* DecodeFrameData( const char* inptr, int nBytes, int major, int minor, sDecodedFrame& frame, unsigned int sections = FrameSection_All );
+
+/**
+ * \brief Validator for a NAT_FRAMEOFDATA payload.
+ * Walks the payload once and checks every count and section size against
+ * the payload end, without storing anything.
+ * \param inptr - pointer to the payload (after the packet header)
+ * \param nBytes - payload size in bytes
+ * \param major - NatNet major version
+ * \param minor - NatNet minor version
+ * \return - PacketError_None if the payload can be decoded safely
+ */
+typedef PacketError ( *FrameValidator )( const char* inptr, int nBytes, int major, int minor );
+
+/**
+ * \brief Select the frame validator for a bitstream version, like SelectFrameDecoder.
+ */
+FrameValidator SelectFrameValidator( int major, int minor );
+
+/**
+ * \brief Check a received datagram before decoding it.
+ * Decoders trust the counts in the bitstream; a datagram that passes
+ * validation never makes them read past pData + length.
+ * \param pData - received datagram
+ * \param length - # of bytes received
+ * \param validateFrame - validator returned by SelectFrameValidator( major, minor )
+ * \param major - NatNet major version
+ * \param minor - NatNet minor version
+ * \return - PacketError_None if the packet can be decoded safely
+ */
+PacketError ValidatePacket( const char* pData, size_t length, FrameValidator validateFrame, int major, int minor );
+
+/**
+ * \brief Check a received datagram before decoding it.
+ * Selects the validator for every call; see SelectFrameValidator.
+ */
+PacketError ValidatePacket( const char* pData, size_t length, int major, int minor );
+
+/**
+ * \brief Decode a complete NatNet packet.
+ * Only NAT_FRAMEOFDATA packets fill frame; other messages are reported
+ * through messageID and left to the caller.
+ * \param pData - input packet (header and payload)
+ * \param major - NatNet major version
+ * \param minor - NatNet minor version
+ * \param messageID - output message ID from the packet header
+ * \param frame - output frame
+ * \param sections - FrameSection mask of the sections to decode
+ * \return - pointer to the beginning of the possible next packet
+ */
+const char* DecodePacket( const char* pData, int major, int minor, int& messageID, sDecodedFrame& frame, unsigned int sections = FrameSection_All );
+
+/**
+ * \brief Decode a complete NatNet packet with a previously selected frame decoder.
+ * \param decodeFrame - decoder returned by SelectFrameDecoder( major, minor )
+ */
+const char* DecodePacket( const char* pData, FrameDecoder decodeFrame, int major, int minor, int& messageID, sDecodedFrame& frame, unsigned int sections = FrameSection_All );
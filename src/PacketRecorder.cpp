@@ -0,0 +1,472 @@
+//=============================================================================
+// PacketRecorder.cpp
+// ~~~~~~~~~~~~~~~~~~
+//
+// Raw packet recording to memory-mapped segment files.
+//=============================================================================
+
+#include "PacketRecorder.h"
+
+#include "FrameLatency.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Type of the filler at the end of the queue when a record does not fit before it wraps
+static const uint8_t kRecordWrap = 0xFF;
+
+static uint64_t AlignUp( uint64_t bytes )
+{
+    return ( bytes + PACKET_LOG_ALIGNMENT - 1 ) / PACKET_LOG_ALIGNMENT * PACKET_LOG_ALIGNMENT;
+}
+
+static size_t RoundUpToPowerOf2( size_t bytes )
+{
+    size_t size = 1;
+    while( size < bytes )
+    {
+        size <<= 1;
+    }
+    return size;
+}
+
+PacketRecorder::PacketRecorder()
+    : mMask( 0 )
+    , mHead( 0 )
+    , mTail( 0 )
+    , mSegmentBytes( 0 )
+    , mSegment( 0 )
+    , mFd( -1 )
+    , mpSegment( nullptr )
+    , mUsed( 0 )
+    , mHaveModelDef( false )
+    , mModelDefHeader()
+    , mStop( true )
+    , mFailed( false )
+    , mnRecords( 0 )
+    , mnBytes( 0 )
+    , mnDropped( 0 )
+    , mnSegments( 0 )
+    , mMaxQueued( 0 )
+    , mError( 0 )
+{
+}
+
+PacketRecorder::~PacketRecorder()
+{
+    Stop();
+}
+
+bool PacketRecorder::Start( const char* path, uint64_t segmentBytes, size_t queueBytes )
+{
+    if( IsRecording() )
+    {
+        errno = EBUSY;
+        return false;
+    }
+    mPath = path;
+    mSegmentBytes = std::max( segmentBytes, (uint64_t) PACKET_LOG_SEGMENT_BYTES_MIN );
+    mSegment = 0;
+    mHaveModelDef = false;
+    mFailed.store( false );
+    mError.store( 0 );
+    if( SegmentsExist() )
+    {
+        errno = EEXIST;
+        return false;
+    }
+    if( !OpenSegment() )
+    {
+        return false;
+    }
+
+    // Room for the largest datagram wherever the queue wraps. Allocated and
+    // zeroed here, so the recording thread never faults a page in.
+    mQueue.assign( RoundUpToPowerOf2( std::max( queueBytes, (size_t) ( 4 * AlignUp( sizeof( sPacketRecordHeader ) + MAX_PACKETSIZE ) ) ) ), 0 );
+    mMask = mQueue.size() - 1;
+    mHead.store( 0 );
+    mTail.store( 0 );
+    mStop.store( false );
+    mThread = std::thread( &PacketRecorder::Flush, this );
+    return true;
+}
+
+bool PacketRecorder::Record( const char* pData, size_t length, int64_t received, int major, int minor, bool truncated )
+{
+    return Queue( PacketRecord_Datagram, truncated ? PACKET_RECORD_TRUNCATED : 0, pData, length, received, major, minor );
+}
+
+bool PacketRecorder::RecordModelDef( const char* pData, size_t length, int64_t received, int major, int minor )
+{
+    return Queue( PacketRecord_ModelDef, 0, pData, length, received, major, minor );
+}
+
+bool PacketRecorder::Queue( uint8_t type, uint8_t flags, const char* pData, size_t length, int64_t received, int major,
+    int minor )
+{
+    if( mStop.load( std::memory_order_relaxed ) || mFailed.load( std::memory_order_relaxed )
+        || ( length > MAX_PACKETSIZE ) )
+    {
+        mnDropped.fetch_add( 1, std::memory_order_relaxed );
+        return false;
+    }
+
+    // A record is contiguous in the queue: one that would wrap starts over at
+    // the beginning, after a filler up to the end
+    const uint64_t size = AlignUp( sizeof( sPacketRecordHeader ) + length );
+    uint64_t head = mHead.load( std::memory_order_relaxed );
+    uint64_t tail = mTail.load( std::memory_order_acquire );
+    size_t offset = (size_t) ( head & mMask );
+    size_t toEnd = mQueue.size() - offset;
+    uint64_t needed = size + ( ( toEnd < size ) ? toEnd : 0 );
+    if( head - tail + needed > mQueue.size() )
+    {
+        mnDropped.fetch_add( 1, std::memory_order_relaxed );
+        return false;
+    }
+    if( toEnd < size )
+    {
+        sPacketRecordHeader filler = {};
+        filler.type = kRecordWrap;
+        memcpy( &mQueue[offset], &filler, sizeof( filler ) );
+        head += toEnd;
+        offset = 0;
+    }
+
+    sPacketRecordHeader header;
+    header.length = (uint32_t) length;
+    header.type = type;
+    header.flags = flags;
+    header.major = (uint8_t) major;
+    header.minor = (uint8_t) minor;
+    header.received = received;
+    memcpy( &mQueue[offset], &header, sizeof( header ) );
+    memcpy( &mQueue[offset + sizeof( header )], pData, length );
+    head += size;
+    mHead.store( head, std::memory_order_release );
+
+    if( head - tail > mMaxQueued.load( std::memory_order_relaxed ) )
+    {
+        mMaxQueued.store( head - tail, std::memory_order_relaxed );
+    }
+    return true;
+}
+
+void PacketRecorder::Stop()
+{
+    if( !IsRecording() )
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        mStop.store( true );
+    }
+    mWake.notify_all();
+    mThread.join();
+}
+
+std::string PacketRecorder::SegmentPath( uint32_t segment ) const
+{
+    char suffix[16];
+    snprintf( suffix, sizeof( suffix ), ".%04u", segment );
+    return mPath + suffix;
+}
+
+sPacketRecorderCounters PacketRecorder::Counters() const
+{
+    sPacketRecorderCounters counters;
+    counters.nRecords = mnRecords.load( std::memory_order_relaxed );
+    counters.nBytes = mnBytes.load( std::memory_order_relaxed );
+    counters.nDropped = mnDropped.load( std::memory_order_relaxed );
+    counters.nSegments = mnSegments.load( std::memory_order_relaxed );
+    counters.maxQueued = mMaxQueued.load( std::memory_order_relaxed );
+    return counters;
+}
+
+void PacketRecorder::Flush()
+{
+    // The recording thread never wakes the flusher, which would cost it a
+    // system call: the flusher looks at the queue at a fixed interval instead
+    std::unique_lock<std::mutex> lock( mMutex );
+    while( !mStop.load() )
+    {
+        mWake.wait_for( lock, std::chrono::milliseconds( PACKET_LOG_FLUSH_INTERVAL_MS ) );
+        lock.unlock();
+        WriteQueued();
+        lock.lock();
+    }
+    lock.unlock();
+    WriteQueued();
+    CloseSegment();
+}
+
+void PacketRecorder::WriteQueued()
+{
+    uint64_t tail = mTail.load( std::memory_order_relaxed );
+    const uint64_t head = mHead.load( std::memory_order_acquire );
+    while( tail != head )
+    {
+        size_t offset = (size_t) ( tail & mMask );
+        sPacketRecordHeader header;
+        memcpy( &header, &mQueue[offset], sizeof( header ) );
+        if( header.type == kRecordWrap )
+        {
+            tail += mQueue.size() - offset;
+        }
+        else
+        {
+            WriteRecord( header, &mQueue[offset + sizeof( header )] );
+            tail += AlignUp( sizeof( header ) + header.length );
+        }
+        mTail.store( tail, std::memory_order_release );
+    }
+}
+
+void PacketRecorder::WriteRecord( const sPacketRecordHeader& header, const char* pData )
+{
+    const uint64_t size = AlignUp( sizeof( header ) + header.length );
+    if( mpSegment && ( mUsed + size > mSegmentBytes ) )
+    {
+        CloseSegment();
+        if( !OpenSegment() )
+        {
+            // Not retried: the records that follow are dropped, see Failed
+            mFailed.store( true, std::memory_order_relaxed );
+        }
+    }
+    if( !mpSegment )
+    {
+        mnDropped.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+
+    // The zeros of the segment pad the record, and end the records after it
+    memcpy( mpSegment + mUsed, &header, sizeof( header ) );
+    memcpy( mpSegment + mUsed + sizeof( header ), pData, header.length );
+    mUsed += size;
+    mnRecords.fetch_add( 1, std::memory_order_relaxed );
+    mnBytes.fetch_add( size, std::memory_order_relaxed );
+
+    if( ( header.type == PacketRecord_ModelDef ) && ( pData != mModelDef.data() ) )
+    {
+        mModelDefHeader = header;
+        mModelDef.assign( pData, pData + header.length );
+        mHaveModelDef = true;
+    }
+}
+
+#if defined(__linux__) || defined(__APPLE__)
+
+bool PacketRecorder::SegmentsExist() const
+{
+    // Any <name>.<digits> next to the path, not only the first segment: a
+    // later one in the way would stop the recording at the rollover
+    std::string directory = ".";
+    std::string name = mPath;
+    size_t slash = mPath.rfind( '/' );
+    if( slash != std::string::npos )
+    {
+        directory = ( slash == 0 ) ? "/" : mPath.substr( 0, slash );
+        name = mPath.substr( slash + 1 );
+    }
+    DIR* pDirectory = opendir( directory.c_str() );
+    if( !pDirectory )
+    {
+        return false;       // OpenSegment reports why
+    }
+    bool exists = false;
+    while( struct dirent* pEntry = readdir( pDirectory ) )
+    {
+        const char* pName = pEntry->d_name;
+        if( ( strncmp( pName, name.c_str(), name.size() ) != 0 ) || ( pName[name.size()] != '.' ) )
+        {
+            continue;
+        }
+        const char* pDigits = pName + name.size() + 1;
+        size_t nDigits = strspn( pDigits, "0123456789" );
+        if( ( nDigits >= 4 ) && ( pDigits[nDigits] == '\0' ) )
+        {
+            exists = true;
+            break;
+        }
+    }
+    closedir( pDirectory );
+    return exists;
+}
+
+bool PacketRecorder::OpenSegment()
+{
+    std::string path = SegmentPath( mSegment );
+    int fd = open( path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644 );
+    if( fd < 0 )
+    {
+        mError.store( errno, std::memory_order_relaxed );
+        return false;
+    }
+    void* pMemory = MAP_FAILED;
+    if( ftruncate( fd, (off_t) mSegmentBytes ) == 0 )
+    {
+        pMemory = mmap( nullptr, mSegmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    }
+    if( pMemory == MAP_FAILED )
+    {
+        int error = errno;
+        close( fd );
+        unlink( path.c_str() );
+        mError.store( error, std::memory_order_relaxed );
+        errno = error;
+        return false;
+    }
+
+    mFd = fd;
+    mpSegment = static_cast<char*>( pMemory );
+    sPacketLogHeader header = {};
+    header.magic = PACKET_LOG_MAGIC;
+    header.version = PACKET_LOG_VERSION;
+    header.headerBytes = (uint32_t) AlignUp( sizeof( sPacketLogHeader ) );
+    header.segment = mSegment;
+    header.created = RealtimeNanoseconds();
+    memcpy( mpSegment, &header, sizeof( header ) );
+    mUsed = header.headerBytes;
+    mSegment++;
+    mnSegments.fetch_add( 1, std::memory_order_relaxed );
+
+    if( mHaveModelDef )
+    {
+        WriteRecord( mModelDefHeader, mModelDef.data() );
+    }
+    return true;
+}
+
+void PacketRecorder::CloseSegment()
+{
+    if( !mpSegment )
+    {
+        return;
+    }
+    sPacketLogHeader* pHeader = reinterpret_cast<sPacketLogHeader*>( mpSegment );
+    pHeader->recordBytes = mUsed - pHeader->headerBytes;
+    munmap( mpSegment, mSegmentBytes );
+    if( ftruncate( mFd, (off_t) mUsed ) != 0 )
+    {
+        mError.store( errno, std::memory_order_relaxed );
+    }
+    close( mFd );
+    mpSegment = nullptr;
+    mFd = -1;
+}
+
+PacketLogReader::PacketLogReader() : mpData( nullptr ), mBytes( 0 ), mEnd( 0 ), mOffset( 0 ) {}
+
+PacketLogReader::~PacketLogReader()
+{
+    Close();
+}
+
+bool PacketLogReader::Open( const char* path )
+{
+    Close();
+    int fd = open( path, O_RDONLY );
+    if( fd < 0 )
+    {
+        return false;
+    }
+    struct stat status;
+    void* pMemory = MAP_FAILED;
+    if( fstat( fd, &status ) == 0 )
+    {
+        if( (size_t) status.st_size < sizeof( sPacketLogHeader ) )
+        {
+            close( fd );
+            errno = EPROTO;
+            return false;
+        }
+        pMemory = mmap( nullptr, (size_t) status.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    }
+    int error = errno;
+    close( fd );
+    if( pMemory == MAP_FAILED )
+    {
+        errno = error;
+        return false;
+    }
+
+    mpData = static_cast<const char*>( pMemory );
+    mBytes = (size_t) status.st_size;
+    const sPacketLogHeader& header = Header();
+    if( ( header.magic != PACKET_LOG_MAGIC ) || ( header.version != PACKET_LOG_VERSION )
+        || ( header.headerBytes < sizeof( sPacketLogHeader ) ) || ( header.headerBytes > mBytes ) )
+    {
+        Close();
+        errno = EPROTO;
+        return false;
+    }
+    // A segment that was not closed ends at its first PacketRecord_End
+    mEnd = mBytes;
+    if( header.recordBytes > 0 )
+    {
+        mEnd = (size_t) std::min( (uint64_t) mBytes, header.headerBytes + header.recordBytes );
+    }
+    Rewind();
+    return true;
+}
+
+void PacketLogReader::Close()
+{
+    if( mpData )
+    {
+        munmap( const_cast<char*>( mpData ), mBytes );
+        mpData = nullptr;
+        mBytes = 0;
+        mEnd = 0;
+        mOffset = 0;
+    }
+}
+
+#else
+
+bool PacketRecorder::SegmentsExist() const { return false; }
+bool PacketRecorder::OpenSegment() { mError.store( ENOSYS ); errno = ENOSYS; return false; }
+void PacketRecorder::CloseSegment() {}
+
+PacketLogReader::PacketLogReader() : mpData( nullptr ), mBytes( 0 ), mEnd( 0 ), mOffset( 0 ) {}
+PacketLogReader::~PacketLogReader() {}
+bool PacketLogReader::Open( const char* ) { errno = ENOSYS; return false; }
+void PacketLogReader::Close() {}
+
+#endif
+
+bool PacketLogReader::Next( const sPacketRecordHeader*& pRecord, const char*& pData )
+{
+    if( !mpData || ( mOffset + sizeof( sPacketRecordHeader ) > mEnd ) )
+    {
+        return false;
+    }
+    const sPacketRecordHeader* pHeader = reinterpret_cast<const sPacketRecordHeader*>( mpData + mOffset );
+    if( ( pHeader->type == PacketRecord_End ) || ( pHeader->length > mEnd - mOffset - sizeof( sPacketRecordHeader ) ) )
+    {
+        mOffset = mEnd;
+        return false;
+    }
+    pRecord = pHeader;
+    pData = mpData + mOffset + sizeof( sPacketRecordHeader );
+    mOffset += (size_t) AlignUp( sizeof( sPacketRecordHeader ) + pHeader->length );
+    return true;
+}
+
+void PacketLogReader::Rewind()
+{
+    mOffset = mpData ? Header().headerBytes : 0;
+}
@@ -0,0 +1,248 @@
+//=============================================================================
+// PacketRecorder.h
+// ~~~~~~~~~~~~~~~~
+//
+// Recording of a NatNet stream as it was received: the raw datagrams with
+// their receive time and the NatNet version of the stream, and the data
+// descriptions in effect, appended to memory-mapped segment files. The
+// receiving thread only copies each datagram into a queue in memory; a
+// flusher thread moves the records into the current segment, and starts the
+// next segment when one is full. PacketLogReader reads the segments back.
+//=============================================================================
+
+#pragma once
+
+#include <NatNetTypes.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// First bytes of a segment ( "NNPL" ), and the version of its format
+#define PACKET_LOG_MAGIC                0x4C504E4E
+#define PACKET_LOG_VERSION              1
+
+// Records start at multiples of this, in the queue and in segments
+#define PACKET_LOG_ALIGNMENT            16
+
+// Size of a segment unless set otherwise, and the smallest one
+#define PACKET_LOG_SEGMENT_BYTES        ( 1024ull * 1024 * 1024 )
+#define PACKET_LOG_SEGMENT_BYTES_MIN    ( 1024ull * 1024 )
+
+// Queue between the receiving thread and the flusher unless set otherwise:
+// a second of 64 KB frames at 1 kHz
+#define PACKET_LOG_QUEUE_BYTES          ( 64u * 1024 * 1024 )
+
+// How often the flusher moves the queued records into the segment
+#define PACKET_LOG_FLUSH_INTERVAL_MS    5
+
+/**
+ * \brief Start of a segment file, followed by the records.
+ * A segment is created at its full size and truncated to its records when it
+ * is closed; the records of a segment that was not closed end at the first
+ * record of type PacketRecord_End ( the zeros of the unwritten part ).
+ */
+typedef struct sPacketLogHeader
+{
+    uint32_t magic;                         // PACKET_LOG_MAGIC
+    uint32_t version;                       // PACKET_LOG_VERSION
+    uint32_t headerBytes;                   // offset of the first record
+    uint32_t segment;                       // index of the segment in the recording, from 0
+    int64_t created;                        // CLOCK_REALTIME nanoseconds
+    uint64_t recordBytes;                   // bytes of records, 0 until the segment is closed
+} sPacketLogHeader;
+
+enum PacketRecordType
+{
+    PacketRecord_End = 0,                   // no more records in the segment
+    PacketRecord_Datagram,                  // a datagram of the data stream, as received
+    PacketRecord_ModelDef                   // NAT_MODELDEF packet now in effect; also first in every later segment
+};
+
+// The datagram was cut to the size of the receive buffer
+#define PACKET_RECORD_TRUNCATED         0x01
+
+/**
+ * \brief Start of a record, followed by the packet and padding to PACKET_LOG_ALIGNMENT.
+ */
+typedef struct sPacketRecordHeader
+{
+    uint32_t length;                        // bytes of the packet
+    uint8_t type;                           // PacketRecordType
+    uint8_t flags;                          // PACKET_RECORD_*
+    uint8_t major;                          // NatNet version of the stream when the packet arrived, 0 if not known yet
+    uint8_t minor;
+    int64_t received;                       // kernel receive timestamp ( CLOCK_REALTIME ns ), or when the packet was read; 0 if not measured
+} sPacketRecordHeader;
+
+static_assert( sizeof( sPacketRecordHeader ) == PACKET_LOG_ALIGNMENT, "record headers keep the packets aligned" );
+
+/**
+ * \brief Counters of a PacketRecorder.
+ */
+typedef struct sPacketRecorderCounters
+{
+    uint64_t nRecords;                      // records written to segments
+    uint64_t nBytes;                        // bytes of records written
+    uint64_t nDropped;                      // packets not recorded: the queue was full, or a segment could not be written
+    uint64_t nSegments;                     // segments started
+    uint64_t maxQueued;                     // most bytes waiting for the flusher
+} sPacketRecorderCounters;
+
+/**
+ * \brief Appends packets to <path>.0000, <path>.0001, ...
+ * Record and RecordModelDef are called from one thread ( the receiving
+ * thread ) and never wait: they copy the packet into the queue, or drop it
+ * when the queue is full. Everything else happens on the flusher thread.
+ */
+class PacketRecorder
+{
+public:
+    PacketRecorder();
+
+    /**
+     * \brief Stop, see Stop.
+     */
+    ~PacketRecorder();
+
+    PacketRecorder( const PacketRecorder& ) = delete;
+    PacketRecorder& operator=( const PacketRecorder& ) = delete;
+
+    /**
+     * \brief Create the first segment and start the flusher.
+     * Fails with EEXIST if any segment of path exists already: files are never overwritten.
+     * \param segmentBytes - size at which a segment is closed and the next one started
+     * \param queueBytes - memory between the receiving thread and the flusher, rounded up to a power of 2
+     * \return - false with errno set if the first segment could not be created
+     */
+    bool Start( const char* path, uint64_t segmentBytes = PACKET_LOG_SEGMENT_BYTES,
+        size_t queueBytes = PACKET_LOG_QUEUE_BYTES );
+
+    /**
+     * \brief Queue a datagram of the data stream.
+     * \param received - see sPacketRecordHeader::received
+     * \param major, minor - NatNet version of the stream, 0 if not known yet
+     * \param truncated - the datagram did not fit the receive buffer
+     * \return - false if it was dropped
+     */
+    bool Record( const char* pData, size_t length, int64_t received, int major, int minor, bool truncated = false );
+
+    /**
+     * \brief Queue the data descriptions now in effect ( a NAT_MODELDEF packet ).
+     * They are written again at the start of every later segment, so that each
+     * segment can be read on its own.
+     */
+    bool RecordModelDef( const char* pData, size_t length, int64_t received, int major, int minor );
+
+    /**
+     * \brief Write the records queued so far, close the segment and join the flusher.
+     */
+    void Stop();
+
+    bool IsRecording() const { return mThread.joinable(); }
+
+    /**
+     * \brief Path of segment i.
+     */
+    std::string SegmentPath( uint32_t segment ) const;
+
+    sPacketRecorderCounters Counters() const;
+
+    /**
+     * \brief errno of the last segment that could not be created or written, 0 if none.
+     */
+    int Error() const { return mError.load( std::memory_order_relaxed ); }
+
+    /**
+     * \brief The next segment could not be created: the recording stopped there, and
+     * Record drops every packet. See Error.
+     */
+    bool Failed() const { return mFailed.load( std::memory_order_relaxed ); }
+
+private:
+    bool Queue( uint8_t type, uint8_t flags, const char* pData, size_t length, int64_t received, int major, int minor );
+    void Flush();
+    void WriteQueued();
+    void WriteRecord( const sPacketRecordHeader& header, const char* pData );
+    bool SegmentsExist() const;
+    bool OpenSegment();
+    void CloseSegment();
+
+    // Queue: records from mTail to mHead, positions counted from the start
+    std::vector<char> mQueue;
+    size_t mMask;
+    std::atomic<uint64_t> mHead;            // written by the recording thread only
+    std::atomic<uint64_t> mTail;            // written by the flusher only
+
+    // Current segment, flusher only
+    std::string mPath;
+    uint64_t mSegmentBytes;
+    uint32_t mSegment;                      // index of the next segment to open
+    int mFd;
+    char* mpSegment;                        // mapped segment, nullptr if none is open
+    uint64_t mUsed;                         // bytes of the segment written, header included
+    bool mHaveModelDef;
+    sPacketRecordHeader mModelDefHeader;
+    std::vector<char> mModelDef;            // written at the start of every segment
+
+    std::mutex mMutex;                      // the flusher sleeps on mWake between flushes
+    std::condition_variable mWake;
+    std::atomic<bool> mStop;
+    std::atomic<bool> mFailed;              // set by the flusher
+    std::thread mThread;
+
+    std::atomic<uint64_t> mnRecords;
+    std::atomic<uint64_t> mnBytes;
+    std::atomic<uint64_t> mnDropped;
+    std::atomic<uint64_t> mnSegments;
+    std::atomic<uint64_t> mMaxQueued;
+    std::atomic<int> mError;
+};
+
+/**
+ * \brief Reads the records of one segment, in place.
+ */
+class PacketLogReader
+{
+public:
+    PacketLogReader();
+    ~PacketLogReader();
+
+    PacketLogReader( const PacketLogReader& ) = delete;
+    PacketLogReader& operator=( const PacketLogReader& ) = delete;
+
+    /**
+     * \brief Map a segment.
+     * \return - false with errno set if it cannot be read, EPROTO if it is not a segment of this version
+     */
+    bool Open( const char* path );
+
+    void Close();
+
+    bool IsOpen() const { return mpData != nullptr; }
+
+    const sPacketLogHeader& Header() const { return *reinterpret_cast<const sPacketLogHeader*>( mpData ); }
+
+    /**
+     * \brief Next record of the segment.
+     * \param pRecord, pData - out: header and packet of the record, valid while the reader is open
+     * \return - false after the last record
+     */
+    bool Next( const sPacketRecordHeader*& pRecord, const char*& pData );
+
+    /**
+     * \brief Read from the first record again.
+     */
+    void Rewind();
+
+private:
+    const char* mpData;
+    size_t mBytes;                          // mapped
+    size_t mEnd;                            // of the records
+    size_t mOffset;                         // of the next record
+};
@@ -0,0 +1,52 @@
+//
+// ReceiveStats.h
+// ~~~~~~~~~~~~~~
+//
+// Counters of the data socket, reported per frame over an interval so the
+// cost of the receive path (system calls, wakeups, CPU time) can be compared
+// between receive modes.
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <stdio.h>
+#include <sys/resource.h>
+
+// User plus system CPU time of the process.
+inline std::chrono::microseconds process_cpu_time()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+    + std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+struct receive_stats
+{
+  std::uint64_t wakeups = 0;        // receive completion handlers run
+  std::uint64_t receive_calls = 0;  // recvfrom / recvmmsg / io_uring_enter system calls
+  std::uint64_t datagrams = 0;
+  std::uint64_t frames = 0;
+  std::chrono::microseconds cpu_time{0};
+};
+
+// Print the per-frame costs between two snapshots of the counters.
+inline void print_receive_stats(std::ostream& out,
+    const receive_stats& begin, const receive_stats& end)
+{
+  std::uint64_t frames = end.frames - begin.frames;
+  std::uint64_t datagrams = end.datagrams - begin.datagrams;
+  double per_frame = frames ? 1.0 / frames : 0.0;
+  char line[256];
+  snprintf(line, sizeof(line),
+      "receive: %llu frames, %llu datagrams, %.3f syscalls/frame, "
+      "%.3f wakeups/frame, %.2f us CPU/frame",
+      (unsigned long long)frames, (unsigned long long)datagrams,
+      (end.receive_calls - begin.receive_calls) * per_frame,
+      (end.wakeups - begin.wakeups) * per_frame,
+      (end.cpu_time - begin.cpu_time).count() * per_frame);
+  out << line << std::endl;
+}
@@ -0,0 +1,765 @@
+//
+// Repeater.cpp
+// ~~~~~~~~~~~~
+//
+// natnetRepeater: receives a NatNet data stream with the open-source receive
+// path and re-streams it to other subnets or to unicast targets. Datagrams of
+// up to SUBPACKET_MAX_SIZE bytes are forwarded as they are; larger ones are
+// split into NAT_SUBPACKET datagrams, which packetClient reassembles. Only
+// the packet headers are read: everything goes out from the receive buffers,
+// with one sendmmsg per received batch. A target may instead take a filtered
+// stream: each frame is then decoded once and re-encoded per target with only
+// the rigid bodies, skeletons, assets and markers it selected, in the NatNet
+// version it decodes, or in the compact stream format ( CompactStream.h )
+// for a link with little bandwidth.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CommandClient.h"
+#include "CompactStream.h"
+#include "DatagramBatch.h"
+#include "DecoderContext.h"
+#include "FrameEncoder.h"
+#include "NatNetDecoder.h"
+#include "SubPackets.h"
+
+constexpr const char* MULTICAST_ADDRESS = "239.255.42.99";
+constexpr int PORT_COMMAND = 1510;
+constexpr unsigned short PORT_DATA = 1511;
+
+// Give up on a server that does not answer NAT_CONNECT.
+const retry_policy CONNECT_POLICY = { 3, std::chrono::milliseconds(1000) };
+
+// Interval of the NAT_KEEPALIVE messages that keep a unicast stream going.
+constexpr std::chrono::milliseconds KEEPALIVE_INTERVAL(1000);
+
+// Datagrams received per wakeup, and datagrams sent per sendmmsg.
+constexpr std::size_t RECEIVE_BATCH = 32;
+constexpr std::size_t SEND_BATCH = 256;
+
+// Filtered frames encoded per send batch before it is flushed.
+constexpr std::size_t ENCODE_BUFFER_SIZE = 4 * MAX_PACKETSIZE;
+
+// Interval of the --stats reports.
+constexpr std::chrono::seconds STATS_INTERVAL(5);
+
+using boost::asio::ip::udp;
+
+struct repeat_target
+{
+  udp::endpoint endpoint;
+  // Frames are re-encoded with only what the filter selects; other
+  // datagrams are forwarded as they are.
+  bool filtered = false;
+  bool selects = false;     // else the whole frame, e.g. for --bitstream
+  FrameFilter filter;
+  // Bitstream version the target decodes; 0 for that of the stream.
+  int major = 0;
+  int minor = 0;
+  // Compact frames instead, encoded against the previous frame sent to this
+  // target.
+  std::shared_ptr<CompactStreamEncoder> compact;
+};
+
+struct forward_stats
+{
+  std::uint64_t datagrams = 0;      // received
+  std::uint64_t frames = 0;         // of which NAT_FRAMEOFDATA
+  std::uint64_t split = 0;          // larger than SUBPACKET_MAX_SIZE
+  std::uint64_t encoded = 0;        // filtered frames, one per target
+  std::uint64_t undecoded = 0;      // frames not sent to filtered targets
+  std::uint64_t sent = 0;           // datagrams sent, subpackets included
+  std::uint64_t send_errors = 0;    // datagrams not sent
+  std::uint64_t send_calls = 0;
+  std::chrono::nanoseconds forward_time{0};     // from receive to sent
+  std::chrono::nanoseconds max_batch_time{0};
+};
+
+class repeater
+{
+public:
+  // commands: the connection of a unicast stream, whose frames arrive on
+  // its socket; nullptr to join the multicast group. major, minor: NatNet
+  // version of the stream, needed only to filter frames.
+  repeater(boost::asio::io_context& io_context,
+      command_client* commands,
+      const udp::endpoint& multicast,
+      const std::vector<repeat_target>& targets,
+      int major, int minor,
+      int ttl,
+      const boost::asio::ip::address& interface,
+      bool print_stats)
+    : socket_(io_context)
+    , data_socket_(nullptr)
+    , send_socket_(io_context, udp::endpoint(udp::v4(), 0))
+    , commands_(commands)
+    , targets_(targets)
+    , receive_(RECEIVE_BATCH, MAX_PACKETSIZE)
+    , send_(SEND_BATCH)
+    , sequence_(0)
+    , context_(major, minor)
+    , filtering_(false)
+    , encoded_size_(0)
+    , keepalive_timer_(io_context)
+    , stats_timer_(io_context)
+    , print_stats_(print_stats)
+  {
+    for (repeat_target& target : targets_)
+    {
+      if (target.major == 0)
+      {
+        target.major = major;
+        target.minor = minor;
+      }
+      filtering_ = filtering_ || target.filtered;
+    }
+    if (filtering_)
+    {
+      frame_.reset(new sDecodedFrame());
+      encoded_.resize(ENCODE_BUFFER_SIZE);
+    }
+
+    if (commands_)
+    {
+      data_socket_ = &commands_->socket();
+      commands_->stop_receiving();
+      command_client::build_request(NAT_KEEPALIVE, keepalive_);
+      send_keepalive();
+    }
+    else
+    {
+      udp::endpoint listen_endpoint(
+          boost::asio::ip::address::from_string("0.0.0.0"), multicast.port());
+      socket_.open(listen_endpoint.protocol());
+      socket_.set_option(udp::socket::reuse_address(true));
+      socket_.bind(listen_endpoint);
+      socket_.set_option(
+          boost::asio::ip::multicast::join_group(multicast.address()));
+      data_socket_ = &socket_;
+    }
+
+    // Multicast targets: leave the subnet only if asked to, and never loop
+    // back into a group this repeater may be listening to.
+    send_socket_.set_option(boost::asio::ip::multicast::hops(ttl));
+    send_socket_.set_option(boost::asio::ip::multicast::enable_loopback(false));
+    if (!interface.is_unspecified())
+    {
+      send_socket_.set_option(boost::asio::ip::multicast::outbound_interface(
+          interface.to_v4()));
+    }
+    send_.enable_segmentation(send_socket_);
+
+    do_receive();
+    if (print_stats_)
+    {
+      report_stats();
+    }
+  }
+
+private:
+  void do_receive()
+  {
+    data_socket_->async_wait(udp::socket::wait_read,
+        [this](boost::system::error_code ec)
+        {
+          if (ec)
+          {
+            std::cerr << "async_wait error: " << ec.message() << std::endl;
+            return;
+          }
+
+          std::size_t count = 0;
+          do
+          {
+            count = receive_.receive(*data_socket_, ec);
+            if (ec && ec != boost::asio::error::would_block)
+            {
+              std::cerr << "receive error: " << ec.message() << std::endl;
+              return;
+            }
+            forward_batch(count);
+          }
+          while (count == receive_.capacity());
+          do_receive();
+        });
+  }
+
+  // Queue every datagram of the batch for every target, then send.
+  void forward_batch(std::size_t count)
+  {
+    if (count == 0)
+    {
+      return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      const char* data = receive_.data(i);
+      std::size_t length = receive_.length(i);
+
+      // The replies to this repeater's own requests stay here.
+      if (commands_ && !is_frame(data, length)
+          && commands_->handle_reply(data, length))
+      {
+        continue;
+      }
+      bool frame = is_frame(data, length);
+      ++stats_.datagrams;
+      stats_.frames += frame;
+      if (receive_.truncated(i))
+      {
+        continue;
+      }
+      stats_.split += (length > SUBPACKET_MAX_SIZE);
+
+      const sFrameOfMocapData* decoded = nullptr;
+      if (frame && filtering_)
+      {
+        decoded = decode(data, length);
+      }
+      std::uint32_t sequence = sequence_++;
+      for (const repeat_target& target : targets_)
+      {
+        if (frame && target.filtered)
+        {
+          if (decoded)
+          {
+            forward_filtered(target, sequence, *decoded);
+          }
+        }
+        else
+        {
+          forward(target.endpoint, sequence, data, length);
+        }
+      }
+    }
+    flush();
+    encoded_size_ = 0;
+
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    stats_.forward_time += elapsed;
+    stats_.max_batch_time = std::max(stats_.max_batch_time, elapsed);
+  }
+
+  // A packet of up to SUBPACKET_MAX_SIZE bytes as it is, a larger one as
+  // subpackets. Target by target, so that the subpackets of a frame to one
+  // target lie next to each other in the batch and go out as one segmented
+  // send.
+  void forward(const udp::endpoint& target, std::uint32_t sequence,
+      const char* data, std::size_t length)
+  {
+    if (length <= SUBPACKET_MAX_SIZE)
+    {
+      queue(target, nullptr, 0, data, length);
+      return;
+    }
+    int count = SubPacketCount(length);
+    for (int index = 0; index < count; ++index)
+    {
+      sSubPacketHeader header;
+      std::size_t offset = 0;
+      std::size_t size = 0;
+      MakeSubPacketHeader(sequence, length, index, header, offset, size);
+      queue(target, &header, sizeof(header), data + offset, size);
+    }
+  }
+
+  // Decode a frame for the filtered targets; nullptr if it is malformed or
+  // still in a previous bitstream version.
+  const sFrameOfMocapData* decode(const char* data, std::size_t length)
+  {
+    int message_id = 0;
+    if (context_.HandlePacket(data, length, message_id, frame_.get())
+        != PacketError_None)
+    {
+      ++stats_.undecoded;
+      return nullptr;
+    }
+    return &frame_->data;
+  }
+
+  // Encode the frame for one target into encoded_, where it stays until the
+  // batch is sent.
+  void forward_filtered(const repeat_target& target, std::uint32_t sequence,
+      const sFrameOfMocapData& frame)
+  {
+    if (encoded_.size() - encoded_size_ < MAX_PACKETSIZE)
+    {
+      flush();
+      encoded_size_ = 0;
+    }
+    char* packet = encoded_.data() + encoded_size_;
+    std::size_t length = target.compact
+      ? target.compact->Encode(frame, &target.filter, packet, MAX_PACKETSIZE)
+      : EncodeFramePacket(frame, target.major, target.minor, &target.filter,
+          packet, MAX_PACKETSIZE);
+    if (length == 0)
+    {
+      ++stats_.undecoded;
+      return;
+    }
+    encoded_size_ += length;
+    ++stats_.encoded;
+    forward(target.endpoint, sequence, packet, length);
+  }
+
+  void queue(const udp::endpoint& target, const void* header,
+      std::size_t header_size, const void* body, std::size_t body_size)
+  {
+    if (send_.full())
+    {
+      flush();
+    }
+    send_.add(target, header, header_size, body, body_size);
+  }
+
+  void flush()
+  {
+    std::size_t queued = send_.size();
+    if (queued == 0)
+    {
+      return;
+    }
+    boost::system::error_code ec;
+    std::uint64_t send_calls = send_.send_calls();
+    std::size_t sent = send_.send(send_socket_, ec);
+    stats_.send_calls += send_.send_calls() - send_calls;
+    stats_.sent += sent;
+    if (sent < queued)
+    {
+      if (stats_.send_errors == 0)
+      {
+        std::cerr << "send error: " << ec.message() << std::endl;
+      }
+      stats_.send_errors += queued - sent;
+    }
+  }
+
+  static bool is_frame(const char* data, std::size_t length)
+  {
+    int messageID = 0;
+    int nBytes = 0;
+    if (length >= 4)
+    {
+      DecodePacketHeader(data, messageID, nBytes);
+    }
+    return messageID == NAT_FRAMEOFDATA;
+  }
+
+  // A unicast server stops streaming to a client it has not heard from for
+  // a while.
+  void send_keepalive()
+  {
+    commands_->send(keepalive_);
+    keepalive_timer_.expires_after(KEEPALIVE_INTERVAL);
+    keepalive_timer_.async_wait(
+        [this](boost::system::error_code ec)
+        {
+          if (!ec)
+          {
+            send_keepalive();
+          }
+        });
+  }
+
+  void report_stats()
+  {
+    stats_timer_.expires_after(STATS_INTERVAL);
+    stats_timer_.async_wait(
+        [this](boost::system::error_code ec)
+        {
+          if (ec)
+          {
+            return;
+          }
+          const forward_stats& a = reported_stats_;
+          const forward_stats& b = stats_;
+          std::uint64_t datagrams = b.datagrams - a.datagrams;
+          double per_datagram = datagrams ? 1.0 / datagrams : 0.0;
+          char line[256];
+          snprintf(line, sizeof(line),
+              "forward: %llu datagrams (%llu frames, %llu split), "
+              "%llu filtered frames encoded, %llu not decoded, %llu sent, "
+              "%llu send errors, %.3f send calls/datagram, "
+              "%.2f us/datagram, max %.1f us/batch",
+              (unsigned long long)datagrams,
+              (unsigned long long)(b.frames - a.frames),
+              (unsigned long long)(b.split - a.split),
+              (unsigned long long)(b.encoded - a.encoded),
+              (unsigned long long)(b.undecoded - a.undecoded),
+              (unsigned long long)(b.sent - a.sent),
+              (unsigned long long)(b.send_errors - a.send_errors),
+              (b.send_calls - a.send_calls) * per_datagram,
+              (b.forward_time - a.forward_time).count() / 1e3 * per_datagram,
+              b.max_batch_time.count() / 1e3);
+          std::cerr << line << std::endl;
+          stats_.max_batch_time = std::chrono::nanoseconds(0);
+          reported_stats_ = stats_;
+          report_stats();
+        });
+  }
+
+  udp::socket socket_;
+  // The multicast socket_, or the command socket of a unicast stream.
+  udp::socket* data_socket_;
+  udp::socket send_socket_;
+  command_client* commands_;
+  std::vector<repeat_target> targets_;
+  datagram_batch receive_;
+  send_batch send_;
+  std::uint32_t sequence_;
+  DecoderContext context_;
+  bool filtering_;
+  std::unique_ptr<sDecodedFrame> frame_;
+  // Filtered frames of the batch being sent, encoded_size_ bytes used.
+  std::vector<char> encoded_;
+  std::size_t encoded_size_;
+  std::vector<char> keepalive_;
+  boost::asio::steady_timer keepalive_timer_;
+  forward_stats stats_;
+  forward_stats reported_stats_;
+  boost::asio::steady_timer stats_timer_;
+  bool print_stats_;
+};
+
+// <address>[:<port>], the data port by default.
+static bool parse_endpoint(const std::string& text, unsigned short default_port,
+    udp::endpoint& endpoint)
+{
+  std::string address = text;
+  unsigned short port = default_port;
+  std::size_t colon = text.rfind(':');
+  if (colon != std::string::npos)
+  {
+    address = text.substr(0, colon);
+    long value = strtol(text.c_str() + colon + 1, nullptr, 10);
+    if (value < 1 || value > 65535)
+    {
+      return false;
+    }
+    port = static_cast<unsigned short>(value);
+  }
+  boost::system::error_code ec;
+  boost::asio::ip::address ip = boost::asio::ip::make_address(address, ec);
+  endpoint = udp::endpoint(ip, port);
+  return !ec && ip.is_v4();
+}
+
+// <major>.<minor>, e.g. 4.1
+static bool parse_version(const std::string& text, int& major, int& minor)
+{
+  char* end = nullptr;
+  major = static_cast<int>(strtol(text.c_str(), &end, 10));
+  if (*end != '.')
+  {
+    return false;
+  }
+  minor = static_cast<int>(strtol(end + 1, &end, 10));
+  return *end == 0 && major >= 2 && minor >= 0;
+}
+
+// Comma separated list.
+static std::vector<std::string> split_list(const std::string& text)
+{
+  std::vector<std::string> items;
+  std::size_t start = 0;
+  while (start <= text.size())
+  {
+    std::size_t comma = text.find(',', start);
+    if (comma == std::string::npos)
+    {
+      comma = text.size();
+    }
+    items.push_back(text.substr(start, comma - start));
+    start = comma + 1;
+  }
+  return items;
+}
+
+// Comma separated IDs, e.g. 1,2,5.
+static bool parse_ids(const std::string& text, std::vector<int>& ids)
+{
+  for (const std::string& item : split_list(text))
+  {
+    char* end = nullptr;
+    long id = strtol(item.c_str(), &end, 10);
+    if (item.empty() || *end != 0)
+    {
+      return false;
+    }
+    ids.push_back(static_cast<int>(id));
+  }
+  return true;
+}
+
+// Comma separated section names, as FrameSection flags.
+static bool parse_sections(const std::string& text, unsigned int& sections)
+{
+  static const struct { const char* name; unsigned int section; } names[] = {
+    { "markersets", FrameSection_MarkerSets },
+    { "other-markers", FrameSection_OtherMarkers },
+    { "rigid-bodies", FrameSection_RigidBodies },
+    { "skeletons", FrameSection_Skeletons },
+    { "assets", FrameSection_Assets },
+    { "labeled-markers", FrameSection_LabeledMarkers },
+    { "force-plates", FrameSection_ForcePlates },
+    { "devices", FrameSection_Devices },
+    { "all", FrameSection_All },
+  };
+  for (const std::string& item : split_list(text))
+  {
+    bool known = false;
+    for (const auto& entry : names)
+    {
+      if (item == entry.name)
+      {
+        sections |= entry.section;
+        known = true;
+      }
+    }
+    if (!known)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The filter options after a --to apply to that target.
+static bool parse_filter_option(const std::string& option, const char* value,
+    repeat_target& target)
+{
+  std::vector<int> ids;
+  if (option == "--rigid-bodies" && parse_ids(value, ids))
+  {
+    for (int id : ids)
+    {
+      target.filter.SelectRigidBody(id);
+    }
+  }
+  else if (option == "--skeletons" && parse_ids(value, ids))
+  {
+    for (int id : ids)
+    {
+      target.filter.SelectSkeleton(id);
+    }
+  }
+  else if (option == "--assets" && parse_ids(value, ids))
+  {
+    for (int id : ids)
+    {
+      target.filter.SelectAsset(id);
+    }
+  }
+  else if (option == "--markersets")
+  {
+    for (const std::string& name : split_list(value))
+    {
+      target.filter.SelectMarkerSet(name.c_str());
+    }
+  }
+  else if (option == "--keep")
+  {
+    unsigned int sections = 0;
+    if (!parse_sections(value, sections))
+    {
+      return false;
+    }
+    target.filter.SelectSections(sections);
+  }
+  else if (option == "--bitstream")
+  {
+    target.filtered = true;
+    return parse_version(value, target.major, target.minor);
+  }
+  else if (option == "--compact")
+  {
+    // Position resolution in millimeters.
+    char* end = nullptr;
+    sCompactStreamSettings settings;
+    settings.positionResolution = strtof(value, &end) / 1000.0f;
+    target.filtered = true;
+    target.compact = std::make_shared<CompactStreamEncoder>(settings);
+    return *end == 0 && settings.positionResolution > 0.0f;
+  }
+  else
+  {
+    return false;
+  }
+  target.filtered = true;
+  target.selects = true;
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  int status = 0;
+  try
+  {
+    std::vector<repeat_target> targets;
+    std::string server;
+    int major = 0;
+    int minor = 0;
+    udp::endpoint multicast(
+        boost::asio::ip::address::from_string(MULTICAST_ADDRESS), PORT_DATA);
+    int ttl = 1;
+    boost::asio::ip::address interface;
+    bool print_stats = false;
+    bool usage = false;
+    for (int i = 1; i < argc && !usage; ++i)
+    {
+      std::string option = argv[i];
+      if (option == "--to" && i + 1 < argc)
+      {
+        repeat_target target;
+        usage = !parse_endpoint(argv[++i], PORT_DATA, target.endpoint);
+        targets.push_back(target);
+      }
+      else if ((option == "--rigid-bodies" || option == "--skeletons"
+            || option == "--assets" || option == "--markersets"
+            || option == "--keep" || option == "--bitstream"
+            || option == "--compact") && i + 1 < argc)
+      {
+        usage = targets.empty()
+          || !parse_filter_option(option, argv[++i], targets.back());
+      }
+      else if (option == "--model-markers" && !targets.empty())
+      {
+        targets.back().filter.SelectModelMarkers(true);
+        targets.back().filtered = true;
+        targets.back().selects = true;
+      }
+      else if (option == "--natnet-version" && i + 1 < argc)
+      {
+        usage = !parse_version(argv[++i], major, minor);
+      }
+      else if (option == "--server" && i + 1 < argc)
+      {
+        server = argv[++i];
+      }
+      else if (option == "--group" && i + 1 < argc)
+      {
+        usage = !parse_endpoint(argv[++i], PORT_DATA, multicast)
+          || !multicast.address().is_multicast();
+      }
+      else if (option == "--ttl" && i + 1 < argc)
+      {
+        ttl = atoi(argv[++i]);
+        usage = (ttl < 1 || ttl > 255);
+      }
+      else if (option == "--interface" && i + 1 < argc)
+      {
+        boost::system::error_code ec;
+        interface = boost::asio::ip::make_address(argv[++i], ec);
+        usage = ec || !interface.is_v4();
+      }
+      else if (option == "--stats")
+      {
+        print_stats = true;
+      }
+      else
+      {
+        usage = true;
+      }
+    }
+    if (usage || targets.empty())
+    {
+      std::cerr << "Usage: natnetRepeater --to <address>[:<port>] [<filter>] [--to ...]"
+        " [--server <host> | --group <address>[:<port>]] [--natnet-version <major.minor>]"
+        " [--ttl <hops>] [--interface <address>] [--stats]\n"
+        "Filter of the preceding --to: [--rigid-bodies <ids>] [--skeletons <ids>] [--assets <ids>]"
+        " [--markersets <names>] [--model-markers] [--keep <sections>] [--bitstream <major.minor>]"
+        " [--compact <resolution mm>]\n"
+        "Sections: markersets, other-markers, rigid-bodies, skeletons, assets, labeled-markers,"
+        " force-plates, devices, all\n";
+      return 1;
+    }
+    bool filtering = false;
+    for (repeat_target& target : targets)
+    {
+      if (target.filtered && !target.selects)
+      {
+        target.filter.SelectSections(FrameSection_All);
+      }
+      filtering = filtering || target.filtered;
+    }
+    if (filtering && server.empty() && major == 0)
+    {
+      std::cerr << "Filtering a multicast stream needs its --natnet-version\n";
+      return 1;
+    }
+
+    boost::asio::io_context io_context;
+    std::unique_ptr<command_client> commands;
+    std::unique_ptr<repeater> r;
+
+    if (server.empty())
+    {
+      printf("Repeating multicast %s:%d\n",
+          multicast.address().to_string().c_str(), multicast.port());
+      r.reset(new repeater(io_context, nullptr, multicast, targets,
+            major, minor, ttl, interface, print_stats));
+    }
+    else
+    {
+      // A unicast server streams to the socket that connected.
+      udp::resolver resolver(io_context);
+      commands.reset(new command_client(io_context,
+            *resolver.resolve({udp::v4(), server, std::to_string(PORT_COMMAND)})));
+      commands->start_receiving();
+      std::vector<char> connect;
+      command_client::build_request(NAT_CONNECT, connect);
+      commands->request(std::move(connect), NAT_SERVERINFO, CONNECT_POLICY,
+          [&](const boost::system::error_code& ec, const char* reply,
+            std::size_t length)
+          {
+            if (ec)
+            {
+              std::cerr << "No reply to NAT_CONNECT from " << commands->server()
+                << ": " << ec.message() << "\n";
+              status = 1;
+              commands->stop_receiving();
+              return;
+            }
+            // The stream is in the server's NatNet version, unless set.
+            if (major == 0)
+            {
+              DecoderContext server_info;
+              int message_id = 0;
+              server_info.HandlePacket(reply, length, message_id, nullptr);
+              major = server_info.Major();
+              minor = server_info.Minor();
+            }
+            printf("Repeating the unicast stream of %s, NatNet %d.%d\n",
+                commands->server().address().to_string().c_str(), major, minor);
+            r.reset(new repeater(io_context, commands.get(), multicast, targets,
+                  major, minor, ttl, interface, print_stats));
+          });
+    }
+    for (const repeat_target& target : targets)
+    {
+      printf("  to %s:%d%s\n", target.endpoint.address().to_string().c_str(),
+          target.endpoint.port(), target.compact ? ", compact"
+          : target.filtered ? ", filtered" : "");
+    }
+
+    io_context.run();
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << "\n";
+    status = 1;
+  }
+
+  return status;
+}
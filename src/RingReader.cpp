@@ -0,0 +1,149 @@
+//=============================================================================
+// RingReader.cpp
+// ~~~~~~~~~~~~~~
+//
+// Follows the shared memory ring a packetClient --publish writes, as an
+// example consumer: every frame is read in place ( or copied, to print it ),
+// and once a second the frames read, those skipped because the reader fell
+// behind, and the delay from publishing to reading are reported.
+//
+// Usage: frameRingReader <name> [--print]
+//=============================================================================
+
+#include "CompactFrame.h"
+#include "FrameLatency.h"
+#include "FrameVisitor.h"
+#include "SharedFrameRing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Poll interval while no frame is pending, and while waiting for the writer
+static const std::chrono::microseconds kPollInterval( 200 );
+static const std::chrono::milliseconds kOpenInterval( 500 );
+
+struct sReadStats
+{
+    uint64_t nRead;
+    uint64_t nSkipped;                      // overwritten before they were read
+    uint64_t nTorn;                         // overwritten while they were read
+    double delaySum;                        // publish to read, microseconds
+    double delayMax;
+};
+
+int main( int argc, char* argv[] )
+{
+    const char* name = nullptr;
+    bool print = false;
+    bool usage = false;
+    for( int i = 1; i < argc; i++ )
+    {
+        if( strcmp( argv[i], "--print" ) == 0 )
+        {
+            print = true;
+        }
+        else if( !name && ( argv[i][0] != '-' ) )
+        {
+            name = argv[i];
+        }
+        else
+        {
+            usage = true;
+        }
+    }
+    if( usage || !name )
+    {
+        fprintf( stderr, "Usage: frameRingReader <name> [--print]\n" );
+        return 1;
+    }
+
+    SharedFrameReader reader;
+    CompactFrame copy;
+    std::unique_ptr<sFrameOfMocapData> frame( print ? new sFrameOfMocapData() : nullptr );
+    FramePrinter printer;
+    sReadStats stats;
+    memset( &stats, 0, sizeof( stats ) );
+    uint64_t cursor = 0;
+    bool waiting = false;
+    std::chrono::steady_clock::time_point nextReport = std::chrono::steady_clock::now() + std::chrono::seconds( 1 );
+
+    while( true )
+    {
+        // Follow the writer to a new ring when it replaces this one
+        if( reader.WriterClosed() )
+        {
+            if( !reader.Open( name ) )
+            {
+                if( !waiting )
+                {
+                    fprintf( stderr, "waiting for ring %s: %s\n", name, strerror( errno ) );
+                    waiting = true;
+                }
+                std::this_thread::sleep_for( kOpenInterval );
+                continue;
+            }
+            waiting = false;
+            cursor = reader.Published();
+            printf( "ring %s: %u slots, %u frames published\n", name, reader.Slots(), (unsigned) cursor );
+        }
+
+        SharedFrameView view;
+        uint64_t nSkipped = 0;
+        SharedFrameResult result = reader.ReadNext( cursor, view, nSkipped );
+        stats.nSkipped += nSkipped;
+        if( result == SharedFrame_OK )
+        {
+            bool intact = false;
+            if( print )
+            {
+                intact = reader.Copy( view, copy );
+            }
+            else
+            {
+                // In place: touch what a consumer would, then check it was not overwritten meanwhile
+                volatile float sum = 0.0f;
+                const sRigidBodyData* rigidBodies = view.RigidBodies();
+                for( int i = 0; i < view.Counts().nRigidBodies; i++ )
+                {
+                    sum = sum + rigidBodies[i].x + rigidBodies[i].y + rigidBodies[i].z;
+                }
+                intact = reader.Validate( view );
+            }
+            if( !intact )
+            {
+                stats.nTorn++;
+                continue;
+            }
+            double delay = ( RealtimeNanoseconds() - view.Header().published ) / 1000.0;
+            stats.nRead++;
+            stats.delaySum += delay;
+            stats.delayMax = std::max( stats.delayMax, delay );
+            if( print )
+            {
+                copy.CopyTo( *frame );
+                VisitFrame( *frame, printer );
+            }
+        }
+        else
+        {
+            std::this_thread::sleep_for( kPollInterval );
+        }
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if( now >= nextReport )
+        {
+            fprintf( stderr, "read: %llu frames, %llu skipped, %llu torn, delay mean %.1f us, max %.1f us\n",
+                (unsigned long long) stats.nRead, (unsigned long long) stats.nSkipped,
+                (unsigned long long) stats.nTorn, stats.nRead ? stats.delaySum / stats.nRead : 0.0, stats.delayMax );
+            memset( &stats, 0, sizeof( stats ) );
+            nextReport = now + std::chrono::seconds( 1 );
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+//
+// ServerDiscovery.cpp
+// ~~~~~~~~~~~~~~~~~~~
+//
+
+#include "ServerDiscovery.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+
+#if defined(__linux__)
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#endif
+
+using boost::asio::ip::udp;
+
+// Broadcast address of every IPv4 interface that is up, and the address of
+// the loopback interface for a server on this host.
+static std::vector<udp::endpoint> discovery_targets(unsigned short port)
+{
+  std::vector<udp::endpoint> targets;
+#if defined(__linux__)
+  ifaddrs* interfaces = nullptr;
+  if (getifaddrs(&interfaces) == 0)
+  {
+    for (ifaddrs* i = interfaces; i != nullptr; i = i->ifa_next)
+    {
+      if (i->ifa_addr == nullptr || i->ifa_addr->sa_family != AF_INET
+          || !(i->ifa_flags & IFF_UP))
+      {
+        continue;
+      }
+      const sockaddr* target = nullptr;
+      if (i->ifa_flags & IFF_LOOPBACK)
+      {
+        target = i->ifa_addr;
+      }
+      else if ((i->ifa_flags & IFF_BROADCAST) && i->ifa_broadaddr != nullptr)
+      {
+        target = i->ifa_broadaddr;
+      }
+      if (target == nullptr)
+      {
+        continue;
+      }
+      boost::asio::ip::address_v4::bytes_type bytes;
+      memcpy(bytes.data(),
+          &reinterpret_cast<const sockaddr_in*>(target)->sin_addr, bytes.size());
+      udp::endpoint endpoint(boost::asio::ip::address_v4(bytes), port);
+      if (std::find(targets.begin(), targets.end(), endpoint) == targets.end())
+      {
+        targets.push_back(endpoint);
+      }
+    }
+    freeifaddrs(interfaces);
+  }
+#endif
+  if (targets.empty())
+  {
+    targets.push_back(udp::endpoint(boost::asio::ip::address_v4::broadcast(), port));
+  }
+  return targets;
+}
+
+server_discovery::server_discovery(boost::asio::io_context& io_context,
+    server_handler handler, unsigned short command_port)
+  : io_context_(io_context)
+  , socket_(io_context, udp::endpoint(udp::v4(), 0))
+  , timer_(io_context)
+  , handler_(std::move(handler))
+  , command_port_(command_port)
+  , interval_(1000)
+  , data_(MAX_PACKETSIZE)
+  , running_(false)
+{
+  socket_.set_option(boost::asio::socket_base::broadcast(true));
+
+  // The request introduces the client, as NAT_CONNECT does.
+  sSender client;
+  memset(&client, 0, sizeof(client));
+  strncpy(client.szName, "NatNetSDKCrossplatform", MAX_NAMELENGTH - 1);
+  client.NatNetVersion[0] = 4;
+  client.NatNetVersion[1] = 1;
+  std::uint16_t header[2] = { NAT_DISCOVERY, sizeof(client) };
+  request_.resize(4 + sizeof(client));
+  memcpy(request_.data(), header, 4);
+  memcpy(request_.data() + 4, &client, sizeof(client));
+}
+
+void server_discovery::start(std::chrono::milliseconds interval)
+{
+  interval_ = interval;
+  if (running_)
+  {
+    return;
+  }
+  running_ = true;
+  do_receive();
+  broadcast();
+}
+
+void server_discovery::stop()
+{
+  running_ = false;
+  timer_.cancel();
+  socket_.cancel();
+}
+
+void server_discovery::broadcast()
+{
+  for (const udp::endpoint& target : discovery_targets(command_port_))
+  {
+    socket_.async_send_to(boost::asio::buffer(request_), target,
+        [target](boost::system::error_code ec, std::size_t /*length*/)
+        {
+          // Interfaces without a route (e.g. not configured yet) fail here.
+          if (ec && ec != boost::asio::error::operation_aborted)
+          {
+            std::cerr << "NAT_DISCOVERY to " << target << " failed: "
+              << ec.message() << std::endl;
+          }
+        });
+  }
+
+  timer_.expires_after(interval_);
+  timer_.async_wait(
+      [this](boost::system::error_code ec)
+      {
+        if (!ec && running_)
+        {
+          broadcast();
+        }
+      });
+}
+
+void server_discovery::do_receive()
+{
+  socket_.async_receive_from(
+      boost::asio::buffer(data_.data(), data_.size()), sender_,
+      [this](boost::system::error_code ec, std::size_t length)
+      {
+        if (ec)
+        {
+          if (ec != boost::asio::error::operation_aborted)
+          {
+            std::cerr << "discovery socket error: " << ec.message() << std::endl;
+          }
+          return;
+        }
+        handle_reply(length);
+        if (running_)
+        {
+          do_receive();
+        }
+      });
+}
+
+void server_discovery::handle_reply(std::size_t length)
+{
+  std::uint16_t header[2] = { 0, 0 };
+  if (length < 4 + sizeof(sSender))
+  {
+    return;
+  }
+  memcpy(header, data_.data(), 4);
+  if (header[0] != NAT_SERVERINFO)
+  {
+    return;
+  }
+  for (const discovered_server& known : servers_)
+  {
+    if (known.command_endpoint == sender_)
+    {
+      return;
+    }
+  }
+
+  // Servers before NatNet 3 send only the common sSender part.
+  discovered_server server;
+  server.command_endpoint = sender_;
+  memset(&server.info, 0, sizeof(server.info));
+  memcpy(&server.info, data_.data() + 4,
+      std::min<std::size_t>(std::min<std::size_t>(header[1], length - 4),
+        sizeof(server.info)));
+  server.info.Common.szName[MAX_NAMELENGTH - 1] = 0;
+
+  // Connecting a UDP socket only looks up the route.
+  boost::system::error_code ec;
+  udp::socket probe(io_context_);
+  probe.open(udp::v4(), ec);
+  probe.connect(sender_, ec);
+  if (!ec)
+  {
+    server.local_address = probe.local_endpoint(ec).address();
+  }
+
+  servers_.push_back(server);
+  if (handler_)
+  {
+    handler_(servers_.back());
+  }
+}
@@ -0,0 +1,65 @@
+//
+// ServerDiscovery.h
+// ~~~~~~~~~~~~~~~~~
+//
+// Finds NatNet servers on the local networks without knowing their
+// addresses: NAT_DISCOVERY is broadcast to the command port on every
+// interface, and each server answers with a NAT_SERVERINFO describing its
+// data stream.
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include <NatNetTypes.h>
+
+struct discovered_server
+{
+  boost::asio::ip::udp::endpoint command_endpoint;  // where the server answered from
+  boost::asio::ip::address local_address;           // interface that reaches it
+  sSender_Server info;                              // NatNet 3+ fields are 0 for older servers
+};
+
+class server_discovery
+{
+public:
+  // Called on the io_context's thread, once for each new server.
+  typedef std::function<void(const discovered_server& server)> server_handler;
+
+  server_discovery(boost::asio::io_context& io_context, server_handler handler,
+      unsigned short command_port = 1510);
+
+  server_discovery(const server_discovery&) = delete;
+  server_discovery& operator=(const server_discovery&) = delete;
+
+  // Broadcast now and then every interval until stop(). Interfaces are
+  // enumerated again for each broadcast, so networks that come up later
+  // are searched too.
+  void start(std::chrono::milliseconds interval);
+  void stop();
+
+  // Servers found so far, in the order they answered.
+  const std::vector<discovered_server>& servers() const { return servers_; }
+
+private:
+  void broadcast();
+  void do_receive();
+  void handle_reply(std::size_t length);
+
+  boost::asio::io_context& io_context_;
+  boost::asio::ip::udp::socket socket_;
+  boost::asio::steady_timer timer_;
+  server_handler handler_;
+  unsigned short command_port_;
+  std::chrono::milliseconds interval_;
+  std::vector<char> request_;
+  std::vector<char> data_;
+  boost::asio::ip::udp::endpoint sender_;
+  std::vector<discovered_server> servers_;
+  bool running_;
+};
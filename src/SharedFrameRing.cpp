@@ -0,0 +1,554 @@
+//=============================================================================
+// SharedFrameRing.cpp
+// ~~~~~~~~~~~~~~~~~~~
+//
+// Decoded frames published in a POSIX shared memory ring.
+//=============================================================================
+
+#include "SharedFrameRing.h"
+
+#include "FrameLatency.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(MAP_POPULATE)
+#define SHARED_RING_MAP_FLAGS           ( MAP_SHARED | MAP_POPULATE )
+#else
+#define SHARED_RING_MAP_FLAGS           MAP_SHARED
+#endif
+
+static_assert( sizeof( sFrameCapacity ) == 15 * sizeof( int32_t ), "sFrameCapacity is handled as an array of counts" );
+
+static uint32_t AlignUp( size_t bytes, size_t alignment )
+{
+    return (uint32_t) ( ( bytes + alignment - 1 ) / alignment * alignment );
+}
+
+/**
+ * \brief Place the pools of a slot after its header.
+ * \return - bytes of a slot, a multiple of the cache line size
+ */
+static size_t LayoutSlot( const sFrameCapacity& capacity, sSharedFrameLayout& layout )
+{
+    size_t offset = AlignUp( sizeof( sSharedFrameHeader ), 64 );
+    auto place = [&offset]( uint32_t& pool, size_t bytes )
+    {
+        pool = (uint32_t) offset;
+        offset += AlignUp( bytes, 8 );
+    };
+    place( layout.markerSets, capacity.nMarkerSets * sizeof( sCompactMarkerSet ) );
+    place( layout.markerSetMarkers, capacity.nMarkerSetMarkers * 3 * sizeof( float ) );
+    place( layout.names, capacity.nNameBytes );
+    place( layout.otherMarkers, capacity.nOtherMarkers * 3 * sizeof( float ) );
+    place( layout.rigidBodies, capacity.nRigidBodies * sizeof( sRigidBodyData ) );
+    place( layout.skeletons, capacity.nSkeletons * sizeof( sCompactAsset ) );
+    place( layout.skeletonRigidBodies, capacity.nSkeletonBones * sizeof( sRigidBodyData ) );
+    place( layout.assets, capacity.nAssets * sizeof( sCompactAsset ) );
+    place( layout.assetRigidBodies, capacity.nAssetRigidBodies * sizeof( sRigidBodyData ) );
+    place( layout.assetMarkers, capacity.nAssetMarkers * sizeof( sMarker ) );
+    place( layout.labeledMarkers, capacity.nLabeledMarkers * sizeof( sMarker ) );
+    place( layout.forcePlates, capacity.nForcePlates * sizeof( sCompactAnalogDevice ) );
+    place( layout.devices, capacity.nDevices * sizeof( sCompactAnalogDevice ) );
+    place( layout.analogChannels, capacity.nAnalogChannels * sizeof( sCompactAnalogChannel ) );
+    place( layout.analogValues, capacity.nAnalogValues * sizeof( float ) );
+    return AlignUp( offset, 64 );
+}
+
+static bool ValidCapacity( const sFrameCapacity& capacity )
+{
+    int32_t counts[15];
+    memcpy( counts, &capacity, sizeof( counts ) );
+    for( int32_t count : counts )
+    {
+        // Keeps every pool offset within 32 bits
+        if( ( count < 0 ) || ( count > ( 1 << 20 ) ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * \brief Element-wise counts bounded by 0 and capacity.
+ */
+static sFrameCapacity BoundCounts( const sFrameCapacity& counts, const sFrameCapacity& capacity )
+{
+    int32_t values[15];
+    int32_t limits[15];
+    memcpy( values, &counts, sizeof( values ) );
+    memcpy( limits, &capacity, sizeof( limits ) );
+    for( int i = 0; i < 15; i++ )
+    {
+        values[i] = std::min( std::max( values[i], 0 ), limits[i] );
+    }
+    sFrameCapacity bounded;
+    memcpy( &bounded, values, sizeof( bounded ) );
+    return bounded;
+}
+
+/**
+ * \brief Shared memory object name with the leading '/' POSIX asks for.
+ */
+static bool MakeName( const char* name, char* buffer, size_t size )
+{
+    if( !name || !name[0] )
+    {
+        return false;
+    }
+    int length = snprintf( buffer, size, "%s%s", ( name[0] == '/' ) ? "" : "/", name );
+    return ( length > 1 ) && ( (size_t) length < size ) && !strchr( buffer + 1, '/' );
+}
+
+template <class T>
+static void CopyPool( char* pSlot, uint32_t offset, const std::vector<T>& pool )
+{
+    if( !pool.empty() )
+    {
+        memcpy( pSlot + offset, pool.data(), pool.size() * sizeof( T ) );
+    }
+}
+
+template <class T>
+static void AssignPool( std::vector<T>& pool, const T* pElements, int32_t count )
+{
+    pool.assign( pElements, pElements + count );
+}
+
+#if defined(__linux__) || defined(__APPLE__)
+
+/**
+ * \brief Mark the ring under name closed, if there is one, and remove the name.
+ */
+static void RetireRing( const char* name )
+{
+    int fd = shm_open( name, O_RDWR, 0 );
+    if( fd < 0 )
+    {
+        return;
+    }
+    struct stat status;
+    if( ( fstat( fd, &status ) == 0 ) && ( (size_t) status.st_size >= sizeof( sSharedRingHeader ) ) )
+    {
+        void* pMemory = mmap( nullptr, sizeof( sSharedRingHeader ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        if( pMemory != MAP_FAILED )
+        {
+            sSharedRingHeader* pHeader = static_cast<sSharedRingHeader*>( pMemory );
+            if( pHeader->magic.load( std::memory_order_acquire ) == SHARED_RING_MAGIC )
+            {
+                pHeader->closed.store( 1, std::memory_order_release );
+            }
+            munmap( pMemory, sizeof( sSharedRingHeader ) );
+        }
+    }
+    close( fd );
+    shm_unlink( name );
+}
+
+SharedFrameWriter::SharedFrameWriter()
+    : mpHeader( nullptr )
+    , mMappedBytes( 0 )
+    , mPublished( 0 )
+{
+    mName[0] = 0;
+}
+
+SharedFrameWriter::~SharedFrameWriter()
+{
+    Close();
+}
+
+bool SharedFrameWriter::Create( const char* name, const sFrameCapacity& capacity, uint32_t nSlots )
+{
+    Close();
+    if( !MakeName( name, mName, sizeof( mName ) ) || !ValidCapacity( capacity ) || ( nSlots == 0 ) )
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    sSharedFrameLayout layout;
+    size_t slotBytes = LayoutSlot( capacity, layout );
+    size_t headerBytes = AlignUp( sizeof( sSharedRingHeader ), 64 );
+    size_t totalBytes = headerBytes + slotBytes * nSlots;
+    if( ( slotBytes > UINT32_MAX ) || ( ( totalBytes - headerBytes ) / nSlots != slotBytes ) )
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    RetireRing( mName );
+    int fd = shm_open( mName, O_RDWR | O_CREAT | O_EXCL, 0644 );
+    if( fd < 0 )
+    {
+        return false;
+    }
+    void* pMemory = MAP_FAILED;
+    if( ftruncate( fd, (off_t) totalBytes ) == 0 )
+    {
+        pMemory = mmap( nullptr, totalBytes, PROT_READ | PROT_WRITE, SHARED_RING_MAP_FLAGS, fd, 0 );
+    }
+    int error = errno;
+    close( fd );
+    if( pMemory == MAP_FAILED )
+    {
+        shm_unlink( mName );
+        errno = error;
+        return false;
+    }
+
+    // The object is zero filled: every slot sequence says "no frame yet"
+    mpHeader = new( pMemory ) sSharedRingHeader;
+    mMappedBytes = totalBytes;
+    mpHeader->version = SHARED_RING_VERSION;
+    mpHeader->headerBytes = (uint32_t) headerBytes;
+    mpHeader->slotBytes = (uint32_t) slotBytes;
+    mpHeader->nSlots = nSlots;
+    mpHeader->writerPid = (int32_t) getpid();
+    mpHeader->capacity = capacity;
+    mpHeader->layout = layout;
+    mpHeader->closed.store( 0, std::memory_order_relaxed );
+    mpHeader->published.store( 0, std::memory_order_relaxed );
+    for( uint32_t i = 0; i < nSlots; i++ )
+    {
+        new( reinterpret_cast<char*>( mpHeader ) + headerBytes + i * slotBytes ) sSharedFrameHeader();
+    }
+    mPublished = 0;
+
+    mStaging = CompactFrame( capacity );
+    mpHeader->magic.store( SHARED_RING_MAGIC, std::memory_order_release );
+    return true;
+}
+
+void SharedFrameWriter::Close()
+{
+    if( !mpHeader )
+    {
+        return;
+    }
+    mpHeader->closed.store( 1, std::memory_order_release );
+    munmap( mpHeader, mMappedBytes );
+    shm_unlink( mName );
+    mpHeader = nullptr;
+    mMappedBytes = 0;
+    mPublished = 0;
+}
+
+int SharedFrameWriter::Publish( const sFrameOfMocapData& frame, const sFrameTimes& times )
+{
+    if( !mpHeader )
+    {
+        return 0;
+    }
+    int nDropped = mStaging.Assign( frame );
+
+    uint64_t n = mPublished;
+    char* pSlot = reinterpret_cast<char*>( mpHeader ) + mpHeader->headerBytes
+        + ( n % mpHeader->nSlots ) * mpHeader->slotBytes;
+    sSharedFrameHeader* pFrame = reinterpret_cast<sSharedFrameHeader*>( pSlot );
+
+    // Odd while writing; the fence keeps the writes below from moving above it
+    pFrame->sequence.store( 2 * n + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    pFrame->iFrame = mStaging.iFrame;
+    pFrame->params = mStaging.params;
+    pFrame->Timecode = mStaging.Timecode;
+    pFrame->TimecodeSubframe = mStaging.TimecodeSubframe;
+    pFrame->fTimestamp = mStaging.fTimestamp;
+    pFrame->CameraMidExposureTimestamp = mStaging.CameraMidExposureTimestamp;
+    pFrame->CameraDataReceivedTimestamp = mStaging.CameraDataReceivedTimestamp;
+    pFrame->TransmitTimestamp = mStaging.TransmitTimestamp;
+    pFrame->PrecisionTimestampSecs = mStaging.PrecisionTimestampSecs;
+    pFrame->PrecisionTimestampFractionalSecs = mStaging.PrecisionTimestampFractionalSecs;
+    pFrame->times = times;
+    pFrame->published = RealtimeNanoseconds();
+    pFrame->nDropped = nDropped;
+
+    sFrameCapacity& counts = pFrame->counts;
+    counts.nMarkerSets = (int32_t) mStaging.MarkerSets.size();
+    counts.nMarkerSetMarkers = (int32_t) mStaging.MarkerSetMarkers.size() / 3;
+    counts.nNameBytes = (int32_t) mStaging.Names.size();
+    counts.nOtherMarkers = (int32_t) mStaging.OtherMarkers.size() / 3;
+    counts.nRigidBodies = (int32_t) mStaging.RigidBodies.size();
+    counts.nSkeletons = (int32_t) mStaging.Skeletons.size();
+    counts.nSkeletonBones = (int32_t) mStaging.SkeletonRigidBodies.size();
+    counts.nAssets = (int32_t) mStaging.Assets.size();
+    counts.nAssetRigidBodies = (int32_t) mStaging.AssetRigidBodies.size();
+    counts.nAssetMarkers = (int32_t) mStaging.AssetMarkers.size();
+    counts.nLabeledMarkers = (int32_t) mStaging.LabeledMarkers.size();
+    counts.nForcePlates = (int32_t) mStaging.ForcePlates.size();
+    counts.nDevices = (int32_t) mStaging.Devices.size();
+    counts.nAnalogChannels = (int32_t) mStaging.AnalogChannels.size();
+    counts.nAnalogValues = (int32_t) mStaging.AnalogValues.size();
+
+    const sSharedFrameLayout& layout = mpHeader->layout;
+    CopyPool( pSlot, layout.markerSets, mStaging.MarkerSets );
+    CopyPool( pSlot, layout.markerSetMarkers, mStaging.MarkerSetMarkers );
+    CopyPool( pSlot, layout.names, mStaging.Names );
+    CopyPool( pSlot, layout.otherMarkers, mStaging.OtherMarkers );
+    CopyPool( pSlot, layout.rigidBodies, mStaging.RigidBodies );
+    CopyPool( pSlot, layout.skeletons, mStaging.Skeletons );
+    CopyPool( pSlot, layout.skeletonRigidBodies, mStaging.SkeletonRigidBodies );
+    CopyPool( pSlot, layout.assets, mStaging.Assets );
+    CopyPool( pSlot, layout.assetRigidBodies, mStaging.AssetRigidBodies );
+    CopyPool( pSlot, layout.assetMarkers, mStaging.AssetMarkers );
+    CopyPool( pSlot, layout.labeledMarkers, mStaging.LabeledMarkers );
+    CopyPool( pSlot, layout.forcePlates, mStaging.ForcePlates );
+    CopyPool( pSlot, layout.devices, mStaging.Devices );
+    CopyPool( pSlot, layout.analogChannels, mStaging.AnalogChannels );
+    CopyPool( pSlot, layout.analogValues, mStaging.AnalogValues );
+
+    pFrame->sequence.store( 2 * n + 2, std::memory_order_release );
+    mPublished = n + 1;
+    mpHeader->published.store( mPublished, std::memory_order_release );
+    return nDropped;
+}
+
+SharedFrameReader::SharedFrameReader()
+    : mpHeader( nullptr )
+    , mMappedBytes( 0 )
+{
+}
+
+SharedFrameReader::~SharedFrameReader()
+{
+    Close();
+}
+
+bool SharedFrameReader::Open( const char* name )
+{
+    Close();
+    char path[256];
+    if( !MakeName( name, path, sizeof( path ) ) )
+    {
+        errno = EINVAL;
+        return false;
+    }
+    int fd = shm_open( path, O_RDONLY, 0 );
+    if( fd < 0 )
+    {
+        return false;
+    }
+    struct stat status;
+    void* pMemory = MAP_FAILED;
+    size_t size = 0;
+    if( fstat( fd, &status ) == 0 )
+    {
+        size = (size_t) status.st_size;
+        if( size >= sizeof( sSharedRingHeader ) )
+        {
+            pMemory = mmap( nullptr, size, PROT_READ, SHARED_RING_MAP_FLAGS, fd, 0 );
+        }
+        else
+        {
+            errno = EAGAIN;
+        }
+    }
+    int error = errno;
+    close( fd );
+    if( pMemory == MAP_FAILED )
+    {
+        errno = error;
+        return false;
+    }
+
+    // Check everything the views rely on: a slot never reaches past the mapping
+    const sSharedRingHeader* pHeader = static_cast<const sSharedRingHeader*>( pMemory );
+    bool ready = ( pHeader->magic.load( std::memory_order_acquire ) == SHARED_RING_MAGIC );
+    bool valid = ready && ( pHeader->version == SHARED_RING_VERSION )
+        && ( pHeader->headerBytes >= sizeof( sSharedRingHeader ) ) && ( pHeader->nSlots > 0 )
+        && ValidCapacity( pHeader->capacity );
+    if( valid )
+    {
+        sSharedFrameLayout layout;
+        size_t slotBytes = LayoutSlot( pHeader->capacity, layout );
+        valid = ( slotBytes == pHeader->slotBytes ) && ( memcmp( &layout, &pHeader->layout, sizeof( layout ) ) == 0 )
+            && ( (uint64_t) pHeader->headerBytes + (uint64_t) slotBytes * pHeader->nSlots <= size );
+    }
+    if( !valid )
+    {
+        munmap( pMemory, size );
+        errno = ready ? EPROTO : EAGAIN;
+        return false;
+    }
+    mpHeader = pHeader;
+    mMappedBytes = size;
+    return true;
+}
+
+void SharedFrameReader::Close()
+{
+    if( mpHeader )
+    {
+        munmap( const_cast<sSharedRingHeader*>( mpHeader ), mMappedBytes );
+        mpHeader = nullptr;
+        mMappedBytes = 0;
+    }
+}
+
+#else
+
+SharedFrameWriter::SharedFrameWriter() : mpHeader( nullptr ), mMappedBytes( 0 ), mPublished( 0 ) { mName[0] = 0; }
+SharedFrameWriter::~SharedFrameWriter() {}
+bool SharedFrameWriter::Create( const char*, const sFrameCapacity&, uint32_t ) { errno = ENOSYS; return false; }
+void SharedFrameWriter::Close() {}
+int SharedFrameWriter::Publish( const sFrameOfMocapData&, const sFrameTimes& ) { return 0; }
+
+SharedFrameReader::SharedFrameReader() : mpHeader( nullptr ), mMappedBytes( 0 ) {}
+SharedFrameReader::~SharedFrameReader() {}
+bool SharedFrameReader::Open( const char* ) { errno = ENOSYS; return false; }
+void SharedFrameReader::Close() {}
+
+#endif
+
+bool SharedFrameReader::WriterClosed() const
+{
+    return !mpHeader || mpHeader->closed.load( std::memory_order_acquire );
+}
+
+uint64_t SharedFrameReader::Published() const
+{
+    return mpHeader ? mpHeader->published.load( std::memory_order_acquire ) : 0;
+}
+
+uint64_t SharedFrameReader::Oldest() const
+{
+    uint64_t published = Published();
+    return ( mpHeader && ( published >= mpHeader->nSlots ) ) ? published - mpHeader->nSlots + 1 : 0;
+}
+
+SharedFrameResult SharedFrameReader::Read( uint64_t index, SharedFrameView& view ) const
+{
+    if( !mpHeader )
+    {
+        return SharedFrame_NotOpen;
+    }
+    uint64_t published = mpHeader->published.load( std::memory_order_acquire );
+    if( index >= published )
+    {
+        return SharedFrame_NotYet;
+    }
+    // The slot of frame published - nSlots is the one written next
+    if( published - index >= mpHeader->nSlots )
+    {
+        return SharedFrame_Overwritten;
+    }
+
+    const sSharedFrameHeader* pFrame = reinterpret_cast<const sSharedFrameHeader*>(
+        reinterpret_cast<const char*>( mpHeader ) + mpHeader->headerBytes
+        + ( index % mpHeader->nSlots ) * mpHeader->slotBytes );
+    if( pFrame->sequence.load( std::memory_order_acquire ) != 2 * index + 2 )
+    {
+        return SharedFrame_Overwritten;
+    }
+    view.mpHeader = pFrame;
+    view.mpLayout = &mpHeader->layout;
+    view.mIndex = index;
+    view.mCounts = BoundCounts( pFrame->counts, mpHeader->capacity );
+    return SharedFrame_OK;
+}
+
+SharedFrameResult SharedFrameReader::ReadLatest( SharedFrameView& view ) const
+{
+    // Overwritten only when the writer laps the reader between two loads
+    SharedFrameResult result = SharedFrame_NotYet;
+    for( int attempt = 0; attempt < 4; attempt++ )
+    {
+        uint64_t published = Published();
+        if( published == 0 )
+        {
+            return mpHeader ? SharedFrame_NotYet : SharedFrame_NotOpen;
+        }
+        result = Read( published - 1, view );
+        if( result != SharedFrame_Overwritten )
+        {
+            break;
+        }
+    }
+    return result;
+}
+
+SharedFrameResult SharedFrameReader::ReadNext( uint64_t& cursor, SharedFrameView& view, uint64_t& nSkipped ) const
+{
+    nSkipped = 0;
+    SharedFrameResult result = SharedFrame_NotYet;
+    for( int attempt = 0; attempt < 4; attempt++ )
+    {
+        result = Read( cursor, view );
+        if( result == SharedFrame_OK )
+        {
+            cursor++;
+            break;
+        }
+        if( result != SharedFrame_Overwritten )
+        {
+            break;
+        }
+        uint64_t oldest = Oldest();
+        if( oldest <= cursor )
+        {
+            break;
+        }
+        nSkipped += oldest - cursor;
+        cursor = oldest;
+    }
+    return result;
+}
+
+bool SharedFrameReader::Validate( const SharedFrameView& view ) const
+{
+    // Keeps the reads of the frame from moving below the sequence check
+    std::atomic_thread_fence( std::memory_order_acquire );
+    return view.mpHeader && ( view.mpHeader->sequence.load( std::memory_order_relaxed ) == 2 * view.mIndex + 2 );
+}
+
+bool SharedFrameReader::Copy( const SharedFrameView& view, CompactFrame& frame ) const
+{
+    if( !mpHeader || !view.mpHeader )
+    {
+        return false;
+    }
+    frame.Reserve( mpHeader->capacity );
+
+    const sSharedFrameHeader& header = view.Header();
+    frame.iFrame = header.iFrame;
+    frame.params = header.params;
+    frame.Timecode = header.Timecode;
+    frame.TimecodeSubframe = header.TimecodeSubframe;
+    frame.fTimestamp = header.fTimestamp;
+    frame.CameraMidExposureTimestamp = header.CameraMidExposureTimestamp;
+    frame.CameraDataReceivedTimestamp = header.CameraDataReceivedTimestamp;
+    frame.TransmitTimestamp = header.TransmitTimestamp;
+    frame.PrecisionTimestampSecs = header.PrecisionTimestampSecs;
+    frame.PrecisionTimestampFractionalSecs = header.PrecisionTimestampFractionalSecs;
+
+    const sFrameCapacity& counts = view.Counts();
+    AssignPool( frame.MarkerSets, view.MarkerSets(), counts.nMarkerSets );
+    AssignPool( frame.MarkerSetMarkers, view.MarkerSetMarkers(), counts.nMarkerSetMarkers * 3 );
+    AssignPool( frame.Names, view.Names(), counts.nNameBytes );
+    AssignPool( frame.OtherMarkers, view.OtherMarkers(), counts.nOtherMarkers * 3 );
+    AssignPool( frame.RigidBodies, view.RigidBodies(), counts.nRigidBodies );
+    AssignPool( frame.Skeletons, view.Skeletons(), counts.nSkeletons );
+    AssignPool( frame.SkeletonRigidBodies, view.SkeletonRigidBodies(), counts.nSkeletonBones );
+    AssignPool( frame.Assets, view.Assets(), counts.nAssets );
+    AssignPool( frame.AssetRigidBodies, view.AssetRigidBodies(), counts.nAssetRigidBodies );
+    AssignPool( frame.AssetMarkers, view.AssetMarkers(), counts.nAssetMarkers );
+    AssignPool( frame.LabeledMarkers, view.LabeledMarkers(), counts.nLabeledMarkers );
+    AssignPool( frame.ForcePlates, view.ForcePlates(), counts.nForcePlates );
+    AssignPool( frame.Devices, view.Devices(), counts.nDevices );
+    AssignPool( frame.AnalogChannels, view.AnalogChannels(), counts.nAnalogChannels );
+    AssignPool( frame.AnalogValues, view.AnalogValues(), counts.nAnalogValues );
+    return Validate( view );
+}
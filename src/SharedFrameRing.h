@@ -0,0 +1,283 @@
+//=============================================================================
+// SharedFrameRing.h
+// ~~~~~~~~~~~~~~~~~
+//
+// Decoded frames published in a POSIX shared memory ring, for any number of
+// local processes. The writer copies each frame into the next slot and never
+// waits for readers; readers use the frames in place, and a sequence number
+// per slot ( seqlock ) tells them whether the writer has overwritten the
+// slot in the meantime. Neither side makes a system call per frame.
+//=============================================================================
+
+#pragma once
+
+#include <NatNetTypes.h>
+
+#include "CompactFrame.h"
+#include "NatNetDecoder.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Slots of a ring unless set otherwise: half a second of history at 120 Hz
+#define SHARED_RING_SLOTS               64
+
+// First bytes of a ring ( "NNFR" ), and the version of its layout
+#define SHARED_RING_MAGIC               0x52464E4E
+#define SHARED_RING_VERSION             1
+
+static_assert( ATOMIC_LLONG_LOCK_FREE == 2, "the ring is shared between processes: its atomics must be lock free" );
+
+/**
+ * \brief Offsets of the element pools of a slot, in bytes from the start of the slot.
+ * Pools hold the elements of a CompactFrame: rigid bodies are sRigidBodyData,
+ * MarkerSet and other markers x, y, z floats, and so on.
+ */
+typedef struct sSharedFrameLayout
+{
+    uint32_t markerSets;                    // sCompactMarkerSet
+    uint32_t markerSetMarkers;              // float[3]
+    uint32_t names;                         // char
+    uint32_t otherMarkers;                  // float[3]
+    uint32_t rigidBodies;                   // sRigidBodyData
+    uint32_t skeletons;                     // sCompactAsset
+    uint32_t skeletonRigidBodies;           // sRigidBodyData
+    uint32_t assets;                        // sCompactAsset
+    uint32_t assetRigidBodies;              // sRigidBodyData
+    uint32_t assetMarkers;                  // sMarker
+    uint32_t labeledMarkers;                // sMarker
+    uint32_t forcePlates;                   // sCompactAnalogDevice
+    uint32_t devices;                       // sCompactAnalogDevice
+    uint32_t analogChannels;                // sCompactAnalogChannel
+    uint32_t analogValues;                  // float
+} sSharedFrameLayout;
+
+/**
+ * \brief Start of the shared memory object, followed by the slots.
+ */
+typedef struct sSharedRingHeader
+{
+    std::atomic<uint32_t> magic;            // SHARED_RING_MAGIC once the ring is ready
+    uint32_t version;                       // SHARED_RING_VERSION
+    uint32_t headerBytes;                   // offset of the first slot
+    uint32_t slotBytes;
+    uint32_t nSlots;
+    int32_t writerPid;
+    sFrameCapacity capacity;                // elements a slot holds
+    sSharedFrameLayout layout;
+    std::atomic<uint32_t> closed;           // the writer closed or replaced the ring: open it again
+    alignas( 64 ) std::atomic<uint64_t> published;  // frames published so far; frame n is in slot n % nSlots
+} sSharedRingHeader;
+
+/**
+ * \brief Start of a slot: the frame fields, followed by the element pools.
+ */
+typedef struct sSharedFrameHeader
+{
+    std::atomic<uint64_t> sequence;         // 2n + 1 while frame n is written, 2n + 2 once it is
+    int32_t iFrame;
+    int16_t params;
+    int16_t reserved;
+    uint32_t Timecode;
+    uint32_t TimecodeSubframe;
+    double fTimestamp;
+    uint64_t CameraMidExposureTimestamp;
+    uint64_t CameraDataReceivedTimestamp;
+    uint64_t TransmitTimestamp;
+    uint32_t PrecisionTimestampSecs;
+    uint32_t PrecisionTimestampFractionalSecs;
+    sFrameTimes times;                      // client-side receive and decode times
+    int64_t published;                      // when the frame was published ( CLOCK_REALTIME ns )
+    sFrameCapacity counts;                  // elements of this frame in each pool
+    int32_t nDropped;                       // elements that did not fit the slot
+} sSharedFrameHeader;
+
+/**
+ * \brief Result of reading a frame from the ring.
+ */
+enum SharedFrameResult
+{
+    SharedFrame_OK = 0,
+    SharedFrame_NotYet,                     // not published yet
+    SharedFrame_Overwritten,                // no longer in the ring
+    SharedFrame_NotOpen
+};
+
+/**
+ * \brief A frame in the ring, read in place.
+ * The writer may overwrite it at any time: data read through a view is only
+ * known to be intact if SharedFrameReader::Validate returns true after it was
+ * read. The pointers stay valid while the reader is open.
+ */
+class SharedFrameView
+{
+public:
+    SharedFrameView() : mpHeader( nullptr ), mpLayout( nullptr ), mIndex( 0 ), mCounts() {}
+
+    uint64_t Index() const { return mIndex; }
+    const sSharedFrameHeader& Header() const { return *mpHeader; }
+
+    /**
+     * \brief Elements of the frame in each pool, as read with the view and bounded by the
+     * ring capacity: a torn frame yields wrong elements, never reads outside its slot.
+     */
+    const sFrameCapacity& Counts() const { return mCounts; }
+
+    const sCompactMarkerSet* MarkerSets() const { return Pool<sCompactMarkerSet>( mpLayout->markerSets ); }
+    const float* MarkerSetMarkers() const { return Pool<float>( mpLayout->markerSetMarkers ); }
+    const char* Names() const { return Pool<char>( mpLayout->names ); }
+    const float* OtherMarkers() const { return Pool<float>( mpLayout->otherMarkers ); }
+    const sRigidBodyData* RigidBodies() const { return Pool<sRigidBodyData>( mpLayout->rigidBodies ); }
+    const sCompactAsset* Skeletons() const { return Pool<sCompactAsset>( mpLayout->skeletons ); }
+    const sRigidBodyData* SkeletonRigidBodies() const { return Pool<sRigidBodyData>( mpLayout->skeletonRigidBodies ); }
+    const sCompactAsset* Assets() const { return Pool<sCompactAsset>( mpLayout->assets ); }
+    const sRigidBodyData* AssetRigidBodies() const { return Pool<sRigidBodyData>( mpLayout->assetRigidBodies ); }
+    const sMarker* AssetMarkers() const { return Pool<sMarker>( mpLayout->assetMarkers ); }
+    const sMarker* LabeledMarkers() const { return Pool<sMarker>( mpLayout->labeledMarkers ); }
+    const sCompactAnalogDevice* ForcePlates() const { return Pool<sCompactAnalogDevice>( mpLayout->forcePlates ); }
+    const sCompactAnalogDevice* Devices() const { return Pool<sCompactAnalogDevice>( mpLayout->devices ); }
+    const sCompactAnalogChannel* AnalogChannels() const { return Pool<sCompactAnalogChannel>( mpLayout->analogChannels ); }
+    const float* AnalogValues() const { return Pool<float>( mpLayout->analogValues ); }
+
+private:
+    friend class SharedFrameReader;
+
+    template <class T>
+    const T* Pool( uint32_t offset ) const
+    {
+        return reinterpret_cast<const T*>( reinterpret_cast<const char*>( mpHeader ) + offset );
+    }
+
+    const sSharedFrameHeader* mpHeader;
+    const sSharedFrameLayout* mpLayout;
+    uint64_t mIndex;
+    sFrameCapacity mCounts;
+};
+
+/**
+ * \brief Publishes frames into a shared memory ring. One writer per ring; Publish
+ * must be called from one thread at a time.
+ */
+class SharedFrameWriter
+{
+public:
+    SharedFrameWriter();
+    ~SharedFrameWriter();
+
+    SharedFrameWriter( const SharedFrameWriter& ) = delete;
+    SharedFrameWriter& operator=( const SharedFrameWriter& ) = delete;
+
+    /**
+     * \brief Create the ring, replacing an open one or one left behind under the same name
+     * ( whose readers see it closed ). All memory is allocated and touched here.
+     * \param name - shared memory object name, e.g. "/natnet"; a leading '/' is added if missing
+     * \param capacity - elements each slot holds, see FrameCapacityFromDescriptions
+     * \param nSlots - frames of history
+     * \return - false on failure, with errno set
+     */
+    bool Create( const char* name, const sFrameCapacity& capacity, uint32_t nSlots = SHARED_RING_SLOTS );
+
+    /**
+     * \brief Mark the ring closed for its readers and remove its name.
+     */
+    void Close();
+
+    bool IsOpen() const { return mpHeader != nullptr; }
+
+    const sFrameCapacity& Capacity() const { return mpHeader->capacity; }
+
+    /**
+     * \brief Copy a frame into the next slot. Never blocks and never allocates.
+     * \return - # of elements that did not fit the slot capacity
+     */
+    int Publish( const sFrameOfMocapData& frame, const sFrameTimes& times );
+
+    uint64_t Published() const { return mPublished; }
+
+private:
+    sSharedRingHeader* mpHeader;
+    size_t mMappedBytes;
+    char mName[256];
+    uint64_t mPublished;
+    CompactFrame mStaging;                  // frames are flattened here, then copied into their slot
+};
+
+/**
+ * \brief Reads frames from a shared memory ring without locks and without
+ * affecting the writer or the other readers.
+ */
+class SharedFrameReader
+{
+public:
+    SharedFrameReader();
+    ~SharedFrameReader();
+
+    SharedFrameReader( const SharedFrameReader& ) = delete;
+    SharedFrameReader& operator=( const SharedFrameReader& ) = delete;
+
+    /**
+     * \brief Map the ring read-only.
+     * \param name - name given to SharedFrameWriter::Create
+     * \return - false if there is no ready ring of a compatible layout under that name, with errno set
+     */
+    bool Open( const char* name );
+
+    void Close();
+
+    bool IsOpen() const { return mpHeader != nullptr; }
+
+    /**
+     * \brief The writer closed the ring or replaced it with a new one; Open again to follow it.
+     */
+    bool WriterClosed() const;
+
+    /**
+     * \brief Frames published so far; the newest is Published() - 1.
+     */
+    uint64_t Published() const;
+
+    /**
+     * \brief Oldest frame in the ring. The slot of the frame before it is being written.
+     */
+    uint64_t Oldest() const;
+
+    uint32_t Slots() const { return mpHeader ? mpHeader->nSlots : 0; }
+
+    const sFrameCapacity& Capacity() const { return mpHeader->capacity; }
+
+    /**
+     * \brief View frame index of the ring ( not the frame number of the stream ).
+     */
+    SharedFrameResult Read( uint64_t index, SharedFrameView& view ) const;
+
+    /**
+     * \brief View the newest frame.
+     */
+    SharedFrameResult ReadLatest( SharedFrameView& view ) const;
+
+    /**
+     * \brief View the frame at cursor and advance the cursor. A reader that fell
+     * behind by more than the ring skips to the oldest frame still there.
+     * \param cursor - next frame to read, start at Oldest() or Published()
+     * \param nSkipped - output frames skipped because they were overwritten
+     */
+    SharedFrameResult ReadNext( uint64_t& cursor, SharedFrameView& view, uint64_t& nSkipped ) const;
+
+    /**
+     * \brief Test that the frame of view was not overwritten while it was read.
+     * Call after reading, and discard what was read if it returns false.
+     */
+    bool Validate( const SharedFrameView& view ) const;
+
+    /**
+     * \brief Copy the frame of view into frame, then Validate it.
+     * frame grows to the ring capacity on the first call.
+     * \return - false if the frame was overwritten while copying
+     */
+    bool Copy( const SharedFrameView& view, CompactFrame& frame ) const;
+
+private:
+    const sSharedRingHeader* mpHeader;
+    size_t mMappedBytes;
+};
@@ -0,0 +1,111 @@
+//=============================================================================
+// StreamCounters.cpp
+// ~~~~~~~~~~~~~~~~~~
+//
+// Continuity accounting of a NAT_FRAMEOFDATA stream.
+//=============================================================================
+
+#include "StreamCounters.h"
+
+StreamCounters::StreamCounters()
+{
+    Reset();
+}
+
+FrameOrder StreamCounters::AddFrame( int32_t frame )
+{
+    Add( mnReceived );
+    if( !mHaveNewest )
+    {
+        mNewest = frame;
+        mWindow = 1;
+        mHaveNewest = true;
+        return FrameOrder_Next;
+    }
+
+    int64_t delta = (int64_t) frame - mNewest;
+    if( delta > 0 )
+    {
+        mWindow = ( delta < STREAM_REORDER_WINDOW ) ? ( mWindow << delta ) | 1 : 1;
+        mNewest = frame;
+        if( delta == 1 )
+        {
+            return FrameOrder_Next;
+        }
+        Add( mnGaps );
+        Add( mnMissing, (uint64_t) ( delta - 1 ) );
+        return FrameOrder_Gap;
+    }
+
+    int64_t behind = -delta;
+    if( behind >= STREAM_RESTART_WINDOW )
+    {
+        Add( mnRestarts );
+        mNewest = frame;
+        mWindow = 1;
+        return FrameOrder_Restart;
+    }
+    if( behind < STREAM_REORDER_WINDOW )
+    {
+        uint64_t bit = 1ULL << behind;
+        if( mWindow & bit )
+        {
+            Add( mnDuplicates );
+            return FrameOrder_Duplicate;
+        }
+        mWindow |= bit;
+
+        // It was counted as missing when the newer frame opened the gap
+        uint64_t nMissing = mnMissing.load( std::memory_order_relaxed );
+        if( nMissing > 0 )
+        {
+            mnMissing.store( nMissing - 1, std::memory_order_relaxed );
+        }
+    }
+
+    // Beyond the window it is not known whether the frame arrived before
+    Add( mnOutOfOrder );
+    return FrameOrder_Late;
+}
+
+void StreamCounters::AddTruncated()
+{
+    Add( mnTruncated );
+}
+
+void StreamCounters::SetSocketDrops( uint64_t nDrops )
+{
+    if( nDrops > mnSocketDrops.load( std::memory_order_relaxed ) )
+    {
+        mnSocketDrops.store( nDrops, std::memory_order_relaxed );
+    }
+}
+
+sStreamCounters StreamCounters::Snapshot() const
+{
+    sStreamCounters counters;
+    counters.nReceived = mnReceived.load( std::memory_order_relaxed );
+    counters.nGaps = mnGaps.load( std::memory_order_relaxed );
+    counters.nMissing = mnMissing.load( std::memory_order_relaxed );
+    counters.nDuplicates = mnDuplicates.load( std::memory_order_relaxed );
+    counters.nOutOfOrder = mnOutOfOrder.load( std::memory_order_relaxed );
+    counters.nRestarts = mnRestarts.load( std::memory_order_relaxed );
+    counters.nTruncated = mnTruncated.load( std::memory_order_relaxed );
+    counters.nSocketDrops = mnSocketDrops.load( std::memory_order_relaxed );
+    return counters;
+}
+
+void StreamCounters::Reset()
+{
+    mNewest = 0;
+    mWindow = 0;
+    mHaveNewest = false;
+    mnReceived.store( 0, std::memory_order_relaxed );
+    mnGaps.store( 0, std::memory_order_relaxed );
+    mnMissing.store( 0, std::memory_order_relaxed );
+    mnDuplicates.store( 0, std::memory_order_relaxed );
+    mnOutOfOrder.store( 0, std::memory_order_relaxed );
+    mnRestarts.store( 0, std::memory_order_relaxed );
+    mnTruncated.store( 0, std::memory_order_relaxed );
+    mnSocketDrops.store( 0, std::memory_order_relaxed );
+}
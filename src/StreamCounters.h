@@ -0,0 +1,103 @@
+//=============================================================================
+// StreamCounters.h
+// ~~~~~~~~~~~~~~~~
+//
+// Continuity accounting of a NAT_FRAMEOFDATA stream: frame number gaps,
+// duplicates and late frames, truncated datagrams and datagrams the socket
+// dropped, counted as frames are delivered and readable from any thread.
+//=============================================================================
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Frames behind the newest one that are still told apart as late or duplicate
+#define STREAM_REORDER_WINDOW           64
+
+// A step back of this many frames or more restarts the sequence ( looped playback, server restart )
+#define STREAM_RESTART_WINDOW           1000
+
+/**
+ * \brief Counters of a stream, see StreamCounters::Snapshot.
+ */
+typedef struct sStreamCounters
+{
+    uint64_t nReceived;                     // frame datagrams accounted
+    uint64_t nGaps;                         // jumps forward by more than one frame
+    uint64_t nMissing;                      // frames skipped by the gaps that have not arrived late
+    uint64_t nDuplicates;                   // frames received before
+    uint64_t nOutOfOrder;                   // frames received after a newer one
+    uint64_t nRestarts;                     // steps back of STREAM_RESTART_WINDOW or more
+    uint64_t nTruncated;                    // datagrams shorter than their header says, or cut by the socket
+    uint64_t nSocketDrops;                  // datagrams dropped by the socket for lack of buffer space ( SO_RXQ_OVFL )
+} sStreamCounters;
+
+/**
+ * \brief How a frame number relates to the frames received before it.
+ */
+enum FrameOrder
+{
+    FrameOrder_Next = 0,                    // the frame after the newest one ( or the first frame )
+    FrameOrder_Gap,                         // newer, with frames missing in between
+    FrameOrder_Late,                        // older than the newest frame, not received before
+    FrameOrder_Duplicate,                   // received before
+    FrameOrder_Restart                      // far behind the newest frame, taken as the start of a new sequence
+};
+
+/**
+ * \brief Per-stream continuity counters.
+ * Each of AddFrame, AddTruncated and SetSocketDrops must be called from one
+ * thread at a time ( AddFrame where frames are delivered, the others on the
+ * receiving thread ); they write different counters, relaxed atomics written
+ * without read-modify-write instructions, so accounting costs a few plain
+ * loads and stores and Snapshot may be called from any thread.
+ */
+class StreamCounters
+{
+public:
+    StreamCounters();
+
+    /**
+     * \brief Account a NAT_FRAMEOFDATA datagram, see PeekFrameNumber.
+     * \return - order of the frame; a duplicate can be dropped
+     */
+    FrameOrder AddFrame( int32_t frame );
+
+    /**
+     * \brief Account a datagram that cannot be decoded because it was truncated.
+     */
+    void AddTruncated();
+
+    /**
+     * \brief Update the socket drop count.
+     * \param nDrops - drops counted by the socket since it was created
+     */
+    void SetSocketDrops( uint64_t nDrops );
+
+    sStreamCounters Snapshot() const;
+
+    /**
+     * \brief Clear the counters and the frame history. Call from the thread calling Add*.
+     */
+    void Reset();
+
+private:
+    static void Add( std::atomic<uint64_t>& counter, uint64_t n = 1 )
+    {
+        counter.store( counter.load( std::memory_order_relaxed ) + n, std::memory_order_relaxed );
+    }
+
+    int32_t mNewest;                        // newest frame number
+    uint64_t mWindow;                       // bit i set: frame mNewest - i was received
+    bool mHaveNewest;
+
+    std::atomic<uint64_t> mnReceived;
+    std::atomic<uint64_t> mnGaps;
+    std::atomic<uint64_t> mnMissing;
+    std::atomic<uint64_t> mnDuplicates;
+    std::atomic<uint64_t> mnOutOfOrder;
+    std::atomic<uint64_t> mnRestarts;
+    std::atomic<uint64_t> mnTruncated;
+    std::atomic<uint64_t> mnSocketDrops;
+};
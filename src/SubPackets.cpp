@@ -0,0 +1,178 @@
+//=============================================================================
+// SubPackets.cpp
+// ~~~~~~~~~~~~~~
+//
+// Splitting of NatNet packets into subpackets and their reassembly.
+//=============================================================================
+
+#include "SubPackets.h"
+
+#include <cstring>
+
+static_assert( sizeof( sSubPacketHeader ) == 16, "sSubPacketHeader is sent as is" );
+static_assert( SUBPACKET_MAX_COUNT <= 64, "one bit per subpacket in sSlot::receivedMask" );
+
+int SubPacketCount( size_t packetBytes )
+{
+    if( packetBytes == 0 )
+    {
+        return 1;
+    }
+    return (int) ( ( packetBytes + SUBPACKET_PAYLOAD_SIZE - 1 ) / SUBPACKET_PAYLOAD_SIZE );
+}
+
+void MakeSubPacketHeader( uint32_t sequence, size_t packetBytes, int index, sSubPacketHeader& header,
+    size_t& offset, size_t& size )
+{
+    offset = (size_t) index * SUBPACKET_PAYLOAD_SIZE;
+    size = ( packetBytes - offset < SUBPACKET_PAYLOAD_SIZE ) ? packetBytes - offset : SUBPACKET_PAYLOAD_SIZE;
+
+    header.messageID = NAT_SUBPACKET;
+    header.nBytes = (uint16_t) ( sizeof( sSubPacketHeader ) - 4 + size );
+    header.sequence = sequence;
+    header.index = (uint16_t) index;
+    header.count = (uint16_t) SubPacketCount( packetBytes );
+    header.packetBytes = (uint32_t) packetBytes;
+}
+
+// Sequence numbers wrap: compare by signed distance
+static bool SequenceBefore( uint32_t a, uint32_t b )
+{
+    return (int32_t) ( a - b ) < 0;
+}
+
+SubPacketReassembler::SubPacketReassembler()
+{
+    for( sSlot& slot : mSlots )
+    {
+        slot.data.resize( MAX_PACKETSIZE );
+    }
+    Reset();
+}
+
+void SubPacketReassembler::Reset()
+{
+    for( sSlot& slot : mSlots )
+    {
+        slot.used = false;
+        slot.complete = false;
+    }
+    mpPacket = nullptr;
+    mPacketLength = 0;
+    memset( &mCounters, 0, sizeof( mCounters ) );
+}
+
+SubPacketReassembler::sSlot* SubPacketReassembler::FindSlot( uint32_t sequence, SubPacketResult& result )
+{
+    sSlot* pFree = nullptr;
+    sSlot* pOldest = nullptr;
+    for( sSlot& slot : mSlots )
+    {
+        if( !slot.used )
+        {
+            pFree = pFree ? pFree : &slot;
+        }
+        else if( slot.sequence == sequence )
+        {
+            return &slot;
+        }
+        else if( !pOldest || SequenceBefore( slot.sequence, pOldest->sequence ) )
+        {
+            pOldest = &slot;
+        }
+    }
+
+    if( pFree )
+    {
+        return pFree;
+    }
+    if( SequenceBefore( sequence, pOldest->sequence )
+        && ( pOldest->sequence - sequence < SUBPACKET_RESTART_DISTANCE ) )
+    {
+        result = SubPacketResult_Stale;
+        return nullptr;
+    }
+    if( !pOldest->complete )
+    {
+        mCounters.nIncomplete++;
+    }
+    pOldest->used = false;
+    return pOldest;
+}
+
+SubPacketResult SubPacketReassembler::Add( const char* pData, size_t length )
+{
+    mCounters.nSubPackets++;
+    mpPacket = nullptr;
+    mPacketLength = 0;
+
+    sSubPacketHeader header;
+    if( length < sizeof( header ) )
+    {
+        mCounters.nInvalid++;
+        return SubPacketResult_Invalid;
+    }
+    memcpy( &header, pData, sizeof( header ) );
+    size_t payload = length - sizeof( header );
+    bool valid = ( header.messageID == NAT_SUBPACKET )
+        && ( header.count > 0 ) && ( header.count <= SUBPACKET_MAX_COUNT )
+        && ( header.index < header.count )
+        && ( header.packetBytes <= MAX_PACKETSIZE )
+        && ( (int) header.count == SubPacketCount( header.packetBytes ) );
+    if( valid )
+    {
+        size_t offset;
+        size_t size;
+        sSubPacketHeader expected;
+        MakeSubPacketHeader( header.sequence, header.packetBytes, header.index, expected, offset, size );
+        valid = ( payload == size ) && ( header.nBytes == expected.nBytes );
+    }
+    if( !valid )
+    {
+        mCounters.nInvalid++;
+        return SubPacketResult_Invalid;
+    }
+
+    SubPacketResult result = SubPacketResult_Pending;
+    sSlot* pSlot = FindSlot( header.sequence, result );
+    if( !pSlot )
+    {
+        mCounters.nStale++;
+        return result;
+    }
+    if( !pSlot->used )
+    {
+        pSlot->used = true;
+        pSlot->complete = false;
+        pSlot->sequence = header.sequence;
+        pSlot->count = header.count;
+        pSlot->nReceived = 0;
+        pSlot->packetBytes = header.packetBytes;
+        pSlot->receivedMask = 0;
+    }
+    else if( ( pSlot->count != header.count ) || ( pSlot->packetBytes != header.packetBytes ) )
+    {
+        // Same sequence, different packet: the sender restarted its count
+        mCounters.nInvalid++;
+        return SubPacketResult_Invalid;
+    }
+
+    uint64_t bit = 1ULL << header.index;
+    if( pSlot->receivedMask & bit )
+    {
+        mCounters.nDuplicates++;
+        return SubPacketResult_Duplicate;
+    }
+    pSlot->receivedMask |= bit;
+    memcpy( pSlot->data.data() + (size_t) header.index * SUBPACKET_PAYLOAD_SIZE, pData + sizeof( header ), payload );
+
+    if( ++pSlot->nReceived < pSlot->count )
+    {
+        return SubPacketResult_Pending;
+    }
+    pSlot->complete = true;
+    mCounters.nPackets++;
+    mpPacket = pSlot->data.data();
+    mPacketLength = pSlot->packetBytes;
+    return SubPacketResult_Complete;
+}
@@ -0,0 +1,131 @@
+//=============================================================================
+// SubPackets.h
+// ~~~~~~~~~~~~
+//
+// Splitting of NatNet packets into datagrams of at most SUBPACKET_MAX_SIZE
+// bytes, for links that do not carry the IP fragments of large frames, and
+// their reassembly. A subpacket starts like any NatNet packet ( message ID and
+// byte count ), so clients that do not know NAT_SUBPACKET ignore it.
+//=============================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <NatNetTypes.h>
+
+// Largest subpacket datagram ( kSubPacketMaxSize of NatNetRepeater.h )
+#define SUBPACKET_MAX_SIZE              1400
+
+// Message ID of a subpacket, outside the range NatNet uses
+#define NAT_SUBPACKET                   0x5350
+
+// Packets reassembled at the same time; a newer packet evicts the oldest unfinished one
+#define SUBPACKET_REASSEMBLY_SLOTS      4
+
+// A packet this far behind the oldest one being reassembled starts a new sequence ( sender restart )
+#define SUBPACKET_RESTART_DISTANCE      1000
+
+/**
+ * \brief Header of a subpacket, followed by its share of the packet.
+ */
+typedef struct sSubPacketHeader
+{
+    uint16_t messageID;                     // NAT_SUBPACKET
+    uint16_t nBytes;                        // bytes after messageID and nBytes, as in any NatNet packet
+    uint32_t sequence;                      // packet number, counted by the sender
+    uint16_t index;                         // 0 .. count - 1
+    uint16_t count;                         // subpackets of the packet
+    uint32_t packetBytes;                   // length of the whole packet
+} sSubPacketHeader;
+
+// Bytes of the packet carried by each subpacket but the last
+#define SUBPACKET_PAYLOAD_SIZE          ( SUBPACKET_MAX_SIZE - sizeof( sSubPacketHeader ) )
+
+// Subpackets of the largest packet
+#define SUBPACKET_MAX_COUNT             ( ( MAX_PACKETSIZE + SUBPACKET_PAYLOAD_SIZE - 1 ) / SUBPACKET_PAYLOAD_SIZE )
+
+/**
+ * \brief Number of subpackets a packet of the given length is split into.
+ */
+int SubPacketCount( size_t packetBytes );
+
+/**
+ * \brief Fill the header of subpacket index of a packet.
+ * \param offset, size - receive the part of the packet the subpacket carries
+ */
+void MakeSubPacketHeader( uint32_t sequence, size_t packetBytes, int index, sSubPacketHeader& header,
+    size_t& offset, size_t& size );
+
+enum SubPacketResult
+{
+    SubPacketResult_Pending = 0,            // stored, the packet is not complete yet
+    SubPacketResult_Complete,               // completed a packet, see SubPacketReassembler::Packet
+    SubPacketResult_Duplicate,              // received before
+    SubPacketResult_Stale,                  // of a packet older than all those being reassembled
+    SubPacketResult_Invalid                 // not a well-formed subpacket
+};
+
+/**
+ * \brief Counters of a SubPacketReassembler.
+ */
+typedef struct sReassemblyCounters
+{
+    uint64_t nSubPackets;                   // subpackets added, including invalid ones
+    uint64_t nPackets;                      // packets completed
+    uint64_t nIncomplete;                   // packets evicted before all their subpackets arrived
+    uint64_t nDuplicates;
+    uint64_t nStale;
+    uint64_t nInvalid;
+} sReassemblyCounters;
+
+/**
+ * \brief Reassembles packets from their subpackets, in any order, several packets at a time.
+ * Memory is allocated up front: adding subpackets does not allocate.
+ */
+class SubPacketReassembler
+{
+public:
+    SubPacketReassembler();
+
+    /**
+     * \brief Add a received NAT_SUBPACKET datagram.
+     * \return - SubPacketResult_Complete when it was the last missing part of its packet
+     */
+    SubPacketResult Add( const char* pData, size_t length );
+
+    /**
+     * \brief The packet completed by the last Add, valid until the next Add.
+     */
+    const char* Packet() const { return mpPacket; }
+    size_t PacketLength() const { return mPacketLength; }
+
+    const sReassemblyCounters& Counters() const { return mCounters; }
+
+    /**
+     * \brief Drop the packets being reassembled and clear the counters.
+     */
+    void Reset();
+
+private:
+    struct sSlot
+    {
+        bool used;
+        bool complete;
+        uint32_t sequence;
+        uint16_t count;
+        uint16_t nReceived;
+        uint32_t packetBytes;
+        uint64_t receivedMask;              // bit i: subpacket i arrived
+        std::vector<char> data;
+    };
+
+    sSlot* FindSlot( uint32_t sequence, SubPacketResult& result );
+
+    sSlot mSlots[SUBPACKET_REASSEMBLY_SLOTS];
+    const char* mpPacket;
+    size_t mPacketLength;
+    sReassemblyCounters mCounters;
+};
@@ -0,0 +1,126 @@
+//=============================================================================
+// ThreadTuning.cpp
+// ~~~~~~~~~~~~~~~~
+//
+// CPU affinity and real-time scheduling of latency critical threads.
+//=============================================================================
+
+#include "ThreadTuning.h"
+
+#include <cstdlib>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+
+// CPU numbers a cpu_set_t can hold
+static const long kCpuLimit = CPU_SETSIZE;
+
+static bool PinNativeThread( pthread_t thread, int cpu )
+{
+    if( ( cpu < 0 ) || ( cpu >= CPU_SETSIZE ) )
+    {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    CPU_SET( cpu, &set );
+    return pthread_setaffinity_np( thread, sizeof( set ), &set ) == 0;
+}
+
+static bool SetNativeRealtimeScheduling( pthread_t thread, int priority )
+{
+    sched_param param;
+    param.sched_priority = priority;
+    return pthread_setschedparam( thread, SCHED_FIFO, &param ) == 0;
+}
+
+bool PinThread( std::thread& thread, int cpu )
+{
+    return PinNativeThread( thread.native_handle(), cpu );
+}
+
+bool PinCurrentThread( int cpu )
+{
+    return PinNativeThread( pthread_self(), cpu );
+}
+
+bool SetRealtimeScheduling( std::thread& thread, int priority )
+{
+    return SetNativeRealtimeScheduling( thread.native_handle(), priority );
+}
+
+bool SetCurrentThreadRealtimeScheduling( int priority )
+{
+    return SetNativeRealtimeScheduling( pthread_self(), priority );
+}
+
+#else
+
+bool PinThread( std::thread& /*thread*/, int /*cpu*/ )
+{
+    return false;
+}
+
+bool PinCurrentThread( int /*cpu*/ )
+{
+    return false;
+}
+
+bool SetRealtimeScheduling( std::thread& /*thread*/, int /*priority*/ )
+{
+    return false;
+}
+
+bool SetCurrentThreadRealtimeScheduling( int /*priority*/ )
+{
+    return false;
+}
+
+// Pinning is not supported: only bounds the lists parsed
+static const long kCpuLimit = 1024;
+
+#endif
+
+bool ParseCpuList( const char* text, std::vector<int>& cpus )
+{
+    cpus.clear();
+    const char* ptr = text;
+    while( *ptr )
+    {
+        char* end = nullptr;
+        long first = strtol( ptr, &end, 10 );
+        if( ( end == ptr ) || ( first < 0 ) || ( first >= kCpuLimit ) )
+        {
+            return false;
+        }
+        long last = first;
+        ptr = end;
+        if( *ptr == '-' )
+        {
+            last = strtol( ptr + 1, &end, 10 );
+            if( ( end == ptr + 1 ) || ( last < first ) || ( last >= kCpuLimit ) )
+            {
+                return false;
+            }
+            ptr = end;
+        }
+        for( long cpu = first; cpu <= last; cpu++ )
+        {
+            cpus.push_back( (int) cpu );
+        }
+        if( *ptr == ',' )
+        {
+            ptr++;
+            if( !*ptr )
+            {
+                return false;
+            }
+        }
+        else if( *ptr )
+        {
+            return false;
+        }
+    }
+    return !cpus.empty();
+}
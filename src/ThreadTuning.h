@@ -0,0 +1,45 @@
+//=============================================================================
+// ThreadTuning.h
+// ~~~~~~~~~~~~~~
+//
+// CPU affinity and real-time scheduling of latency critical threads ( Linux;
+// elsewhere the calls do nothing and return false ).
+//=============================================================================
+
+#pragma once
+
+#include <thread>
+#include <vector>
+
+// SCHED_FIFO priority of the receive and decode threads ( 1 - 99 )
+#define REALTIME_PRIORITY               50
+
+/**
+ * \brief Pin a thread to one CPU.
+ * \return - false if the CPU does not exist or pinning is not supported
+ */
+bool PinThread( std::thread& thread, int cpu );
+
+/**
+ * \brief Pin the calling thread to one CPU, see PinThread.
+ */
+bool PinCurrentThread( int cpu );
+
+/**
+ * \brief Run a thread with SCHED_FIFO at the given priority.
+ * A real-time thread that never blocks starves everything else on its CPU; combine with
+ * PinThread to a CPU set aside for it.
+ * \return - false if not permitted ( needs CAP_SYS_NICE or an RLIMIT_RTPRIO ) or not supported
+ */
+bool SetRealtimeScheduling( std::thread& thread, int priority );
+
+/**
+ * \brief SetRealtimeScheduling for the calling thread.
+ */
+bool SetCurrentThreadRealtimeScheduling( int priority );
+
+/**
+ * \brief Parse a CPU list such as "2", "2,3" or "2-5,8".
+ * \return - false if the list is malformed, or names a CPU a cpu_set_t cannot hold ( CPU_SETSIZE )
+ */
+bool ParseCpuList( const char* text, std::vector<int>& cpus );
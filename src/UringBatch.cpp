@@ -0,0 +1,486 @@
+//
+// UringBatch.cpp
+// ~~~~~~~~~~~~~~
+//
+// Raw io_uring system calls, no liburing: one submission (the multishot
+// receive) and a completion queue read in user space.
+//
+
+#include "UringBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <string.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// Multishot recvmsg (6.0) came after provided buffer rings (5.19).
+#if defined(IORING_RECV_MULTISHOT)
+#define URING_BATCH_SUPPORTED 1
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const std::uint16_t buffer_group = 0;
+
+std::size_t round_up_power_of_2(std::size_t n)
+{
+  std::size_t p = 1;
+  while (p < n)
+  {
+    p <<= 1;
+  }
+  return p;
+}
+
+} // namespace
+
+uring_batch::uring_batch(std::size_t capacity, std::size_t buffer_count,
+    std::size_t payload_size)
+  : capacity_(capacity)
+  // Buffer IDs are 16 bits and the ring size a power of 2.
+  , buffer_count_(std::min<std::size_t>(
+        round_up_power_of_2(std::max(buffer_count, capacity + 1)), 32768))
+  , payload_size_(payload_size)
+  , buffer_size_(0)
+  , size_(0)
+  , ring_fd_(-1)
+  , socket_fd_(-1)
+  , sq_ring_(nullptr)
+  , sq_ring_size_(0)
+  , cq_ring_(nullptr)
+  , cq_ring_size_(0)
+  , sqes_(nullptr)
+  , sqes_size_(0)
+  , buffer_ring_(nullptr)
+  , buffer_ring_size_(0)
+  , sq_tail_(nullptr)
+  , sq_mask_(nullptr)
+  , sq_array_(nullptr)
+  , cq_head_(nullptr)
+  , cq_tail_(nullptr)
+  , cq_mask_(nullptr)
+  , cqes_(nullptr)
+  , buffer_tail_(0)
+  , timestamps_enabled_(false)
+  , armed_(false)
+  , received_any_(false)
+  , data_(capacity)
+  , lengths_(capacity)
+  , truncated_(capacity)
+  , senders_(capacity)
+  , timestamps_(capacity)
+  , socket_drops_(0)
+  , enter_calls_(0)
+{
+  held_.reserve(capacity);
+}
+
+uring_batch::~uring_batch()
+{
+  close();
+}
+
+#if defined(URING_BATCH_SUPPORTED)
+
+namespace {
+
+int io_uring_setup(unsigned entries, io_uring_params* params)
+{
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+    unsigned flags)
+{
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit,
+        min_complete, flags, nullptr, 0));
+}
+
+int io_uring_register(int fd, unsigned opcode, void* arg, unsigned count)
+{
+  return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg,
+        count));
+}
+
+std::int64_t realtime_now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+boost::system::error_code last_error()
+{
+  return boost::system::error_code(errno, boost::system::system_category());
+}
+
+void* map_ring(int fd, std::size_t size, off_t offset)
+{
+  void* ring = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, fd, offset);
+  return ring == MAP_FAILED ? nullptr : ring;
+}
+
+std::uint32_t* ring_field(void* ring, std::uint32_t offset)
+{
+  return reinterpret_cast<std::uint32_t*>(static_cast<char*>(ring) + offset);
+}
+
+} // namespace
+
+bool uring_batch::start(boost::asio::ip::udp::socket& socket, bool timestamps,
+    bool drop_count, boost::system::error_code& ec)
+{
+  close();
+  socket_fd_ = socket.native_handle();
+
+  // Control messages land in every buffer, in the room reserved here.
+  int on = 1;
+  std::size_t control_size = 0;
+  timestamps_enabled_ = timestamps;
+  if (timestamps && ::setsockopt(socket_fd_, SOL_SOCKET, SO_TIMESTAMPNS,
+        &on, sizeof(on)) == 0)
+  {
+    control_size += CMSG_SPACE(sizeof(timespec));
+  }
+  if (drop_count && ::setsockopt(socket_fd_, SOL_SOCKET, SO_RXQ_OVFL,
+        &on, sizeof(on)) == 0)
+  {
+    control_size += CMSG_SPACE(sizeof(std::uint32_t));
+  }
+
+  message_.assign(sizeof(msghdr), 0);
+  msghdr* message = reinterpret_cast<msghdr*>(message_.data());
+  message->msg_namelen = static_cast<socklen_t>(senders_[0].capacity());
+  message->msg_controllen = control_size;
+  buffer_size_ = sizeof(io_uring_recvmsg_out) + message->msg_namelen
+    + control_size + payload_size_;
+
+  // Every buffer can complete before the completions are read.
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = static_cast<unsigned>(buffer_count_ * 2);
+  ring_fd_ = io_uring_setup(4, &params);
+  if (ring_fd_ < 0)
+  {
+    ec = last_error();
+    close();
+    return false;
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+  sq_ring_ = map_ring(ring_fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+  if (sq_ring_ && (params.features & IORING_FEAT_SINGLE_MMAP))
+  {
+    cq_ring_ = sq_ring_;
+  }
+  else if (sq_ring_)
+  {
+    cq_ring_ = map_ring(ring_fd_, cq_ring_size_, IORING_OFF_CQ_RING);
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = map_ring(ring_fd_, sqes_size_, IORING_OFF_SQES);
+  if (!sq_ring_ || !cq_ring_ || !sqes_)
+  {
+    ec = last_error();
+    close();
+    return false;
+  }
+  sq_tail_ = ring_field(sq_ring_, params.sq_off.tail);
+  sq_mask_ = ring_field(sq_ring_, params.sq_off.ring_mask);
+  sq_array_ = ring_field(sq_ring_, params.sq_off.array);
+  cq_head_ = ring_field(cq_ring_, params.cq_off.head);
+  cq_tail_ = ring_field(cq_ring_, params.cq_off.tail);
+  cq_mask_ = ring_field(cq_ring_, params.cq_off.ring_mask);
+  cqes_ = static_cast<char*>(cq_ring_) + params.cq_off.cqes;
+
+  // The provided buffer ring: page aligned, shared with the kernel.
+  buffer_ring_size_ = buffer_count_ * sizeof(io_uring_buf);
+  buffer_ring_ = ::mmap(nullptr, buffer_ring_size_, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffer_ring_ == MAP_FAILED)
+  {
+    buffer_ring_ = nullptr;
+    ec = last_error();
+    close();
+    return false;
+  }
+  io_uring_buf_reg registration;
+  memset(&registration, 0, sizeof(registration));
+  registration.ring_addr = reinterpret_cast<std::uintptr_t>(buffer_ring_);
+  registration.ring_entries = static_cast<std::uint32_t>(buffer_count_);
+  registration.bgid = buffer_group;
+  if (io_uring_register(ring_fd_, IORING_REGISTER_PBUF_RING,
+        &registration, 1) != 0)
+  {
+    ec = last_error();
+    ::munmap(buffer_ring_, buffer_ring_size_);
+    buffer_ring_ = nullptr;
+    close();
+    return false;
+  }
+
+  buffers_.assign(buffer_count_ * buffer_size_, 0);
+  buffer_tail_ = 0;
+  held_.clear();
+  for (std::size_t i = 0; i < buffer_count_; ++i)
+  {
+    held_.push_back(static_cast<std::uint16_t>(i));
+  }
+  recycle();
+
+  received_any_ = false;
+  if (!submit_receive(ec))
+  {
+    close();
+    return false;
+  }
+  ec = boost::system::error_code();
+  return true;
+}
+
+// Queue the multishot receive and submit it.
+bool uring_batch::submit_receive(boost::system::error_code& ec)
+{
+  std::uint32_t tail = *sq_tail_;
+  std::uint32_t index = tail & *sq_mask_;
+  io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes_) + index;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = socket_fd_;
+  sqe->addr = reinterpret_cast<std::uintptr_t>(message_.data());
+  sqe->len = 1;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = buffer_group;
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+  ++enter_calls_;
+  if (io_uring_enter(ring_fd_, 1, 0, 0) != 1)
+  {
+    ec = last_error();
+    return false;
+  }
+  armed_ = true;
+  return true;
+}
+
+// Hand the buffers of the current batch back to the kernel.
+void uring_batch::recycle()
+{
+  if (held_.empty())
+  {
+    return;
+  }
+  io_uring_buf* ring = static_cast<io_uring_buf*>(buffer_ring_);
+  std::size_t mask = buffer_count_ - 1;
+  for (std::uint16_t id : held_)
+  {
+    // Only these fields: the ring tail overlays resv of the first entry.
+    io_uring_buf& entry = ring[buffer_tail_ & mask];
+    entry.addr = reinterpret_cast<std::uintptr_t>(
+        buffers_.data() + id * buffer_size_);
+    entry.len = static_cast<std::uint32_t>(buffer_size_);
+    entry.bid = id;
+    ++buffer_tail_;
+  }
+  __atomic_store_n(&static_cast<io_uring_buf_ring*>(buffer_ring_)->tail,
+      buffer_tail_, __ATOMIC_RELEASE);
+  held_.clear();
+}
+
+std::size_t uring_batch::receive(boost::system::error_code& ec)
+{
+  size_ = 0;
+  if (ring_fd_ < 0)
+  {
+    ec = boost::asio::error::bad_descriptor;
+    return 0;
+  }
+  recycle();
+
+  ec = boost::system::error_code();
+  const msghdr* message = reinterpret_cast<const msghdr*>(message_.data());
+  std::uint32_t head = *cq_head_;
+  std::uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  std::int64_t now = timestamps_enabled_ ? realtime_now() : 0;
+  while (head != tail && size_ < capacity_)
+  {
+    const io_uring_cqe* cqe =
+      static_cast<const io_uring_cqe*>(cqes_) + (head & *cq_mask_);
+    ++head;
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+    {
+      armed_ = false;
+    }
+    if (cqe->res < 0)
+    {
+      // Out of buffers, or the like: restarted below. Turned down from the
+      // start: this kernel cannot do it, so the caller falls back.
+      if (!received_any_ && (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP))
+      {
+        ec = boost::asio::error::operation_not_supported;
+      }
+      else if (cqe->res != -ENOBUFS)
+      {
+        ec = boost::system::error_code(-cqe->res, boost::system::system_category());
+      }
+      continue;
+    }
+    if (!(cqe->flags & IORING_CQE_F_BUFFER))
+    {
+      continue;
+    }
+    received_any_ = true;
+    std::uint16_t id = static_cast<std::uint16_t>(
+        cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    held_.push_back(id);
+
+    char* buffer = buffers_.data() + id * buffer_size_;
+    const io_uring_recvmsg_out* out =
+      reinterpret_cast<const io_uring_recvmsg_out*>(buffer);
+    char* name = buffer + sizeof(io_uring_recvmsg_out);
+    char* control = name + message->msg_namelen;
+    char* payload = control + message->msg_controllen;
+    std::size_t used = static_cast<std::size_t>(cqe->res);
+    std::size_t offset = static_cast<std::size_t>(payload - buffer);
+
+    data_[size_] = payload;
+    lengths_[size_] = used > offset ? std::min<std::size_t>(used - offset,
+        out->payloadlen) : 0;
+    truncated_[size_] = (out->flags & MSG_TRUNC) != 0;
+    boost::asio::ip::udp::endpoint& sender = senders_[size_];
+    std::size_t name_length = std::min<std::size_t>(out->namelen,
+        message->msg_namelen);
+    memcpy(sender.data(), name, name_length);
+    sender.resize(name_length);
+
+    timestamps_[size_] = now;
+    msghdr header;
+    memset(&header, 0, sizeof(header));
+    header.msg_control = control;
+    header.msg_controllen = std::min<std::size_t>(out->controllen,
+        message->msg_controllen);
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&header); cmsg != nullptr;
+        cmsg = CMSG_NXTHDR(&header, cmsg))
+    {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+      {
+        timespec ts;
+        memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+        timestamps_[size_] = static_cast<std::int64_t>(ts.tv_sec) * 1000000000
+          + ts.tv_nsec;
+      }
+      else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+      {
+        std::uint32_t drops;
+        memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+        socket_drops_ = drops;
+      }
+    }
+    ++size_;
+  }
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+  if (ec == boost::asio::error::operation_not_supported)
+  {
+    return size_;
+  }
+  if (!armed_)
+  {
+    // The kernel ends a multishot receive when it runs out of buffers (or
+    // completion queue space); the buffers are back after the next call.
+    boost::system::error_code submit_ec;
+    if (!submit_receive(submit_ec) && !ec)
+    {
+      ec = submit_ec;
+    }
+  }
+  if (size_ == 0 && !ec)
+  {
+    ec = boost::asio::error::would_block;
+  }
+  return size_;
+}
+
+void uring_batch::close()
+{
+  // Closing the ring cancels the receive and releases the buffer ring.
+  if (ring_fd_ >= 0)
+  {
+    ::close(ring_fd_);
+    ring_fd_ = -1;
+  }
+  if (sqes_)
+  {
+    ::munmap(sqes_, sqes_size_);
+    sqes_ = nullptr;
+  }
+  if (cq_ring_ && cq_ring_ != sq_ring_)
+  {
+    ::munmap(cq_ring_, cq_ring_size_);
+  }
+  cq_ring_ = nullptr;
+  if (sq_ring_)
+  {
+    ::munmap(sq_ring_, sq_ring_size_);
+    sq_ring_ = nullptr;
+  }
+  if (buffer_ring_)
+  {
+    ::munmap(buffer_ring_, buffer_ring_size_);
+    buffer_ring_ = nullptr;
+  }
+  held_.clear();
+  armed_ = false;
+  size_ = 0;
+}
+
+#else
+
+bool uring_batch::start(boost::asio::ip::udp::socket& /*socket*/,
+    bool /*timestamps*/, bool /*drop_count*/, boost::system::error_code& ec)
+{
+  ec = boost::asio::error::operation_not_supported;
+  return false;
+}
+
+std::size_t uring_batch::receive(boost::system::error_code& ec)
+{
+  size_ = 0;
+  ec = boost::asio::error::operation_not_supported;
+  return 0;
+}
+
+bool uring_batch::submit_receive(boost::system::error_code& ec)
+{
+  ec = boost::asio::error::operation_not_supported;
+  return false;
+}
+
+void uring_batch::recycle()
+{
+}
+
+void uring_batch::close()
+{
+}
+
+#endif
@@ -0,0 +1,119 @@
+//
+// UringBatch.h
+// ~~~~~~~~~~~~
+//
+// io_uring receive backend with the interface of datagram_batch. One
+// multishot IORING_OP_RECVMSG keeps receiving into a ring of buffers
+// provided to the kernel up front (IORING_REGISTER_PBUF_RING), and
+// completions are read from the shared completion queue: no system call per
+// datagram, and the datagrams are handed out in place, without a copy.
+// Linux 6.0+; elsewhere start() fails and the caller keeps its asio path.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <boost/asio.hpp>
+
+class uring_batch
+{
+public:
+  // capacity: datagrams per receive(); buffer_count: buffers provided to the
+  // kernel (a power of 2, more than capacity); payload_size: largest
+  // datagram.
+  uring_batch(std::size_t capacity, std::size_t buffer_count,
+      std::size_t payload_size);
+  ~uring_batch();
+
+  uring_batch(const uring_batch&) = delete;
+  uring_batch& operator=(const uring_batch&) = delete;
+
+  // Set up the ring and start receiving from the socket, optionally with
+  // kernel receive timestamps (SO_TIMESTAMPNS) and the socket drop count
+  // (SO_RXQ_OVFL). Returns false, with the reason in ec, where io_uring or
+  // one of the features is not available.
+  bool start(boost::asio::ip::udp::socket& socket, bool timestamps,
+      bool drop_count, boost::system::error_code& ec);
+
+  // Take the datagrams completed so far, up to capacity(), without a system
+  // call (unless the multishot receive has to be restarted). The buffers of
+  // the previous batch go back to the kernel first. Returns 0 with ec set to
+  // would_block when nothing is waiting, to operation_not_supported when the
+  // kernel turned the receive down.
+  std::size_t receive(boost::system::error_code& ec);
+
+  // The ring's file descriptor, readable when completions are waiting.
+  int native_handle() const { return ring_fd_; }
+
+  std::size_t capacity() const { return capacity_; }
+  std::size_t size() const { return size_; }
+
+  const char* data(std::size_t i) const { return data_[i]; }
+  std::size_t length(std::size_t i) const { return lengths_[i]; }
+  bool truncated(std::size_t i) const { return truncated_[i] != 0; }
+
+  boost::asio::ip::udp::endpoint sender(std::size_t i) const
+  {
+    return senders_[i];
+  }
+
+  // Receive time in nanoseconds of the realtime clock, 0 unless started
+  // with timestamps.
+  std::int64_t timestamp(std::size_t i) const { return timestamps_[i]; }
+
+  // Datagrams dropped by the socket since it was created, as of the last
+  // datagram received, 0 unless started with drop_count.
+  std::uint64_t socket_drops() const { return socket_drops_; }
+
+  // io_uring_enter system calls issued so far.
+  std::uint64_t enter_calls() const { return enter_calls_; }
+
+private:
+  bool submit_receive(boost::system::error_code& ec);
+  void recycle();
+  void close();
+
+  std::size_t capacity_;
+  std::size_t buffer_count_;
+  std::size_t payload_size_;
+  std::size_t buffer_size_;       // payload plus the recvmsg header, name and control
+  std::size_t size_;
+
+  int ring_fd_;
+  int socket_fd_;
+  void* sq_ring_;
+  std::size_t sq_ring_size_;
+  void* cq_ring_;
+  std::size_t cq_ring_size_;
+  void* sqes_;
+  std::size_t sqes_size_;
+  void* buffer_ring_;
+  std::size_t buffer_ring_size_;
+  std::vector<char> buffers_;
+
+  // Offsets into the mapped rings.
+  std::uint32_t* sq_tail_;
+  std::uint32_t* sq_mask_;
+  std::uint32_t* sq_array_;
+  std::uint32_t* cq_head_;
+  std::uint32_t* cq_tail_;
+  std::uint32_t* cq_mask_;
+  void* cqes_;
+  std::uint16_t buffer_tail_;
+
+  std::vector<char> message_;     // msghdr template of the multishot receive
+  bool timestamps_enabled_;
+  bool armed_;
+  bool received_any_;
+
+  std::vector<const char*> data_;
+  std::vector<std::size_t> lengths_;
+  std::vector<char> truncated_;
+  std::vector<boost::asio::ip::udp::endpoint> senders_;
+  std::vector<std::int64_t> timestamps_;
+  std::vector<std::uint16_t> held_;   // buffer IDs of the current batch
+  std::uint64_t socket_drops_;
+  std::uint64_t enter_calls_;
+};
@@ -8,61 +8,482 @@
 // file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 //
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <string>
+#include <memory>
+#include <mutex>
 #include <boost/asio.hpp>
+#include <errno.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <NatNetRequests.h>
+
+#include "NatNetDecoder.h"
+#include "ClockSync.h"
+#include "CommandClient.h"
+#include "CompactStream.h"
+#include "DatagramBatch.h"
+#include "DecodePipeline.h"
+#include "DecoderContext.h"
+#include "FrameLatency.h"
+#include "FramePool.h"
+#include "FrameVisitor.h"
+#include "PacketRecorder.h"
+#include "ReceiveStats.h"
+#include "ServerDiscovery.h"
+#include "SharedFrameRing.h"
+#include "StreamCounters.h"
+#include "SubPackets.h"
+#include "ThreadTuning.h"
+#include "UringBatch.h"
 
 constexpr const char* MULTICAST_ADDRESS = "239.255.42.99";
 constexpr int PORT_COMMAND = 1510;
 constexpr int PORT_DATA = 1511;
-constexpr int MAX_PACKETSIZE = 100000;  // max size of packet (actual packet size is dynamic)
 
-char* Unpack( char* pPacketIn, unsigned int level=0 );
-void buildConnectPacket(std::vector<char>& buffer);
-void UnpackCommand(char* pData);
+// Interval of the NAT_DISCOVERY broadcasts while looking for a server.
+constexpr std::chrono::milliseconds DISCOVERY_INTERVAL(1000);
+
+// Give up on a server that does not answer NAT_CONNECT.
+const retry_policy CONNECT_POLICY = { 3, std::chrono::milliseconds(1000) };
+
+// Resend an unanswered NAT_REQUEST_MODELDEF every second until answered.
+const retry_policy MODELDEF_POLICY = { 0, std::chrono::milliseconds(1000) };
+
+// String requests for the startup report.
+const retry_policy QUERY_POLICY = { 3, std::chrono::milliseconds(500) };
+
+// Interval of the NAT_KEEPALIVE messages that keep a unicast stream going.
+constexpr std::chrono::milliseconds KEEPALIVE_INTERVAL(1000);
+
+// Interval of the NAT_ECHOREQUEST round trips that synchronize to the server clock.
+constexpr std::chrono::milliseconds ECHO_INTERVAL(250);
+
+// An echo is not resent: a late response still gives a sample, unanswered
+// ones are replaced by the next.
+const retry_policy ECHO_POLICY = { 1, ECHO_INTERVAL };
+
+// Datagrams drained from the data socket per wakeup, unless set by --batch.
+#if defined(__linux__)
+constexpr std::size_t DEFAULT_RECEIVE_BATCH = 32;
+#else
+constexpr std::size_t DEFAULT_RECEIVE_BATCH = 1;
+#endif
+
+// Frames received but not yet delivered that the --workers pipeline can hold.
+constexpr int PIPELINE_SLOTS = 16;
+
+// --rcvbuf auto doubles the socket receive buffer at most this often, up
+// to RCVBUF_AUTO_MAX bytes, while the socket keeps dropping datagrams.
+constexpr std::chrono::seconds RCVBUF_GROW_INTERVAL(1);
+constexpr std::size_t RCVBUF_AUTO_MAX = 64 * 1024 * 1024;
+
+// --busy-poll: SO_BUSY_POLL time of each receive, and the receive passes
+// between two runs of the ready command and timer handlers.
+constexpr int BUSY_POLL_US = 50;
+constexpr unsigned BUSY_POLL_IO_INTERVAL = 64;
+
+// --uring: buffers of MAX_PACKETSIZE provided to the kernel, at least two
+// receive batches' worth.
+constexpr std::size_t URING_BUFFERS = 64;
+
+// Interval of the --stats and --latency reports.
+constexpr std::chrono::seconds STATS_INTERVAL(5);
 
 using boost::asio::ip::udp;
 
+// Where the frames come from. A unicast stream is sent to the socket that
+// connected to the server, so it shares the command socket.
+struct data_stream
+{
+  bool unicast;
+  boost::asio::ip::address listen_address;
+  boost::asio::ip::address multicast_address;
+  unsigned short port;
+};
+
+struct receiver_options
+{
+  bool print_frames = true;
+  std::size_t receive_batch = DEFAULT_RECEIVE_BATCH;
+  int decode_workers = 0;
+  bool print_stats = false;
+  bool measure_latency = false;
+  std::string latency_csv;
+  std::size_t receive_buffer = 0;    // SO_RCVBUF, 0 for the system default
+  bool grow_receive_buffer = false;  // --rcvbuf auto
+  bool busy_poll = false;            // spin on the data socket, see poll_data()
+  bool uring = false;                // io_uring receive, see start_uring()
+  std::vector<int> cpus;             // receive thread, then decode workers
+  bool realtime = false;             // SCHED_FIFO for the same threads
+  std::string publish;               // shared memory ring of decoded frames
+  PacketRecorder* recorder = nullptr; // raw datagrams and descriptions, --record
+};
+
+// NatNet 3 servers describe their data stream; older ones always multicast
+// to the default group and port.
+static data_stream select_data_stream(const sSender_Server& settings,
+    bool force_unicast, bool force_multicast)
+{
+  bool described = (settings.Common.NatNetVersion[0] >= 3);
+  data_stream stream;
+  stream.unicast = force_unicast
+    || (described && !settings.IsMulticast && !force_multicast);
+  stream.listen_address = boost::asio::ip::address::from_string("0.0.0.0");
+  stream.multicast_address =
+    boost::asio::ip::address::from_string(MULTICAST_ADDRESS);
+  stream.port = PORT_DATA;
+  if (described && settings.DataPort != 0)
+  {
+    stream.port = settings.DataPort;
+  }
+  if (described && settings.MulticastGroupAddress[0] != 0)
+  {
+    boost::asio::ip::address_v4::bytes_type group;
+    memcpy(group.data(), settings.MulticastGroupAddress, group.size());
+    stream.multicast_address = boost::asio::ip::address_v4(group);
+  }
+  return stream;
+}
+
+// Ask for a float32 setting (see NatNetRequests.h) and print it when the
+// answer arrives.
+static void print_setting(command_client& commands, const char* name)
+{
+  std::vector<char> request;
+  command_client::build_string_request(name, request);
+  std::string label(name);
+  commands.request(std::move(request), NAT_RESPONSE, QUERY_POLICY,
+      [label](const boost::system::error_code& ec, const char* reply,
+        std::size_t length)
+      {
+        if (ec)
+        {
+          std::cerr << label << ": " << ec.message() << std::endl;
+          return;
+        }
+        float value = 0.0f;
+        if (length >= 8)
+        {
+          memcpy(&value, reply + 4, 4);
+          printf("%s: %g\n", label.c_str(), value);
+        }
+      });
+}
+
 class receiver
 {
 public:
   receiver(boost::asio::io_context& io_context,
-      const boost::asio::ip::address& listen_address,
-      const boost::asio::ip::address& multicast_address)
+      command_client& commands,
+      const data_stream& stream,
+      DecoderContext& context,
+      const receiver_options& options)
     : socket_(io_context)
     , sender_endpoint_()
-    , data_(20000)
+    , data_(MAX_PACKETSIZE)
+    , batch_(options.receive_batch, MAX_PACKETSIZE)
+    , uring_wait_(io_context)
+    , busy_poll_(options.busy_poll)
+    , receive_buffer_request_(options.receive_buffer)
+    , receive_buffer_(0)
+    , grow_receive_buffer_(options.grow_receive_buffer)
+    , drop_count_(false)
+    , losses_seen_(0)
+    , commands_(commands)
+    , unicast_(stream.unicast)
+    , data_socket_(nullptr)
+    , model_request_pending_(false)
+    , keepalive_timer_(io_context)
+    , echo_timer_(io_context)
+    , context_(context)
+    , frames_(2)
+    , dropped_packets_(0)
+    , print_frames_(options.print_frames)
+    , delivered_frames_(0)
+    , stats_timer_(io_context)
+    , print_stats_(options.print_stats)
+    , latency_csv_(options.latency_csv)
+    , timestamps_(false)
+    , recorder_(options.recorder)
+    , ring_name_(options.publish)
+  {
+    command_client::build_request(NAT_REQUEST_MODELDEF, model_request_);
+    command_client::build_request(NAT_KEEPALIVE, keepalive_);
+
+    if (stream.unicast)
+    {
+      data_socket_ = &commands_.socket();
+      commands_.stop_receiving();
+    }
+    else
+    {
+      // Create the socket so that multiple may be bound to the same address.
+      boost::asio::ip::udp::endpoint listen_endpoint(
+          stream.listen_address, stream.port);
+      socket_.open(listen_endpoint.protocol());
+      socket_.set_option(boost::asio::ip::udp::socket::reuse_address(true));
+      socket_.bind(listen_endpoint);
+
+      // Join the multicast group.
+      socket_.set_option(
+          boost::asio::ip::multicast::join_group(stream.multicast_address));
+      data_socket_ = &socket_;
+    }
+
+    if (receive_buffer_request_ > 0)
+    {
+      set_receive_buffer_size(*data_socket_, receive_buffer_request_);
+    }
+    receive_buffer_ = receive_buffer_size(*data_socket_);
+    if (receive_buffer_request_ == 0)
+    {
+      receive_buffer_request_ = receive_buffer_;
+    }
+
+    // Socket drops and kernel receive timestamps come with the batched and
+    // io_uring receives only.
+    drop_count_ = batch_.enable_drop_count(*data_socket_);
+    if (options.measure_latency)
+    {
+      latency_.reset(new FrameLatency());
+      latency_->SetServerClockFrequency(context_.Server().HighResClockFrequency);
+    }
+    timestamps_ = latency_ || recorder_;
+    if (timestamps_ && !batch_.enable_timestamps(*data_socket_))
+    {
+      std::cerr << "no kernel receive timestamps, measuring from when "
+        "datagrams are read" << std::endl;
+    }
+
+    // With decode workers, this thread only receives; frames are decoded
+    // in parallel and printed in the order they were received.
+    if (options.decode_workers > 0)
+    {
+      pipeline_.reset(new DecodePipeline(options.decode_workers, PIPELINE_SLOTS,
+          [this](const sDecodedFrame& frame)
+          {
+            deliver(frame);
+          }));
+    }
+
+    // Busy polling leaves the data socket to poll_data().
+    if (options.busy_poll && !set_busy_poll(*data_socket_, BUSY_POLL_US))
+    {
+      std::cerr << "SO_BUSY_POLL not permitted, polling the socket only"
+        << std::endl;
+    }
+    if (!(options.uring && start_uring()))
+    {
+      start_receive();
+    }
+    // Replies to the commands arrive with the frames of a unicast stream.
+    commands_.set_unsolicited_handler(
+        [this](const char* data, std::size_t length)
+        {
+          handle_message(data, length, commands_.server());
+        });
+    if (stream.unicast)
+    {
+      send_keepalive();
+    }
+    request_descriptions();
+
+    // Servers before NatNet 3 have no timestamps to map.
+    clock_sync_.SetServerClockFrequency(context_.Server().HighResClockFrequency);
+    if (context_.Server().HighResClockFrequency != 0)
+    {
+      send_echo();
+    }
+
+    if (print_stats_ || latency_)
+    {
+      stats_.cpu_time = process_cpu_time();
+      reported_stats_ = stats_;
+      report_stats();
+    }
+
+    // The receive thread is the one constructing the receiver. The workers
+    // were created before it is tuned, so they do not inherit its CPU.
+    tune_threads(options.cpus, options.realtime);
+  }
+
+  // --busy-poll: take what is queued on the data socket, without waiting.
+  // Called in a loop on the thread running the io_context, in between
+  // io_context.poll() calls that run the command and timer handlers, so
+  // that no reactor wakeup sits between a datagram and its frame.
+  std::size_t poll_data()
   {
-    // Create the socket so that multiple may be bound to the same address.
-    boost::asio::ip::udp::endpoint listen_endpoint(
-        listen_address, PORT_DATA);
-    socket_.open(listen_endpoint.protocol());
-    socket_.set_option(boost::asio::ip::udp::socket::reuse_address(true));
-    socket_.bind(listen_endpoint);
+    if (uring_)
+    {
+      std::size_t count = handle_uring();
+      stats_.wakeups += (count > 0);
+      return count;
+    }
+
+    boost::system::error_code ec;
+    std::uint64_t receive_calls = batch_.receive_calls();
+    std::size_t count = batch_.receive(*data_socket_, ec);
+    stats_.receive_calls += batch_.receive_calls() - receive_calls;
+    if (count == 0)
+    {
+      return 0;
+    }
+
+    ++stats_.wakeups;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      handle_datagram(batch_.data(i), batch_.length(i), batch_.sender(i),
+          batch_.timestamp(i), batch_.truncated(i));
+    }
+    stream_.SetSocketDrops(batch_.socket_drops());
+    check_receive_buffer();
+    return count;
+  }
 
-    // Join the multicast group.
-    socket_.set_option(
-        boost::asio::ip::multicast::join_group(multicast_address));
+  // Continuity of the frame numbers and datagrams lost on the way. Safe to
+  // use from any thread.
+  sStreamCounters stream_counters() const
+  {
+    return stream_.Snapshot();
+  }
 
-    do_receive();
+  // Server clock mapping; frame timestamps converted with
+  // clock_sync().HostTicksToLocalNs() are in realtime nanoseconds. Safe to
+  // use from any thread.
+  const ClockSync& clock_sync() const
+  {
+    return clock_sync_;
   }
 
 private:
+  // The asio receive of the data socket, unless busy polling.
+  void start_receive()
+  {
+    if (busy_poll_)
+    {
+      return;
+    }
+    if (batch_.capacity() > 1 || timestamps_)
+    {
+      do_receive_batch();
+    }
+    else
+    {
+      do_receive();
+    }
+  }
+
+  // --uring: one multishot receive keeps filling the buffers of uring_, so
+  // that a wakeup takes every datagram waiting without a system call and
+  // decodes it where the kernel put it. Where the kernel has no io_uring
+  // (or it is disabled), the asio receive takes over.
+  bool start_uring()
+  {
+    uring_.reset(new uring_batch(batch_.capacity(),
+        std::max(URING_BUFFERS, 2 * batch_.capacity()), MAX_PACKETSIZE));
+    boost::system::error_code ec;
+    if (!uring_->start(*data_socket_, timestamps_, drop_count_, ec))
+    {
+      std::cerr << "io_uring receive not available (" << ec.message()
+        << "), using the asio receive" << std::endl;
+      uring_.reset();
+      return false;
+    }
+    if (!busy_poll_)
+    {
+      // The descriptor closes its own duplicate of the ring's.
+      uring_wait_.assign(::dup(uring_->native_handle()));
+      do_receive_uring();
+    }
+    return true;
+  }
+
+  // Wait until completions are waiting on the ring, then take them all.
+  void do_receive_uring()
+  {
+    uring_wait_.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+        [this](boost::system::error_code ec)
+        {
+          if (ec)
+          {
+            if (ec != boost::asio::error::operation_aborted)
+            {
+              std::cerr << "async_wait error: " << ec.message() << std::endl;
+            }
+            return;
+          }
+
+          ++stats_.wakeups;
+          handle_uring();
+          if (uring_)
+          {
+            do_receive_uring();
+          }
+        });
+  }
+
+  // Handle the datagrams completed on the ring so far. Their buffers go
+  // back to the kernel on the next receive, after the frames are decoded
+  // (or copied into the pipeline).
+  std::size_t handle_uring()
+  {
+    std::size_t total = 0;
+    std::size_t count = 0;
+    do
+    {
+      boost::system::error_code ec;
+      std::uint64_t enter_calls = uring_->enter_calls();
+      count = uring_->receive(ec);
+      stats_.receive_calls += uring_->enter_calls() - enter_calls;
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        handle_datagram(uring_->data(i), uring_->length(i), uring_->sender(i),
+            uring_->timestamp(i), uring_->truncated(i));
+      }
+      total += count;
+
+      if (ec == boost::asio::error::operation_not_supported)
+      {
+        std::cerr << "io_uring multishot receive not supported, using the "
+          "asio receive" << std::endl;
+        uring_wait_.close();
+        uring_.reset();
+        start_receive();
+        return total;
+      }
+      if (ec && ec != boost::asio::error::would_block)
+      {
+        std::cerr << "io_uring receive error: " << ec.message() << std::endl;
+      }
+    }
+    while (count == uring_->capacity());
+
+    stream_.SetSocketDrops(uring_->socket_drops());
+    check_receive_buffer();
+    return total;
+  }
+
   void do_receive()
   {
-    socket_.async_receive_from(
+    data_socket_->async_receive_from(
         boost::asio::buffer(data_.data(), data_.size()), sender_endpoint_,
-        [this](boost::system::error_code ec, std::size_t /*length*/)
+        [this](boost::system::error_code ec, std::size_t length)
         {
           if (!ec)
           {
-            // std::cout.write(data_.data(), length);
-            // std::cout << std::endl;
-            Unpack(data_.data());
-
+            ++stats_.wakeups;
+            ++stats_.receive_calls;
+            handle_datagram(data_.data(), length, sender_endpoint_, 0, false);
+            check_receive_buffer();
             do_receive();
           } else {
             std::cerr << "async_receive_from error: " << ec.message() << std::endl;
@@ -70,52 +491,922 @@ private:
         });
   }
 
+  // Wait until the data socket is readable, then take everything queued on
+  // it, up to a batch, with a single receive call.
+  void do_receive_batch()
+  {
+    data_socket_->async_wait(udp::socket::wait_read,
+        [this](boost::system::error_code ec)
+        {
+          if (ec)
+          {
+            std::cerr << "async_wait error: " << ec.message() << std::endl;
+            return;
+          }
+
+          ++stats_.wakeups;
+          std::uint64_t receive_calls = batch_.receive_calls();
+          std::size_t count = batch_.receive(*data_socket_, ec);
+          stats_.receive_calls += batch_.receive_calls() - receive_calls;
+          if (ec && ec != boost::asio::error::would_block)
+          {
+            std::cerr << "receive error: " << ec.message() << std::endl;
+            return;
+          }
+
+          for (std::size_t i = 0; i < count; ++i)
+          {
+            handle_datagram(batch_.data(i), batch_.length(i), batch_.sender(i),
+                batch_.timestamp(i), batch_.truncated(i));
+          }
+          stream_.SetSocketDrops(batch_.socket_drops());
+          check_receive_buffer();
+          do_receive_batch();
+        });
+  }
+
+  // received: receive time in realtime nanoseconds, 0 if not measured.
+  // truncated: the socket cut the datagram to the buffer size.
+  void handle_datagram(const char* data, std::size_t length,
+      const udp::endpoint& sender, std::int64_t received, bool truncated)
+  {
+    ++stats_.datagrams;
+    if (recorder_ && recorder_->IsRecording()
+        && !recorder_->Record(data, length, received, context_.Major(),
+          context_.Minor(), truncated)
+        && recorder_->Failed())
+    {
+      std::cerr << "recording stopped, cannot create the next segment: "
+        << strerror(recorder_->Error()) << std::endl;
+      recorder_->Stop();
+    }
+
+    int messageID = 0;
+    int nBytes = 0;
+    if (length >= 4)
+    {
+      DecodePacketHeader(data, messageID, nBytes);
+    }
+
+    // A packet split by natnetRepeater, handled once its last part is in.
+    // It was received when that part was.
+    if (messageID == NAT_SUBPACKET && !truncated)
+    {
+      if (subpackets_.Add(data, length) == SubPacketResult_Complete)
+      {
+        handle_packet(subpackets_.Packet(), subpackets_.PacketLength(),
+            sender, received, false);
+      }
+      return;
+    }
+    handle_packet(data, length, sender, received, truncated);
+  }
+
+  void handle_packet(const char* data, std::size_t length,
+      const udp::endpoint& sender, std::int64_t received, bool truncated)
+  {
+    int messageID = 0;
+    int nBytes = 0;
+    if (length >= 4)
+    {
+      DecodePacketHeader(data, messageID, nBytes);
+    }
+    if (messageID == NAT_COMPACTFRAME)
+    {
+      handle_compact_frame(data, length, sender, received, truncated);
+      return;
+    }
+    if (messageID != NAT_FRAMEOFDATA)
+    {
+      if (!(unicast_ && commands_.handle_reply(data, length)))
+      {
+        handle_message(data, length, sender);
+      }
+      return;
+    }
+
+    if (truncated || static_cast<std::size_t>(nBytes) + 4 > length)
+    {
+      stream_.AddTruncated();
+      ++dropped_packets_;
+      std::cerr << "dropped packet " << dropped_packets_ << " from "
+        << sender << ": truncated" << std::endl;
+      return;
+    }
+    if (pipeline_)
+    {
+      push_frame(data, length, sender, received);
+      return;
+    }
+
+    // The frame returns to the pool when the handle goes out of scope.
+    FramePool<sDecodedFrame>::Handle frame = frames_.Acquire();
+    PacketError error = context_.HandlePacket(data, length, messageID, frame.get());
+    frame->times.received = received;
+    frame->times.decoded = received ? RealtimeNanoseconds() : 0;
+    if (error != PacketError_None)
+    {
+      ++dropped_packets_;
+      std::cerr << "dropped packet " << dropped_packets_ << " from "
+        << sender << ": " << PacketErrorString(error) << std::endl;
+      return;
+    }
+    deliver(*frame);
+  }
+
+  // A frame of a natnetRepeater --compact stream. Each one refers to the one
+  // before, so they are decoded here in order, decode workers or not.
+  void handle_compact_frame(const char* data, std::size_t length,
+      const udp::endpoint& sender, std::int64_t received, bool truncated)
+  {
+    if (truncated)
+    {
+      stream_.AddTruncated();
+      ++dropped_packets_;
+      std::cerr << "dropped packet " << dropped_packets_ << " from "
+        << sender << ": truncated" << std::endl;
+      return;
+    }
+
+    FramePool<sDecodedFrame>::Handle frame = frames_.Acquire();
+    CompactStreamResult result = compact_.Decode(data, length, *frame);
+    frame->times.received = received;
+    frame->times.decoded = received ? RealtimeNanoseconds() : 0;
+    if (result == CompactStream_Malformed)
+    {
+      ++dropped_packets_;
+      std::cerr << "dropped packet " << dropped_packets_ << " from "
+        << sender << ": malformed compact frame" << std::endl;
+      return;
+    }
+    // Deltas waiting for a keyframe and stale frames are only counted.
+    if (result != CompactStream_OK)
+    {
+      return;
+    }
+    deliver(*frame);
+  }
+
+  // The consumers of decoded frames, for every path: called on the
+  // io_context thread, and on the decode workers with --workers (compact
+  // frames are still decoded here), so one frame at a time.
+  // Only frames that decoded enter the continuity counters, so a bad
+  // datagram cannot make the real frame of its number a duplicate. The
+  // decode workers deliver in frame number order, having dropped duplicates
+  // and late frames as stale themselves.
+  void deliver(const sDecodedFrame& frame)
+  {
+    std::lock_guard<std::mutex> lock(deliver_mutex_);
+    if (stream_.AddFrame(frame.data.iFrame) == FrameOrder_Duplicate)
+    {
+      return;
+    }
+    check_descriptions(frame.data.params);
+    delivered_frames_.fetch_add(1, std::memory_order_relaxed);
+    if (!ring_name_.empty())
+    {
+      publish(frame);
+    }
+    if (print_frames_)
+    {
+      VisitFrame(frame.data, printer_);
+    }
+    if (latency_)
+    {
+      latency_->Record(frame.data, frame.times, RealtimeNanoseconds());
+    }
+  }
+
+  void push_frame(const char* data, std::size_t length,
+      const udp::endpoint& sender, std::int64_t received)
+  {
+    // The workers validate the frame; it is accounted when delivered.
+    PacketError error = context_.AdmitFrame(data, length);
+    if (error != PacketError_None)
+    {
+      ++dropped_packets_;
+      std::cerr << "dropped packet " << dropped_packets_ << " from "
+        << sender << ": " << PacketErrorString(error) << std::endl;
+      return;
+    }
+    if (!pipeline_->Push(data, length, context_, received))
+    {
+      ++dropped_packets_;
+      std::cerr << "dropped packet " << dropped_packets_ << " from "
+        << sender << ": decode pipeline full" << std::endl;
+    }
+  }
+
+  // --publish: a frame that does not fit the ring replaces it with a larger
+  // one, which its readers open again. Runs on the thread delivering frames.
+  void publish(const sDecodedFrame& frame)
+  {
+    if (!ring_.IsOpen() && !create_ring(FrameCapacityOf(frame.data)))
+    {
+      return;
+    }
+    if (ring_.Publish(frame.data, frame.times) > 0)
+    {
+      sFrameCapacity capacity = MaxFrameCapacity(ring_.Capacity(),
+          FrameCapacityOf(frame.data));
+      if (create_ring(capacity))
+      {
+        ring_.Publish(frame.data, frame.times);
+      }
+    }
+  }
+
+  // Room for every described object, so that the ring is not replaced
+  // each time one comes into view.
+  bool create_ring(const sFrameCapacity& capacity)
+  {
+    sFrameCapacity described =
+      FrameCapacityFromDescriptions(*context_.Descriptions());
+    if (!ring_.Create(ring_name_.c_str(), MaxFrameCapacity(capacity, described)))
+    {
+      std::cerr << "cannot create shared memory ring " << ring_name_ << ": "
+        << strerror(errno) << ", not publishing" << std::endl;
+      ring_name_.clear();
+      return false;
+    }
+    std::cerr << "publishing frames to shared memory ring " << ring_name_
+      << std::endl;
+    return true;
+  }
+
+  // --cpu: the calling thread goes to the first CPU, the decode workers to
+  // the others in turn. --realtime: SCHED_FIFO for all of them.
+  void tune_threads(const std::vector<int>& cpus, bool realtime)
+  {
+    int workers = pipeline_ ? pipeline_->Workers() : 0;
+    for (int i = 0; i < workers && cpus.size() > 1; ++i)
+    {
+      int cpu = cpus[1 + i % (cpus.size() - 1)];
+      if (!PinThread(pipeline_->Worker(i), cpu))
+      {
+        std::cerr << "cannot pin decode worker " << i << " to CPU " << cpu << std::endl;
+      }
+    }
+    for (int i = 0; i < workers && realtime; ++i)
+    {
+      if (!SetRealtimeScheduling(pipeline_->Worker(i), REALTIME_PRIORITY))
+      {
+        std::cerr << "real-time scheduling not permitted for decode workers" << std::endl;
+        break;
+      }
+    }
+    if (!cpus.empty() && !PinCurrentThread(cpus[0]))
+    {
+      std::cerr << "cannot pin the receive thread to CPU " << cpus[0] << std::endl;
+    }
+    if (realtime && !SetCurrentThreadRealtimeScheduling(REALTIME_PRIORITY))
+    {
+      std::cerr << "real-time scheduling not permitted for the receive thread" << std::endl;
+    }
+  }
+
+  // --rcvbuf auto: the socket dropped datagrams (or, where it cannot count
+  // them, frames went missing), so give it more room.
+  void check_receive_buffer()
+  {
+    if (!grow_receive_buffer_)
+    {
+      return;
+    }
+    sStreamCounters counters = stream_.Snapshot();
+    std::uint64_t losses = drop_count_ ? counters.nSocketDrops : counters.nMissing;
+    if (losses == losses_seen_)
+    {
+      return;
+    }
+    losses_seen_ = losses;
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (receive_buffer_request_ >= RCVBUF_AUTO_MAX
+        || now - last_receive_buffer_growth_ < RCVBUF_GROW_INTERVAL)
+    {
+      return;
+    }
+    last_receive_buffer_growth_ = now;
+    receive_buffer_request_ = std::min(receive_buffer_request_ * 2, RCVBUF_AUTO_MAX);
+    receive_buffer_ = set_receive_buffer_size(*data_socket_, receive_buffer_request_);
+    std::cerr << "receive buffer grown to " << receive_buffer_ << " bytes after "
+      << losses << (drop_count_ ? " socket drops" : " missing frames") << std::endl;
+  }
+
+  // Messages other than frames: replies to the requests of this client,
+  // late ones included, and descriptions the server sends on its own.
+  void handle_message(const char* data, std::size_t length,
+      const udp::endpoint& sender)
+  {
+    uint64_t generation = context_.Descriptions()->Generation();
+    int messageID = 0;
+    PacketError error = context_.HandlePacket(data, length, messageID, nullptr);
+    if (error != PacketError_None)
+    {
+      std::cerr << "bad message from " << sender << ": "
+        << PacketErrorString(error) << std::endl;
+    }
+    else if (messageID == NAT_MODELDEF)
+    {
+      if (recorder_)
+      {
+        recorder_->RecordModelDef(data, length, RealtimeNanoseconds(),
+            context_.Major(), context_.Minor());
+      }
+      report_descriptions(generation);
+    }
+    else if (messageID == NAT_ECHORESPONSE)
+    {
+      handle_echo(data, length, RealtimeNanoseconds());
+    }
+  }
+
+  // Frames keep being decoded against the current descriptions until the
+  // ones requested when a frame flags a change arrive. Called while
+  // delivering, so the request is made on the io_context thread.
+  void check_descriptions(uint16_t params)
+  {
+    if (params & FRAME_PARAMS_TRACKED_MODELS_CHANGED)
+    {
+      boost::asio::post(socket_.get_executor(),
+          [this]()
+          {
+            request_descriptions();
+          });
+    }
+  }
+
+  // Ask the server for its data descriptions, unless a request is already
+  // outstanding.
+  void request_descriptions()
+  {
+    if (model_request_pending_)
+    {
+      return;
+    }
+    model_request_pending_ = true;
+
+    commands_.request(model_request_, NAT_MODELDEF, MODELDEF_POLICY,
+        [this](const boost::system::error_code& ec, const char* reply,
+          std::size_t length)
+        {
+          model_request_pending_ = false;
+          if (ec)
+          {
+            std::cerr << "NAT_REQUEST_MODELDEF failed: " << ec.message() << std::endl;
+            return;
+          }
+          handle_message(reply, length, commands_.server());
+        });
+  }
+
+  // A unicast server stops streaming to a client it has not heard from for
+  // a while.
+  void send_keepalive()
+  {
+    commands_.send(keepalive_);
+
+    keepalive_timer_.expires_after(KEEPALIVE_INTERVAL);
+    keepalive_timer_.async_wait(
+        [this](boost::system::error_code ec)
+        {
+          if (!ec)
+          {
+            send_keepalive();
+          }
+        });
+  }
+
+  // Echo requests carry their send time, which the response returns
+  // together with the server clock.
+  void send_echo()
+  {
+    std::vector<char> request;
+    ClockSync::BuildRequest(RealtimeNanoseconds(), request);
+    commands_.request(std::move(request), NAT_ECHORESPONSE, ECHO_POLICY,
+        [this](const boost::system::error_code& ec, const char* reply,
+          std::size_t length)
+        {
+          if (!ec)
+          {
+            handle_echo(reply, length, RealtimeNanoseconds());
+          }
+        });
+
+    echo_timer_.expires_after(ECHO_INTERVAL);
+    echo_timer_.async_wait(
+        [this](boost::system::error_code ec)
+        {
+          if (!ec)
+          {
+            send_echo();
+          }
+        });
+  }
+
+  // The command client only checks the message ID of a reply, so the
+  // response is checked against the length of the datagram here.
+  void handle_echo(const char* packet, std::size_t length,
+      std::int64_t received)
+  {
+    if (clock_sync_.AddResponse(packet, length, received) && latency_
+        && clock_sync_.Synchronized())
+    {
+      latency_->SetServerClockOffset(clock_sync_.Status().offset);
+    }
+  }
+
+  // The context builds the new description set next to the current one,
+  // which stays in use until it is swapped out.
+  void report_descriptions(uint64_t previous_generation)
+  {
+    std::shared_ptr<const DataDescriptionCache> descriptions =
+        context_.Descriptions();
+    if (descriptions->Generation() == previous_generation)
+    {
+      return;
+    }
+    const sDescriptionChanges& changes = descriptions->LastChanges();
+    std::cerr << "data descriptions: " << changes.nDecoded << " new or changed, "
+      << changes.nUnchanged << " unchanged, " << changes.nRemoved << " removed"
+      << std::endl;
+  }
+
+  void report_stats()
+  {
+    stats_timer_.expires_after(STATS_INTERVAL);
+    stats_timer_.async_wait(
+        [this](boost::system::error_code ec)
+        {
+          if (ec)
+          {
+            return;
+          }
+          stats_.cpu_time = process_cpu_time();
+          stats_.frames = delivered_frames_.load(std::memory_order_relaxed);
+          if (print_stats_)
+          {
+            print_receive_stats(std::cerr, reported_stats_, stats_);
+            print_stream_stats();
+            print_subpacket_stats();
+            print_compact_stats();
+            print_record_stats();
+            print_clock_stats();
+            print_pipeline_stats();
+          }
+          if (latency_)
+          {
+            latency_->Print(stderr);
+            write_latency_csv();
+          }
+          reported_stats_ = stats_;
+          report_stats();
+        });
+  }
+
+  // Continuity of the stream, as delivered. With decode workers the frames
+  // arrive here in order: the duplicates and late frames are the pipeline's
+  // stale ones, and its skipped frames are the gaps here.
+  void print_stream_stats()
+  {
+    sStreamCounters stream = stream_.Snapshot();
+    char line[256];
+    snprintf(line, sizeof(line), "stream: %llu frames, %llu gaps "
+        "(%llu missing), %llu duplicates, %llu out of order, "
+        "%llu restarts, %llu truncated, %llu socket drops, "
+        "receive buffer %zu bytes",
+        (unsigned long long)stream.nReceived,
+        (unsigned long long)stream.nGaps,
+        (unsigned long long)stream.nMissing,
+        (unsigned long long)stream.nDuplicates,
+        (unsigned long long)stream.nOutOfOrder,
+        (unsigned long long)stream.nRestarts,
+        (unsigned long long)stream.nTruncated,
+        (unsigned long long)stream.nSocketDrops, receive_buffer_);
+    std::cerr << line << std::endl;
+  }
+
+  // Reassembly of NAT_SUBPACKET datagrams, once any arrived.
+  void print_subpacket_stats()
+  {
+    if (subpackets_.Counters().nSubPackets == 0)
+    {
+      return;
+    }
+    const sReassemblyCounters& split = subpackets_.Counters();
+    char line[256];
+    snprintf(line, sizeof(line), "subpackets: %llu received, "
+        "%llu packets reassembled, %llu incomplete, %llu duplicates, "
+        "%llu stale, %llu invalid",
+        (unsigned long long)split.nSubPackets,
+        (unsigned long long)split.nPackets,
+        (unsigned long long)split.nIncomplete,
+        (unsigned long long)split.nDuplicates,
+        (unsigned long long)split.nStale,
+        (unsigned long long)split.nInvalid);
+    std::cerr << line << std::endl;
+  }
+
+  // Decoding of NAT_COMPACTFRAME packets, once any arrived.
+  void print_compact_stats()
+  {
+    if (compact_.Counters().nBytes == 0)
+    {
+      return;
+    }
+    const sCompactStreamCounters& compact = compact_.Counters();
+    char line[256];
+    snprintf(line, sizeof(line), "compact: %llu keyframes, "
+        "%llu deltas, %llu waiting for a keyframe, %llu stale, "
+        "%llu malformed, %.0f bytes/frame",
+        (unsigned long long)compact.nKeyframes,
+        (unsigned long long)compact.nDeltas,
+        (unsigned long long)compact.nWaiting,
+        (unsigned long long)compact.nStale,
+        (unsigned long long)compact.nMalformed,
+        (double)compact.nBytes / (compact.nKeyframes + compact.nDeltas));
+    std::cerr << line << std::endl;
+  }
+
+  // The --record recorder, when recording.
+  void print_record_stats()
+  {
+    if (!recorder_)
+    {
+      return;
+    }
+    sPacketRecorderCounters recorded = recorder_->Counters();
+    char line[256];
+    snprintf(line, sizeof(line), "record: %llu records, %.1f MB, "
+        "%llu segments, %llu dropped, %.1f MB most queued",
+        (unsigned long long)recorded.nRecords, recorded.nBytes / 1e6,
+        (unsigned long long)recorded.nSegments,
+        (unsigned long long)recorded.nDropped,
+        recorded.maxQueued / 1e6);
+    std::cerr << line << std::endl;
+    if (recorder_->Error() != 0)
+    {
+      std::cerr << "record: " << strerror(recorder_->Error()) << std::endl;
+    }
+  }
+
+  // Synchronization to the server clock, once synchronized.
+  void print_clock_stats()
+  {
+    if (!clock_sync_.Synchronized())
+    {
+      return;
+    }
+    sClockSyncStatus clock = clock_sync_.Status();
+    char line[256];
+    snprintf(line, sizeof(line), "clock: offset %.3f ms, drift %.2f ppm, "
+        "min round trip %.1f us, %llu echoes (%llu rejected)",
+        clock.offset / 1e6, clock.driftPpm, clock.minRoundTrip / 1e3,
+        (unsigned long long)clock.nSamples,
+        (unsigned long long)clock.nRejected);
+    std::cerr << line << std::endl;
+  }
+
+  // The decode workers, with --workers.
+  void print_pipeline_stats()
+  {
+    if (!pipeline_)
+    {
+      return;
+    }
+    sPipelineStats pipeline = pipeline_->Stats();
+    std::cerr << "pipeline: " << pipeline_->Workers() << " workers, "
+      << pipeline.nDelivered << " delivered, " << pipeline.nRingFull
+      << " ring full, " << pipeline.nInvalid << " invalid, "
+      << pipeline.nStale << " stale, " << pipeline.nReordered
+      << " reordered, " << pipeline.nSkipped << " skipped" << std::endl;
+  }
+
+  // Rewrite the --latency-csv file with the current rolling histograms.
+  void write_latency_csv()
+  {
+    if (latency_csv_.empty())
+    {
+      return;
+    }
+    FILE* fp = fopen(latency_csv_.c_str(), "w");
+    if (fp == nullptr)
+    {
+      std::cerr << "cannot write " << latency_csv_ << ": " << strerror(errno) << std::endl;
+      return;
+    }
+    latency_->WriteCsv(fp);
+    fclose(fp);
+  }
+
   boost::asio::ip::udp::socket socket_;
   boost::asio::ip::udp::endpoint sender_endpoint_;
   std::vector<char> data_;
+  datagram_batch batch_;
+  std::unique_ptr<uring_batch> uring_;
+  boost::asio::posix::stream_descriptor uring_wait_;
+  bool busy_poll_;
+  std::size_t receive_buffer_request_;
+  std::size_t receive_buffer_;       // as reported by the socket
+  bool grow_receive_buffer_;
+  bool drop_count_;                  // the batch reports socket drops
+  std::uint64_t losses_seen_;
+  std::chrono::steady_clock::time_point last_receive_buffer_growth_;
+  StreamCounters stream_;
+  SubPacketReassembler subpackets_;
+  CompactStreamDecoder compact_;
+  command_client& commands_;
+  bool unicast_;
+  // The multicast socket_, or the command socket of a unicast stream.
+  udp::socket* data_socket_;
+  std::vector<char> model_request_;
+  bool model_request_pending_;
+  std::vector<char> keepalive_;
+  boost::asio::steady_timer keepalive_timer_;
+  boost::asio::steady_timer echo_timer_;
+  ClockSync clock_sync_;
+  DecoderContext& context_;
+  FramePool<sDecodedFrame> frames_;
+  uint64_t dropped_packets_;
+  FramePrinter printer_;
+  bool print_frames_;
+  receive_stats stats_;
+  receive_stats reported_stats_;
+  // Frames passed to deliver(), whichever thread delivered them; copied
+  // into stats_.frames for the report.
+  std::atomic<std::uint64_t> delivered_frames_;
+  boost::asio::steady_timer stats_timer_;
+  bool print_stats_;
+  std::unique_ptr<FrameLatency> latency_;
+  std::string latency_csv_;
+  // Kernel receive timestamps are wanted, for latency_ or recorder_.
+  bool timestamps_;
+  PacketRecorder* recorder_;
+  // Serializes deliver(); guards the members below and printer_.
+  std::mutex deliver_mutex_;
+  std::string ring_name_;
+  SharedFrameWriter ring_;
+  // Last, so the workers stop before the members they use are destroyed.
+  std::unique_ptr<DecodePipeline> pipeline_;
 };
 
 int main(int argc, char* argv[])
 {
+  int status = 0;
   try
   {
     // Connect to command port to query version
 
-    if (argc != 2)
+    receiver_options options;
+    // Follow the server's streaming settings unless --unicast or --multicast.
+    bool force_unicast = false;
+    bool force_multicast = false;
+    // Without a host, connect to the first server that answers discovery.
+    std::string host;
+    int first_option = 1;
+    if (argc > 1 && strncmp(argv[1], "--", 2) != 0)
+    {
+      host = argv[1];
+      first_option = 2;
+    }
+    // --record: segments of at most record_segment bytes.
+    std::string record_path;
+    std::uint64_t record_segment = PACKET_LOG_SEGMENT_BYTES;
+    bool usage = false;
+    for (int i = first_option; i < argc && !usage; ++i)
+    {
+      std::string option = argv[i];
+      if (option == "--quiet")
+      {
+        options.print_frames = false;
+      }
+      else if (option == "--stats")
+      {
+        options.print_stats = true;
+      }
+      else if (option == "--latency")
+      {
+        options.measure_latency = true;
+      }
+      else if (option == "--latency-csv" && i + 1 < argc)
+      {
+        options.measure_latency = true;
+        options.latency_csv = argv[++i];
+      }
+      else if (option == "--unicast")
+      {
+        force_unicast = true;
+      }
+      else if (option == "--multicast")
+      {
+        force_multicast = true;
+      }
+      else if (option == "--batch" && i + 1 < argc)
+      {
+        long receive_batch = strtol(argv[++i], nullptr, 10);
+        usage = (receive_batch < 1 || receive_batch > 1024);
+        options.receive_batch = static_cast<std::size_t>(receive_batch);
+      }
+      else if (option == "--workers" && i + 1 < argc)
+      {
+        long decode_workers = strtol(argv[++i], nullptr, 10);
+        usage = (decode_workers < 1 || decode_workers > 256);
+        options.decode_workers = static_cast<int>(decode_workers);
+      }
+      else if (option == "--busy-poll")
+      {
+        options.busy_poll = true;
+      }
+      else if (option == "--uring")
+      {
+        options.uring = true;
+      }
+      else if (option == "--cpu" && i + 1 < argc)
+      {
+        usage = !ParseCpuList(argv[++i], options.cpus);
+      }
+      else if (option == "--realtime")
+      {
+        options.realtime = true;
+      }
+      else if (option == "--publish" && i + 1 < argc)
+      {
+        options.publish = argv[++i];
+      }
+      else if (option == "--record" && i + 1 < argc)
+      {
+        record_path = argv[++i];
+      }
+      else if (option == "--record-segment" && i + 1 < argc)
+      {
+        long megabytes = strtol(argv[++i], nullptr, 10);
+        usage = (megabytes < 1 || megabytes > 1024L * 1024);
+        record_segment = static_cast<std::uint64_t>(megabytes) * 1024 * 1024;
+      }
+      else if (option == "--rcvbuf" && i + 1 < argc)
+      {
+        std::string size = argv[++i];
+        options.grow_receive_buffer = (size == "auto");
+        if (!options.grow_receive_buffer)
+        {
+          long bytes = strtol(size.c_str(), nullptr, 10);
+          usage = (bytes < 1 || bytes > 1024L * 1024 * 1024);
+          options.receive_buffer = static_cast<std::size_t>(bytes);
+        }
+      }
+      else
+      {
+        usage = true;
+      }
+    }
+    usage = usage || (force_unicast && force_multicast);
+    if (usage)
     {
-      std::cerr << "Usage: packetClient <host>\n";
+      std::cerr << "Usage: packetClient [<host>] [--quiet] [--unicast | --multicast] [--batch <datagrams>] [--workers <threads>] [--rcvbuf <bytes>|auto] [--uring] [--busy-poll] [--cpu <list>] [--realtime] [--stats]"
+        " [--latency] [--latency-csv <file>] [--publish <name>] [--record <path> [--record-segment <MB>]]\n";
       return 1;
     }
 
-    boost::asio::io_context io_context_cmd;
+    // Before the io_context, so that it outlives the receiver.
+    PacketRecorder recorder;
+    if (!record_path.empty())
+    {
+      if (!recorder.Start(record_path.c_str(), record_segment))
+      {
+        std::cerr << "cannot record to " << record_path << ".*: "
+          << strerror(errno) << std::endl;
+        return 1;
+      }
+      options.recorder = &recorder;
+      printf("Recording to %s\n", recorder.SegmentPath(0).c_str());
+    }
 
-    udp::socket socket_cmd(io_context_cmd, udp::endpoint(udp::v4(), 0));
+    boost::asio::io_context io_context;
+    // Stop cleanly on a signal while recording, so the queued records are
+    // written and the segment is closed.
+    boost::asio::signal_set signals(io_context);
+    if (recorder.IsRecording())
+    {
+      signals.add(SIGINT);
+      signals.add(SIGTERM);
+      signals.async_wait(
+          [&](const boost::system::error_code& ec, int)
+          {
+            if (!ec)
+            {
+              io_context.stop();
+            }
+          });
+    }
+    DecoderContext context;
+    std::unique_ptr<server_discovery> discovery;
+    std::unique_ptr<command_client> commands;
+    std::unique_ptr<receiver> r;
 
-    udp::resolver resolver_cmd(io_context_cmd);
-    udp::endpoint endpoint_cmd = *resolver_cmd.resolve({udp::v4(), argv[1], std::to_string(PORT_COMMAND)});
+    // A unicast server streams to the socket that connected, so the
+    // receiver shares it with the commands.
+    auto connect_to = [&](const udp::endpoint& endpoint_cmd)
+    {
+      commands.reset(new command_client(io_context, endpoint_cmd));
+      commands->start_receiving();
 
-    std::vector<char> connectCmd;
-    buildConnectPacket(connectCmd);
-    socket_cmd.send_to(boost::asio::buffer(connectCmd.data(), connectCmd.size()), endpoint_cmd);
+      std::vector<char> connect;
+      command_client::build_request(NAT_CONNECT, connect);
+      commands->request(std::move(connect), NAT_SERVERINFO, CONNECT_POLICY,
+          [&](const boost::system::error_code& ec, const char* reply,
+            std::size_t length)
+          {
+            // The NAT_SERVERINFO reply sets the bitstream version of the context.
+            int messageID = 0;
+            PacketError error = ec ? PacketError_None
+              : context.HandlePacket(reply, length, messageID, nullptr);
+            if (ec || error != PacketError_None)
+            {
+              std::cerr << "No valid reply to NAT_CONNECT from "
+                << commands->server() << ": "
+                << (ec ? ec.message() : PacketErrorString(error)) << "\n";
+              status = 1;
+              commands->stop_receiving();
+              return;
+            }
+            const sSender& server = context.Server().Common;
+            printf("NatNetVersion: %d.%d.%d.%d\n", server.NatNetVersion[0], server.NatNetVersion[1],
+                server.NatNetVersion[2], server.NatNetVersion[3]);
+            printf("ServerVersion: %d.%d.%d.%d\n", server.Version[0], server.Version[1],
+                server.Version[2], server.Version[3]);
 
-    std::vector<char> reply(MAX_PACKETSIZE);
-    udp::endpoint sender_endpoint;
-    /*size_t reply_length =*/ socket_cmd.receive_from(
-        boost::asio::buffer(reply, MAX_PACKETSIZE), sender_endpoint);
+            data_stream stream = select_data_stream(context.Server(),
+                force_unicast, force_multicast);
+            if (stream.unicast)
+            {
+              printf("Data: unicast to port %d\n",
+                  commands->socket().local_endpoint().port());
+            }
+            else
+            {
+              printf("Data: multicast %s:%d\n",
+                  stream.multicast_address.to_string().c_str(), stream.port);
+            }
 
-    UnpackCommand(reply.data());
+            // Both requests are in flight at once.
+            print_setting(*commands, NATNET_REQUEST_GETFRAMERATE);
+            print_setting(*commands, NATNET_REQUEST_GETUNITSTOMILLIMETERS);
 
-    // Listen on multicast address
-    boost::asio::io_context io_context;
-    receiver r(io_context,
-        boost::asio::ip::address::from_string("0.0.0.0"),
-        boost::asio::ip::address::from_string(MULTICAST_ADDRESS));
-    io_context.run();
+            r.reset(new receiver(io_context, *commands, stream, context,
+                options));
+          });
+    };
+
+    if (host.empty())
+    {
+      // Keep looking until a server answers, e.g. while the network or
+      // the server is still starting.
+      printf("Looking for NatNet servers...\n");
+      discovery.reset(new server_discovery(io_context,
+          [&](const discovered_server& found)
+          {
+            const sSender& server = found.info.Common;
+            printf("Found %s %d.%d.%d.%d at %s (from %s)\n", server.szName,
+                server.Version[0], server.Version[1], server.Version[2],
+                server.Version[3],
+                found.command_endpoint.address().to_string().c_str(),
+                found.local_address.to_string().c_str());
+            discovery->stop();
+            connect_to(found.command_endpoint);
+          }, PORT_COMMAND));
+      discovery->start(DISCOVERY_INTERVAL);
+    }
+    else
+    {
+      udp::resolver resolver_cmd(io_context);
+      connect_to(*resolver_cmd.resolve({udp::v4(), host, std::to_string(PORT_COMMAND)}));
+    }
+
+    if (options.busy_poll)
+    {
+      // Connect as usual, then spin on the data socket.
+      while (!r && io_context.run_one())
+      {
+      }
+      for (unsigned pass = 0; r && !io_context.stopped(); ++pass)
+      {
+        r->poll_data();
+        if (pass % BUSY_POLL_IO_INTERVAL == 0)
+        {
+          io_context.poll();
+        }
+      }
+    }
+    else
+    {
+      io_context.run();
+    }
   }
   catch (std::exception& e)
   {
     std::cerr << "Exception: " << e.what() << "\n";
   }
 
-  return 0;
+  return status;
 }
\ No newline at end of file